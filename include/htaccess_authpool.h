@@ -0,0 +1,118 @@
+/**
+ * htaccess_authpool.h - Password hashing off the event loop
+ *
+ * A bcrypt or SHA-crypt check takes milliseconds to tens of milliseconds
+ * of CPU, and run inline it stalls every other connection of the worker.
+ * This pool runs the check on a small set of threads instead. The caller
+ * suspends its request, and the result comes back on the event loop via
+ * lsi_schedule_event(), where the completion callback can resume it.
+ *
+ * The queue of waiting checks is bounded: once it holds the configured
+ * number of jobs, authpool_submit() fails at once so the caller can turn
+ * the request away instead of letting the backlog grow.
+ *
+ * The same threads run other slow work handed over with authpool_run(),
+ * such as rebuilding a large RedirectMap; such tasks share the queue and
+ * its bound with the password checks.
+ *
+ * Threads are started lazily by the first submit in each process, so a
+ * pool configured before the server forks its workers runs in each
+ * worker rather than in the parent.
+ *
+ * Validates: Requirements 10.4
+ */
+#ifndef HTACCESS_AUTHPOOL_H
+#define HTACCESS_AUTHPOOL_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Hashing threads started per worker process by default. */
+#define AUTHPOOL_DEFAULT_THREADS 2
+
+/** Checks allowed to wait for a thread by default. */
+#define AUTHPOOL_DEFAULT_QUEUE 64
+
+/** authpool_submit() result when the queue is full. */
+#define AUTHPOOL_FULL (-2)
+
+/** Upper bound on the thread count accepted by authpool_init(). */
+#define AUTHPOOL_MAX_THREADS 16
+
+/**
+ * Completion callback, run on the event loop.
+ *
+ * @param arg     The pointer given to authpool_submit().
+ * @param result  1 if the password matched, 0 if not, -1 on error.
+ */
+typedef void (*authpool_done_cb)(void *arg, int result);
+
+/**
+ * Task run on a pool thread by authpool_run(). It must not touch state
+ * owned by the event loop; its return value is passed to the completion
+ * callback.
+ */
+typedef int (*authpool_task_fn)(void *arg);
+
+/**
+ * Pool counters (totals since authpool_init()).
+ */
+typedef struct {
+    uint64_t submitted; /* Checks accepted into the queue */
+    uint64_t rejected;  /* Checks turned away by a full queue */
+    uint64_t completed; /* Checks whose result was delivered */
+    int      queued;    /* Checks waiting for a thread right now */
+} authpool_stats_t;
+
+/**
+ * Configure the pool. Threads start on the first authpool_submit().
+ *
+ * @param threads    Hashing threads (1..AUTHPOOL_MAX_THREADS).
+ * @param queue_max  Checks allowed to wait for a thread (at least 1).
+ * @return 0 on success, -1 on invalid arguments.
+ */
+int authpool_init(int threads, int queue_max);
+
+/**
+ * Queue a password check.
+ *
+ * @p hash and @p password are used in place and must stay valid until
+ * @p done has been called; @p done is called exactly once for every
+ * accepted check, from the event loop.
+ *
+ * @return 0 if queued, AUTHPOOL_FULL if the queue is full, -1 if the pool
+ *         is not configured or cannot start.
+ */
+int authpool_submit(const char *hash, const char *password,
+                    authpool_done_cb done, void *arg);
+
+/**
+ * Queue @p task(@p arg) to run on a pool thread, followed by
+ * @p done(@p arg, result) on the event loop. The queue bound and the
+ * return values are those of authpool_submit(); if the task is dropped
+ * by authpool_destroy() before it starts, @p done gets -1.
+ */
+int authpool_run(authpool_task_fn task, authpool_done_cb done, void *arg);
+
+/**
+ * Read the pool counters.
+ *
+ * @return 0 on success, -1 if @p out is NULL.
+ */
+int authpool_get_stats(authpool_stats_t *out);
+
+/**
+ * Stop the threads and drop checks that have not started. Their
+ * callbacks are called at once, from the caller, with result -1. Checks
+ * already running finish and deliver their result.
+ */
+void authpool_destroy(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HTACCESS_AUTHPOOL_H */
@@ -0,0 +1,87 @@
+/**
+ * htaccess_byte_trie.h - Byte trie built from sorted keys
+ *
+ * Shared by the BruteForceProtectPath trie, the Redirect prefix trie and
+ * the goto trie of the regex set automaton. Keys are sorted once, and
+ * each node is built from the range of keys sharing its path, so the
+ * arrays are sized up front and every node's outgoing edges, and the
+ * keys ending in it, are contiguous ranges.
+ *
+ * Each key carries a 32-bit value (a rule or pattern index). Keys that
+ * end in a node are values[first_key .. first_key + num_keys), ordered
+ * by value, so the first is the smallest.
+ *
+ * Validates: Requirements 7.1, 7.2, 7.5, 12.1
+ */
+#ifndef HTACCESS_BYTE_TRIE_H
+#define HTACCESS_BYTE_TRIE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** byte_trie_next() result when there is no edge. */
+#define BYTE_TRIE_NONE UINT32_MAX
+
+/**
+ * Trie node. Edges are stored contiguously per node and sorted by byte.
+ */
+typedef struct {
+    uint32_t first_edge;  /* Index of the node's first edge */
+    uint16_t num_edges;   /* Edges out of this node (at most 256) */
+    uint32_t first_key;   /* Index in values of the first key ending here */
+    uint32_t num_keys;    /* Keys ending here */
+} byte_trie_node_t;
+
+typedef struct {
+    uint8_t  byte;        /* Byte followed */
+    uint32_t child;       /* Node reached */
+} byte_trie_edge_t;
+
+typedef struct {
+    byte_trie_node_t *nodes;   /* Node 0 is the root */
+    byte_trie_edge_t *edges;
+    uint32_t         *values;  /* Key values in sorted key order */
+    size_t            num_nodes;
+} byte_trie_t;
+
+/** One key to insert (NUL-terminated) and its value. */
+typedef struct {
+    const char *key;
+    uint32_t    value;
+} byte_trie_key_t;
+
+/**
+ * Sort keys by bytes, then by value, as byte_trie_build() expects. A key
+ * sorts right after every key that is a prefix of it.
+ */
+void byte_trie_sort_keys(byte_trie_key_t *keys, size_t count);
+
+/**
+ * Build a trie from @p count keys sorted by byte_trie_sort_keys(). An
+ * empty key set builds a root without edges.
+ *
+ * @return 0 on success, -1 on allocation failure (out is left empty).
+ */
+int byte_trie_build(const byte_trie_key_t *keys, size_t count,
+                    byte_trie_t *out);
+
+/**
+ * Child of @p node on @p byte, or BYTE_TRIE_NONE.
+ */
+uint32_t byte_trie_next(const byte_trie_t *trie, uint32_t node,
+                        unsigned char byte);
+
+/**
+ * Release the arrays held by a trie.
+ */
+void byte_trie_free(byte_trie_t *trie);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HTACCESS_BYTE_TRIE_H */
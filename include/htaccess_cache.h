@@ -5,6 +5,13 @@
  * invalidation. Each entry stores the parsed directive list and tracks
  * its own memory usage (≤ 2KB per entry).
  *
+ * A second table, keyed by target directory, holds effective configs
+ * (merged lists plus compiled matchers). Every stored file entry gets a
+ * fresh generation number; an effective config remembers the generation
+ * of each contributing level and is only reused while all still match.
+ * That table is bounded: once it holds CACHE_MAX_CONFIGS entries, storing
+ * another evicts the least recently used one.
+ *
  * Validates: Requirements 3.1, 3.2, 3.3, 3.4, 3.6
  */
 #ifndef HTACCESS_CACHE_H
@@ -15,12 +22,17 @@ extern "C" {
 #endif
 
 #include "htaccess_directive.h"
+#include "htaccess_config.h"
 #include <stddef.h>
+#include <stdint.h>
 #include <time.h>
 
 /** Maximum memory per cache entry in bytes. */
 #define CACHE_MAX_ENTRY_BYTES 2048
 
+/** Maximum number of effective configs kept (least recently used go). */
+#define CACHE_MAX_CONFIGS 1024
+
 /**
  * Cache entry — one per cached .htaccess file.
  * Stored in a singly-linked chain for hash collision resolution.
@@ -30,9 +42,23 @@ typedef struct cache_entry {
     time_t mtime;                     /* File modification time */
     htaccess_directive_t *directives; /* Parsed directive list (owned) */
     size_t memory_usage;              /* Estimated memory for this entry */
+    uint64_t generation;              /* Bumped on every put (never 0) */
     struct cache_entry *chain_next;   /* Next entry in same bucket */
 } cache_entry_t;
 
+/**
+ * Effective config entry — one per target directory.
+ */
+typedef struct config_entry {
+    char *target_dir;                 /* Target directory (hash key) */
+    uint64_t *level_gens;             /* Generation per level, 0 = no file */
+    int num_levels;                   /* Entries in level_gens */
+    htaccess_config_t *config;        /* Cached config (one reference) */
+    struct config_entry *chain_next;  /* Next entry in same bucket */
+    struct config_entry *lru_prev;    /* More recently used entry */
+    struct config_entry *lru_next;    /* Less recently used entry */
+} config_entry_t;
+
 /**
  * Hash table structure.
  */
@@ -40,6 +66,11 @@ typedef struct {
     cache_entry_t **buckets;  /* Array of bucket head pointers */
     size_t num_buckets;       /* Number of buckets */
     size_t num_entries;       /* Current number of stored entries */
+    config_entry_t **config_buckets; /* Effective configs by target dir */
+    size_t num_configs;       /* Current number of stored configs */
+    config_entry_t *lru_head; /* Most recently used config */
+    config_entry_t *lru_tail; /* Least recently used config */
+    uint64_t next_generation; /* Next file entry generation */
 } htaccess_cache_t;
 
 /**
@@ -62,6 +93,16 @@ int htaccess_cache_init(size_t initial_buckets);
 int htaccess_cache_get(const char *filepath, time_t current_mtime,
                        htaccess_directive_t **out_directives);
 
+/**
+ * Look up a cached entry and report its generation.
+ *
+ * Same as htaccess_cache_get(), additionally setting @p out_generation
+ * (if not NULL) to the entry's generation on a hit.
+ */
+int htaccess_cache_get_versioned(const char *filepath, time_t current_mtime,
+                                 htaccess_directive_t **out_directives,
+                                 uint64_t *out_generation);
+
 /**
  * Store or replace a cache entry.
  *
@@ -77,8 +118,36 @@ int htaccess_cache_get(const char *filepath, time_t current_mtime,
 int htaccess_cache_put(const char *filepath, time_t mtime,
                        htaccess_directive_t *directives);
 
+/**
+ * Look up the effective config of a target directory.
+ *
+ * @param target_dir  Target directory path.
+ * @param level_gens  Current generation of each level (0 = no file).
+ * @param num_levels  Number of levels.
+ * @param out_config  On hit, set to the config with a new reference that
+ *                    the caller must drop with htaccess_config_release().
+ * @return 0 on hit, -1 on miss or when any level generation differs.
+ */
+int htaccess_cache_get_config(const char *target_dir,
+                              const uint64_t *level_gens, int num_levels,
+                              htaccess_config_t **out_config);
+
+/**
+ * Store or replace the effective config of a target directory.
+ *
+ * The cache takes its own reference to @p config; the caller keeps
+ * theirs. A replaced or evicted config is released.
+ *
+ * @return 0 on success, -1 on allocation failure.
+ */
+int htaccess_cache_put_config(const char *target_dir,
+                              const uint64_t *level_gens, int num_levels,
+                              htaccess_config_t *config);
+
 /**
  * Destroy the global cache, freeing all entries and the table itself.
+ * Cached effective configs are released (still-borrowed ones survive
+ * until their last reference is dropped).
  * Safe to call even if htaccess_cache_init() was never called.
  */
 void htaccess_cache_destroy(void);
@@ -2,7 +2,13 @@
  * htaccess_cidr.h - CIDR parsing and matching for OLS .htaccess module
  *
  * Provides IPv4 CIDR notation parsing ("A.B.C.D/N") and IP-in-range
- * matching. Also supports the "all" keyword to match any IP address.
+ * matching. Also supports the "all" keyword to match any IP address, and
+ * compiled CIDR sets so directive values are parsed once at load time.
+ *
+ * The address engine used by the executors is family-neutral: every
+ * address is a 128-bit ip_addr_t, with IPv4 stored in its IPv4-mapped
+ * form (::ffff:A.B.C.D). An IPv4 rule "A.B.C.D/N" therefore becomes the
+ * 128-bit prefix /(96+N) and also matches IPv4-mapped IPv6 clients.
  *
  * All addresses and masks are stored in host byte order.
  *
@@ -11,6 +17,7 @@
 #ifndef HTACCESS_CIDR_H
 #define HTACCESS_CIDR_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -25,6 +32,43 @@ typedef struct {
     uint32_t mask;      /* Subnet mask (host byte order)     */
 } cidr_v4_t;
 
+/**
+ * 128-bit IP address in host byte order (hi = first 8 bytes on the wire).
+ * IPv4 addresses are held as IPv4-mapped IPv6 (::ffff:A.B.C.D).
+ */
+typedef struct {
+    uint64_t hi;
+    uint64_t lo;
+} ip_addr_t;
+
+/** Prefix length of the IPv4-mapped block (::ffff:0:0/96). */
+#define IP_V4_MAPPED_PREFIX 96
+
+/**
+ * Family-neutral CIDR range: network address (masked) and a prefix
+ * length in the 128-bit space. "all" is prefix length 0.
+ */
+typedef struct {
+    ip_addr_t network;    /* Network address, bits past prefix_len zeroed */
+    uint8_t   prefix_len; /* Prefix length [0..128] */
+} ip_cidr_t;
+
+/**
+ * Compiled CIDR set — the pre-parsed form of an IP-bearing directive value
+ * (Allow/Deny from, Require [not] ip, BruteForceWhitelist).
+ *
+ * Built once by the parser and normalized into the minimal list of
+ * sorted, disjoint closed intervals: ranges nested in or overlapping
+ * others, and ranges that touch, are merged. Starts and ends live in two
+ * flat arrays (one allocation) so a lookup is a binary search over the
+ * starts with no string handling or allocation.
+ */
+typedef struct {
+    ip_addr_t *first;   /* Interval starts, strictly ascending (owned) */
+    ip_addr_t *last;    /* Inclusive interval ends, parallel to first */
+    int        count;   /* Number of intervals */
+} cidr_set_t;
+
 /**
  * Parse a CIDR string into a cidr_v4_t structure.
  *
@@ -61,6 +105,104 @@ int cidr_match(const cidr_v4_t *cidr, uint32_t ip);
  */
 int ip_parse(const char *ip_str, uint32_t *out_ip);
 
+/**
+ * Build the IPv4-mapped 128-bit form of an IPv4 address.
+ */
+void ip_addr_from_v4(uint32_t v4, ip_addr_t *out);
+
+/**
+ * Return 1 if the address is IPv4-mapped (::ffff:0:0/96), 0 otherwise.
+ */
+int ip_addr_is_v4(const ip_addr_t *addr);
+
+/**
+ * Parse an IPv4 ("192.0.2.1") or IPv6 ("2001:db8::1", "::ffff:192.0.2.1")
+ * address. A trailing IPv6 zone ("%eth0") is ignored.
+ *
+ * @param str  Input string; surrounding whitespace is allowed.
+ * @param out  Output address.
+ * @return 0 on success, -1 on error.
+ */
+int ip_addr_parse(const char *str, ip_addr_t *out);
+
+/**
+ * Parse an IPv4 or IPv6 CIDR range.
+ *
+ * Supported formats:
+ *   - "A.B.C.D/N", "A.B.C.D"  — IPv4, N in [0..32] (mapped to /(96+N))
+ *   - "X:X::X/N",  "X:X::X"   — IPv6, N in [0..128]
+ *   - "all"                   — matches everything (prefix_len 0)
+ *
+ * @return 0 on success, -1 on error (invalid format / out-of-range).
+ */
+int ip_cidr_parse(const char *cidr_str, ip_cidr_t *out);
+
+/**
+ * Check whether an address falls within a range.
+ *
+ * @return 1 if the address matches, 0 otherwise.
+ */
+int ip_cidr_match(const ip_cidr_t *cidr, const ip_addr_t *addr);
+
+/**
+ * Compile a whitespace/comma separated CIDR list into a cidr_set_t.
+ *
+ * Tokens that fail ip_cidr_parse() are skipped, mirroring the
+ * request-time behaviour of ignoring invalid rules. IPv4 and IPv6
+ * entries may be mixed.
+ *
+ * @param list  Input list (e.g. "10.0.0.0/8 192.168.1.1"); may be NULL.
+ * @param out   Output set (must not be NULL). Zeroed on entry.
+ * @return Number of intervals after normalization, or -1 on allocation
+ *         failure.
+ */
+int cidr_set_compile(const char *list, cidr_set_t *out);
+
+/**
+ * Check whether an address matches any range of a compiled set.
+ * O(log n) branch-free binary search over the interval starts.
+ *
+ * @return 1 if matched, 0 otherwise (including NULL/empty sets).
+ */
+int cidr_set_match(const cidr_set_t *set, const ip_addr_t *addr);
+
+/**
+ * Build the normalized union of several compiled sets.
+ *
+ * @param out    Output set (must not be NULL). Zeroed on entry.
+ * @param sets   Input sets; NULL entries are skipped.
+ * @param nsets  Number of entries in sets.
+ * @return Number of intervals in the union, or -1 on allocation failure.
+ */
+int cidr_set_union(cidr_set_t *out, const cidr_set_t *const *sets, int nsets);
+
+/**
+ * Heap footprint of a compiled set in bytes.
+ */
+size_t cidr_set_memory(const cidr_set_t *set);
+
+/**
+ * Deep-copy a compiled set.
+ *
+ * @return 0 on success, -1 on allocation failure (dst is left empty).
+ */
+int cidr_set_copy(cidr_set_t *dst, const cidr_set_t *src);
+
+/**
+ * Release a compiled set's intervals and reset it to empty.
+ */
+void cidr_set_free(cidr_set_t *set);
+
+/**
+ * Match an IP against an uncompiled CIDR list string.
+ *
+ * Fallback for directives that were built without going through the
+ * parser. Tokenizes in place on the stack — no heap allocation.
+ *
+ * @return 1 if any token matches, 0 otherwise.
+ */
+int cidr_list_match(const char *list, const ip_addr_t *addr);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
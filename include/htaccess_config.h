@@ -0,0 +1,101 @@
+/**
+ * htaccess_config.h - Effective per-directory configuration
+ *
+ * An effective config is the merged directive list for one target
+ * directory together with the matchers compiled from it. It is built
+ * once by the DirWalker, stored in the cache keyed by target directory,
+ * and shared by every request for that directory until one of the
+ * contributing .htaccess files changes.
+ *
+ * Configs are reference counted: the cache holds one reference and each
+ * request that borrows the config holds another.
+ *
+ * Validates: Requirements 3.1, 13.1, 13.2
+ */
+#ifndef HTACCESS_CONFIG_H
+#define HTACCESS_CONFIG_H
+
+#include "htaccess_directive.h"
+#include "htaccess_exec_acl.h"
+#include "htaccess_exec_brute_force.h"
+#include "htaccess_exec_redirect.h"
+#include "htaccess_exec_require.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Effective configuration for one target directory.
+ */
+typedef struct htaccess_config {
+    htaccess_directive_t *directives;    /* Merged directive list (owned) */
+    acl_compiled_t        acl;           /* Compiled Order/Allow/Deny */
+    int                   acl_ready;     /* 0 if ACL compilation failed */
+    require_program_t     require;       /* Compiled Require tree */
+    int                   require_ready; /* 0 if Require compilation failed */
+    bf_path_trie_t        bf_paths;      /* Compiled BruteForceProtectPath */
+    int                   bf_paths_ready; /* 0 if trie compilation failed */
+    redirect_set_t        redirects;     /* Compiled Redirect(Match) */
+    int                   redirects_ready; /* 0 if compilation failed */
+    int                   refcount;      /* Outstanding references */
+} htaccess_config_t;
+
+/**
+ * Build an effective config from a merged directive list.
+ *
+ * Takes ownership of @p directives (also on failure). Compilation
+ * failures of individual matchers are not fatal: the matching *_ready
+ * flag stays 0 and executors fall back to scanning the list.
+ *
+ * @return New config with a reference count of 1, or NULL on
+ *         allocation failure.
+ */
+htaccess_config_t *htaccess_config_create(htaccess_directive_t *directives);
+
+/**
+ * Take an additional reference.
+ */
+void htaccess_config_retain(htaccess_config_t *cfg);
+
+/**
+ * Drop a reference; the config is freed when the last one goes.
+ * NULL is ignored.
+ */
+void htaccess_config_release(htaccess_config_t *cfg);
+
+/**
+ * Evaluate Order/Allow/Deny for a config, using the compiled sets when
+ * available. Same return values as exec_access_control().
+ */
+int htaccess_config_exec_acl(const htaccess_request_t *req,
+                             const htaccess_config_t *cfg);
+
+/**
+ * Evaluate Require for a config, using the compiled program when
+ * available. Same return values as exec_require().
+ */
+int htaccess_config_exec_require(const htaccess_request_t *req,
+                                 const htaccess_config_t *cfg);
+
+/**
+ * Request-phase brute force check for a config, matching protect paths
+ * with the compiled trie when available. Same return values as
+ * exec_brute_force_req().
+ */
+int htaccess_config_exec_brute_force(const htaccess_request_t *req,
+                                     const htaccess_config_t *cfg);
+
+/**
+ * Response-phase brute force accounting for a config. Same return
+ * values as exec_brute_force_resp_req().
+ */
+int htaccess_config_exec_brute_force_resp(const htaccess_request_t *req,
+                                          const htaccess_config_t *cfg,
+                                          int status);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* HTACCESS_CONFIG_H */
@@ -1,7 +1,7 @@
 /**
  * htaccess_directive.h - Directive data model for OLS .htaccess module
  *
- * Defines the directive_type_t enum (59 directive types: 28 v1 + 31 v2),
+ * Defines the directive_type_t enum (67 directive types: 28 v1 + 39 v2),
  * supporting enums (acl_order_t, bf_action_t), and the htaccess_directive_t
  * linked-list node structure with a union for type-specific fields.
  *
@@ -11,13 +11,15 @@
 #ifndef HTACCESS_DIRECTIVE_H
 #define HTACCESS_DIRECTIVE_H
 
+#include "htaccess_cidr.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /**
- * Directive type enumeration — covers all 59 supported .htaccess directives
- * (28 v1 + 31 v2).
+ * Directive type enumeration — covers all 67 supported .htaccess directives
+ * (28 v1 + 39 v2).
  *
  * IMPORTANT: v1 values (0-27) MUST NOT be reordered or removed.
  * New v2 values are appended after DIR_BRUTE_FORCE_THROTTLE_DURATION
@@ -96,6 +98,22 @@ typedef enum {
     DIR_BRUTE_FORCE_X_FORWARDED_FOR,   /* 56 */
     DIR_BRUTE_FORCE_WHITELIST,         /* 57 */
     DIR_BRUTE_FORCE_PROTECT_PATH,      /* 58 */
+
+    /* Brute force prefix aggregation */
+    DIR_BRUTE_FORCE_IPV4_PREFIX,       /* 59 */
+    DIR_BRUTE_FORCE_IPV6_PREFIX,       /* 60 */
+    DIR_BRUTE_FORCE_PREFIX_ATTEMPTS,   /* 61 */
+
+    /* Brute force response-phase accounting */
+    DIR_BRUTE_FORCE_FAILURE_STATUS,    /* 62 */
+
+    /* Group and per-user authorization */
+    DIR_AUTH_GROUP_FILE,               /* 63 */
+    DIR_REQUIRE_USER,                  /* 64 — value: user names */
+    DIR_REQUIRE_GROUP,                 /* 65 — value: group names */
+
+    /* Bulk redirects */
+    DIR_REDIRECT_MAP,                  /* 66 — value: map file path */
 } directive_type_t;
 
 /**
@@ -138,6 +156,7 @@ typedef struct htaccess_directive {
         struct {
             int   status_code;    /* HTTP status code (301, 302, etc.) */
             char *pattern;        /* RedirectMatch regex pattern */
+                                  /* (status_code also for RedirectMap) */
         } redirect;
 
         struct {
@@ -165,6 +184,7 @@ typedef struct htaccess_directive {
             int        window_sec;       /* Time window in seconds */
             bf_action_t action;          /* block or throttle */
             int        throttle_ms;      /* Throttle delay in milliseconds */
+            int        prefix_len;       /* Aggregation prefix (0 = off) */
         } brute_force;
 
         /* === v2 new fields === */
@@ -203,6 +223,18 @@ typedef struct htaccess_directive {
             char *methods;                         /* Space-separated HTTP methods */
             struct htaccess_directive *children;    /* Nested directive list */
         } limit;
+
+        /**
+         * IP-bearing directives (Allow/Deny from, Require [not] ip,
+         * BruteForceWhitelist) — value compiled by the parser.
+         * Without `compiled` (hand-built directives, allocation failure)
+         * executors fall back to value; a compiled set may be empty when
+         * no token of the value is a valid range.
+         */
+        struct {
+            cidr_set_t cidrs;                      /* Pre-parsed ranges (owned) */
+            int compiled;                          /* 1 once cidrs is built */
+        } ip;
     } data;
 
     struct htaccess_directive *next; /* Next node in linked list */
@@ -218,6 +250,19 @@ typedef struct htaccess_directive {
  */
 void htaccess_directives_free(htaccess_directive_t *head);
 
+/**
+ * Match an IPv4 or IPv6 address against an IP-bearing directive.
+ *
+ * Uses the compiled CIDR set when present; directives built by hand
+ * (without the parser) fall back to matching the raw value string.
+ *
+ * @param dir   Allow/Deny from, Require [not] ip or BruteForceWhitelist.
+ * @param addr  Client address (see ip_addr_parse()).
+ * @return 1 if any range matches, 0 otherwise.
+ */
+int htaccess_directive_ip_match(const htaccess_directive_t *dir,
+                                const ip_addr_t *addr);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
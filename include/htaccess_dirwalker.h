@@ -15,6 +15,7 @@ extern "C" {
 #endif
 
 #include "htaccess_directive.h"
+#include "htaccess_config.h"
 #include "ls.h"
 
 /**
@@ -39,6 +40,25 @@ htaccess_directive_t *htaccess_dirwalk(lsi_session_t *session,
                                        const char *doc_root,
                                        const char *target_dir);
 
+/**
+ * Get the effective config (merged directives plus compiled matchers)
+ * for target_dir.
+ *
+ * Walks the same levels as htaccess_dirwalk() to validate them against
+ * the cache, then reuses the cached config for target_dir when no level
+ * changed. Otherwise the levels are merged, compiled once and the result
+ * is cached for subsequent requests.
+ *
+ * @param session     LSIAPI session handle (may be NULL in tests).
+ * @param doc_root    Document root path.
+ * @param target_dir  Target directory path (must start with doc_root).
+ * @return Config with a reference owned by the caller (drop it with
+ *         htaccess_config_release()), or NULL if no directives found.
+ */
+htaccess_config_t *htaccess_dirwalk_config(lsi_session_t *session,
+                                           const char *doc_root,
+                                           const char *target_dir);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
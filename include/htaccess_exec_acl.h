@@ -10,12 +10,28 @@
 #define HTACCESS_EXEC_ACL_H
 
 #include "htaccess_directive.h"
+#include "htaccess_cidr.h"
+#include "htaccess_request.h"
 #include "ls.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * Compiled Order/Allow/Deny rules for one effective directory config.
+ *
+ * All Allow and Deny ranges are folded into two normalized interval
+ * sets, so redundant entries of generated blocklists disappear and a
+ * request costs two O(log n) binary searches over flat arrays.
+ */
+typedef struct {
+    acl_order_t order;      /* Effective Order (last one wins) */
+    int         active;     /* 0 when no Order/Allow/Deny present */
+    cidr_set_t  allow;      /* Union of all Allow from ranges */
+    cidr_set_t  deny;       /* Union of all Deny from ranges */
+} acl_compiled_t;
+
 /**
  * Execute access control evaluation over a directive list.
  *
@@ -41,6 +57,42 @@ extern "C" {
 int exec_access_control(lsi_session_t *session,
                         const htaccess_directive_t *directives);
 
+/**
+ * exec_access_control() using the client address already parsed into
+ * the request context.
+ */
+int exec_access_control_req(const htaccess_request_t *req,
+                            const htaccess_directive_t *directives);
+
+/**
+ * Compile the Order/Allow/Deny directives of a list into @p out.
+ *
+ * Uses each directive's parser-compiled CIDR set, falling back to its
+ * value string when the set is empty.
+ *
+ * @return 0 on success, -1 on allocation failure (out is left empty).
+ */
+int acl_compile(const htaccess_directive_t *directives, acl_compiled_t *out);
+
+/**
+ * Release the interval sets held by a compiled ACL.
+ */
+void acl_compiled_free(acl_compiled_t *acl);
+
+/**
+ * Execute access control against pre-compiled rules.
+ *
+ * Same semantics and return values as exec_access_control().
+ */
+int exec_access_control_compiled(lsi_session_t *session,
+                                 const acl_compiled_t *acl);
+
+/**
+ * exec_access_control_compiled() using the request context.
+ */
+int exec_access_control_compiled_req(const htaccess_request_t *req,
+                                     const acl_compiled_t *acl);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -1,8 +1,10 @@
 /**
  * htaccess_exec_auth.h - AuthType Basic executor
  *
- * Collects AuthType, AuthName, AuthUserFile, Require valid-user from
- * the directive list and validates the Authorization header.
+ * Collects AuthType, AuthName, AuthUserFile, AuthGroupFile and the
+ * Require valid-user/user/group lines from the directive list, validates
+ * the Authorization header and checks that a Require line admits the
+ * user.
  *
  * Validates: Requirements 10.1-10.9
  */
@@ -26,9 +28,53 @@ extern "C" {
 int exec_auth_basic(lsi_session_t *session,
                     const htaccess_directive_t *directives);
 
+/**
+ * Completion of an authentication that returned LSI_SUSPEND, run on the
+ * event loop.
+ *
+ * @param session  The suspended session, or NULL if it ended while the
+ *                 password was hashed; the callback must then only
+ *                 release @p arg.
+ * @param rc       LSI_OK if the credentials were accepted, LSI_ERROR if
+ *                 the response status (401) has been set.
+ * @param arg      The pointer given to exec_auth_basic_async().
+ */
+typedef void (*auth_resume_cb)(lsi_session_t *session, int rc, void *arg);
+
+/**
+ * Execute HTTP Basic authentication, hashing the password on the
+ * authpool threads when it has to be checked.
+ *
+ * Requests that can be decided without hashing (no credentials, unknown
+ * user, a recently verified password) complete synchronously, as does
+ * every request when the pool is not configured. When the pool's queue is
+ * full the request is answered 503 at once.
+ *
+ * @param session     LSIAPI session handle.
+ * @param directives  Head of the directive linked list; only read before
+ *                    this function returns.
+ * @param done        Called once, from the event loop, when a suspended
+ *                    check completes. NULL always checks inline.
+ * @param arg         Passed to @p done.
+ * @return LSI_OK if auth passes or is not required, LSI_ERROR if the
+ *         status was set (401/500/503), LSI_SUSPEND if @p done will be
+ *         called later.
+ */
+int exec_auth_basic_async(lsi_session_t *session,
+                          const htaccess_directive_t *directives,
+                          auth_resume_cb done, void *arg);
+
+/**
+ * Detach @p session from its pending password checks. Call when a
+ * session ends: a check still on the pool then completes without
+ * touching the session and calls its callback with a NULL session.
+ */
+void exec_auth_session_end(lsi_session_t *session);
+
 /**
  * Check a password against an htpasswd hash.
- * Supports: crypt, MD5 ($apr1$), bcrypt ($2y$).
+ * Supports: Apache MD5 ($apr1$), MD5-crypt ($1$), {SHA}, SHA-256/512-crypt
+ * ($5$, $6$) natively; bcrypt ($2y$), DES and others through libc crypt.
  *
  * @param hash      The hash string from htpasswd file.
  * @param password  The plaintext password to check.
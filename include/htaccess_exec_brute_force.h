@@ -2,14 +2,20 @@
  * htaccess_exec_brute_force.h - Brute force protection executor
  *
  * Implements per-IP failed attempt tracking with configurable thresholds.
- * Supports block (403) and throttle (delay) actions.
+ * Supports block (403) and throttle (delay) actions; throttled requests
+ * are suspended and resumed by a timer rather than holding the worker.
  *
  * Validates: Requirements 12.1, 12.2, 12.3, 12.4, 12.5, 12.6, 12.7, 12.8
  */
 #ifndef HTACCESS_EXEC_BRUTE_FORCE_H
 #define HTACCESS_EXEC_BRUTE_FORCE_H
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include "htaccess_byte_trie.h"
 #include "htaccess_directive.h"
+#include "htaccess_request.h"
 #include "ls.h"
 
 #ifdef __cplusplus
@@ -21,8 +27,57 @@ extern "C" {
 #define BF_DEFAULT_WINDOW_SEC        300
 #define BF_DEFAULT_THROTTLE_MS       1000
 
+/*
+ * Prefix aggregation defaults: IPv6 clients are also counted per /64
+ * (one subscriber allocation), IPv4 aggregation is opt-in. Unless
+ * BruteForcePrefixAttempts is set, a prefix may make this many times
+ * the per-address allowance.
+ */
+#define BF_DEFAULT_IPV4_PREFIX       0
+#define BF_DEFAULT_IPV6_PREFIX       64
+#define BF_PREFIX_ATTEMPTS_FACTOR    4
+
+/** Response statuses counted as failed attempts by default. */
+#define BF_DEFAULT_FAILURE_STATUS    "401 403"
+
+/**
+ * BruteForceProtectPath prefixes compiled into a byte trie.
+ *
+ * A path that extends another configured path is dropped at compile time,
+ * since the shorter one already protects it, so nodes where a path ends
+ * are leaves. One scan of the URI answers whether it is protected,
+ * however many paths there are.
+ */
+typedef struct {
+    byte_trie_t paths;      /* Kept paths; key values are unused */
+    int         num_paths;  /* BruteForceProtectPath entries seen */
+} bf_path_trie_t;
+
 /**
- * Execute brute force protection over a directive list.
+ * Compile the BruteForceProtectPath directives of a list into @p out.
+ *
+ * @return 0 on success, -1 on allocation failure (out is left empty).
+ */
+int bf_path_trie_compile(const htaccess_directive_t *directives,
+                         bf_path_trie_t *out);
+
+/**
+ * Whether @p uri starts with one of the compiled paths. A trie compiled
+ * from no paths matches nothing.
+ */
+int bf_path_trie_match(const bf_path_trie_t *trie, const char *uri);
+
+/**
+ * Release the arrays held by a compiled trie.
+ */
+void bf_path_trie_free(bf_path_trie_t *trie);
+
+/**
+ * Check and count one failed attempt in a single step.
+ *
+ * Used where the response status is not known: the call itself is
+ * treated as a failed attempt. The module hooks use
+ * exec_brute_force_req() and exec_brute_force_resp_req() instead.
  *
  * Scans directives for brute force configuration:
  *   - BruteForceProtection On/Off
@@ -30,11 +85,19 @@ extern "C" {
  *   - BruteForceWindow W (seconds)
  *   - BruteForceAction block|throttle
  *   - BruteForceThrottleDuration ms
+ *   - BruteForceIPv4Prefix / BruteForceIPv6Prefix N (0 = off)
+ *   - BruteForcePrefixAttempts N
+ *   - BruteForceFailureStatus code... (ignored here)
  *
- * If enabled, tracks per-IP failed attempts using shared memory.
- * When the threshold is exceeded within the window:
+ * If enabled, tracks per-IP failed attempts using shared memory, plus a
+ * second tier of per-prefix counters so clients rotating through the
+ * addresses of one network share a budget. Once the prefix budget is
+ * spent, further addresses from it are rejected without taking a slot.
+ * When either threshold is exceeded within the window:
  *   - block: sets status 403 and returns LSI_ERROR
- *   - throttle: records throttle intent (in tests) or sleeps (production)
+ *   - throttle: sets BF_THROTTLE_MS, arms a timer for the throttle
+ *     duration and returns LSI_SUSPEND; the timer resumes the request
+ *     with lsi_session_resume(). Without a timer it returns LSI_OK.
  *
  * If shared memory is not initialized or allocation fails, protection
  * is disabled and the request continues normally.
@@ -42,12 +105,64 @@ extern "C" {
  * @param session     LSIAPI session handle.
  * @param directives  Head of the directive linked list.
  * @param client_ip   Client IP address string.
- * @return LSI_OK if request should proceed, LSI_ERROR if blocked.
+ * @return LSI_OK if request should proceed, LSI_ERROR if blocked,
+ *         LSI_SUSPEND if throttled.
  */
 int exec_brute_force(lsi_session_t *session,
                      const htaccess_directive_t *directives,
                      const char *client_ip);
 
+/**
+ * Cancel the throttle timer of @p session, if any. Call when a session
+ * ends so the timer does not resume a freed session.
+ */
+void exec_brute_force_session_end(lsi_session_t *session);
+
+/**
+ * Request-phase check for the client address and URI held in the request
+ * context. Applies the action when the client (or its prefix) has no
+ * attempts left, but counts nothing: attempts are counted by
+ * exec_brute_force_resp_req() once the response status is known. Only
+ * reads the shared store.
+ *
+ * @return LSI_OK if the request should proceed, LSI_ERROR if blocked,
+ *         LSI_SUSPEND if throttled (the hook must return it as is).
+ */
+int exec_brute_force_req(const htaccess_request_t *req,
+                         const htaccess_directive_t *directives);
+
+/**
+ * exec_brute_force_req() with the protect paths of @p directives
+ * pre-compiled into @p paths (NULL scans the list instead).
+ */
+int exec_brute_force_compiled_req(const htaccess_request_t *req,
+                                  const htaccess_directive_t *directives,
+                                  const bf_path_trie_t *paths);
+
+/**
+ * Response-phase accounting: count a failed attempt when @p status is one
+ * of the BruteForceFailureStatus codes (default 401 and 403). Successful
+ * responses, and attempts from clients that are already blocked, do not
+ * write to the shared store.
+ *
+ * @param req         Request context.
+ * @param directives  Head of the directive linked list.
+ * @param status      Final response status.
+ * @return 1 if an attempt was counted, 0 otherwise.
+ */
+int exec_brute_force_resp_req(const htaccess_request_t *req,
+                              const htaccess_directive_t *directives,
+                              int status);
+
+/**
+ * exec_brute_force_resp_req() with pre-compiled protect paths, as for
+ * exec_brute_force_compiled_req().
+ */
+int exec_brute_force_resp_compiled_req(const htaccess_request_t *req,
+                                       const htaccess_directive_t *directives,
+                                       const bf_path_trie_t *paths,
+                                       int status);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
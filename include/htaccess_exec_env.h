@@ -14,6 +14,7 @@
 #define HTACCESS_EXEC_ENV_H
 
 #include "htaccess_directive.h"
+#include "htaccess_request.h"
 #include "ls.h"
 
 #ifdef __cplusplus
@@ -53,6 +54,13 @@ int exec_setenv(lsi_session_t *session, const htaccess_directive_t *dir);
  */
 int exec_setenvif(lsi_session_t *session, const htaccess_directive_t *dir);
 
+/**
+ * exec_setenvif() taking Remote_Addr and Request_URI from the request
+ * context instead of the session.
+ */
+int exec_setenvif_req(const htaccess_request_t *req,
+                      const htaccess_directive_t *dir);
+
 /**
  * Execute a BrowserMatch directive — set env var when User-Agent matches.
  *
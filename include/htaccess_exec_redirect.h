@@ -1,22 +1,96 @@
 /**
  * htaccess_exec_redirect.h - Redirect and RedirectMatch directive executors
  *
- * Implements execution of Redirect (prefix match, optional status code)
- * and RedirectMatch (regex match with $N backreference substitution).
- * Both return 1 when a redirect is triggered (short-circuit), 0 otherwise.
+ * Implements execution of Redirect (prefix match, optional status code),
+ * RedirectMatch (regex match with $N backreference substitution) and
+ * RedirectMap (exact match in a compiled map file, see
+ * htaccess_redirect_map.h). All return 1 when a redirect is triggered
+ * (short-circuit), 0 otherwise.
+ *
+ * An effective config also compiles its redirects into a redirect_set_t,
+ * so a request does not have to compare every Redirect prefix or run
+ * every RedirectMatch regex in turn.
  *
  * Validates: Requirements 7.1, 7.2, 7.3, 7.4, 7.5
  */
 #ifndef HTACCESS_EXEC_REDIRECT_H
 #define HTACCESS_EXEC_REDIRECT_H
 
+#include "htaccess_byte_trie.h"
 #include "htaccess_directive.h"
+#include "htaccess_regex_set.h"
+#include "htaccess_request.h"
 #include "ls.h"
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * Redirect and RedirectMatch directives of a list, in declaration order,
+ * with the plain Redirect prefixes compiled into a byte trie.
+ *
+ * Each prefix is a trie key whose value is its rule index, so the first
+ * key ending in a node is the earliest rule with that prefix. A lookup
+ * walks the URI once, keeping the smallest rule index seen on the way.
+ * The result is the Redirect a sequential scan would hit first, found in
+ * O(URI length) however many Redirect lines there are.
+ *
+ * The RedirectMatch patterns are compiled once into a regex_set_t, whose
+ * pattern i is the rule at regex_rules[i]. RedirectMap rules are listed
+ * in map_rules; each is a single hash lookup.
+ */
+typedef struct {
+    const htaccess_directive_t **rules; /* Redirect*, in order */
+    size_t                num_rules;
+    uint32_t             *regex_rules;  /* Indices of RedirectMatch rules */
+    size_t                num_regex;
+    uint32_t             *map_rules;    /* Indices of RedirectMap rules */
+    size_t                num_maps;
+    byte_trie_t           prefixes;     /* Redirect paths -> rule */
+    regex_set_t           regex;        /* RedirectMatch patterns */
+} redirect_set_t;
+
+/**
+ * Compile the Redirect, RedirectMatch and RedirectMap directives of a
+ * list into @p out. The set points into @p directives, which must outlive it.
+ *
+ * @return 0 on success, -1 on allocation failure (out is left empty).
+ */
+int redirect_set_compile(const htaccess_directive_t *directives,
+                         redirect_set_t *out);
+
+/**
+ * Index in @p set->rules of the first declared Redirect whose path is a
+ * prefix of @p uri, or @p set->num_rules if none is.
+ */
+size_t redirect_set_first_prefix(const redirect_set_t *set, const char *uri,
+                                 size_t uri_len);
+
+/**
+ * Index in @p set->regex_rules of the first RedirectMatch rule declared
+ * before rule @p limit whose pattern matches @p uri (or does not
+ * compile), or @p set->num_regex if none does. The search starts at
+ * regex_rules[@p from].
+ */
+size_t redirect_set_first_match(const redirect_set_t *set, const char *uri,
+                                size_t uri_len, size_t from, size_t limit);
+
+/**
+ * exec_redirect_match_req() for RedirectMatch rule regex_rules[@p i] of
+ * @p set, using the precompiled pattern.
+ */
+int exec_redirect_set_match(const htaccess_request_t *req,
+                            const redirect_set_t *set, size_t i);
+
+/**
+ * Release the arrays held by a compiled set.
+ */
+void redirect_set_free(redirect_set_t *set);
+
 /**
  * Execute a Redirect directive (DIR_REDIRECT).
  *
@@ -31,6 +105,12 @@ extern "C" {
  */
 int exec_redirect(lsi_session_t *session, const htaccess_directive_t *dir);
 
+/**
+ * exec_redirect() matching against the URI held in the request context.
+ */
+int exec_redirect_req(const htaccess_request_t *req,
+                      const htaccess_directive_t *dir);
+
 /**
  * Execute a RedirectMatch directive (DIR_REDIRECT_MATCH).
  *
@@ -46,6 +126,34 @@ int exec_redirect(lsi_session_t *session, const htaccess_directive_t *dir);
  */
 int exec_redirect_match(lsi_session_t *session, const htaccess_directive_t *dir);
 
+/**
+ * exec_redirect_match() matching against the URI held in the request
+ * context.
+ */
+int exec_redirect_match_req(const htaccess_request_t *req,
+                            const htaccess_directive_t *dir);
+
+/**
+ * Execute a RedirectMap directive (DIR_REDIRECT_MAP).
+ *
+ * Looks the request URI up in the map file dir->value. On a hit, sets
+ * the response status to dir->data.redirect.status_code (defaulting to
+ * 302 if 0) and the Location header to the mapped target.
+ *
+ * @param session  LSIAPI session handle.
+ * @param dir      Directive with type DIR_REDIRECT_MAP.
+ * @return 1 if redirect was triggered (short-circuit), 0 if no match,
+ *         -1 on error (including an unreadable map file).
+ */
+int exec_redirect_map(lsi_session_t *session, const htaccess_directive_t *dir);
+
+/**
+ * exec_redirect_map() matching against the URI held in the request
+ * context.
+ */
+int exec_redirect_map_req(const htaccess_request_t *req,
+                          const htaccess_directive_t *dir);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
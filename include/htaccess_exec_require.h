@@ -7,30 +7,115 @@
  * When Require directives coexist with Order/Allow/Deny, Require takes
  * precedence (Apache 2.4 semantics).
  *
+ * The Require tree is compiled into a flat program of leaf tests. Each
+ * instruction names the instruction to continue with when its test
+ * passes and when it fails, so RequireAny/RequireAll short-circuiting is
+ * encoded as jump targets and evaluation is a single loop.
+ *
  * Validates: Requirements 8.1-8.8
  */
 #ifndef HTACCESS_EXEC_REQUIRE_H
 #define HTACCESS_EXEC_REQUIRE_H
 
 #include "htaccess_directive.h"
+#include "htaccess_request.h"
 #include "ls.h"
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/** Jump target: stop and grant access. */
+#define REQUIRE_PC_GRANT 0xFFFFFFFEu
+/** Jump target: stop and deny access. */
+#define REQUIRE_PC_DENY  0xFFFFFFFFu
+
+/**
+ * Leaf test performed by one instruction.
+ */
+typedef enum {
+    REQUIRE_OP_TRUE,    /* Require all granted, empty RequireAll */
+    REQUIRE_OP_FALSE,   /* Require all denied, empty RequireAny */
+    REQUIRE_OP_IP,      /* Require ip: client in set */
+    REQUIRE_OP_NOT_IP,  /* Require not ip: client not in set */
+} require_op_t;
+
+/**
+ * One program instruction.
+ */
+typedef struct {
+    uint32_t          op;       /* require_op_t */
+    uint32_t          on_true;  /* Next pc when the test passes */
+    uint32_t          on_false; /* Next pc when the test fails */
+    const cidr_set_t *ips;      /* Address set for the IP ops */
+} require_insn_t;
+
+/**
+ * Compiled Require program for one directive list.
+ */
+typedef struct {
+    require_insn_t *code;      /* Instructions; evaluation starts at 0 */
+    uint32_t        count;     /* Number of instructions */
+    cidr_set_t     *owned;     /* Sets compiled for leaves built without
+                                  the parser (indexed like code) */
+    int             active;    /* 0 when no Require directive present */
+} require_program_t;
+
 /**
  * Evaluate Apache 2.4 Require access control directives.
  *
  * @param session     LSIAPI session handle.
  * @param directives  Head of the directive linked list.
- * @param client_ip   Client IP address string (dotted-decimal).
+ * @param client_ip   Client IP address string (IPv4 or IPv6).
  * @return LSI_OK (0) if access allowed, LSI_ERROR (-1) if denied (403 set).
  */
 int exec_require(lsi_session_t *session,
                  const htaccess_directive_t *directives,
                  const char *client_ip);
 
+/**
+ * exec_require() for the client address parsed into the request context.
+ *
+ * Compiles a temporary program for @p directives; callers holding an
+ * effective config use its pre-compiled program instead.
+ *
+ * @param req         Request context (session and client address).
+ * @param directives  Head of the directive linked list.
+ * @return LSI_OK (0) if access allowed, LSI_ERROR (-1) if denied (403 set).
+ */
+int exec_require_req(const htaccess_request_t *req,
+                     const htaccess_directive_t *directives);
+
+/**
+ * Compile the Require directives of a list into @p out.
+ *
+ * The program borrows the parser-compiled CIDR sets of @p directives,
+ * which must outlive it. Logs the Require vs Order/Allow/Deny
+ * coexistence warning once, here, rather than on every request.
+ *
+ * @param directives   Head of the directive linked list.
+ * @param log_session  Session for the warning (NULL outside a request).
+ * @param out          Output program.
+ * @return 0 on success, -1 on allocation failure (out is left empty).
+ */
+int require_compile(const htaccess_directive_t *directives,
+                    lsi_session_t *log_session, require_program_t *out);
+
+/**
+ * Release a compiled program.
+ */
+void require_program_free(require_program_t *prog);
+
+/**
+ * Run a compiled program for the request's client address.
+ *
+ * Same return values as exec_require().
+ */
+int exec_require_compiled(const htaccess_request_t *req,
+                          const require_program_t *prog);
+
 #ifdef __cplusplus
 }
 #endif
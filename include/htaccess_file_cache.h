@@ -0,0 +1,100 @@
+/**
+ * htaccess_file_cache.h - Path-keyed cache of files revalidated by stat()
+ *
+ * AuthUserFile, AuthGroupFile and RedirectMap files are each parsed once
+ * into a module-specific form and kept until the file changes. This is
+ * the cache they share: entries are keyed by path in a small chained
+ * table, and every get stat()s the path and rebuilds the entry when the
+ * modification time, size, device or inode differs from the copy held,
+ * as .htaccess files are revalidated. A warm get costs one stat() and a
+ * short chain walk, and never reads the file.
+ *
+ * A module embeds file_cache_entry_t as the first member of its record
+ * and supplies the callbacks that build and release records.
+ *
+ * Validates: Requirements 7.1, 10.4
+ */
+#ifndef HTACCESS_FILE_CACHE_H
+#define HTACCESS_FILE_CACHE_H
+
+#include <stddef.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Buckets per cache; each cache holds one entry per distinct path. */
+#define FILE_CACHE_BUCKETS 16
+
+/** What a later stat() of a file must still match. */
+typedef struct {
+    struct timespec mtime;
+    off_t           size;
+    dev_t           dev;
+    ino_t           ino;
+} file_ident_t;
+
+/** Record the identity of the file behind @p st. */
+void file_ident_set(file_ident_t *id, const struct stat *st);
+
+/** 1 if @p st describes the same file content as @p id. */
+int file_ident_matches(const file_ident_t *id, const struct stat *st);
+
+/** Header of a cached record; embed it as the record's first member. */
+typedef struct file_cache_entry {
+    char                    *path;   /* Set and freed by the cache */
+    file_ident_t             ident;  /* Set by the load callback */
+    struct file_cache_entry *chain_next;
+} file_cache_entry_t;
+
+typedef struct {
+    /*
+     * Build the record of @p path, which stat() described as @p st, and
+     * set its ident from the file actually read. NULL if it cannot be.
+     */
+    file_cache_entry_t *(*load)(const char *path, const struct stat *st);
+
+    /* Free a record built by load (not its path) */
+    void (*release)(file_cache_entry_t *e);
+
+    /*
+     * Optional: 1 if @p e still stands for the file behind @p st. The
+     * default compares e->ident.
+     */
+    int (*current)(const file_cache_entry_t *e, const struct stat *st);
+
+    /*
+     * Optional: called when a changed file cannot be loaded; return 1 to
+     * keep serving @p e. Without it the old record is dropped before the
+     * new one is loaded, so the two are never held at once.
+     */
+    int (*keep)(file_cache_entry_t *e, const struct stat *st);
+} file_cache_ops_t;
+
+typedef struct {
+    const file_cache_ops_t *ops;
+    file_cache_entry_t     *buckets[FILE_CACHE_BUCKETS];
+} file_cache_t;
+
+#define FILE_CACHE_INIT(ops) { (ops), { NULL } }
+
+/**
+ * Current record of @p path, loading or rebuilding it if needed.
+ *
+ * @return The record, or NULL if the file is gone or cannot be loaded
+ *         (a cached record of a file that is gone is dropped).
+ */
+file_cache_entry_t *file_cache_get(file_cache_t *cache, const char *path);
+
+/**
+ * Release every record; the cache stays usable.
+ */
+void file_cache_clear(file_cache_t *cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HTACCESS_FILE_CACHE_H */
@@ -0,0 +1,48 @@
+/**
+ * htaccess_fileio.h - Whole-buffer file descriptor I/O
+ *
+ * read() and write() may transfer less than asked or be interrupted by
+ * a signal. These helpers loop until the whole buffer is transferred,
+ * retrying on EINTR, for the modules that load or save files in one
+ * piece (auth files, redirect maps and brute force snapshots).
+ *
+ * Validates: Requirements 7.1, 10.4, 12.4
+ */
+#ifndef HTACCESS_FILEIO_H
+#define HTACCESS_FILEIO_H
+
+#include <stddef.h>
+#include <sys/stat.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Read exactly @p len bytes from @p fd into @p buf.
+ *
+ * @return 0 on success, -1 on error or end of file before @p len bytes.
+ */
+int fileio_read_all(int fd, void *buf, size_t len);
+
+/**
+ * Write all @p len bytes of @p buf to @p fd.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int fileio_write_all(int fd, const void *buf, size_t len);
+
+/**
+ * Read the regular file @p path into a NUL-terminated heap buffer.
+ *
+ * @param st  Receives the fstat() of the file that was read.
+ * @return The content (st->st_size bytes and a NUL), or NULL if the file
+ *         cannot be read, is not a regular file, or is 4 GiB or larger.
+ */
+char *fileio_read_file(const char *path, struct stat *st);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HTACCESS_FILEIO_H */
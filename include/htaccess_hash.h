@@ -0,0 +1,31 @@
+/**
+ * htaccess_hash.h - FNV-1a hashing of names and keys
+ *
+ * One 64-bit FNV-1a for the hash tables keyed by strings: the file caches
+ * and their user, group and redirect indexes, and the pattern cache. It
+ * is fast on the short keys these tables hold; none of them is exposed to
+ * keys chosen to collide, as each is built from server-side files.
+ *
+ * Validates: Requirements 7.1, 9.1, 10.4
+ */
+#ifndef HTACCESS_HASH_H
+#define HTACCESS_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** FNV-1a of @p len bytes. */
+uint64_t hash_fnv1a(const char *data, size_t len);
+
+/** FNV-1a of a NUL-terminated string, without the NUL. */
+uint64_t hash_fnv1a_str(const char *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HTACCESS_HASH_H */
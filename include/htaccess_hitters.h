@@ -0,0 +1,137 @@
+/**
+ * htaccess_hitters.h - Heavy-hitter telemetry for brute force protection
+ *
+ * Keeps a fixed-size summary of the busiest clients and paths seen on the
+ * brute force path, shared by all worker processes:
+ *   - a Count-Min sketch gives an over-estimate of the attempts made by
+ *     any address or path, hot or not;
+ *   - two Space-Saving tables (one for addresses, one for paths) hold the
+ *     top HITTERS_TOP_K keys with their counts and error bounds.
+ *
+ * Memory does not grow with the number of distinct keys. The region lives
+ * in a file mapped MAP_SHARED next to the brute force table, and a text
+ * snapshot of the top offenders is periodically written to
+ * HITTERS_EXPORT_NAME in the same directory so operators can read it
+ * without touching the workers.
+ *
+ * Validates: Requirements 12.1, 12.2
+ */
+#ifndef HTACCESS_HITTERS_H
+#define HTACCESS_HITTERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "htaccess_cidr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Shared region created inside the hitters_init() directory. */
+#define HITTERS_FILE_NAME "brute_force_top.shm"
+
+/** Text snapshot written by hitters_maybe_export(). */
+#define HITTERS_EXPORT_NAME "brute_force_top.txt"
+
+/** Bumped whenever the shared layout changes. */
+#define HITTERS_LAYOUT_VERSION 1
+
+/* Sketch geometry: HITTERS_CM_DEPTH rows of HITTERS_CM_WIDTH counters */
+#define HITTERS_CM_DEPTH 4
+#define HITTERS_CM_WIDTH 4096
+
+/** Keys tracked per Space-Saving table. */
+#define HITTERS_TOP_K 32
+
+/** Longest path kept in a top-K entry (longer paths are truncated). */
+#define HITTERS_PATH_MAX 47
+
+/** Minimum seconds between two exports of the text snapshot. */
+#define HITTERS_EXPORT_INTERVAL 10
+
+typedef enum {
+    HITTERS_ADDR = 0,   /* Client addresses */
+    HITTERS_PATH = 1,   /* Request paths */
+} hitters_kind_t;
+
+/**
+ * One top-K entry (a snapshot; the true count lies in
+ * [count - error, count]).
+ */
+typedef struct {
+    uint64_t  count;                      /* Space-Saving count */
+    uint64_t  error;                      /* Over-count bound */
+    ip_addr_t addr;                       /* HITTERS_ADDR key */
+    char      path[HITTERS_PATH_MAX + 1]; /* HITTERS_PATH key */
+} hitters_entry_t;
+
+/**
+ * Attach to (or create) the shared region.
+ *
+ * @param dir  Directory for the backing file, created if missing; the
+ *             text snapshot is exported there too. NULL maps an anonymous
+ *             region visible to forked children only, with no export.
+ * @return 0 on success, -1 on failure.
+ */
+int hitters_init(const char *dir);
+
+/**
+ * Count one attempt for an address and the path it targeted.
+ *
+ * @param addr  Client address (may be NULL).
+ * @param path  Request path (may be NULL).
+ */
+void hitters_record(const ip_addr_t *addr, const char *path);
+
+/**
+ * Count-Min estimate of the attempts made by an address or to a path;
+ * never below the true count.
+ */
+uint64_t hitters_estimate_addr(const ip_addr_t *addr);
+uint64_t hitters_estimate_path(const char *path);
+
+/**
+ * Copy the top entries of one table, highest count first.
+ *
+ * @param kind  Table to read.
+ * @param out   Receives up to @p n entries.
+ * @param n     Capacity of @p out.
+ * @return Number of entries copied, or -1 if not initialized or the
+ *         tables stayed locked by another worker for the whole attempt.
+ */
+int hitters_top(hitters_kind_t kind, hitters_entry_t *out, int n);
+
+/**
+ * Write a text snapshot of both tables to @p file (replaced atomically).
+ *
+ * Each line is "<addr|path> <count> <error> <key>", highest count first
+ * within each table, after a "# total <n>" line with the number of
+ * recorded attempts.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int hitters_export(const char *file);
+
+/**
+ * Export to HITTERS_EXPORT_NAME when HITTERS_EXPORT_INTERVAL seconds have
+ * passed since the last export by any worker. Does nothing for an
+ * anonymous region. Meant for a worker timer, not the request path: a
+ * snapshot skipped because the tables are busy is retried on the next
+ * call.
+ *
+ * @return 1 if a snapshot was written, 0 otherwise.
+ */
+int hitters_maybe_export(time_t now);
+
+/**
+ * Detach from the shared region; the backing file is kept.
+ */
+void hitters_destroy(void);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* HTACCESS_HITTERS_H */
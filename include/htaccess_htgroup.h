@@ -0,0 +1,67 @@
+/**
+ * htaccess_htgroup.h - Compiled cache of AuthGroupFile files
+ *
+ * A group file lists one group per line as "group: user user ...". It
+ * is parsed once and compiled into a membership matrix: group and user
+ * names are interned into dense ids, and every user gets a bitset with
+ * one bit per group. Checking "Require group" for an authenticated user
+ * then costs one probe for the user's row and one bit test per group
+ * named by the directive, however large the file is.
+ *
+ * Files are keyed by path and revalidated like AuthUserFile files: a
+ * stat() on every check, with the compiled copy rebuilt when the
+ * modification time, size or inode changes. A group named on several
+ * lines collects the members of all of them, as in Apache.
+ *
+ * Validates: Requirements 10.4
+ */
+#ifndef HTACCESS_HTGROUP_H
+#define HTACCESS_HTGROUP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Cache counters (totals since the cache was created).
+ */
+typedef struct {
+    uint64_t loads;  /* Files read and compiled */
+    uint64_t checks; /* Membership checks answered */
+    size_t   files;  /* Files currently cached */
+    size_t   groups; /* Groups across all cached files */
+    size_t   users;  /* Distinct members across all cached files */
+} htgroup_stats_t;
+
+/**
+ * Check whether @p user belongs to any of @p groups.
+ *
+ * @param path    AuthGroupFile path.
+ * @param user    Authenticated user name.
+ * @param groups  Space- or tab-separated group names.
+ * @return 1 if the user is in at least one of the groups, 0 if not, -1 if
+ *         the file cannot be read.
+ */
+int htgroup_cache_check(const char *path, const char *user,
+                        const char *groups);
+
+/**
+ * Read the cache counters.
+ *
+ * @return 0 on success, -1 if @p out is NULL.
+ */
+int htgroup_cache_get_stats(htgroup_stats_t *out);
+
+/**
+ * Drop every compiled file and reset the counters.
+ */
+void htgroup_cache_destroy(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HTACCESS_HTGROUP_H */
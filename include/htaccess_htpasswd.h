@@ -0,0 +1,134 @@
+/**
+ * htaccess_htpasswd.h - Parsed and indexed cache of AuthUserFile files
+ *
+ * An htpasswd file is read and parsed once, into a hash index keyed by
+ * user name, and kept until the file changes. The cache is keyed by the
+ * file's path, so every directory whose AuthUserFile names the same file
+ * shares one parsed copy.
+ *
+ * Files are revalidated the same way .htaccess files are: a stat() on
+ * every lookup, with the entry rebuilt when the modification time, size
+ * or inode differs from the parsed copy. A warm lookup therefore costs
+ * one stat() and one hash probe, and never reads the file.
+ *
+ * The format is one "user:hash" entry per line. Blank lines and lines
+ * starting with '#' are ignored, CRLF line endings are accepted and lines
+ * have no length limit. When a user appears more than once the first
+ * entry wins, as in Apache. The hash format of each entry is detected
+ * while the file is parsed, so a check does not have to sniff it again.
+ *
+ * Successful password checks are remembered for HTPASSWD_VERIFIED_TTL
+ * seconds so that a page and its assets do not each pay for a slow hash
+ * such as bcrypt. The verified-credential table has a fixed number of
+ * slots and holds only a 64-bit SipHash-2-4 tag of (file, user, password,
+ * stored hash) under a random per-process key; the password itself is
+ * never stored. Because the stored hash is part of the tag, changing a
+ * user's entry in the file makes its old verifications unreachable.
+ *
+ * Validates: Requirements 10.4
+ */
+#ifndef HTACCESS_HTPASSWD_H
+#define HTACCESS_HTPASSWD_H
+
+#include "htaccess_pwhash.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Seconds a successful password check is remembered by default. */
+#define HTPASSWD_VERIFIED_TTL 300
+
+/** Verified-credential slots (a power of two), grouped in sets of WAYS. */
+#define HTPASSWD_VERIFIED_SLOTS 1024
+#define HTPASSWD_VERIFIED_WAYS 4
+
+/**
+ * Cache counters (totals since the cache was created).
+ */
+typedef struct {
+    uint64_t loads;   /* Files read and parsed */
+    uint64_t lookups; /* Lookups answered from a parsed copy */
+    size_t   files;   /* Files currently cached */
+    size_t   users;   /* Users indexed across all cached files */
+    uint64_t verified_hits;   /* Checks answered by a remembered success */
+    uint64_t verified_misses; /* Checks that had to hash the password */
+} htpasswd_stats_t;
+
+/**
+ * Look up the password hash of a user.
+ *
+ * Parses @p path on first use or when it changed on disk; otherwise the
+ * cached index answers without reading the file.
+ *
+ * @param path      AuthUserFile path.
+ * @param user      User name to find.
+ * @param hash      Receives the user's hash, NUL-terminated.
+ * @param hash_len  Capacity of @p hash.
+ * @return 1 if found, 0 if the user is not listed (or the hash does not
+ *         fit in @p hash), -1 if the file cannot be read.
+ */
+int htpasswd_cache_lookup(const char *path, const char *user,
+                          char *hash, size_t hash_len);
+
+/**
+ * Like htpasswd_cache_lookup(), also returning the hash format detected
+ * when the file was loaded.
+ *
+ * @param format  Receives the format when the user is found; may be NULL.
+ */
+int htpasswd_cache_lookup_format(const char *path, const char *user,
+                                 char *hash, size_t hash_len,
+                                 pwhash_format_t *format);
+
+/**
+ * Check whether a password was verified against @p hash within the TTL.
+ *
+ * @param path      AuthUserFile the hash came from.
+ * @param user      User name.
+ * @param password  Password presented by the client.
+ * @param hash      The user's current hash from htpasswd_cache_lookup().
+ * @param now       Current time.
+ * @return 1 if a live verification is remembered, 0 otherwise.
+ */
+int htpasswd_verified_check(const char *path, const char *user,
+                            const char *password, const char *hash,
+                            time_t now);
+
+/**
+ * Remember that @p password matched @p hash. Only call this after a
+ * successful htpasswd_check(). When the set is full the entry closest to
+ * expiry is replaced.
+ */
+void htpasswd_verified_store(const char *path, const char *user,
+                             const char *password, const char *hash,
+                             time_t now);
+
+/**
+ * Set how long successful checks are remembered; 0 disables the
+ * verified-credential table and forgets what it held.
+ */
+void htpasswd_verified_set_ttl(int seconds);
+
+/**
+ * Read the cache counters.
+ *
+ * @return 0 on success, -1 if @p out is NULL.
+ */
+int htpasswd_cache_get_stats(htpasswd_stats_t *out);
+
+/**
+ * Drop every cached file and verification, reset the counters and the
+ * TTL. The cache is created again on the next lookup.
+ */
+void htpasswd_cache_destroy(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HTACCESS_HTPASSWD_H */
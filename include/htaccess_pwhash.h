@@ -0,0 +1,67 @@
+/**
+ * htaccess_pwhash.h - Native verifiers for htpasswd password hashes
+ *
+ * The formats htpasswd and control panels write most are checked by
+ * built-in, reentrant code instead of libc crypt():
+ *   - "$apr1$" Apache MD5 and "$1$" MD5-crypt,
+ *   - "{SHA}" base64 SHA-1 (unsalted),
+ *   - "$5$" SHA-256-crypt and "$6$" SHA-512-crypt, with "rounds=".
+ * Anything else (bcrypt, DES, ...) goes to crypt_r() with a private
+ * crypt_data, so every verifier is safe to call from any thread.
+ *
+ * The format of an AuthUserFile entry is detected once, when the file is
+ * loaded into the htpasswd cache.
+ *
+ * Validates: Requirements 10.4
+ */
+#ifndef HTACCESS_PWHASH_H
+#define HTACCESS_PWHASH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    PWHASH_CRYPT = 0,     /* Not recognised: libc crypt_r() */
+    PWHASH_APR1,          /* $apr1$salt$hash */
+    PWHASH_MD5_CRYPT,     /* $1$salt$hash */
+    PWHASH_SHA1,          /* {SHA}base64 */
+    PWHASH_SHA256_CRYPT,  /* $5$[rounds=N$]salt$hash */
+    PWHASH_SHA512_CRYPT,  /* $6$[rounds=N$]salt$hash */
+} pwhash_format_t;
+
+/**
+ * Detect the format of a stored hash from its prefix.
+ */
+pwhash_format_t pwhash_detect(const char *hash);
+
+/**
+ * Short name of a format ("apr1", "sha512-crypt", ..., "crypt").
+ */
+const char *pwhash_format_name(pwhash_format_t format);
+
+/**
+ * 1 for formats cheap enough to check on the event loop (apr1, MD5-crypt
+ * and {SHA} take well under a millisecond).
+ */
+int pwhash_is_fast(pwhash_format_t format);
+
+/**
+ * Check a password against a stored hash of a known format.
+ *
+ * @return 1 if match, 0 if no match, -1 if the hash is malformed or
+ *         cannot be computed.
+ */
+int pwhash_verify(pwhash_format_t format, const char *hash,
+                  const char *password);
+
+/**
+ * pwhash_verify() with the format detected from @p hash.
+ */
+int pwhash_check(const char *hash, const char *password);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HTACCESS_PWHASH_H */
@@ -0,0 +1,114 @@
+/**
+ * htaccess_redirect_map.h - Compiled, memory-mapped RedirectMap files
+ *
+ * "RedirectMap [status] <file>" keeps bulk redirects out of .htaccess. The
+ * map file is plain text with one "<path> <target>" pair per line; blank
+ * lines and lines starting with '#' are ignored, and when a path is
+ * listed twice the first line wins, like the first matching Redirect.
+ *
+ * A map is compiled into "<file>.rmap", an open-addressing hash table
+ * that records the size, modification time and inode of the text it was
+ * built from. The compiled file is used in place through a read-only
+ * mmap() only when the server owns it and nobody else can write it; a
+ * file another user could truncate under the mapping is copied into
+ * memory instead.
+ *
+ * A map is compiled when it is first loaded and again whenever its text
+ * changes. The image is written next to the text (through a temporary
+ * file renamed over the old one) or, if the directory is not writable,
+ * kept in memory. Texts of at most REDIRECT_MAP_INLINE_MAX bytes are
+ * compiled on the request path. A larger text that changes is compiled
+ * by the runner set with redirect_map_set_runner() (the password hashing
+ * pool in the server) while the image of the older text is served stale;
+ * the new image replaces it on the first lookup after the rebuild ends.
+ * A large map is compiled inline only when there is no image to serve
+ * or no runner. ols_htaccess_mapc compiles maps ahead of time, so that
+ * the first request does not pay for it.
+ *
+ * A lookup costs one stat() of the text file, one hash probe sequence
+ * and no heap allocation; the target it returns points into the image.
+ *
+ * Validates: Requirements 7.1, 7.3
+ */
+#ifndef HTACCESS_REDIRECT_MAP_H
+#define HTACCESS_REDIRECT_MAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Suffix appended to the map file's path to name the compiled file. */
+#define REDIRECT_MAP_SUFFIX ".rmap"
+
+/** Largest changed map text (bytes) recompiled on the request path. */
+#define REDIRECT_MAP_INLINE_MAX (256 * 1024)
+
+/**
+ * Cache counters (totals since the cache was created).
+ */
+typedef struct {
+    uint64_t builds;   /* Maps compiled from their text */
+    uint64_t opens;    /* Compiled files loaded without a rebuild */
+    uint64_t copies;   /* Compiled files copied instead of mapped */
+    uint64_t stale;    /* Maps served from the image of older text */
+    uint64_t rebuilds; /* Compiles handed to the runner */
+    uint64_t lookups;  /* Lookups answered */
+    size_t   maps;     /* Maps currently cached */
+    size_t   entries;  /* Entries across all cached maps */
+} redirect_map_stats_t;
+
+/**
+ * Runs @p task(@p arg) off the event loop and then @p done(@p arg, result)
+ * on it; returns 0 if the task was accepted. authpool_run() fits.
+ */
+typedef int (*redirect_map_runner_t)(int (*task)(void *arg),
+                                     void (*done)(void *arg, int result),
+                                     void *arg);
+
+/**
+ * Compile the map text at @p src into @p dst, replacing it atomically.
+ *
+ * @return Number of entries written, or -1 if @p src cannot be read or
+ *         @p dst cannot be written.
+ */
+long redirect_map_compile(const char *src, const char *dst);
+
+/**
+ * Look @p uri up in the map file @p path, compiling it if it has no
+ * image for its current text (see REDIRECT_MAP_INLINE_MAX).
+ *
+ * @param target      Set to the target URL (not NUL-terminated) on a hit.
+ * @param target_len  Set to the target's length on a hit.
+ * @return 1 if the map has an entry for @p uri, 0 if not, -1 if the map
+ *         cannot be read or compiled.
+ */
+int redirect_map_lookup(const char *path, const char *uri, size_t uri_len,
+                        const char **target, size_t *target_len);
+
+/**
+ * Set the runner that recompiles large maps off the request path, or
+ * NULL to compile them inline.
+ */
+void redirect_map_set_runner(redirect_map_runner_t run);
+
+/**
+ * Read the cache counters.
+ *
+ * @return 0 on success, -1 if @p out is NULL.
+ */
+int redirect_map_get_stats(redirect_map_stats_t *out);
+
+/**
+ * Unmap every cached map, forget finished rebuilds and reset the
+ * counters. A rebuild still running is left to finish and discarded.
+ */
+void redirect_map_cache_destroy(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HTACCESS_REDIRECT_MAP_H */
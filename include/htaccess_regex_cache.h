@@ -0,0 +1,65 @@
+/**
+ * htaccess_regex_cache.h - Compiled patterns for FilesMatch, SetEnvIf and
+ *                          BrowserMatch
+ *
+ * These directives used to regcomp() their pattern on every request. The
+ * cache compiles each distinct pattern once, together with its regex
+ * prefilter (htaccess_regex_set.h), so a request whose subject lacks the
+ * pattern's required literal ("\\.php$", "^/old-blog/", "Googlebot") is
+ * turned away with a memcmp() or memchr() scan and never reaches
+ * regexec().
+ *
+ * The cache is direct-mapped on a hash of the pattern: a pattern that
+ * collides with another replaces it, so memory stays bounded whatever
+ * the configuration holds.
+ *
+ * Validates: Requirements 9.1, 11.1
+ */
+#ifndef HTACCESS_REGEX_CACHE_H
+#define HTACCESS_REGEX_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Number of cache slots (a power of two). */
+#define REGEX_CACHE_SLOTS 256
+
+/**
+ * Cache counters (totals since the cache was created).
+ */
+typedef struct {
+    uint64_t compiles;  /* Patterns compiled */
+    uint64_t rejected;  /* Subjects turned away by the prefilter */
+    uint64_t execs;     /* Subjects handed to regexec() */
+    size_t   patterns;  /* Patterns currently cached */
+} regex_cache_stats_t;
+
+/**
+ * Match the NUL-terminated @p subject against the extended regex
+ * @p pattern, compiling and caching the pattern on first use.
+ *
+ * @return 1 on a match, 0 if there is none, -1 if @p pattern is invalid.
+ */
+int regex_cache_match(const char *pattern, const char *subject);
+
+/**
+ * Read the cache counters.
+ *
+ * @return 0 on success, -1 if @p out is NULL.
+ */
+int regex_cache_get_stats(regex_cache_stats_t *out);
+
+/**
+ * Free every cached pattern and reset the counters.
+ */
+void regex_cache_destroy(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HTACCESS_REGEX_CACHE_H */
@@ -0,0 +1,141 @@
+/**
+ * htaccess_regex_set.h - Ordered set of POSIX regexes with a literal
+ *                        prefilter
+ *
+ * A regex set compiles a list of extended regular expressions once and
+ * answers "which is the first pattern, in list order, that matches this
+ * subject?". Most patterns found in .htaccess files contain a literal that
+ * every match must include ("/old/", ".php", "MSIE"). Those literals are
+ * extracted at compile time and combined into one Aho-Corasick automaton,
+ * so a single pass over the subject yields the candidate patterns. Only
+ * candidates, plus patterns without a usable literal, are handed to
+ * regexec(), and without capture groups; callers extract captures for
+ * the winning pattern alone.
+ *
+ * A single pattern gets the same treatment through a regex prefilter:
+ * besides the required literal, the analysis finds literals anchored at
+ * the start ("^/old-blog/") or end ("\\.php$") of every match, which are
+ * checked with one memcmp() instead of a search.
+ *
+ * Validates: Requirements 7.2, 7.5
+ */
+#ifndef HTACCESS_REGEX_SET_H
+#define HTACCESS_REGEX_SET_H
+
+#include "htaccess_byte_trie.h"
+
+#include <regex.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Longest literal regex_required_literal() extracts. */
+#define REGEX_LITERAL_MAX 64
+
+/**
+ * Automaton links of a state. The states themselves are the nodes of the
+ * goto trie, whose keys are the literals and whose values are the pattern
+ * indices: a state's outputs are the patterns whose literal ends there.
+ */
+typedef struct {
+    uint32_t fail;        /* Longest proper suffix that is a state */
+    uint32_t dict;        /* Nearest suffix state with outputs, or none */
+} regex_set_link_t;
+
+/** Where a prefilter literal must occur in the subject. */
+typedef enum {
+    REGEX_ANCHOR_NONE = 0,  /* Anywhere */
+    REGEX_ANCHOR_START,     /* At the start */
+    REGEX_ANCHOR_END,       /* At the end */
+    REGEX_ANCHOR_EXACT      /* The subject is the literal */
+} regex_anchor_t;
+
+/**
+ * Necessary condition for a pattern to match. A zero-length literal
+ * admits every subject.
+ */
+typedef struct {
+    char           lit[REGEX_LITERAL_MAX + 1];  /* Folded if icase */
+    uint8_t        len;
+    uint8_t        icase;
+    regex_anchor_t anchor;
+} regex_prefilter_t;
+
+typedef struct {
+    regex_t          *re;       /* Compiled patterns, in list order */
+    uint8_t          *ok;       /* 0 if the pattern failed to compile */
+    size_t            count;
+    int               icase;    /* Compiled with REG_ICASE */
+    uint64_t         *always;   /* Patterns that bypass the prefilter */
+    size_t            words;    /* Bitset words per pattern bitset */
+    byte_trie_t       goto_trie; /* Literals -> pattern index */
+    regex_set_link_t *links;    /* Per goto trie state */
+    regex_prefilter_t *anchors; /* Anchored literal per pattern, if any */
+} regex_set_t;
+
+/**
+ * Extract a literal that every match of the extended regex @p pattern
+ * must contain, preferring the longest one found.
+ *
+ * The analysis is conservative: alternation anywhere in the pattern,
+ * groups, bracket expressions and optional characters end or suppress a
+ * literal, so an empty result only means "unknown".
+ *
+ * @param buf  Output buffer of at least REGEX_LITERAL_MAX + 1 bytes.
+ * @return Length of the literal written to @p buf (NUL-terminated), 0 if
+ *         none was found.
+ */
+size_t regex_required_literal(const char *pattern, char *buf);
+
+/**
+ * Build the prefilter of the extended regex @p pattern. An anchored
+ * literal is preferred unless the unanchored one is more than twice as
+ * long; @p cflags only matters for REG_ICASE.
+ */
+void regex_prefilter_compile(const char *pattern, int cflags,
+                             regex_prefilter_t *out);
+
+/**
+ * Whether the @p len bytes at @p subject can match the prefilter's
+ * pattern (1) or certainly cannot (0).
+ */
+int regex_prefilter_match(const regex_prefilter_t *pf, const char *subject,
+                          size_t len);
+
+/**
+ * Compile @p count patterns with @p cflags (REG_EXTENDED is implied).
+ * A NULL or invalid pattern does not fail the set: it is recorded as not
+ * compiled and always reported as a candidate, so the caller can surface
+ * the error at the point where the pattern would have been tried.
+ *
+ * @return 0 on success, -1 on allocation failure (out is left empty).
+ */
+int regex_set_compile(const char *const *patterns, size_t count,
+                      int cflags, regex_set_t *out);
+
+/**
+ * Index of the first pattern in [@p from, @p limit) that matches the
+ * NUL-terminated @p subject of @p len bytes or failed to compile, or
+ * @p limit if there is none.
+ */
+size_t regex_set_first(const regex_set_t *set, const char *subject,
+                       size_t len, size_t from, size_t limit);
+
+/**
+ * Compiled regex of pattern @p i, or NULL if it failed to compile.
+ */
+const regex_t *regex_set_regex(const regex_set_t *set, size_t i);
+
+/**
+ * Release everything held by a compiled set.
+ */
+void regex_set_free(regex_set_t *set);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HTACCESS_REGEX_SET_H */
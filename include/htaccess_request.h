@@ -0,0 +1,64 @@
+/**
+ * htaccess_request.h - Per-request context shared by the executors
+ *
+ * Gathers the request facts the executors need — URI, method, document
+ * root and the client address in both text and parsed binary form — with
+ * one LSIAPI call each, once per hook invocation. Executors take a
+ * pointer to this context instead of querying the session and parsing
+ * the client IP again for every directive class.
+ *
+ * All string pointers borrow server-owned storage and are valid for the
+ * duration of the hook callback only.
+ *
+ * Validates: Requirements 6.6, 8.1, 11.1, 12.1
+ */
+#ifndef HTACCESS_REQUEST_H
+#define HTACCESS_REQUEST_H
+
+#include "htaccess_cidr.h"
+#include "ls.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Decoded request facts for one hook invocation.
+ */
+typedef struct {
+    lsi_session_t *session;        /* Session the facts were read from */
+    const char    *doc_root;       /* Document root, NULL if unknown */
+    int            doc_root_len;
+    const char    *uri;            /* Request URI, NULL if unknown */
+    int            uri_len;
+    const char    *filename;       /* Last URI path segment (into uri) */
+    const char    *method;         /* HTTP method, NULL if unknown */
+    int            method_len;
+    const char    *client_ip;      /* Client address text, NULL if unknown */
+    int            client_ip_len;
+    ip_addr_t      client_addr;    /* Parsed client_ip */
+    int            client_addr_ok; /* 1 if client_addr is valid */
+} htaccess_request_t;
+
+/**
+ * Populate a request context from the session.
+ *
+ * @param req      Context to fill (must not be NULL).
+ * @param session  LSIAPI session handle (may be NULL: empty context).
+ */
+void htaccess_request_init(htaccess_request_t *req, lsi_session_t *session);
+
+/**
+ * Replace the client address (text and parsed form).
+ *
+ * Used by callers that evaluate rules for an address other than the
+ * connection peer. NULL clears the address.
+ */
+void htaccess_request_set_client_ip(htaccess_request_t *req,
+                                    const char *client_ip);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* HTACCESS_REQUEST_H */
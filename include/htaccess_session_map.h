@@ -0,0 +1,67 @@
+/**
+ * htaccess_session_map.h - Records of suspended requests, by session
+ *
+ * A request suspended on a password check or a throttle timer leaves a
+ * record behind that the session-end hook must find. Every request end
+ * looks, so during a credential stuffing wave, with thousands of
+ * requests suspended, the lookup has to stay O(1): records are linked
+ * into a chained hash table keyed by the session pointer.
+ *
+ * The links are intrusive: a record embeds a session_link_t, so adding
+ * only allocates when the bucket array grows.
+ *
+ * Validates: Requirements 10.4, 12.5
+ */
+#ifndef HTACCESS_SESSION_MAP_H
+#define HTACCESS_SESSION_MAP_H
+
+#include <stddef.h>
+
+#include "ls.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Link embedded in a record; `session` is the key. */
+typedef struct session_link {
+    lsi_session_t       *session;
+    struct session_link *next;
+} session_link_t;
+
+typedef struct {
+    session_link_t **buckets;   /* Power-of-two count, NULL when unused */
+    size_t           nbuckets;
+    size_t           count;
+} session_map_t;
+
+#define SESSION_MAP_INIT { NULL, 0, 0 }
+
+/**
+ * Add @p link, keyed by link->session.
+ *
+ * @return 0 on success, -1 if the first bucket array cannot be allocated.
+ */
+int session_map_add(session_map_t *map, session_link_t *link);
+
+/**
+ * Remove @p link, which must be in @p map.
+ */
+void session_map_remove(session_map_t *map, session_link_t *link);
+
+/**
+ * Remove and return a link keyed by @p session, or NULL if there is none.
+ */
+session_link_t *session_map_take(session_map_t *map,
+                                 const lsi_session_t *session);
+
+/**
+ * Release the bucket array. The records themselves are not touched.
+ */
+void session_map_free(session_map_t *map);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HTACCESS_SESSION_MAP_H */
@@ -1,12 +1,46 @@
 /**
  * htaccess_shm.h - Shared memory management for brute force protection
  *
- * Provides IP tracking record storage for brute force protection.
- * This implementation uses an in-memory hash table for testability.
- * In production, the backing store would be /dev/shm/ols/.
+ * Provides IP tracking record storage for brute force protection. The
+ * store is an open-addressing hash table in a file mapped MAP_SHARED
+ * from the configured directory (normally /dev/shm/ols/), so every OLS
+ * worker process sees and updates the same counters.
  *
- * Uses file locks for inter-process synchronization (conceptually;
- * the in-memory implementation is single-process safe).
+ * Records are keyed by the 16-byte binary address (IPv4 stored mapped)
+ * and packed into 32 bytes, two per cache line. Slots are grouped by 16;
+ * each group has a control byte per slot holding the slot state and a
+ * 7-bit hash tag, so a probe compares 16 tags with one SIMD instruction
+ * and only reads the records whose tag matches.
+ *
+ * Synchronization is lock-free: slots are claimed with a compare-and-swap
+ * on their control byte, and a record's window start and attempt count are
+ * packed into one 64-bit word that is updated by compare-and-swap. File
+ * locks are only taken while a worker attaches to (or formats) the file.
+ *
+ * Besides per-address records the table holds aggregate records that
+ * count attempts for a whole network prefix (see shm_prefix_key()).
+ *
+ * Probe sequences are bounded, so a full table costs no more per request
+ * than an empty one. The table never fails open when full: an insert
+ * evicts the least valuable record near the key's home instead,
+ * preferring expired, old and low-count records over actively blocked
+ * ones.
+ *
+ * The file starts with a versioned header. A worker that restarts
+ * re-attaches to the existing table when the header matches its own
+ * layout; otherwise a new table is formatted in a temporary file and
+ * renamed over the old one. The old file is never resized or cleared,
+ * so processes still mapping it keep working until they re-attach.
+ *
+ * The table can also be checkpointed to a snapshot file on persistent
+ * storage (see shm_set_snapshot_dir()), so blocks survive a reboot or a
+ * reformat. A snapshot holds only the records still tracking a window or
+ * a block. It is written in full now and then (compaction); in between,
+ * each checkpoint appends just the records changed since the previous
+ * one. When shm_init() formats a fresh table it only maps the snapshot;
+ * records are restored lazily: a record is brought in when its address
+ * is first looked up, and shm_restore() moves the rest over in bounded
+ * steps. Entries that expired in the meantime are dropped either way.
  *
  * Validates: Requirements 12.2, 12.3, 12.4
  */
@@ -14,28 +48,75 @@
 #define HTACCESS_SHM_H
 
 #include <stddef.h>
+#include <stdint.h>
 #include <time.h>
 
+#include "htaccess_cidr.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/** File created inside the shm_init() directory. */
+#define SHM_FILE_NAME "brute_force.shm"
+
+/** Bumped whenever the on-disk layout changes. */
+#define SHM_LAYOUT_VERSION 8
+
+/** Snapshot file created inside the shm_set_snapshot_dir() directory. */
+#define SHM_SNAPSHOT_NAME "brute_force.snap"
+
+/** Seconds between two periodic snapshots. */
+#define SHM_SNAPSHOT_INTERVAL 60
+
+/** Changed records a snapshot may accumulate before it is compacted. */
+#define SHM_SNAPSHOT_LOG_MAX 32768
+
+/** Snapshot records restored per shm_restore() step of the module. */
+#define SHM_RESTORE_BUDGET 2048
+
+/** Milliseconds between two shm_restore() steps of the module. */
+#define SHM_RESTORE_INTERVAL_MS 10
+
+/** High word of aggregate-record keys: the reserved 0100::/8 block. */
+#define SHM_PREFIX_KEY_HI 0x0100000000000000ULL
+
+/** Expiry work (wheel ticks plus records examined) per shm_expire() call
+ *  made on the request path. */
+#define SHM_EXPIRE_BUDGET 32
+
 /**
- * IP tracking record for brute force protection.
+ * IP tracking record for brute force protection (a snapshot of the
+ * shared slot; changing it does not affect the store).
  */
 typedef struct {
-    char    ip[46];          /* IPv4 or IPv6 address string */
-    int     attempt_count;   /* Failed attempt count */
-    time_t  first_attempt;   /* Time of first attempt in current window */
-    time_t  blocked_until;   /* Block expiry time (0 = not blocked) */
+    ip_addr_t addr;          /* Client address */
+    int       attempt_count; /* Failed attempt count */
+    time_t    first_attempt; /* Time of first attempt in current window */
+    time_t    blocked_until; /* Block expiry time (0 = not blocked) */
 } brute_force_record_t;
 
+/**
+ * Table counters, shared by all workers.
+ */
+typedef struct {
+    size_t   capacity;         /* Slots in the table */
+    size_t   occupied;         /* Live records */
+    uint64_t evictions;        /* Records replaced in a full table */
+    uint64_t expired;          /* Records freed by expiry */
+    uint64_t insert_failures;  /* Inserts that found no slot to use */
+    uint64_t restored;         /* Records reloaded from the snapshot */
+    uint64_t restore_left;     /* Snapshot records not yet restored */
+} shm_stats_t;
+
 /**
  * Initialize the shared memory region.
  *
- * @param shm_path     Path for shared memory (e.g. "/dev/shm/ols/").
- *                     Ignored in the in-memory implementation.
- * @param max_records  Maximum number of IP records to store.
+ * @param shm_path     Directory for the backing file (e.g. "/dev/shm/ols/"),
+ *                     created if missing. NULL maps an anonymous shared
+ *                     region instead, visible to forked children only.
+ * @param max_records  Maximum number of IP records to store (rounded up
+ *                     to a multiple of the 16-slot group size).
  * @return 0 on success, -1 on failure.
  */
 int shm_init(const char *shm_path, size_t max_records);
@@ -43,28 +124,76 @@ int shm_init(const char *shm_path, size_t max_records);
 /**
  * Look up an IP record.
  *
- * @param ip  Client IP address string.
- * @return Pointer to the record if found, NULL otherwise.
- *         The pointer is valid until the next shm_update_record or shm_destroy call.
+ * @param ip   Client address.
+ * @param out  Receives a snapshot of the record.
+ * @return 0 if found, -1 otherwise.
  */
-brute_force_record_t *shm_get_record(const char *ip);
+int shm_get_record(const ip_addr_t *ip, brute_force_record_t *out);
 
 /**
- * Create or update an IP record.
+ * Create or overwrite an IP record.
  *
- * @param ip      Client IP address string.
- * @param record  Record data to store (copied into the store).
- * @return 0 on success, -1 on failure (e.g. store full).
+ * @param ip      Client address.
+ * @param record  Record data to store (addr field ignored).
+ * @return 0 on success, -1 on failure (store unavailable).
  */
-int shm_update_record(const char *ip, const brute_force_record_t *record);
+int shm_update_record(const ip_addr_t *ip,
+                      const brute_force_record_t *record);
 
 /**
- * Remove all records whose window has expired.
+ * Atomically count one attempt for an IP.
+ *
+ * Starts a new window with a count of 1 when the record is new or its
+ * window (window_sec seconds) has passed. Otherwise increments the count,
+ * unless it already reached @p limit, in which case nothing is changed.
+ *
+ * @param ip          Client address.
+ * @param now         Current time.
+ * @param window_sec  Tracking window length in seconds.
+ * @param limit       Allowed attempts per window.
+ * @param out         Optional; receives the record after the update.
+ * @return 0 if counted, 1 if the limit was already reached,
+ *         -1 if the store is unavailable (or no slot could be evicted).
+ */
+int shm_record_attempt(const ip_addr_t *ip, time_t now, int window_sec,
+                       int limit, brute_force_record_t *out);
+
+/**
+ * Build the key of the aggregate record for the network holding @p ip.
+ *
+ * Aggregate records count attempts for a whole IPv4 /N or IPv6 /N block
+ * and live in the same table as per-address records. Their keys are
+ * taken from the reserved 0100::/8 block (family, prefix length and
+ * network bits), which never appears as a client address, so the two
+ * tiers cannot collide.
+ *
+ * @param ip         Client address.
+ * @param v4_prefix  Prefix length for IPv4 clients, 1..32 (0 = off).
+ * @param v6_prefix  Prefix length for IPv6 clients, 1..64 (0 = off).
+ * @param out        Receives the aggregate key.
+ * @return 0 on success, -1 if aggregation is off for the address family.
+ */
+int shm_prefix_key(const ip_addr_t *ip, int v4_prefix, int v6_prefix,
+                   ip_addr_t *out);
+
+/**
+ * Advance the expiry timing wheel towards @p now, freeing records whose
+ * deadline has passed. A record's deadline is the end of its tracking
+ * window or its blocked_until time, whichever is later; records created
+ * by shm_update_record() are kept until blocked_until.
+ *
+ * At most @p budget units of work (wheel ticks or records examined) are
+ * done; the rest is picked up by later calls. Returns immediately when
+ * another process is already running expiry.
  *
- * A record is considered expired when:
- *   now - first_attempt > some reasonable threshold (caller decides)
- * This function removes records where blocked_until < now AND
- * the record is not actively being tracked.
+ * @param now     Current time.
+ * @param budget  Work limit for this call.
+ * @return Number of records freed.
+ */
+int shm_expire(time_t now, int budget);
+
+/**
+ * Run expiry up to @p now without a work limit.
  *
  * @param now  Current time.
  * @return Number of records cleaned up.
@@ -72,10 +201,80 @@ int shm_update_record(const char *ip, const brute_force_record_t *record);
 int shm_cleanup_expired(time_t now);
 
 /**
- * Destroy the shared memory region and free all resources.
+ * Read the table counters.
+ *
+ * @param out  Receives the counters (zeroed when the store is detached).
+ * @return 0 on success, -1 if the store is not initialized.
+ */
+int shm_get_stats(shm_stats_t *out);
+
+/**
+ * Set the directory holding the snapshot file (created on first save).
+ * Call before shm_init(): a table formatted by shm_init() is restored
+ * from the snapshot, skipping records whose window and block have both
+ * ended.
+ *
+ * @param dir  Snapshot directory; NULL disables snapshots.
+ * @return 0 on success, -1 if the path is too long.
+ */
+int shm_set_snapshot_dir(const char *dir);
+
+/**
+ * Restore up to @p budget snapshot records into the table. Records are
+ * also restored on demand when their address is looked up, so this only
+ * has to run in the background until it returns 0.
+ *
+ * @param now     Current time; records whose deadline has passed are
+ *                dropped.
+ * @param budget  Snapshot records to examine in this call.
+ * @return Records still waiting to be restored, 0 once there are none
+ *         (or this process cannot read the snapshot being restored).
+ */
+int shm_restore(time_t now, int budget);
+
+/**
+ * Checkpoint the live records (window or block not yet over at @p now)
+ * to the snapshot file. The records changed since the previous
+ * checkpoint are appended to the file, including those that expired, so
+ * that they replace their older copies. The file is compacted
+ * instead (rewritten with every live record, replacing it atomically)
+ * when it was not written for this table or its appended records would
+ * exceed SHM_SNAPSHOT_LOG_MAX; a compaction first finishes any restore
+ * still in progress.
+ *
+ * @return Number of records written, or -1 on failure (no snapshot
+ *         directory, store not initialized, another process saving, or
+ *         I/O error).
+ */
+int shm_snapshot_save(time_t now);
+
+/**
+ * Save a snapshot unless one was taken by any worker less than
+ * @p min_interval seconds ago.
+ *
+ * @return 1 if a snapshot was written, 0 otherwise.
+ */
+int shm_maybe_snapshot(time_t now, int min_interval);
+
+/**
+ * Detach from the shared memory region. The backing file is kept so
+ * other workers, and this one after a restart, retain the counters.
  */
 void shm_destroy(void);
 
+/** murmur3 64-bit finalizer (also used by htaccess_hitters.c). */
+uint64_t shm_mix64(uint64_t h);
+
+/** Hash of an address, as used to place it in the table. */
+uint64_t shm_hash_addr(const ip_addr_t *ip);
+
+/**
+ * Create every missing component of a directory path (mode 0700).
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int shm_make_dirs(const char *dir);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
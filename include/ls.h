@@ -32,6 +32,11 @@ extern "C" {
 #define LSI_HKPT_SEND_RESP_HEADER 1
 #endif
 
+/* The session is ending; the handle is invalid once the hook returns */
+#ifndef LSI_HKPT_HTTP_END
+#define LSI_HKPT_HTTP_END         2
+#endif
+
 /* ------------------------------------------------------------------ */
 /*  Module signature                                                   */
 /* ------------------------------------------------------------------ */
@@ -46,6 +51,8 @@ extern "C" {
 
 #define LSI_OK    0
 #define LSI_ERROR (-1)
+/* The hook paused the request; lsi_session_resume() continues it */
+#define LSI_SUSPEND 1
 
 /* ------------------------------------------------------------------ */
 /*  Log levels                                                         */
@@ -181,6 +188,35 @@ const char *lsi_session_get_auth_header(lsi_session_t *session, int *len);
 int         lsi_session_set_www_authenticate(lsi_session_t *session,
                                              const char *realm, int realm_len);
 
+/* ------------------------------------------------------------------ */
+/*  Timers and request suspension                                      */
+/* ------------------------------------------------------------------ */
+
+typedef void (*lsi_timer_cb)(const void *arg);
+
+/*
+ * Run cb(arg) from the worker's event loop after timeout_ms (every
+ * timeout_ms when repeat is set). Returns a timer id, or -1 on failure.
+ */
+int         lsi_set_timer(unsigned int timeout_ms, int repeat,
+                          lsi_timer_cb cb, const void *arg);
+int         lsi_remove_timer(int timer_id);
+
+/*
+ * Continue a request whose hook returned LSI_SUSPEND, with the hook
+ * after the one that suspended it.
+ */
+int         lsi_session_resume(lsi_session_t *session);
+
+typedef void (*lsi_event_cb)(const void *arg);
+
+/*
+ * Queue cb(arg) to run once on the worker's event loop. Unlike the rest
+ * of the API this may be called from any thread; it is how work done off
+ * the loop hands its result back. Returns 0, or -1 on failure.
+ */
+int         lsi_schedule_event(lsi_event_cb cb, const void *arg);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -0,0 +1,242 @@
+/**
+ * htaccess_authpool.c - Password hashing thread pool implementation
+ *
+ * One mutex guards a FIFO of jobs and the counters; idle threads wait on
+ * a condition variable. Checks run through pwhash_check(), which is
+ * reentrant for every format; other tasks run through their own function.
+ * A finished job is handed to the event loop with
+ * lsi_schedule_event(), and the loop-side callback reports the result
+ * and frees the job, so callbacks never run on a pool thread.
+ *
+ * Validates: Requirements 10.4
+ */
+#include "htaccess_authpool.h"
+#include "htaccess_pwhash.h"
+#include "ls.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/** Delay before retrying a failed hand-off to the event loop. */
+#define AUTHPOOL_RETRY_US 10000
+
+typedef struct authpool_job {
+    authpool_task_fn task;      /* NULL: check `password` against `hash` */
+    const char *hash;
+    const char *password;
+    authpool_done_cb done;
+    void *arg;
+    int result;
+    struct authpool_job *next;
+} authpool_job_t;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    authpool_job_t *head, *tail;
+    int             configured;
+    int             threads;
+    int             queue_max;
+    int             stopping;
+    pid_t           owner;      /* Process whose threads are running */
+    int             running;    /* Threads started by `owner` */
+    pthread_t       tids[AUTHPOOL_MAX_THREADS];
+    authpool_stats_t stats;
+} g_pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+/* ------------------------------------------------------------------ */
+/* Event loop side                                                     */
+/* ------------------------------------------------------------------ */
+
+static void deliver(const void *arg)
+{
+    authpool_job_t *job = (authpool_job_t *)arg;
+
+    pthread_mutex_lock(&g_pool.lock);
+    g_pool.stats.completed++;
+    pthread_mutex_unlock(&g_pool.lock);
+    job->done(job->arg, job->result);
+    free(job);
+}
+
+/* ------------------------------------------------------------------ */
+/* Pool threads                                                        */
+/* ------------------------------------------------------------------ */
+
+static void *worker_main(void *unused)
+{
+    (void)unused;
+    for (;;) {
+        authpool_job_t *job;
+
+        pthread_mutex_lock(&g_pool.lock);
+        while (!g_pool.head && !g_pool.stopping)
+            pthread_cond_wait(&g_pool.cond, &g_pool.lock);
+        if (!g_pool.head) {
+            pthread_mutex_unlock(&g_pool.lock);
+            break;
+        }
+        job = g_pool.head;
+        g_pool.head = job->next;
+        if (!g_pool.head)
+            g_pool.tail = NULL;
+        g_pool.stats.queued--;
+        pthread_mutex_unlock(&g_pool.lock);
+
+        job->result = job->task ? job->task(job->arg)
+                                : pwhash_check(job->hash, job->password);
+        /* The loop only fails to take an event when out of memory */
+        while (lsi_schedule_event(deliver, job) != 0)
+            usleep(AUTHPOOL_RETRY_US);
+    }
+    return NULL;
+}
+
+/* Start this process's threads if needed. Called with the lock held. */
+static int ensure_started(void)
+{
+    pid_t pid = getpid();
+
+    if (g_pool.running > 0 && g_pool.owner == pid)
+        return 0;
+    /* Threads of a parent process do not exist after fork() */
+    g_pool.running = 0;
+    g_pool.owner = pid;
+    g_pool.stopping = 0;
+    for (int i = 0; i < g_pool.threads; i++) {
+        if (pthread_create(&g_pool.tids[i], NULL, worker_main, NULL) != 0)
+            break;
+        g_pool.running++;
+    }
+    return g_pool.running > 0 ? 0 : -1;
+}
+
+/* ------------------------------------------------------------------ */
+/* Public API                                                          */
+/* ------------------------------------------------------------------ */
+
+int authpool_init(int threads, int queue_max)
+{
+    if (threads < 1 || threads > AUTHPOOL_MAX_THREADS || queue_max < 1)
+        return -1;
+    authpool_destroy();
+
+    pthread_mutex_lock(&g_pool.lock);
+    g_pool.threads = threads;
+    g_pool.queue_max = queue_max;
+    g_pool.configured = 1;
+    memset(&g_pool.stats, 0, sizeof(g_pool.stats));
+    pthread_mutex_unlock(&g_pool.lock);
+    return 0;
+}
+
+/* Append `job` to the queue, or free it if the queue cannot take it */
+static int enqueue(authpool_job_t *job)
+{
+    pthread_mutex_lock(&g_pool.lock);
+    if (!g_pool.configured || ensure_started() != 0) {
+        pthread_mutex_unlock(&g_pool.lock);
+        free(job);
+        return -1;
+    }
+    if (g_pool.stats.queued >= g_pool.queue_max) {
+        g_pool.stats.rejected++;
+        pthread_mutex_unlock(&g_pool.lock);
+        free(job);
+        return AUTHPOOL_FULL;
+    }
+    if (g_pool.tail)
+        g_pool.tail->next = job;
+    else
+        g_pool.head = job;
+    g_pool.tail = job;
+    g_pool.stats.queued++;
+    g_pool.stats.submitted++;
+    pthread_cond_signal(&g_pool.cond);
+    pthread_mutex_unlock(&g_pool.lock);
+    return 0;
+}
+
+int authpool_submit(const char *hash, const char *password,
+                    authpool_done_cb done, void *arg)
+{
+    authpool_job_t *job;
+
+    if (!hash || !password || !done)
+        return -1;
+    job = calloc(1, sizeof(*job));
+    if (!job)
+        return -1;
+    job->hash = hash;
+    job->password = password;
+    job->done = done;
+    job->arg = arg;
+    return enqueue(job);
+}
+
+int authpool_run(authpool_task_fn task, authpool_done_cb done, void *arg)
+{
+    authpool_job_t *job;
+
+    if (!task || !done)
+        return -1;
+    job = calloc(1, sizeof(*job));
+    if (!job)
+        return -1;
+    job->task = task;
+    job->done = done;
+    job->arg = arg;
+    return enqueue(job);
+}
+
+int authpool_get_stats(authpool_stats_t *out)
+{
+    if (!out)
+        return -1;
+    pthread_mutex_lock(&g_pool.lock);
+    *out = g_pool.stats;
+    pthread_mutex_unlock(&g_pool.lock);
+    return 0;
+}
+
+void authpool_destroy(void)
+{
+    authpool_job_t *job;
+    int running, owned;
+
+    pthread_mutex_lock(&g_pool.lock);
+    g_pool.configured = 0;
+    /* Drop checks that have not started */
+    job = g_pool.head;
+    g_pool.head = g_pool.tail = NULL;
+    g_pool.stats.queued = 0;
+    owned = g_pool.owner == getpid();
+    running = owned ? g_pool.running : 0;
+    g_pool.stopping = 1;
+    pthread_cond_broadcast(&g_pool.cond);
+    pthread_mutex_unlock(&g_pool.lock);
+
+    /*
+     * Fail the dropped checks so their owners can clean up. Jobs queued
+     * by a parent process belong to requests that do not exist here.
+     */
+    while (job) {
+        authpool_job_t *next = job->next;
+        if (owned)
+            job->done(job->arg, -1);
+        free(job);
+        job = next;
+    }
+    for (int i = 0; i < running; i++)
+        pthread_join(g_pool.tids[i], NULL);
+
+    pthread_mutex_lock(&g_pool.lock);
+    g_pool.running = 0;
+    g_pool.stopping = 0;
+    pthread_mutex_unlock(&g_pool.lock);
+}
@@ -0,0 +1,139 @@
+/**
+ * htaccess_byte_trie.c - Byte trie built from sorted keys
+ *
+ * A trie over keys totalling N bytes has at most N + 1 nodes and N edges,
+ * so both arrays are allocated once before building. The build recurses
+ * over key ranges: the keys in [lo, hi) share their first `depth` bytes,
+ * those ending there sort first, and each run of equal next bytes
+ * becomes one edge and one subtrie.
+ *
+ * Validates: Requirements 7.1, 7.2, 7.5, 12.1
+ */
+#include "htaccess_byte_trie.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const byte_trie_key_t *keys;
+    byte_trie_t           *trie;
+    uint32_t               num_edges;
+} byte_trie_build_t;
+
+static int cmp_key(const void *a, const void *b)
+{
+    const byte_trie_key_t *x = a, *y = b;
+    int c = strcmp(x->key, y->key);
+    if (c)
+        return c;
+    return x->value < y->value ? -1 : x->value > y->value;
+}
+
+void byte_trie_sort_keys(byte_trie_key_t *keys, size_t count)
+{
+    if (keys && count > 1)
+        qsort(keys, count, sizeof(*keys), cmp_key);
+}
+
+/*
+ * Build the subtrie for keys[lo, hi), which share their first `depth`
+ * bytes, and return its node index.
+ */
+static uint32_t build_node(byte_trie_build_t *b, size_t lo, size_t hi,
+                           size_t depth)
+{
+    byte_trie_t *t = b->trie;
+    uint32_t node = (uint32_t)t->num_nodes++;
+    uint32_t first = b->num_edges;
+    uint16_t n = 0;
+    size_t i, start;
+
+    t->nodes[node].first_edge = first;
+    t->nodes[node].num_edges = 0;
+    t->nodes[node].first_key = (uint32_t)lo;
+    t->nodes[node].num_keys = 0;
+
+    /* Keys ending here sort first */
+    while (lo < hi && b->keys[lo].key[depth] == '\0') {
+        t->values[lo] = b->keys[lo].value;
+        t->nodes[node].num_keys++;
+        lo++;
+    }
+    if (lo == hi)
+        return node;
+
+    /* Reserve one edge per distinct next byte, then fill them in */
+    for (i = lo; i < hi; i++)
+        if (i == lo || b->keys[i].key[depth] != b->keys[i - 1].key[depth])
+            n++;
+    b->num_edges += n;
+    t->nodes[node].num_edges = n;
+
+    n = 0;
+    for (start = lo, i = lo + 1; i <= hi; i++) {
+        if (i < hi && b->keys[i].key[depth] == b->keys[start].key[depth])
+            continue;
+        t->edges[first + n].byte = (uint8_t)b->keys[start].key[depth];
+        t->edges[first + n].child = build_node(b, start, i, depth + 1);
+        n++;
+        start = i;
+    }
+    return node;
+}
+
+int byte_trie_build(const byte_trie_key_t *keys, size_t count,
+                    byte_trie_t *out)
+{
+    byte_trie_build_t b;
+    size_t bytes = 0;
+
+    memset(out, 0, sizeof(*out));
+    if (count >= BYTE_TRIE_NONE)
+        return -1;
+    for (size_t i = 0; i < count; i++)
+        bytes += strlen(keys[i].key);
+
+    /* At most one node per byte plus the root, one edge per byte */
+    out->nodes = malloc((bytes + 1) * sizeof(*out->nodes));
+    out->edges = malloc((bytes ? bytes : 1) * sizeof(*out->edges));
+    out->values = malloc((count ? count : 1) * sizeof(*out->values));
+    if (!out->nodes || !out->edges || !out->values) {
+        byte_trie_free(out);
+        return -1;
+    }
+    b.keys = keys;
+    b.trie = out;
+    b.num_edges = 0;
+    build_node(&b, 0, count, 0);
+    return 0;
+}
+
+uint32_t byte_trie_next(const byte_trie_t *trie, uint32_t node,
+                        unsigned char byte)
+{
+    const byte_trie_node_t *n = &trie->nodes[node];
+    const byte_trie_edge_t *e = trie->edges + n->first_edge;
+    int lo = 0, hi = n->num_edges;
+
+    /* Binary search of the sorted edges */
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (e[mid].byte < byte)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < n->num_edges && e[lo].byte == byte)
+        return e[lo].child;
+    return BYTE_TRIE_NONE;
+}
+
+void byte_trie_free(byte_trie_t *trie)
+{
+    if (!trie)
+        return;
+    free(trie->nodes);
+    free(trie->edges);
+    free(trie->values);
+    memset(trie, 0, sizeof(*trie));
+}
@@ -4,7 +4,10 @@
  * Uses a simple hash table with separate chaining (linked list per bucket).
  * The hash function is djb2 applied to the file's absolute path string.
  * mtime comparison is used for invalidation: a get with a different mtime
- * returns a miss (-1).
+ * returns a miss (-1). Effective configs live in a parallel table keyed
+ * by target directory and are validated by per-level generations; a
+ * doubly-linked recency list across that table picks the config to evict
+ * once CACHE_MAX_CONFIGS are stored.
  *
  * Validates: Requirements 3.1, 3.2, 3.3, 3.4, 3.6
  */
@@ -58,6 +61,13 @@ static size_t estimate_directives_memory(const htaccess_directive_t *head)
             if (d->data.envif.pattern)
                 total += strlen(d->data.envif.pattern) + 1;
             break;
+        case DIR_ALLOW_FROM:
+        case DIR_DENY_FROM:
+        case DIR_REQUIRE_IP:
+        case DIR_REQUIRE_NOT_IP:
+        case DIR_BRUTE_FORCE_WHITELIST:
+            total += cidr_set_memory(&d->data.ip.cidrs);
+            break;
         default:
             break;
         }
@@ -77,6 +87,63 @@ static void cache_entry_free(cache_entry_t *entry)
     free(entry);
 }
 
+/* ------------------------------------------------------------------ */
+/* Free a single config entry (releases the cache's reference)         */
+/* ------------------------------------------------------------------ */
+static void config_entry_free(config_entry_t *entry)
+{
+    if (!entry)
+        return;
+    free(entry->target_dir);
+    free(entry->level_gens);
+    htaccess_config_release(entry->config);
+    free(entry);
+}
+
+/* ------------------------------------------------------------------ */
+/* Config recency list (head = most recently used)                     */
+/* ------------------------------------------------------------------ */
+static void config_lru_unlink(config_entry_t *entry)
+{
+    if (entry->lru_prev)
+        entry->lru_prev->lru_next = entry->lru_next;
+    else
+        g_cache->lru_head = entry->lru_next;
+    if (entry->lru_next)
+        entry->lru_next->lru_prev = entry->lru_prev;
+    else
+        g_cache->lru_tail = entry->lru_prev;
+    entry->lru_prev = entry->lru_next = NULL;
+}
+
+static void config_lru_push(config_entry_t *entry)
+{
+    entry->lru_prev = NULL;
+    entry->lru_next = g_cache->lru_head;
+    if (g_cache->lru_head)
+        g_cache->lru_head->lru_prev = entry;
+    else
+        g_cache->lru_tail = entry;
+    g_cache->lru_head = entry;
+}
+
+/* Drop the least recently used config */
+static void config_evict_lru(void)
+{
+    config_entry_t *victim = g_cache->lru_tail;
+    if (!victim)
+        return;
+
+    size_t idx = hash_string(victim->target_dir, g_cache->num_buckets);
+    config_entry_t **link = &g_cache->config_buckets[idx];
+    while (*link != victim)
+        link = &(*link)->chain_next;
+    *link = victim->chain_next;
+    config_lru_unlink(victim);
+    config_entry_free(victim);
+    g_cache->num_configs--;
+}
+
 /* ------------------------------------------------------------------ */
 /* Public API                                                          */
 /* ------------------------------------------------------------------ */
@@ -96,14 +163,31 @@ int htaccess_cache_init(size_t initial_buckets)
         return -1;
     }
 
+    cache->config_buckets = calloc(initial_buckets, sizeof(config_entry_t *));
+    if (!cache->config_buckets) {
+        free(cache->buckets);
+        free(cache);
+        return -1;
+    }
+
     cache->num_buckets = initial_buckets;
     cache->num_entries = 0;
+    cache->num_configs = 0;
+    cache->next_generation = 1;
     g_cache = cache;
     return 0;
 }
 
 int htaccess_cache_get(const char *filepath, time_t current_mtime,
                        htaccess_directive_t **out_directives)
+{
+    return htaccess_cache_get_versioned(filepath, current_mtime,
+                                        out_directives, NULL);
+}
+
+int htaccess_cache_get_versioned(const char *filepath, time_t current_mtime,
+                                 htaccess_directive_t **out_directives,
+                                 uint64_t *out_generation)
 {
     if (!g_cache || !filepath || !out_directives)
         return -1;
@@ -116,6 +200,8 @@ int htaccess_cache_get(const char *filepath, time_t current_mtime,
             /* Found the path — check mtime */
             if (entry->mtime == current_mtime) {
                 *out_directives = entry->directives;
+                if (out_generation)
+                    *out_generation = entry->generation;
                 return 0;  /* Cache hit */
             }
             return -1;     /* mtime mismatch → miss */
@@ -144,6 +230,7 @@ int htaccess_cache_put(const char *filepath, time_t mtime,
             htaccess_directives_free(entry->directives);
             entry->directives = directives;
             entry->mtime = mtime;
+            entry->generation = g_cache->next_generation++;
             entry->memory_usage = sizeof(cache_entry_t)
                                 + strlen(filepath) + 1
                                 + estimate_directives_memory(directives);
@@ -166,6 +253,7 @@ int htaccess_cache_put(const char *filepath, time_t mtime,
 
     new_entry->mtime = mtime;
     new_entry->directives = directives;
+    new_entry->generation = g_cache->next_generation++;
     new_entry->memory_usage = sizeof(cache_entry_t)
                             + strlen(filepath) + 1
                             + estimate_directives_memory(directives);
@@ -179,6 +267,94 @@ int htaccess_cache_put(const char *filepath, time_t mtime,
     return 0;
 }
 
+int htaccess_cache_get_config(const char *target_dir,
+                              const uint64_t *level_gens, int num_levels,
+                              htaccess_config_t **out_config)
+{
+    if (!g_cache || !target_dir || !out_config || num_levels < 0)
+        return -1;
+
+    size_t idx = hash_string(target_dir, g_cache->num_buckets);
+    for (config_entry_t *entry = g_cache->config_buckets[idx]; entry;
+         entry = entry->chain_next) {
+        if (strcmp(entry->target_dir, target_dir) != 0)
+            continue;
+        if (entry->num_levels != num_levels ||
+            (num_levels > 0 &&
+             memcmp(entry->level_gens, level_gens,
+                    (size_t)num_levels * sizeof(uint64_t)) != 0))
+            return -1; /* a contributing file changed → miss */
+        config_lru_unlink(entry);
+        config_lru_push(entry);
+        htaccess_config_retain(entry->config);
+        *out_config = entry->config;
+        return 0;
+    }
+
+    return -1;
+}
+
+int htaccess_cache_put_config(const char *target_dir,
+                              const uint64_t *level_gens, int num_levels,
+                              htaccess_config_t *config)
+{
+    if (!g_cache || !target_dir || !config || num_levels < 0)
+        return -1;
+
+    size_t gens_size = (size_t)num_levels * sizeof(uint64_t);
+    uint64_t *gens = malloc(gens_size ? gens_size : 1);
+    if (!gens)
+        return -1;
+    if (gens_size)
+        memcpy(gens, level_gens, gens_size);
+
+    size_t idx = hash_string(target_dir, g_cache->num_buckets);
+    for (config_entry_t *entry = g_cache->config_buckets[idx]; entry;
+         entry = entry->chain_next) {
+        if (strcmp(entry->target_dir, target_dir) == 0) {
+            /* Replace existing entry's data */
+            htaccess_config_retain(config);
+            htaccess_config_release(entry->config);
+            free(entry->level_gens);
+            entry->config = config;
+            entry->level_gens = gens;
+            entry->num_levels = num_levels;
+            config_lru_unlink(entry);
+            config_lru_push(entry);
+            return 0;
+        }
+    }
+
+    /* New entry; make room first so the table stays bounded */
+    if (g_cache->num_configs >= CACHE_MAX_CONFIGS)
+        config_evict_lru();
+    config_entry_t *new_entry = calloc(1, sizeof(config_entry_t));
+    if (!new_entry) {
+        free(gens);
+        return -1;
+    }
+
+    new_entry->target_dir = strdup(target_dir);
+    if (!new_entry->target_dir) {
+        free(gens);
+        free(new_entry);
+        return -1;
+    }
+
+    htaccess_config_retain(config);
+    new_entry->config = config;
+    new_entry->level_gens = gens;
+    new_entry->num_levels = num_levels;
+
+    /* Insert at head of bucket chain */
+    new_entry->chain_next = g_cache->config_buckets[idx];
+    g_cache->config_buckets[idx] = new_entry;
+    config_lru_push(new_entry);
+    g_cache->num_configs++;
+
+    return 0;
+}
+
 void htaccess_cache_destroy(void)
 {
     if (!g_cache)
@@ -193,7 +369,17 @@ void htaccess_cache_destroy(void)
         }
     }
 
+    for (size_t i = 0; i < g_cache->num_buckets; i++) {
+        config_entry_t *entry = g_cache->config_buckets[i];
+        while (entry) {
+            config_entry_t *next = entry->chain_next;
+            config_entry_free(entry);
+            entry = next;
+        }
+    }
+
     free(g_cache->buckets);
+    free(g_cache->config_buckets);
     free(g_cache);
     g_cache = NULL;
 }
@@ -5,10 +5,18 @@
  */
 #include "htaccess_cidr.h"
 
+#include <arpa/inet.h>
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
 #include <ctype.h>
 
+/** Separators accepted between entries of a CIDR list. */
+#define CIDR_LIST_SEPS " ,\t"
+
+/** Longest list token we attempt to parse (longer ones are invalid). */
+#define CIDR_TOKEN_MAX 64
+
 /**
  * Internal: parse four dotted-decimal octets from `str` into a uint32_t
  * in host byte order.  On success sets *out and returns 0; on any format
@@ -151,3 +159,440 @@ int ip_parse(const char *ip_str, uint32_t *out_ip)
 
     return 0;
 }
+
+/* ------------------------------------------------------------------ */
+/*  128-bit address engine                                             */
+/* ------------------------------------------------------------------ */
+
+/** Upper 64 bits of every IPv4-mapped address (::ffff:0:0/96). */
+#define V4_MAPPED_HI 0ULL
+#define V4_MAPPED_LO_PREFIX 0x0000FFFF00000000ULL
+
+/** Longest address text we accept (IPv6 with embedded IPv4 + zone). */
+#define IP_TEXT_MAX 64
+
+static uint64_t mask64(unsigned bits)
+{
+    return bits ? ~0ULL << (64 - bits) : 0;
+}
+
+/* Zero every bit of `addr` past `prefix_len`. */
+static void addr_apply_prefix(ip_addr_t *addr, unsigned prefix_len)
+{
+    if (prefix_len <= 64) {
+        addr->hi &= mask64(prefix_len);
+        addr->lo = 0;
+    } else {
+        addr->lo &= mask64(prefix_len - 64);
+    }
+}
+
+static uint64_t load_be64(const unsigned char *b)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++)
+        v = (v << 8) | b[i];
+    return v;
+}
+
+/*
+ * Copy an address token (no surrounding whitespace, no zone) into buf.
+ * Returns 0 on success, -1 if it is empty or does not fit.
+ */
+static int copy_addr_text(const char *str, size_t len, char *buf)
+{
+    const char *zone = memchr(str, '%', len);
+    if (zone)
+        len = (size_t)(zone - str);
+    if (len == 0 || len >= IP_TEXT_MAX)
+        return -1;
+    memcpy(buf, str, len);
+    buf[len] = '\0';
+    return 0;
+}
+
+/*
+ * Parse the address part [str, str+len) of a token. Sets *is_v4 to the
+ * family that was written. Returns 0 on success, -1 on error.
+ */
+static int parse_addr_span(const char *str, size_t len, ip_addr_t *out,
+                           int *is_v4)
+{
+    char buf[IP_TEXT_MAX];
+
+    if (memchr(str, ':', len) == NULL) {
+        uint32_t v4;
+        const char *end;
+        if (parse_ipv4(str, &v4, &end) != 0 || end != str + len)
+            return -1;
+        ip_addr_from_v4(v4, out);
+        *is_v4 = 1;
+        return 0;
+    }
+
+    unsigned char raw[16];
+    if (copy_addr_text(str, len, buf) != 0 ||
+        inet_pton(AF_INET6, buf, raw) != 1)
+        return -1;
+    out->hi = load_be64(raw);
+    out->lo = load_be64(raw + 8);
+    *is_v4 = 0;
+    return 0;
+}
+
+void ip_addr_from_v4(uint32_t v4, ip_addr_t *out)
+{
+    if (!out)
+        return;
+    out->hi = V4_MAPPED_HI;
+    out->lo = V4_MAPPED_LO_PREFIX | v4;
+}
+
+int ip_addr_is_v4(const ip_addr_t *addr)
+{
+    return addr && addr->hi == V4_MAPPED_HI &&
+           (addr->lo >> 32) == (V4_MAPPED_LO_PREFIX >> 32);
+}
+
+int ip_addr_parse(const char *str, ip_addr_t *out)
+{
+    int is_v4;
+
+    if (!str || !out)
+        return -1;
+
+    while (*str && isspace((unsigned char)*str))
+        str++;
+    size_t len = strlen(str);
+    while (len > 0 && isspace((unsigned char)str[len - 1]))
+        len--;
+    if (len == 0)
+        return -1;
+
+    return parse_addr_span(str, len, out, &is_v4);
+}
+
+int ip_cidr_parse(const char *cidr_str, ip_cidr_t *out)
+{
+    int is_v4;
+
+    if (!cidr_str || !out)
+        return -1;
+
+    /* Skip surrounding whitespace */
+    while (*cidr_str && isspace((unsigned char)*cidr_str))
+        cidr_str++;
+    size_t len = strlen(cidr_str);
+    while (len > 0 && isspace((unsigned char)cidr_str[len - 1]))
+        len--;
+
+    /* Handle "all" keyword (case-insensitive) */
+    if (len == 3 && strncasecmp(cidr_str, "all", 3) == 0) {
+        memset(out, 0, sizeof(*out));
+        return 0;
+    }
+
+    const char *slash = memchr(cidr_str, '/', len);
+    size_t addr_len = slash ? (size_t)(slash - cidr_str) : len;
+    if (parse_addr_span(cidr_str, addr_len, &out->network, &is_v4) != 0)
+        return -1;
+
+    unsigned max_len = is_v4 ? 32 : 128;
+    unsigned prefix = max_len;
+    if (slash) {
+        const char *p = slash + 1;
+        const char *end = cidr_str + len;
+        if (p == end)
+            return -1;
+        prefix = 0;
+        for (; p < end; p++) {
+            if (!isdigit((unsigned char)*p))
+                return -1;
+            prefix = prefix * 10 + (unsigned)(*p - '0');
+            if (prefix > max_len)
+                return -1;
+        }
+    }
+
+    if (is_v4)
+        prefix += IP_V4_MAPPED_PREFIX;
+    out->prefix_len = (uint8_t)prefix;
+    addr_apply_prefix(&out->network, prefix);
+    return 0;
+}
+
+int ip_cidr_match(const ip_cidr_t *cidr, const ip_addr_t *addr)
+{
+    if (!cidr || !addr)
+        return 0;
+
+    unsigned len = cidr->prefix_len;
+    if (len <= 64)
+        return ((addr->hi ^ cidr->network.hi) & mask64(len)) == 0;
+    return addr->hi == cidr->network.hi &&
+           ((addr->lo ^ cidr->network.lo) & mask64(len - 64)) == 0;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Interval arithmetic                                                */
+/* ------------------------------------------------------------------ */
+
+/* Closed interval used while normalizing a set. */
+typedef struct {
+    ip_addr_t first;
+    ip_addr_t last;
+} ip_interval_t;
+
+static int addr_cmp(const ip_addr_t *a, const ip_addr_t *b)
+{
+    if (a->hi != b->hi)
+        return a->hi < b->hi ? -1 : 1;
+    if (a->lo != b->lo)
+        return a->lo < b->lo ? -1 : 1;
+    return 0;
+}
+
+/* Branch-free a <= b, so the search loop compiles to conditional moves. */
+static inline int addr_le(const ip_addr_t *a, const ip_addr_t *b)
+{
+    return (a->hi < b->hi) | ((a->hi == b->hi) & (a->lo <= b->lo));
+}
+
+static int interval_cmp(const void *a, const void *b)
+{
+    return addr_cmp(&((const ip_interval_t *)a)->first,
+                    &((const ip_interval_t *)b)->first);
+}
+
+/* Highest address inside a prefix (network | host bits). */
+static ip_addr_t cidr_last(const ip_cidr_t *cidr)
+{
+    ip_addr_t r = cidr->network;
+    unsigned len = cidr->prefix_len;
+    if (len <= 64) {
+        r.hi |= ~mask64(len);
+        r.lo = ~0ULL;
+    } else {
+        r.lo |= ~mask64(len - 64);
+    }
+    return r;
+}
+
+/* a + 1; returns 1 on wrap-around past the top of the address space. */
+static int addr_inc(ip_addr_t *a)
+{
+    if (++a->lo != 0)
+        return 0;
+    return ++a->hi == 0;
+}
+
+/*
+ * Sort and coalesce intervals in place: overlapping and adjacent ones
+ * are merged. Returns the new count.
+ */
+static int intervals_normalize(ip_interval_t *iv, int n)
+{
+    int out = 0;
+
+    if (n <= 0)
+        return 0;
+    qsort(iv, (size_t)n, sizeof(*iv), interval_cmp);
+
+    for (int i = 1; i < n; i++) {
+        ip_addr_t next = iv[out].last;
+        int wrapped = addr_inc(&next);
+        if (wrapped || addr_le(&iv[i].first, &next)) {
+            /* Overlaps or touches the current interval */
+            if (addr_cmp(&iv[i].last, &iv[out].last) > 0)
+                iv[out].last = iv[i].last;
+        } else {
+            iv[++out] = iv[i];
+        }
+    }
+    return out + 1;
+}
+
+/* Move normalized intervals into the set's flat arrays. */
+static int set_from_intervals(cidr_set_t *out, const ip_interval_t *iv,
+                              int n)
+{
+    out->first = (ip_addr_t *)malloc((size_t)n * 2 * sizeof(ip_addr_t));
+    if (!out->first)
+        return -1;
+    out->last = out->first + n;
+    for (int i = 0; i < n; i++) {
+        out->first[i] = iv[i].first;
+        out->last[i] = iv[i].last;
+    }
+    out->count = n;
+    return 0;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Compiled CIDR sets                                                 */
+/* ------------------------------------------------------------------ */
+
+/**
+ * Internal: copy the next list token from *pp into buf (NUL-terminated).
+ * Returns the token length, 0 at end of list. Tokens that do not fit in
+ * buf are consumed and reported as length -1 so callers can skip them.
+ */
+static int next_list_token(const char **pp, char *buf, size_t buf_size)
+{
+    const char *p = *pp;
+    size_t len;
+
+    p += strspn(p, CIDR_LIST_SEPS);
+    len = strcspn(p, CIDR_LIST_SEPS);
+    *pp = p + len;
+    if (len == 0)
+        return 0;
+    if (len >= buf_size)
+        return -1;
+    memcpy(buf, p, len);
+    buf[len] = '\0';
+    return (int)len;
+}
+
+int cidr_set_compile(const char *list, cidr_set_t *out)
+{
+    char tok[CIDR_TOKEN_MAX];
+    const char *p;
+    ip_interval_t *iv;
+    int cap = 0;
+    int n = 0;
+    int len;
+
+    if (!out)
+        return -1;
+    memset(out, 0, sizeof(*out));
+    if (!list)
+        return 0;
+
+    /* First pass: upper bound on the number of entries */
+    for (p = list; (len = next_list_token(&p, tok, sizeof(tok))) != 0; )
+        cap++;
+    if (cap == 0)
+        return 0;
+
+    iv = (ip_interval_t *)malloc((size_t)cap * sizeof(*iv));
+    if (!iv)
+        return -1;
+
+    for (p = list; (len = next_list_token(&p, tok, sizeof(tok))) != 0; ) {
+        ip_cidr_t cidr;
+        if (len > 0 && ip_cidr_parse(tok, &cidr) == 0) {
+            iv[n].first = cidr.network;
+            iv[n].last = cidr_last(&cidr);
+            n++;
+        }
+    }
+
+    n = intervals_normalize(iv, n);
+    int rc = n > 0 ? set_from_intervals(out, iv, n) : 0;
+    free(iv);
+    return rc < 0 ? -1 : out->count;
+}
+
+int cidr_set_match(const cidr_set_t *set, const ip_addr_t *addr)
+{
+    if (!set || !addr || set->count <= 0)
+        return 0;
+
+    /*
+     * Find the last interval starting at or before addr. The loop has a
+     * fixed trip count for a given set size and no data-dependent
+     * branches, so mispredictions do not grow with the rule count.
+     */
+    const ip_addr_t *base = set->first;
+    size_t n = (size_t)set->count;
+    while (n > 1) {
+        size_t half = n / 2;
+        base += addr_le(&base[half], addr) ? half : 0;
+        n -= half;
+    }
+
+    size_t idx = (size_t)(base - set->first);
+    return addr_le(base, addr) & addr_le(addr, &set->last[idx]);
+}
+
+int cidr_set_union(cidr_set_t *out, const cidr_set_t *const *sets, int nsets)
+{
+    ip_interval_t *iv;
+    int total = 0;
+    int n = 0;
+
+    if (!out)
+        return -1;
+    memset(out, 0, sizeof(*out));
+    for (int i = 0; i < nsets; i++)
+        total += sets[i] ? sets[i]->count : 0;
+    if (total == 0)
+        return 0;
+
+    iv = (ip_interval_t *)malloc((size_t)total * sizeof(*iv));
+    if (!iv)
+        return -1;
+    for (int i = 0; i < nsets; i++) {
+        for (int j = 0; sets[i] && j < sets[i]->count; j++) {
+            iv[n].first = sets[i]->first[j];
+            iv[n].last = sets[i]->last[j];
+            n++;
+        }
+    }
+
+    n = intervals_normalize(iv, n);
+    int rc = set_from_intervals(out, iv, n);
+    free(iv);
+    return rc < 0 ? -1 : out->count;
+}
+
+size_t cidr_set_memory(const cidr_set_t *set)
+{
+    return set ? (size_t)set->count * 2 * sizeof(ip_addr_t) : 0;
+}
+
+int cidr_set_copy(cidr_set_t *dst, const cidr_set_t *src)
+{
+    if (!dst)
+        return -1;
+    memset(dst, 0, sizeof(*dst));
+    if (!src || src->count <= 0 || !src->first)
+        return 0;
+
+    size_t bytes = cidr_set_memory(src);
+    dst->first = (ip_addr_t *)malloc(bytes);
+    if (!dst->first)
+        return -1;
+    dst->last = dst->first + src->count;
+    memcpy(dst->first, src->first, (size_t)src->count * sizeof(ip_addr_t));
+    memcpy(dst->last, src->last, (size_t)src->count * sizeof(ip_addr_t));
+    dst->count = src->count;
+    return 0;
+}
+
+void cidr_set_free(cidr_set_t *set)
+{
+    if (!set)
+        return;
+    free(set->first);
+    memset(set, 0, sizeof(*set));
+}
+
+int cidr_list_match(const char *list, const ip_addr_t *addr)
+{
+    char tok[CIDR_TOKEN_MAX];
+    const char *p;
+    int len;
+
+    if (!list || !addr)
+        return 0;
+
+    for (p = list; (len = next_list_token(&p, tok, sizeof(tok))) != 0; ) {
+        ip_cidr_t cidr;
+        if (len > 0 && ip_cidr_parse(tok, &cidr) == 0 &&
+            ip_cidr_match(&cidr, addr))
+            return 1;
+    }
+    return 0;
+}
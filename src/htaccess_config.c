@@ -0,0 +1,89 @@
+/**
+ * htaccess_config.c - Effective per-directory configuration implementation
+ *
+ * Validates: Requirements 3.1, 13.1, 13.2
+ */
+#include "htaccess_config.h"
+
+#include <stdlib.h>
+
+htaccess_config_t *htaccess_config_create(htaccess_directive_t *directives)
+{
+    htaccess_config_t *cfg = calloc(1, sizeof(htaccess_config_t));
+    if (!cfg) {
+        htaccess_directives_free(directives);
+        return NULL;
+    }
+
+    cfg->directives = directives;
+    cfg->refcount = 1;
+    cfg->acl_ready = (acl_compile(directives, &cfg->acl) == 0);
+    cfg->require_ready = (require_compile(directives, NULL,
+                                          &cfg->require) == 0);
+    cfg->bf_paths_ready = (bf_path_trie_compile(directives,
+                                                &cfg->bf_paths) == 0);
+    cfg->redirects_ready = (redirect_set_compile(directives,
+                                                 &cfg->redirects) == 0);
+    return cfg;
+}
+
+void htaccess_config_retain(htaccess_config_t *cfg)
+{
+    if (cfg)
+        cfg->refcount++;
+}
+
+void htaccess_config_release(htaccess_config_t *cfg)
+{
+    if (!cfg || --cfg->refcount > 0)
+        return;
+
+    acl_compiled_free(&cfg->acl);
+    require_program_free(&cfg->require);
+    bf_path_trie_free(&cfg->bf_paths);
+    redirect_set_free(&cfg->redirects);
+    htaccess_directives_free(cfg->directives);
+    free(cfg);
+}
+
+int htaccess_config_exec_acl(const htaccess_request_t *req,
+                             const htaccess_config_t *cfg)
+{
+    if (!cfg)
+        return LSI_OK;
+    if (cfg->acl_ready)
+        return exec_access_control_compiled_req(req, &cfg->acl);
+    return exec_access_control_req(req, cfg->directives);
+}
+
+int htaccess_config_exec_require(const htaccess_request_t *req,
+                                 const htaccess_config_t *cfg)
+{
+    if (!cfg)
+        return LSI_OK;
+    if (cfg->require_ready)
+        return exec_require_compiled(req, &cfg->require);
+    return exec_require_req(req, cfg->directives);
+}
+
+int htaccess_config_exec_brute_force(const htaccess_request_t *req,
+                                     const htaccess_config_t *cfg)
+{
+    if (!cfg)
+        return LSI_OK;
+    return exec_brute_force_compiled_req(req, cfg->directives,
+                                         cfg->bf_paths_ready
+                                             ? &cfg->bf_paths : NULL);
+}
+
+int htaccess_config_exec_brute_force_resp(const htaccess_request_t *req,
+                                          const htaccess_config_t *cfg,
+                                          int status)
+{
+    if (!cfg)
+        return 0;
+    return exec_brute_force_resp_compiled_req(req, cfg->directives,
+                                              cfg->bf_paths_ready
+                                                  ? &cfg->bf_paths : NULL,
+                                              status);
+}
@@ -3,7 +3,7 @@
  *
  * Implements htaccess_directives_free() which walks a directive linked list
  * and releases all dynamically allocated memory, including type-specific
- * strings and nested children (FilesMatch).
+ * strings, compiled CIDR sets and nested children (FilesMatch).
  *
  * Validates: Requirements 2.2
  */
@@ -24,6 +24,7 @@ static void directive_free_fields(htaccess_directive_t *dir)
     switch (dir->type) {
     case DIR_REDIRECT:
     case DIR_REDIRECT_MATCH:
+    case DIR_REDIRECT_MAP:
         free(dir->data.redirect.pattern);
         break;
 
@@ -59,6 +60,15 @@ static void directive_free_fields(htaccess_directive_t *dir)
         htaccess_directives_free(dir->data.limit.children);
         break;
 
+    /* IP-bearing directives — compiled CIDR sets */
+    case DIR_ALLOW_FROM:
+    case DIR_DENY_FROM:
+    case DIR_REQUIRE_IP:
+    case DIR_REQUIRE_NOT_IP:
+    case DIR_BRUTE_FORCE_WHITELIST:
+        cidr_set_free(&dir->data.ip.cidrs);
+        break;
+
     default:
         /* No additional heap allocations for other types */
         break;
@@ -75,3 +85,13 @@ void htaccess_directives_free(htaccess_directive_t *head)
         cur = next;
     }
 }
+
+int htaccess_directive_ip_match(const htaccess_directive_t *dir,
+                                const ip_addr_t *addr)
+{
+    if (!dir)
+        return 0;
+    if (dir->data.ip.compiled)
+        return cidr_set_match(&dir->data.ip.cidrs, addr);
+    return cidr_list_match(dir->value, addr);
+}
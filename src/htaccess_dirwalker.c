@@ -22,6 +22,8 @@
 /* Maximum path length */
 #define MAX_PATH_LEN 4096
 
+static htaccess_directive_t *copy_directive_list(const htaccess_directive_t *src);
+
 /* ------------------------------------------------------------------ */
 /* Internal: deep-copy a single directive node                         */
 /* ------------------------------------------------------------------ */
@@ -48,23 +50,8 @@ static htaccess_directive_t *copy_directive(const htaccess_directive_t *src)
     case DIR_FILES_MATCH:
         if (src->data.files_match.pattern)
             d->data.files_match.pattern = strdup(src->data.files_match.pattern);
-        /* Deep-copy children */
-        d->data.files_match.children = NULL;
-        if (src->data.files_match.children) {
-            htaccess_directive_t *child_head = NULL;
-            htaccess_directive_t *child_tail = NULL;
-            for (const htaccess_directive_t *c = src->data.files_match.children;
-                 c; c = c->next) {
-                htaccess_directive_t *cc = copy_directive(c);
-                if (!cc) break;
-                if (!child_head)
-                    child_head = cc;
-                else
-                    child_tail->next = cc;
-                child_tail = cc;
-            }
-            d->data.files_match.children = child_head;
-        }
+        d->data.files_match.children =
+            copy_directive_list(src->data.files_match.children);
         break;
     case DIR_SETENVIF:
     case DIR_BROWSER_MATCH:
@@ -73,6 +60,37 @@ static htaccess_directive_t *copy_directive(const htaccess_directive_t *src)
         if (src->data.envif.pattern)
             d->data.envif.pattern = strdup(src->data.envif.pattern);
         break;
+    /*
+     * Containers must not alias the cached children: the merged list is
+     * freed independently of the cache entry it was copied from.
+     */
+    case DIR_IFMODULE:
+        d->data.ifmodule.children =
+            copy_directive_list(src->data.ifmodule.children);
+        break;
+    case DIR_FILES:
+        d->data.files.children = copy_directive_list(src->data.files.children);
+        break;
+    case DIR_REQUIRE_ANY_OPEN:
+    case DIR_REQUIRE_ALL_OPEN:
+        d->data.require_container.children =
+            copy_directive_list(src->data.require_container.children);
+        break;
+    case DIR_LIMIT:
+    case DIR_LIMIT_EXCEPT:
+        if (src->data.limit.methods)
+            d->data.limit.methods = strdup(src->data.limit.methods);
+        d->data.limit.children = copy_directive_list(src->data.limit.children);
+        break;
+    case DIR_ALLOW_FROM:
+    case DIR_DENY_FROM:
+    case DIR_REQUIRE_IP:
+    case DIR_REQUIRE_NOT_IP:
+    case DIR_BRUTE_FORCE_WHITELIST:
+        /* A failed copy leaves the value to be matched as a string */
+        d->data.ip.compiled = src->data.ip.compiled &&
+            cidr_set_copy(&d->data.ip.cidrs, &src->data.ip.cidrs) == 0;
+        break;
     default:
         break;
     }
@@ -163,6 +181,10 @@ static int directives_match_for_override(const htaccess_directive_t *a,
     case DIR_BRUTE_FORCE_WINDOW:
     case DIR_BRUTE_FORCE_ACTION:
     case DIR_BRUTE_FORCE_THROTTLE_DURATION:
+    case DIR_BRUTE_FORCE_IPV4_PREFIX:
+    case DIR_BRUTE_FORCE_IPV6_PREFIX:
+    case DIR_BRUTE_FORCE_PREFIX_ATTEMPTS:
+    case DIR_BRUTE_FORCE_FAILURE_STATUS:
         return 1;
 
     /* Allow/Deny: match by value (CIDR or "all") */
@@ -260,7 +282,8 @@ static htaccess_directive_t *merge_directives(htaccess_directive_t *parent,
 /* ------------------------------------------------------------------ */
 /* Internal: try to read and parse a file, then cache it               */
 /* ------------------------------------------------------------------ */
-static htaccess_directive_t *read_and_cache(const char *htaccess_path)
+static htaccess_directive_t *read_and_cache(const char *htaccess_path,
+                                            uint64_t *out_generation)
 {
     struct stat st;
     if (stat(htaccess_path, &st) != 0)
@@ -298,22 +321,59 @@ static htaccess_directive_t *read_and_cache(const char *htaccess_path)
 
     /* We need to return a copy since cache owns the original */
     htaccess_directive_t *cached = NULL;
-    htaccess_cache_get(htaccess_path, st.st_mtime, &cached);
+    htaccess_cache_get_versioned(htaccess_path, st.st_mtime, &cached,
+                                 out_generation);
     return cached;
 }
 
 /* ------------------------------------------------------------------ */
-/* Public API                                                          */
+/* Internal: load the cached directive list of every level             */
+/*                                                                     */
+/* Levels run from doc_root down to target_dir. The lists are borrowed */
+/* from the cache; gens[i] is 0 for levels without a .htaccess file.   */
 /* ------------------------------------------------------------------ */
+typedef struct {
+    const htaccess_directive_t *dirs[MAX_DIR_DEPTH];
+    uint64_t gens[MAX_DIR_DEPTH];
+    int count;
+} dir_levels_t;
 
-htaccess_directive_t *htaccess_dirwalk(lsi_session_t *session,
-                                       const char *doc_root,
-                                       const char *target_dir)
+static void load_level(dir_levels_t *levels, const char *dir_path)
 {
-    (void)session; /* Not used currently; reserved for logging */
+    int i = levels->count++;
+    levels->dirs[i] = NULL;
+    levels->gens[i] = 0;
+
+    /* Construct .htaccess path for this directory */
+    char htaccess_path[MAX_PATH_LEN];
+    int written = snprintf(htaccess_path, MAX_PATH_LEN,
+                           "%s/.htaccess", dir_path);
+    if (written < 0 || written >= MAX_PATH_LEN)
+        return;
+
+    /* Try cache first */
+    htaccess_directive_t *level_dirs = NULL;
+    struct stat st;
+    time_t mtime = 0;
+
+    if (stat(htaccess_path, &st) == 0)
+        mtime = st.st_mtime;
+
+    if (htaccess_cache_get_versioned(htaccess_path, mtime, &level_dirs,
+                                     &levels->gens[i]) != 0) {
+        /* Cache miss — try to read and parse the file */
+        level_dirs = read_and_cache(htaccess_path, &levels->gens[i]);
+    }
+    levels->dirs[i] = level_dirs;
+}
+
+static int collect_levels(const char *doc_root, const char *target_dir,
+                          dir_levels_t *levels)
+{
+    levels->count = 0;
 
     if (!doc_root || !target_dir)
-        return NULL;
+        return -1;
 
     size_t root_len = strlen(doc_root);
     size_t target_len = strlen(target_dir);
@@ -324,88 +384,25 @@ htaccess_directive_t *htaccess_dirwalk(lsi_session_t *session,
 
     /* target_dir must start with doc_root */
     if (target_len < root_len)
-        return NULL;
+        return -1;
     if (strncmp(doc_root, target_dir, root_len) != 0)
-        return NULL;
-
-    /* Collect directory paths from root to target */
-    char paths[MAX_DIR_DEPTH][MAX_PATH_LEN];
-    int num_paths = 0;
-
-    /* First path: doc_root itself */
-    if (root_len < MAX_PATH_LEN) {
-        memcpy(paths[num_paths], doc_root, root_len);
-        paths[num_paths][root_len] = '\0';
-        num_paths++;
-    }
-
-    /* Walk through remaining path components */
-    const char *rest = target_dir + root_len;
-    size_t current_len = root_len;
-
-    while (*rest && num_paths < MAX_DIR_DEPTH) {
-        /* Skip leading slash */
-        if (*rest == '/') {
-            rest++;
-            continue;
-        }
-
-        /* Find end of this path component */
-        const char *slash = strchr(rest, '/');
-        size_t comp_len = slash ? (size_t)(slash - rest) : strlen(rest);
-
-        if (current_len + 1 + comp_len >= MAX_PATH_LEN)
-            break;
-
-        /* Build path up to this component */
-        memcpy(paths[num_paths], doc_root, root_len);
-        paths[num_paths][root_len] = '\0';
-
-        /* Append all components up to and including this one */
-        const char *p = target_dir + root_len;
-        size_t path_len = root_len;
-        int components_added = 0;
-        int target_components = num_paths; /* how many components to add */
-
-        while (*p && components_added < target_components) {
-            if (*p == '/') {
-                p++;
-                continue;
-            }
-            const char *next_slash = strchr(p, '/');
-            size_t clen = next_slash ? (size_t)(next_slash - p) : strlen(p);
-            paths[num_paths][path_len] = '/';
-            memcpy(paths[num_paths] + path_len + 1, p, clen);
-            path_len += 1 + clen;
-            paths[num_paths][path_len] = '\0';
-            p = next_slash ? next_slash + 1 : p + clen;
-            components_added++;
-        }
-
-        num_paths++;
-        current_len += 1 + comp_len;
-        rest = slash ? slash : rest + comp_len;
-    }
-
-    /* Simpler approach: rebuild paths array properly */
-    num_paths = 0;
+        return -1;
 
     /* Build all directory paths from root to target */
     char current_path[MAX_PATH_LEN];
     if (root_len >= MAX_PATH_LEN)
-        return NULL;
+        return -1;
 
     memcpy(current_path, doc_root, root_len);
     current_path[root_len] = '\0';
+    size_t cur_len = root_len;
 
     /* Add doc_root */
-    strncpy(paths[num_paths], current_path, MAX_PATH_LEN - 1);
-    paths[num_paths][MAX_PATH_LEN - 1] = '\0';
-    num_paths++;
+    load_level(levels, current_path);
 
     /* Walk remaining components */
-    rest = target_dir + root_len;
-    while (*rest && num_paths < MAX_DIR_DEPTH) {
+    const char *rest = target_dir + root_len;
+    while (*rest && levels->count < MAX_DIR_DEPTH) {
         if (*rest == '/') {
             rest++;
             continue;
@@ -413,53 +410,75 @@ htaccess_directive_t *htaccess_dirwalk(lsi_session_t *session,
         const char *slash = strchr(rest, '/');
         size_t comp_len = slash ? (size_t)(slash - rest) : strlen(rest);
 
-        size_t cur_len = strlen(current_path);
         if (cur_len + 1 + comp_len >= MAX_PATH_LEN)
             break;
 
         current_path[cur_len] = '/';
         memcpy(current_path + cur_len + 1, rest, comp_len);
-        current_path[cur_len + 1 + comp_len] = '\0';
+        cur_len += 1 + comp_len;
+        current_path[cur_len] = '\0';
 
-        strncpy(paths[num_paths], current_path, MAX_PATH_LEN - 1);
-        paths[num_paths][MAX_PATH_LEN - 1] = '\0';
-        num_paths++;
+        load_level(levels, current_path);
 
         rest = slash ? slash + 1 : rest + comp_len;
     }
 
-    /* Now process each directory level */
+    return 0;
+}
+
+/* Merge the levels parent-first (child overrides parent). */
+static htaccess_directive_t *merge_levels(const dir_levels_t *levels)
+{
     htaccess_directive_t *merged = NULL;
 
-    for (int i = 0; i < num_paths; i++) {
-        /* Construct .htaccess path for this directory */
-        char htaccess_path[MAX_PATH_LEN];
-        int written = snprintf(htaccess_path, MAX_PATH_LEN,
-                               "%s/.htaccess", paths[i]);
-        if (written < 0 || written >= MAX_PATH_LEN)
-            continue;
+    for (int i = 0; i < levels->count; i++) {
+        /* If no directives at this level, skip (doesn't affect inheritance) */
+        if (levels->dirs[i])
+            merged = merge_directives(merged, levels->dirs[i]);
+    }
+    return merged;
+}
 
-        /* Try cache first */
-        htaccess_directive_t *level_dirs = NULL;
-        struct stat st;
-        time_t mtime = 0;
+/* ------------------------------------------------------------------ */
+/* Public API                                                          */
+/* ------------------------------------------------------------------ */
 
-        if (stat(htaccess_path, &st) == 0)
-            mtime = st.st_mtime;
+htaccess_directive_t *htaccess_dirwalk(lsi_session_t *session,
+                                       const char *doc_root,
+                                       const char *target_dir)
+{
+    (void)session; /* Not used currently; reserved for logging */
 
-        int cache_hit = htaccess_cache_get(htaccess_path, mtime, &level_dirs);
+    dir_levels_t levels;
+    if (collect_levels(doc_root, target_dir, &levels) != 0)
+        return NULL;
 
-        if (cache_hit != 0) {
-            /* Cache miss — try to read and parse the file */
-            level_dirs = read_and_cache(htaccess_path);
-        }
+    return merge_levels(&levels);
+}
 
-        if (level_dirs) {
-            /* Merge this level's directives into the accumulated result */
-            merged = merge_directives(merged, level_dirs);
-        }
-        /* If no directives at this level, skip (doesn't affect inheritance) */
-    }
+htaccess_config_t *htaccess_dirwalk_config(lsi_session_t *session,
+                                           const char *doc_root,
+                                           const char *target_dir)
+{
+    (void)session; /* Not used currently; reserved for logging */
 
-    return merged;
+    dir_levels_t levels;
+    if (collect_levels(doc_root, target_dir, &levels) != 0)
+        return NULL;
+
+    htaccess_config_t *cfg = NULL;
+    if (htaccess_cache_get_config(target_dir, levels.gens, levels.count,
+                                  &cfg) == 0)
+        return cfg;
+
+    htaccess_directive_t *merged = merge_levels(&levels);
+    if (!merged)
+        return NULL;
+
+    cfg = htaccess_config_create(merged);
+    if (cfg) {
+        /* Not fatal if it fails: the config is just rebuilt next time */
+        htaccess_cache_put_config(target_dir, levels.gens, levels.count, cfg);
+    }
+    return cfg;
 }
@@ -2,59 +2,137 @@
  * htaccess_exec_acl.c - Access control directive executor implementation
  *
  * Implements Apache-compatible Order/Allow/Deny access control evaluation
- * with CIDR matching and "all" keyword support.
+ * with CIDR matching and "all" keyword support. Rule values are matched
+ * through the CIDR sets compiled by the parser; the compiled form folds
+ * them further into one allow and one deny interval set per effective
+ * config.
  *
  * Validates: Requirements 6.1, 6.2, 6.3, 6.4, 6.5, 6.6
  */
 #include "htaccess_exec_acl.h"
 #include "htaccess_cidr.h"
 
+#include <stdlib.h>
 #include <string.h>
-#include <strings.h>
+
+/* ------------------------------------------------------------------ */
+/* Internal helpers                                                    */
+/* ------------------------------------------------------------------ */
 
 /**
- * Check if a client IP matches a single Allow/Deny rule value.
- *
- * The rule value can be:
- *   - "all"           → matches any IP
- *   - "A.B.C.D"       → matches a single IP (/32)
- *   - "A.B.C.D/N"     → matches a CIDR range
- *
- * @param rule_value  The Allow/Deny rule string (e.g. "192.168.1.0/24").
- * @param client_ip   Client IP as uint32_t in host byte order.
- * @return 1 if the IP matches the rule, 0 otherwise.
+ * Apply Apache ACL semantics to the match results and set 403 on deny.
  */
-static int ip_matches_rule(const char *rule_value, uint32_t client_ip)
+static int acl_decide(lsi_session_t *session, acl_order_t order,
+                      int allow_matched, int deny_matched)
 {
-    cidr_v4_t cidr;
+    int denied = 0;
+
+    if (order == ORDER_ALLOW_DENY) {
+        /*
+         * Order Allow,Deny: Default is DENY.
+         * Allow rules evaluated first, then Deny rules override.
+         * Access is allowed only if Allow matches AND Deny does not match.
+         */
+        if (allow_matched && !deny_matched)
+            denied = 0;
+        else
+            denied = 1;
+    } else {
+        /*
+         * Order Deny,Allow: Default is ALLOW.
+         * Deny rules evaluated first, then Allow rules override.
+         * Access is denied only if Deny matches AND Allow does not match.
+         */
+        if (deny_matched && !allow_matched)
+            denied = 1;
+        else
+            denied = 0;
+    }
 
-    if (!rule_value)
+    if (denied) {
+        lsi_session_set_status(session, 403);
+        return LSI_ERROR;
+    }
+
+    return LSI_OK;
+}
+
+/*
+ * Union the CIDR sets of every directive of `type` into `out`. Hand-built
+ * directives without a compiled set have their value compiled on the fly.
+ */
+static int union_directive_sets(const htaccess_directive_t *directives,
+                                directive_type_t type, cidr_set_t *out)
+{
+    const htaccess_directive_t *dir;
+    int n = 0;
+    int rc = 0;
+
+    memset(out, 0, sizeof(*out));
+    for (dir = directives; dir; dir = dir->next) {
+        if (dir->type == type && dir->value)
+            n++;
+    }
+    if (n == 0)
         return 0;
 
-    /* Handle "all" keyword explicitly */
-    if (strcasecmp(rule_value, "all") == 0)
-        return 1;
+    const cidr_set_t **parts = malloc((size_t)n * sizeof(*parts));
+    cidr_set_t *tmp = calloc((size_t)n, sizeof(*tmp));
+    if (!parts || !tmp) {
+        free(parts);
+        free(tmp);
+        return -1;
+    }
+
+    int i = 0;
+    for (dir = directives; dir; dir = dir->next) {
+        if (dir->type != type || !dir->value)
+            continue;
+        if (dir->data.ip.compiled) {
+            parts[i] = &dir->data.ip.cidrs;
+        } else {
+            if (cidr_set_compile(dir->value, &tmp[i]) < 0)
+                rc = -1;
+            parts[i] = &tmp[i];
+        }
+        i++;
+    }
 
-    /* Parse CIDR/IP and match */
-    if (cidr_parse(rule_value, &cidr) != 0)
-        return 0; /* Invalid rule — skip */
+    if (rc == 0 && cidr_set_union(out, parts, n) < 0)
+        rc = -1;
 
-    return cidr_match(&cidr, client_ip);
+    for (i = 0; i < n; i++)
+        cidr_set_free(&tmp[i]);
+    free(tmp);
+    free(parts);
+    return rc;
 }
 
+/* ------------------------------------------------------------------ */
+/* Public API                                                          */
+/* ------------------------------------------------------------------ */
+
 int exec_access_control(lsi_session_t *session,
                         const htaccess_directive_t *directives)
+{
+    htaccess_request_t req;
+
+    if (!session || !directives)
+        return LSI_OK;
+    htaccess_request_init(&req, session);
+    return exec_access_control_req(&req, directives);
+}
+
+int exec_access_control_req(const htaccess_request_t *req,
+                            const htaccess_directive_t *directives)
 {
     const htaccess_directive_t *dir;
     acl_order_t order = ORDER_ALLOW_DENY; /* default */
     int have_order = 0;
     int allow_matched = 0;
     int deny_matched = 0;
-    uint32_t client_ip;
-    int ip_len = 0;
-    const char *ip_str;
 
-    if (!session || !directives)
+    if (!req || !req->session || !directives)
         return LSI_OK;
 
     /* Find the Order directive (use the last one found) */
@@ -78,54 +156,82 @@ int exec_access_control(lsi_session_t *session,
             return LSI_OK;
     }
 
-    /* Get client IP */
-    ip_str = lsi_session_get_client_ip(session, &ip_len);
-    if (!ip_str || ip_len <= 0)
-        return LSI_OK; /* No client IP available, allow by default */
-
-    if (ip_parse(ip_str, &client_ip) != 0)
-        return LSI_OK; /* Cannot parse client IP, allow by default */
+    /* No usable client IP → allow by default */
+    if (!req->client_addr_ok)
+        return LSI_OK;
 
     /* Check all Allow and Deny rules */
     for (dir = directives; dir; dir = dir->next) {
         if (dir->type == DIR_ALLOW_FROM && dir->value) {
-            if (ip_matches_rule(dir->value, client_ip))
+            if (htaccess_directive_ip_match(dir, &req->client_addr))
                 allow_matched = 1;
         } else if (dir->type == DIR_DENY_FROM && dir->value) {
-            if (ip_matches_rule(dir->value, client_ip))
+            if (htaccess_directive_ip_match(dir, &req->client_addr))
                 deny_matched = 1;
         }
     }
 
-    /* Evaluate according to Apache ACL semantics */
-    int denied = 0;
+    return acl_decide(req->session, order, allow_matched, deny_matched);
+}
 
-    if (order == ORDER_ALLOW_DENY) {
-        /*
-         * Order Allow,Deny: Default is DENY.
-         * Allow rules evaluated first, then Deny rules override.
-         * Access is allowed only if Allow matches AND Deny does not match.
-         */
-        if (allow_matched && !deny_matched)
-            denied = 0;
-        else
-            denied = 1;
-    } else {
-        /*
-         * Order Deny,Allow: Default is ALLOW.
-         * Deny rules evaluated first, then Allow rules override.
-         * Access is denied only if Deny matches AND Allow does not match.
-         */
-        if (deny_matched && !allow_matched)
-            denied = 1;
-        else
-            denied = 0;
+int acl_compile(const htaccess_directive_t *directives, acl_compiled_t *out)
+{
+    if (!out)
+        return -1;
+
+    memset(out, 0, sizeof(*out));
+    out->order = ORDER_ALLOW_DENY;
+
+    for (const htaccess_directive_t *dir = directives; dir; dir = dir->next) {
+        if (dir->type == DIR_ORDER) {
+            out->order = dir->data.acl.order;
+            out->active = 1;
+        } else if (dir->type == DIR_ALLOW_FROM || dir->type == DIR_DENY_FROM) {
+            out->active = 1;
+        }
     }
+    if (!out->active)
+        return 0;
 
-    if (denied) {
-        lsi_session_set_status(session, 403);
-        return LSI_ERROR;
+    if (union_directive_sets(directives, DIR_ALLOW_FROM, &out->allow) != 0 ||
+        union_directive_sets(directives, DIR_DENY_FROM, &out->deny) != 0) {
+        acl_compiled_free(out);
+        return -1;
     }
+    return 0;
+}
 
-    return LSI_OK;
+void acl_compiled_free(acl_compiled_t *acl)
+{
+    if (!acl)
+        return;
+    cidr_set_free(&acl->allow);
+    cidr_set_free(&acl->deny);
+    acl->active = 0;
+}
+
+int exec_access_control_compiled(lsi_session_t *session,
+                                 const acl_compiled_t *acl)
+{
+    htaccess_request_t req;
+
+    if (!session || !acl || !acl->active)
+        return LSI_OK;
+    htaccess_request_init(&req, session);
+    return exec_access_control_compiled_req(&req, acl);
+}
+
+int exec_access_control_compiled_req(const htaccess_request_t *req,
+                                     const acl_compiled_t *acl)
+{
+    if (!req || !req->session || !acl || !acl->active)
+        return LSI_OK;
+
+    /* No usable client IP → allow by default */
+    if (!req->client_addr_ok)
+        return LSI_OK;
+
+    return acl_decide(req->session, acl->order,
+                      cidr_set_match(&acl->allow, &req->client_addr),
+                      cidr_set_match(&acl->deny, &req->client_addr));
 }
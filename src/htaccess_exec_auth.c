@@ -2,19 +2,36 @@
  * htaccess_exec_auth.c - AuthType Basic executor
  *
  * Collects auth config from directive list, validates Authorization header
- * against htpasswd file entries. Supports crypt hash format.
+ * against htpasswd file entries. apr1, MD5-crypt, {SHA} and SHA-crypt
+ * hashes are checked by the native verifiers in htaccess_pwhash.c, other
+ * crypt formats by libc. The AuthUserFile is read through the htpasswd
+ * cache, so a request only touches the file when it changed.
+ *
+ * "Require user" and "Require group" are decided before the password is
+ * hashed: a user no Require line admits gets the same 401 a wrong
+ * password would, without paying for the hash. Group membership comes
+ * from the compiled AuthGroupFile (htaccess_htgroup.c).
  *
  * Validates: Requirements 10.1-10.9
  */
 #define _GNU_SOURCE
 #include "htaccess_exec_auth.h"
+#include "htaccess_authpool.h"
+#include "htaccess_htgroup.h"
+#include "htaccess_htpasswd.h"
+#include "htaccess_pwhash.h"
+#include "htaccess_session_map.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <time.h>
 #include <unistd.h>
 
+/** Longest password hash accepted from an AuthUserFile. */
+#define HTPASSWD_HASH_MAX 512
+
 /* Base64 decode table */
 static const unsigned char b64_table[256] = {
     ['A']=0,['B']=1,['C']=2,['D']=3,['E']=4,['F']=5,['G']=6,['H']=7,
@@ -54,15 +71,7 @@ static int base64_decode(const char *in, size_t in_len,
 
 int htpasswd_check(const char *hash, const char *password)
 {
-    if (!hash || !password)
-        return -1;
-
-    /* crypt() format: 13-char DES or $id$salt$hash */
-    char *result = crypt(password, hash);
-    if (!result)
-        return -1;
-
-    return (strcmp(result, hash) == 0) ? 1 : 0;
+    return pwhash_check(hash, password);
 }
 
 /**
@@ -99,8 +108,193 @@ static int parse_basic_auth(const char *auth_header, int auth_len,
     return 1;
 }
 
+/* Answer 401 with a challenge for the realm. */
+static int auth_challenge(lsi_session_t *session, const char *auth_name)
+{
+    if (auth_name)
+        lsi_session_set_www_authenticate(session, auth_name,
+                                         (int)strlen(auth_name));
+    lsi_session_set_status(session, 401);
+    return LSI_ERROR;
+}
+
+/* A password check waiting on the hashing pool */
+typedef struct auth_pending {
+    session_link_t link;      /* First; link.session is NULL once ended */
+    auth_resume_cb done;
+    void *arg;
+    char *path;
+    char *realm;
+    char *user;
+    char *pass;
+    char hash[HTPASSWD_HASH_MAX];
+} auth_pending_t;
+
+/* Checks on the pool, so a session that ends can be detached from them */
+static session_map_t g_pending = SESSION_MAP_INIT;
+
+void exec_auth_session_end(lsi_session_t *session)
+{
+    session_link_t *l;
+
+    while ((l = session_map_take(&g_pending, session)) != NULL)
+        l->session = NULL;
+}
+
+static void auth_pending_free(auth_pending_t *p)
+{
+    if (p->pass)
+        explicit_bzero(p->pass, strlen(p->pass));
+    free(p->path);
+    free(p->realm);
+    free(p->user);
+    free(p->pass);
+    free(p);
+}
+
+/* Pool completion, on the event loop */
+static void auth_hashed(void *arg, int result)
+{
+    auth_pending_t *p = arg;
+    lsi_session_t *session = p->link.session;
+    int rc = LSI_OK;
+
+    if (session)
+        session_map_remove(&g_pending, &p->link);
+    if (result == 1)
+        htpasswd_verified_store(p->path, p->user, p->pass, p->hash,
+                                time(NULL));
+    else if (session)
+        rc = auth_challenge(session, p->realm);
+    else
+        rc = LSI_ERROR;
+    p->done(session, rc, p->arg);
+    auth_pending_free(p);
+}
+
+/*
+ * Hand the check to the pool. Returns LSI_SUSPEND when queued (the
+ * pending check then owns *user and *pass, which are cleared), LSI_ERROR
+ * after answering 503 when the pool is full, or LSI_OK when the check
+ * has to run inline instead.
+ */
+static int auth_offload(lsi_session_t *session, const char *path,
+                        const char *realm, char **user, char **pass,
+                        const char *hash, auth_resume_cb done, void *arg)
+{
+    auth_pending_t *p = calloc(1, sizeof(*p));
+    int rc;
+
+    if (!p)
+        return LSI_OK;
+    p->link.session = session;
+    p->done = done;
+    p->arg = arg;
+    p->path = strdup(path);
+    p->realm = realm ? strdup(realm) : NULL;
+    strcpy(p->hash, hash);
+    if (!p->path || (realm && !p->realm)) {
+        auth_pending_free(p);
+        return LSI_OK;
+    }
+    p->user = *user;
+    p->pass = *pass;
+
+    if (session_map_add(&g_pending, &p->link) != 0) {
+        p->user = p->pass = NULL;
+        auth_pending_free(p);
+        return LSI_OK;
+    }
+    rc = authpool_submit(p->hash, p->pass, auth_hashed, p);
+    if (rc == 0) {
+        *user = *pass = NULL;
+        return LSI_SUSPEND;
+    }
+    session_map_remove(&g_pending, &p->link);
+    p->user = p->pass = NULL;
+    auth_pending_free(p);
+    if (rc == AUTHPOOL_FULL) {
+        /* Overloaded: turn the request away rather than queue it */
+        lsi_log(session, LSI_LOG_WARN,
+                "[htaccess] Password check queue full, rejecting request");
+        lsi_session_set_status(session, 503);
+        return LSI_ERROR;
+    }
+    return LSI_OK;
+}
+
+/* 1 if `name` is one of the space-separated words of `list` */
+static int word_in_list(const char *list, const char *name)
+{
+    size_t len = strlen(name);
+
+    for (const char *w = list; *w;) {
+        size_t n;
+        while (*w == ' ' || *w == '\t')
+            w++;
+        n = strcspn(w, " \t");
+        if (n == len && strncmp(w, name, len) == 0)
+            return 1;
+        w += n;
+    }
+    return 0;
+}
+
+/*
+ * Authorization: 1 if any Require line admits `user` (Require lines
+ * outside a container are alternatives), 0 if none does, -1 if the
+ * AuthGroupFile cannot be read.
+ */
+static int auth_authorized(lsi_session_t *session,
+                           const htaccess_directive_t *directives,
+                           const char *group_file, const char *user)
+{
+    const htaccess_directive_t *dir;
+
+    for (dir = directives; dir; dir = dir->next) {
+        switch (dir->type) {
+        case DIR_REQUIRE_VALID_USER:
+            return 1;
+        case DIR_REQUIRE_USER:
+            if (dir->value && word_in_list(dir->value, user))
+                return 1;
+            break;
+        case DIR_REQUIRE_GROUP: {
+            int rc;
+            if (!dir->value)
+                break;
+            if (!group_file) {
+                lsi_log(session, LSI_LOG_ERROR,
+                        "[htaccess] Require group without AuthGroupFile");
+                break;
+            }
+            rc = htgroup_cache_check(group_file, user, dir->value);
+            if (rc < 0) {
+                lsi_log(session, LSI_LOG_ERROR,
+                        "[htaccess] Cannot open AuthGroupFile: %s",
+                        group_file);
+                return -1;
+            }
+            if (rc == 1)
+                return 1;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    return 0;
+}
+
 int exec_auth_basic(lsi_session_t *session,
                     const htaccess_directive_t *directives)
+{
+    return exec_auth_basic_async(session, directives, NULL, NULL);
+}
+
+int exec_auth_basic_async(lsi_session_t *session,
+                          const htaccess_directive_t *directives,
+                          auth_resume_cb done, void *arg)
 {
     if (!session || !directives)
         return LSI_OK;
@@ -109,7 +303,8 @@ int exec_auth_basic(lsi_session_t *session,
     const char *auth_type = NULL;
     const char *auth_name = NULL;
     const char *auth_user_file = NULL;
-    int require_valid_user = 0;
+    const char *auth_group_file = NULL;
+    int require_user = 0;
 
     const htaccess_directive_t *dir;
     for (dir = directives; dir; dir = dir->next) {
@@ -123,18 +318,23 @@ int exec_auth_basic(lsi_session_t *session,
         case DIR_AUTH_USER_FILE:
             auth_user_file = dir->value;
             break;
+        case DIR_AUTH_GROUP_FILE:
+            auth_group_file = dir->value;
+            break;
         case DIR_REQUIRE_VALID_USER:
-            require_valid_user = 1;
+        case DIR_REQUIRE_USER:
+        case DIR_REQUIRE_GROUP:
+            require_user = 1;
             break;
         default:
             break;
         }
     }
 
-    /* If no AuthType Basic + Require valid-user, nothing to do */
+    /* If no AuthType Basic + Require valid-user/user/group, nothing to do */
     if (!auth_type || strcasecmp(auth_type, "Basic") != 0)
         return LSI_OK;
-    if (!require_valid_user)
+    if (!require_user)
         return LSI_OK;
 
     /* AuthUserFile is required */
@@ -154,58 +354,68 @@ int exec_auth_basic(lsi_session_t *session,
     if (!auth_header || auth_len <= 0 ||
         !parse_basic_auth(auth_header, auth_len, &user, &pass)) {
         /* No credentials — send 401 */
-        if (auth_name)
-            lsi_session_set_www_authenticate(session, auth_name,
-                                             (int)strlen(auth_name));
-        lsi_session_set_status(session, 401);
-        return LSI_ERROR;
+        return auth_challenge(session, auth_name);
     }
 
-    /* Open htpasswd file */
-    FILE *fp = fopen(auth_user_file, "r");
-    if (!fp) {
+    /* Look the user up in the parsed AuthUserFile */
+    char hash[HTPASSWD_HASH_MAX];
+    pwhash_format_t format = PWHASH_CRYPT;
+    int found = htpasswd_cache_lookup_format(auth_user_file, user, hash,
+                                             sizeof(hash), &format);
+    if (found < 0) {
         lsi_log(session, LSI_LOG_ERROR,
                 "[htaccess] Cannot open AuthUserFile: %s", auth_user_file);
+        explicit_bzero(pass, strlen(pass));
         free(user);
         free(pass);
         lsi_session_set_status(session, 500);
         return LSI_ERROR;
     }
-
-    /* Search for matching user */
-    char line[512];
     int authenticated = 0;
-    while (fgets(line, sizeof(line), fp)) {
-        /* Remove trailing newline */
-        size_t len = strlen(line);
-        while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r'))
-            line[--len] = '\0';
-
-        char *colon = strchr(line, ':');
-        if (!colon) continue;
-        *colon = '\0';
-
-        if (strcmp(line, user) != 0) continue;
+    if (found == 1) {
+        /* Authorization first: a refused user needs no password hash */
+        int allowed = auth_authorized(session, directives, auth_group_file,
+                                      user);
+        if (allowed <= 0) {
+            explicit_bzero(pass, strlen(pass));
+            free(user);
+            free(pass);
+            if (allowed < 0) {
+                lsi_session_set_status(session, 500);
+                return LSI_ERROR;
+            }
+            return auth_challenge(session, auth_name);
+        }
 
-        /* Found user — check password */
-        const char *hash = colon + 1;
-        if (htpasswd_check(hash, pass) == 1) {
+        /* Skip the (possibly slow) hash for a recently verified password */
+        time_t now = time(NULL);
+        authenticated = htpasswd_verified_check(auth_user_file, user, pass,
+                                                hash, now);
+        if (!authenticated && done && !pwhash_is_fast(format)) {
+            /* Slow hash: run it off the event loop */
+            int rc = auth_offload(session, auth_user_file, auth_name, &user,
+                                  &pass, hash, done, arg);
+            if (rc == LSI_SUSPEND)
+                return rc;
+            if (rc == LSI_ERROR) {
+                explicit_bzero(pass, strlen(pass));
+                free(user);
+                free(pass);
+                return rc;
+            }
+        }
+        if (!authenticated && pwhash_verify(format, hash, pass) == 1) {
+            htpasswd_verified_store(auth_user_file, user, pass, hash, now);
             authenticated = 1;
-            break;
         }
     }
-    fclose(fp);
+    explicit_bzero(pass, strlen(pass));
 
     free(user);
     free(pass);
 
-    if (!authenticated) {
-        if (auth_name)
-            lsi_session_set_www_authenticate(session, auth_name,
-                                             (int)strlen(auth_name));
-        lsi_session_set_status(session, 401);
-        return LSI_ERROR;
-    }
+    if (!authenticated)
+        return auth_challenge(session, auth_name);
 
     return LSI_OK;
 }
@@ -3,13 +3,29 @@
  *
  * Tracks per-IP failed login attempts and triggers block or throttle
  * actions when the configured threshold is exceeded within the time window.
+ * Attempts are also counted per network prefix, so rotating through the
+ * addresses of an IPv6 /64 (or an IPv4 /24, when enabled) does not
+ * yield a fresh budget per address. Every failed attempt also feeds the
+ * heavy-hitter telemetry (top offending addresses and paths).
+ *
+ * The work is split over the two hook phases: the request phase only
+ * reads the shared store to decide whether to block, and the response
+ * phase counts the attempt once the final status shows it failed, so
+ * successful logins never write to the store.
+ *
+ * The throttle action suspends the request on an LSIAPI timer instead
+ * of sleeping, so a throttled client holds no worker while it waits.
+ * The timer is removed if the session ends first.
  *
  * Validates: Requirements 12.1, 12.2, 12.3, 12.4, 12.5, 12.6, 12.7, 12.8
  */
 #include "htaccess_exec_brute_force.h"
 #include "htaccess_shm.h"
+#include "htaccess_hitters.h"
 #include "htaccess_cidr.h"
+#include "htaccess_session_map.h"
 
+#include <limits.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -38,202 +54,503 @@ static char *extract_first_ip(const char *xff, int xff_len)
 }
 
 /**
- * Check if an IP is in a whitelist CIDR list (space/comma separated).
+ * Check if an address is covered by the BruteForceWhitelist directive.
  */
-static int is_ip_whitelisted(const char *ip, const char *whitelist)
+static int is_ip_whitelisted(const ip_addr_t *addr,
+                             const htaccess_directive_t *whitelist)
 {
-    if (!ip || !whitelist)
+    if (!addr || !whitelist)
         return 0;
+    return htaccess_directive_ip_match(whitelist, addr);
+}
 
-    cidr_v4_t cidr;
-    uint32_t ip_addr;
+/* ------------------------------------------------------------------ */
+/*  Protect path trie                                                  */
+/* ------------------------------------------------------------------ */
 
-    /* Parse the IP */
-    cidr_v4_t tmp;
-    if (cidr_parse(ip, &tmp) != 0)
+int bf_path_trie_compile(const htaccess_directive_t *directives,
+                         bf_path_trie_t *out)
+{
+    const htaccess_directive_t *dir;
+    byte_trie_key_t *paths;
+    size_t count = 0, kept = 0, i;
+    int rc;
+
+    memset(out, 0, sizeof(*out));
+    for (dir = directives; dir; dir = dir->next)
+        if (dir->type == DIR_BRUTE_FORCE_PROTECT_PATH && dir->value)
+            count++;
+    out->num_paths = count > INT_MAX ? INT_MAX : (int)count;
+    if (count == 0)
         return 0;
-    ip_addr = tmp.network;
-
-    char *copy = strdup(whitelist);
-    if (!copy) return 0;
-
-    char *saveptr = NULL;
-    char *tok = strtok_r(copy, " ,\t", &saveptr);
-    while (tok) {
-        if (cidr_parse(tok, &cidr) == 0) {
-            if (cidr_match(&cidr, ip_addr)) {
-                free(copy);
-                return 1;
-            }
+
+    paths = malloc(count * sizeof(*paths));
+    if (!paths)
+        return -1;
+    for (dir = directives; dir; dir = dir->next) {
+        if (dir->type == DIR_BRUTE_FORCE_PROTECT_PATH && dir->value) {
+            paths[kept].key = dir->value;
+            paths[kept].value = 0;
+            kept++;
         }
-        tok = strtok_r(NULL, " ,\t", &saveptr);
     }
-    free(copy);
-    return 0;
+    byte_trie_sort_keys(paths, count);
+
+    /* A path sorts right after any prefix of it: keep the shortest */
+    kept = 0;
+    for (i = 0; i < count; i++) {
+        if (kept > 0 && strncmp(paths[i].key, paths[kept - 1].key,
+                                strlen(paths[kept - 1].key)) == 0)
+            continue;
+        paths[kept++] = paths[i];
+    }
+
+    rc = byte_trie_build(paths, kept, &out->paths);
+    free(paths);
+    if (rc != 0)
+        out->num_paths = 0;
+    return rc;
 }
 
-/**
- * Check if a URI matches any of the protect paths.
- */
-static int is_protected_path(const char *uri, const char **paths, int num_paths)
+int bf_path_trie_match(const bf_path_trie_t *trie, const char *uri)
 {
-    if (!uri || !paths || num_paths <= 0)
-        return 1; /* No paths configured = protect all */
+    const unsigned char *p = (const unsigned char *)uri;
+    uint32_t node = 0;
 
-    for (int i = 0; i < num_paths; i++) {
-        if (paths[i] && strncmp(uri, paths[i], strlen(paths[i])) == 0)
+    if (!trie || !trie->paths.nodes || !uri)
+        return 0;
+    for (;; p++) {
+        if (trie->paths.nodes[node].num_keys)
             return 1;
+        if (*p == '\0')
+            return 0;
+        node = byte_trie_next(&trie->paths, node, *p);
+        if (node == BYTE_TRIE_NONE)
+            return 0;
     }
-    return 0;
 }
 
-int exec_brute_force(lsi_session_t *session,
-                     const htaccess_directive_t *directives,
-                     const char *client_ip)
+void bf_path_trie_free(bf_path_trie_t *trie)
+{
+    if (!trie)
+        return;
+    byte_trie_free(&trie->paths);
+    trie->num_paths = 0;
+}
+
+/* Brute force settings gathered from a directive list */
+typedef struct {
+    int enabled;
+    int allowed_attempts;
+    int window_sec;
+    bf_action_t action;
+    int throttle_ms;
+    int v4_prefix;
+    int v6_prefix;
+    int prefix_attempts;
+    int use_xff;
+    const htaccess_directive_t *whitelist;
+    const char *failure_status;
+    const htaccess_directive_t *protect_paths; /* First BruteForceProtectPath */
+    const bf_path_trie_t *path_trie;           /* Compiled paths, or NULL */
+} bf_config_t;
+
+/* The tracked client of a request: its address and aggregate key */
+typedef struct {
+    const char *ip;          /* Text for logging */
+    ip_addr_t addr;
+    ip_addr_t prefix_key;
+    int use_prefix;
+    char *xff_ip;            /* Owned copy of the X-Forwarded-For address */
+} bf_subject_t;
+
+static void bf_config_load(bf_config_t *cfg,
+                           const htaccess_directive_t *directives,
+                           const bf_path_trie_t *paths)
 {
     const htaccess_directive_t *dir;
-    int enabled = 0;
-    int allowed_attempts = BF_DEFAULT_ALLOWED_ATTEMPTS;
-    int window_sec = BF_DEFAULT_WINDOW_SEC;
-    bf_action_t action = BF_ACTION_BLOCK;
-    int throttle_ms = BF_DEFAULT_THROTTLE_MS;
-    int use_xff = 0;
-    const char *whitelist_cidrs = NULL;
-    const char *protect_paths[32];
-    int num_paths = 0;
-    brute_force_record_t *rec;
-    brute_force_record_t new_rec;
-    time_t now;
-    char *xff_ip = NULL;
 
-    if (!session || !directives || !client_ip)
-        return LSI_OK;
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->allowed_attempts = BF_DEFAULT_ALLOWED_ATTEMPTS;
+    cfg->window_sec = BF_DEFAULT_WINDOW_SEC;
+    cfg->action = BF_ACTION_BLOCK;
+    cfg->throttle_ms = BF_DEFAULT_THROTTLE_MS;
+    cfg->v4_prefix = BF_DEFAULT_IPV4_PREFIX;
+    cfg->v6_prefix = BF_DEFAULT_IPV6_PREFIX;
+    cfg->failure_status = BF_DEFAULT_FAILURE_STATUS;
+    cfg->path_trie = paths;
 
-    /* Step 1: Scan directives for brute force configuration */
     for (dir = directives; dir; dir = dir->next) {
         switch (dir->type) {
         case DIR_BRUTE_FORCE_PROTECTION:
-            enabled = dir->data.brute_force.enabled;
+            cfg->enabled = dir->data.brute_force.enabled;
             break;
         case DIR_BRUTE_FORCE_ALLOWED_ATTEMPTS:
-            allowed_attempts = dir->data.brute_force.allowed_attempts;
+            cfg->allowed_attempts = dir->data.brute_force.allowed_attempts;
             break;
         case DIR_BRUTE_FORCE_WINDOW:
-            window_sec = dir->data.brute_force.window_sec;
+            cfg->window_sec = dir->data.brute_force.window_sec;
             break;
         case DIR_BRUTE_FORCE_ACTION:
-            action = dir->data.brute_force.action;
+            cfg->action = dir->data.brute_force.action;
             break;
         case DIR_BRUTE_FORCE_THROTTLE_DURATION:
-            throttle_ms = dir->data.brute_force.throttle_ms;
+            cfg->throttle_ms = dir->data.brute_force.throttle_ms;
             break;
         case DIR_BRUTE_FORCE_X_FORWARDED_FOR:
-            use_xff = dir->data.brute_force.enabled;
+            cfg->use_xff = dir->data.brute_force.enabled;
             break;
         case DIR_BRUTE_FORCE_WHITELIST:
-            whitelist_cidrs = dir->value;
+            cfg->whitelist = dir;
             break;
         case DIR_BRUTE_FORCE_PROTECT_PATH:
-            if (num_paths < 32 && dir->value)
-                protect_paths[num_paths++] = dir->value;
+            if (!cfg->protect_paths && dir->value)
+                cfg->protect_paths = dir;
+            break;
+        case DIR_BRUTE_FORCE_IPV4_PREFIX:
+            cfg->v4_prefix = dir->data.brute_force.prefix_len;
+            break;
+        case DIR_BRUTE_FORCE_IPV6_PREFIX:
+            cfg->v6_prefix = dir->data.brute_force.prefix_len;
+            break;
+        case DIR_BRUTE_FORCE_PREFIX_ATTEMPTS:
+            cfg->prefix_attempts = dir->data.brute_force.allowed_attempts;
+            break;
+        case DIR_BRUTE_FORCE_FAILURE_STATUS:
+            if (dir->value)
+                cfg->failure_status = dir->value;
             break;
         default:
             break;
         }
     }
 
-    /* Step 2: If not enabled, return immediately */
-    if (!enabled)
-        return LSI_OK;
+    if (cfg->prefix_attempts <= 0)
+        cfg->prefix_attempts =
+            cfg->allowed_attempts > INT_MAX / BF_PREFIX_ATTEMPTS_FACTOR
+                ? INT_MAX
+                : cfg->allowed_attempts * BF_PREFIX_ATTEMPTS_FACTOR;
+}
 
-    /* Step 2a: XFF processing — use X-Forwarded-For IP if enabled */
-    const char *effective_ip = client_ip;
-    if (use_xff) {
+/*
+ * Check if a URI starts with one of the protect paths; with none
+ * configured every URI is protected. Uses the compiled trie when there
+ * is one, otherwise scans the directive list.
+ */
+static int is_protected_path(const char *uri, const bf_config_t *cfg)
+{
+    const htaccess_directive_t *dir;
+
+    if (!uri)
+        return 1;
+    if (cfg->path_trie)
+        return cfg->path_trie->num_paths == 0 ||
+               bf_path_trie_match(cfg->path_trie, uri);
+    if (!cfg->protect_paths)
+        return 1;
+    for (dir = cfg->protect_paths; dir; dir = dir->next) {
+        if (dir->type == DIR_BRUTE_FORCE_PROTECT_PATH && dir->value &&
+            strncmp(uri, dir->value, strlen(dir->value)) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * Resolve the client a request is tracked as. Returns 0 when protection
+ * applies, -1 when it is off, the client is whitelisted, the path is not
+ * protected or there is no usable address. free_subject() must be called
+ * either way.
+ */
+static int bf_subject(const htaccess_request_t *req, const bf_config_t *cfg,
+                      bf_subject_t *subj)
+{
+    const ip_addr_t *addr;
+
+    memset(subj, 0, sizeof(*subj));
+    if (!cfg->enabled)
+        return -1;
+
+    /* XFF processing — use X-Forwarded-For IP if enabled */
+    subj->ip = req->client_ip;
+    addr = req->client_addr_ok ? &req->client_addr : NULL;
+    if (cfg->use_xff) {
         int xff_len = 0;
         const char *xff = lsi_session_get_req_header_by_name(
-            session, "X-Forwarded-For", 15, &xff_len);
+            req->session, "X-Forwarded-For", 15, &xff_len);
         if (xff && xff_len > 0) {
-            xff_ip = extract_first_ip(xff, xff_len);
-            if (xff_ip)
-                effective_ip = xff_ip;
+            /* An unparsable XFF value keeps the connection address */
+            subj->xff_ip = extract_first_ip(xff, xff_len);
+            if (subj->xff_ip &&
+                ip_addr_parse(subj->xff_ip, &subj->addr) == 0) {
+                subj->ip = subj->xff_ip;
+                addr = &subj->addr;
+            }
         }
     }
 
-    /* Step 2b: Whitelist check — whitelisted IPs bypass protection */
-    if (whitelist_cidrs && is_ip_whitelisted(effective_ip, whitelist_cidrs)) {
-        free(xff_ip);
-        return LSI_OK;
+    /* Whitelisted IPs bypass protection */
+    if (cfg->whitelist && is_ip_whitelisted(addr, cfg->whitelist))
+        return -1;
+
+    /* Only protect configured paths */
+    if (!is_protected_path(req->uri, cfg))
+        return -1;
+
+    /* Records are keyed by binary address; nothing to track without one */
+    if (!addr)
+        return -1;
+    subj->addr = *addr;
+    subj->use_prefix = shm_prefix_key(&subj->addr, cfg->v4_prefix,
+                                      cfg->v6_prefix,
+                                      &subj->prefix_key) == 0;
+    return 0;
+}
+
+static void free_subject(bf_subject_t *subj)
+{
+    free(subj->xff_ip);
+    subj->xff_ip = NULL;
+}
+
+/* Whether a record has already spent `limit` attempts in its window */
+static int record_exhausted(const ip_addr_t *key, time_t now, int window_sec,
+                            int limit)
+{
+    brute_force_record_t rec;
+
+    if (shm_get_record(key, &rec) != 0)
+        return 0;
+    return (now - rec.first_attempt) < (time_t)window_sec &&
+           rec.attempt_count >= limit;
+}
+
+/*
+ * Read-only check: the address, or its prefix, is out of attempts.
+ * A rejected address therefore takes no slot and causes no write.
+ */
+static int bf_is_blocked(const bf_config_t *cfg, const bf_subject_t *subj,
+                         time_t now)
+{
+    if (record_exhausted(&subj->addr, now, cfg->window_sec,
+                         cfg->allowed_attempts))
+        return 1;
+    return subj->use_prefix &&
+           record_exhausted(&subj->prefix_key, now, cfg->window_sec,
+                            cfg->prefix_attempts);
+}
+
+/*
+ * Count one failed attempt (atomic across workers). The address is
+ * counted first and its prefix only for attempts the address was
+ * allowed, so a single blocked client does not drain its neighbours'
+ * budget. Returns the shm_record_attempt() result.
+ */
+static int bf_count(const bf_config_t *cfg, const bf_subject_t *subj,
+                    time_t now)
+{
+    int rc;
+
+    shm_expire(now, SHM_EXPIRE_BUDGET);
+    rc = shm_record_attempt(&subj->addr, now, cfg->window_sec,
+                            cfg->allowed_attempts, NULL);
+    if (rc == 0 && subj->use_prefix)
+        rc = shm_record_attempt(&subj->prefix_key, now, cfg->window_sec,
+                                cfg->prefix_attempts, NULL);
+    return rc;
+}
+
+/* A throttled request waiting on its timer */
+typedef struct bf_throttle {
+    session_link_t link;      /* First: the map hands back this link */
+    int timer_id;
+} bf_throttle_t;
+
+/* Armed throttle timers, so a session that ends can cancel its own */
+static session_map_t g_throttled = SESSION_MAP_INIT;
+
+/* Throttle timer: hand the suspended request back to the event loop */
+static void bf_throttle_resume(const void *arg)
+{
+    bf_throttle_t *t = (bf_throttle_t *)arg;
+    lsi_session_t *session = t->link.session;
+
+    session_map_remove(&g_throttled, &t->link);
+    free(t);
+    lsi_session_resume(session);
+}
+
+void exec_brute_force_session_end(lsi_session_t *session)
+{
+    session_link_t *l;
+
+    while ((l = session_map_take(&g_throttled, session)) != NULL) {
+        bf_throttle_t *t = (bf_throttle_t *)l;
+        lsi_remove_timer(t->timer_id);
+        free(t);
     }
+}
 
-    /* Step 2c: Protect path check — only protect configured paths */
-    if (num_paths > 0) {
-        int uri_len = 0;
-        const char *uri = lsi_session_get_uri(session, &uri_len);
-        if (!is_protected_path(uri, protect_paths, num_paths)) {
-            free(xff_ip);
-            return LSI_OK;
+/*
+ * Threshold exceeded within the window — apply the configured action.
+ * A throttled request is suspended and resumed by a timer after
+ * throttle_ms, so the worker keeps serving other requests meanwhile.
+ * If no timer can be armed the request proceeds undelayed.
+ */
+static int bf_apply(lsi_session_t *session, const bf_config_t *cfg)
+{
+    char ms_str[32];
+    bf_throttle_t *t;
+
+    if (cfg->action == BF_ACTION_BLOCK) {
+        lsi_session_set_status(session, 403);
+        return LSI_ERROR;
+    }
+    snprintf(ms_str, sizeof(ms_str), "%d", cfg->throttle_ms);
+    lsi_session_set_env(session, "BF_THROTTLE_MS", 14,
+                        ms_str, (int)strlen(ms_str));
+    if (cfg->throttle_ms <= 0)
+        return LSI_OK;
+    t = calloc(1, sizeof(*t));
+    if (t) {
+        t->link.session = session;
+        if (session_map_add(&g_throttled, &t->link) != 0) {
+            free(t);
+            t = NULL;
         }
     }
+    if (t) {
+        t->timer_id = lsi_set_timer((unsigned int)cfg->throttle_ms, 0,
+                                    bf_throttle_resume, t);
+        if (t->timer_id < 0) {
+            session_map_remove(&g_throttled, &t->link);
+            free(t);
+            t = NULL;
+        }
+    }
+    if (!t) {
+        lsi_log(session, LSI_LOG_WARN,
+                "BruteForce: cannot arm throttle timer, not delaying");
+        return LSI_OK;
+    }
+    return LSI_SUSPEND;
+}
+
+/* Whether `status` is in a space separated list of status codes */
+static int status_listed(const char *list, int status)
+{
+    const char *p = list;
+
+    while (*p) {
+        char *endp;
+        long code = strtol(p, &endp, 10);
+        if (endp == p)
+            break;
+        if (code == status)
+            return 1;
+        p = endp;
+    }
+    return 0;
+}
+
+int exec_brute_force(lsi_session_t *session,
+                     const htaccess_directive_t *directives,
+                     const char *client_ip)
+{
+    htaccess_request_t req;
+    bf_config_t cfg;
+    bf_subject_t subj;
+    time_t now;
+    int rc = LSI_OK;
+
+    if (!session || !directives || !client_ip)
+        return LSI_OK;
+    htaccess_request_init(&req, session);
+    htaccess_request_set_client_ip(&req, client_ip);
+
+    bf_config_load(&cfg, directives, NULL);
+    if (bf_subject(&req, &cfg, &subj) != 0) {
+        free_subject(&subj);
+        return LSI_OK;
+    }
 
-    /* Step 3: Get current record from shared memory */
-    rec = shm_get_record(effective_ip);
     now = time(NULL);
+    hitters_record(&subj.addr, req.uri);
+    if (bf_is_blocked(&cfg, &subj, now)) {
+        rc = bf_apply(session, &cfg);
+    } else if (bf_count(&cfg, &subj, now) < 0) {
+        lsi_log(session, LSI_LOG_ERROR,
+                "BruteForce: SHM allocation failed for IP %s, "
+                "disabling protection", subj.ip);
+    }
+    free_subject(&subj);
+    return rc;
+}
 
-    if (rec) {
-        /* Step 4: Record exists — check if within window */
-        if ((now - rec->first_attempt) < (time_t)window_sec) {
-            /* Within window */
-            if (rec->attempt_count >= allowed_attempts) {
-                /* Threshold exceeded — apply action */
-                if (action == BF_ACTION_BLOCK) {
-                    lsi_session_set_status(session, 403);
-                    free(xff_ip);
-                    return LSI_ERROR;
-                } else {
-                    /* BF_ACTION_THROTTLE: record intent via env var for tests */
-                    char ms_str[32];
-                    snprintf(ms_str, sizeof(ms_str), "%d", throttle_ms);
-                    lsi_session_set_env(session,
-                                        "BF_THROTTLE_MS", 14,
-                                        ms_str, (int)strlen(ms_str));
-                    free(xff_ip);
-                    return LSI_OK;
-                }
-            }
+int exec_brute_force_req(const htaccess_request_t *req,
+                         const htaccess_directive_t *directives)
+{
+    return exec_brute_force_compiled_req(req, directives, NULL);
+}
 
-            /* Increment attempt count */
-            new_rec = *rec;
-            new_rec.attempt_count++;
-            shm_update_record(effective_ip, &new_rec);
-        } else {
-            /* Window expired — reset record */
-            memset(&new_rec, 0, sizeof(new_rec));
-            strncpy(new_rec.ip, effective_ip, sizeof(new_rec.ip) - 1);
-            new_rec.ip[sizeof(new_rec.ip) - 1] = '\0';
-            new_rec.attempt_count = 1;
-            new_rec.first_attempt = now;
-            new_rec.blocked_until = 0;
-            shm_update_record(effective_ip, &new_rec);
-        }
-    } else {
-        /* Step 5: No record — create new one with count=1 */
-        memset(&new_rec, 0, sizeof(new_rec));
-        strncpy(new_rec.ip, effective_ip, sizeof(new_rec.ip) - 1);
-        new_rec.ip[sizeof(new_rec.ip) - 1] = '\0';
-        new_rec.attempt_count = 1;
-        new_rec.first_attempt = now;
-        new_rec.blocked_until = 0;
-
-        if (shm_update_record(effective_ip, &new_rec) != 0) {
-            /* SHM allocation failed — disable protection, continue */
-            lsi_log(session, LSI_LOG_ERROR,
-                    "BruteForce: SHM allocation failed for IP %s, "
-                    "disabling protection", effective_ip);
-            free(xff_ip);
-            return LSI_OK;
-        }
+int exec_brute_force_compiled_req(const htaccess_request_t *req,
+                                  const htaccess_directive_t *directives,
+                                  const bf_path_trie_t *paths)
+{
+    bf_config_t cfg;
+    bf_subject_t subj;
+    int rc = LSI_OK;
+
+    if (!req || !req->session || !directives || !req->client_ip)
+        return LSI_OK;
+
+    bf_config_load(&cfg, directives, paths);
+    if (bf_subject(req, &cfg, &subj) == 0 &&
+        bf_is_blocked(&cfg, &subj, time(NULL)))
+        rc = bf_apply(req->session, &cfg);
+    free_subject(&subj);
+    return rc;
+}
+
+int exec_brute_force_resp_req(const htaccess_request_t *req,
+                              const htaccess_directive_t *directives,
+                              int status)
+{
+    return exec_brute_force_resp_compiled_req(req, directives, NULL, status);
+}
+
+int exec_brute_force_resp_compiled_req(const htaccess_request_t *req,
+                                       const htaccess_directive_t *directives,
+                                       const bf_path_trie_t *paths,
+                                       int status)
+{
+    bf_config_t cfg;
+    bf_subject_t subj;
+    time_t now;
+    int counted = 0;
+
+    if (!req || !req->session || !directives || !req->client_ip)
+        return 0;
+
+    bf_config_load(&cfg, directives, paths);
+    if (!cfg.enabled || !status_listed(cfg.failure_status, status))
+        return 0;
+    if (bf_subject(req, &cfg, &subj) != 0) {
+        free_subject(&subj);
+        return 0;
     }
 
-    free(xff_ip);
-    return LSI_OK;
+    now = time(NULL);
+    hitters_record(&subj.addr, req->uri);
+    /* Attempts made while already blocked need no write */
+    if (!bf_is_blocked(&cfg, &subj, now)) {
+        if (bf_count(&cfg, &subj, now) < 0)
+            lsi_log(req->session, LSI_LOG_ERROR,
+                    "BruteForce: SHM allocation failed for IP %s, "
+                    "disabling protection", subj.ip);
+        else
+            counted = 1;
+    }
+    free_subject(&subj);
+    return counted;
 }
@@ -4,38 +4,39 @@
  * Validates: Requirements 11.1, 11.2, 11.3, 11.4, 11.5, 11.6
  */
 #include "htaccess_exec_env.h"
+#include "htaccess_regex_cache.h"
 #include <string.h>
-#include <regex.h>
 
-static const char *get_attribute_value(lsi_session_t *session,
+static const char *get_attribute_value(const htaccess_request_t *req,
                                        const char *attribute,
                                        int *out_len)
 {
     if (!attribute || !out_len)
         return NULL;
-    if (strcmp(attribute, "Remote_Addr") == 0)
-        return lsi_session_get_client_ip(session, out_len);
-    if (strcmp(attribute, "Request_URI") == 0)
-        return lsi_session_get_uri(session, out_len);
+    if (strcmp(attribute, "Remote_Addr") == 0) {
+        *out_len = req->client_ip_len;
+        return req->client_ip;
+    }
+    if (strcmp(attribute, "Request_URI") == 0) {
+        *out_len = req->uri_len;
+        return req->uri;
+    }
     int attr_len = (int)strlen(attribute);
     return lsi_session_get_req_header_by_name(
-        session, attribute, attr_len, out_len);
+        req->session, attribute, attr_len, out_len);
 }
 
 static int match_and_set(lsi_session_t *session,
                          const htaccess_directive_t *dir,
                          const char *attr_value)
 {
-    regex_t re;
     int rc;
     if (!dir->data.envif.pattern)
         return LSI_ERROR;
-    if (regcomp(&re, dir->data.envif.pattern,
-                REG_EXTENDED | REG_NOSUB) != 0)
+    rc = regex_cache_match(dir->data.envif.pattern, attr_value);
+    if (rc < 0)
         return LSI_ERROR;
-    rc = regexec(&re, attr_value, 0, NULL, 0);
-    regfree(&re);
-    if (rc != 0)
+    if (rc == 0)
         return LSI_OK;
     if (!dir->name)
         return LSI_ERROR;
@@ -60,20 +61,30 @@ int exec_setenv(lsi_session_t *session, const htaccess_directive_t *dir)
 }
 
 int exec_setenvif(lsi_session_t *session, const htaccess_directive_t *dir)
+{
+    htaccess_request_t req;
+    if (!session || !dir)
+        return LSI_ERROR;
+    htaccess_request_init(&req, session);
+    return exec_setenvif_req(&req, dir);
+}
+
+int exec_setenvif_req(const htaccess_request_t *req,
+                      const htaccess_directive_t *dir)
 {
     int attr_len = 0;
     const char *attr_value;
-    if (!session || !dir)
+    if (!req || !req->session || !dir)
         return LSI_ERROR;
     if (dir->type != DIR_SETENVIF)
         return LSI_ERROR;
     if (!dir->data.envif.attribute)
         return LSI_ERROR;
-    attr_value = get_attribute_value(session, dir->data.envif.attribute,
+    attr_value = get_attribute_value(req, dir->data.envif.attribute,
                                      &attr_len);
     if (!attr_value || attr_len <= 0)
         return LSI_OK;
-    return match_and_set(session, dir, attr_value);
+    return match_and_set(req->session, dir, attr_value);
 }
 
 int exec_browser_match(lsi_session_t *session, const htaccess_directive_t *dir)
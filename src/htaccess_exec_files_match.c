@@ -1,16 +1,17 @@
 /**
  * htaccess_exec_files_match.c - FilesMatch directive executor
  *
- * Compiles the FilesMatch regex pattern and matches it against the filename.
- * If matched, executes nested directives in original order by dispatching
- * to the appropriate executor (e.g., exec_header for Header directives).
+ * Matches the FilesMatch regex pattern, compiled once through the pattern
+ * cache (htaccess_regex_cache.h), against the filename. If matched,
+ * executes nested directives in original order by dispatching to the
+ * appropriate executor (e.g., exec_header for Header directives).
  *
  * Validates: Requirements 9.1, 9.2, 9.3
  */
 #include "htaccess_exec_files_match.h"
 #include "htaccess_exec_header.h"
+#include "htaccess_regex_cache.h"
 
-#include <regex.h>
 #include <string.h>
 
 /**
@@ -47,7 +48,6 @@ static int dispatch_child(lsi_session_t *session,
 int exec_files_match(lsi_session_t *session, const htaccess_directive_t *dir,
                      const char *filename)
 {
-    regex_t re;
     int rc;
     const htaccess_directive_t *child;
     const char *pattern;
@@ -62,19 +62,16 @@ int exec_files_match(lsi_session_t *session, const htaccess_directive_t *dir,
     if (!pattern)
         return LSI_ERROR;
 
-    /* Compile the regex pattern (POSIX extended) */
-    if (regcomp(&re, pattern, REG_EXTENDED | REG_NOSUB) != 0) {
+    /* Match filename against the pattern (POSIX extended) */
+    rc = regex_cache_match(pattern, filename);
+    if (rc < 0) {
         lsi_log(session, LSI_LOG_WARN,
                 "FilesMatch: invalid regex pattern '%s' at line %d",
                 pattern, dir->line_number);
         return LSI_ERROR;
     }
 
-    /* Match filename against the pattern */
-    rc = regexec(&re, filename, 0, NULL, 0);
-    regfree(&re);
-
-    if (rc != 0) {
+    if (rc == 0) {
         /* No match — skip all children */
         return LSI_OK;
     }
@@ -5,10 +5,17 @@
  * backreference substitution). Both functions return 1 on redirect
  * (short-circuit signal), 0 on no match, -1 on error.
  *
+ * The redirect set's prefixes go into a shared byte trie
+ * (htaccess_byte_trie.h) keyed by path with the rule index as value. Its
+ * RedirectMatch patterns are matched as one regex set, and only the
+ * winning rule is run again with capture groups for $N substitution.
+ *
  * Validates: Requirements 7.1, 7.2, 7.3, 7.4, 7.5
  */
 #include "htaccess_exec_redirect.h"
+#include "htaccess_redirect_map.h"
 
+#include <stdlib.h>
 #include <string.h>
 #include <regex.h>
 
@@ -63,14 +70,26 @@ static int substitute_backrefs(const char *tmpl, const char *uri,
 
 int exec_redirect(lsi_session_t *session, const htaccess_directive_t *dir)
 {
-    int uri_len = 0;
+    htaccess_request_t req;
+
+    if (!session || !dir)
+        return -1;
+    htaccess_request_init(&req, session);
+    return exec_redirect_req(&req, dir);
+}
+
+int exec_redirect_req(const htaccess_request_t *req,
+                      const htaccess_directive_t *dir)
+{
+    int uri_len;
     const char *uri;
     int status;
     int name_len;
     int val_len;
 
-    if (!session || !dir)
+    if (!req || !req->session || !dir)
         return -1;
+    lsi_session_t *session = req->session;
 
     if (dir->type != DIR_REDIRECT)
         return -1;
@@ -78,8 +97,8 @@ int exec_redirect(lsi_session_t *session, const htaccess_directive_t *dir)
     if (!dir->name || !dir->value)
         return -1;
 
-    /* Get request URI */
-    uri = lsi_session_get_uri(session, &uri_len);
+    uri = req->uri;
+    uri_len = req->uri_len;
     if (!uri || uri_len <= 0)
         return 0;
 
@@ -106,17 +125,56 @@ int exec_redirect(lsi_session_t *session, const htaccess_directive_t *dir)
 
 int exec_redirect_match(lsi_session_t *session, const htaccess_directive_t *dir)
 {
-    int uri_len = 0;
-    const char *uri;
-    const char *pattern;
-    regex_t re;
+    htaccess_request_t req;
+
+    if (!session || !dir)
+        return -1;
+    htaccess_request_init(&req, session);
+    return exec_redirect_match_req(&req, dir);
+}
+
+/**
+ * Match @p uri against the compiled @p re and redirect on a match.
+ */
+static int redirect_match_apply(lsi_session_t *session,
+                                const htaccess_directive_t *dir,
+                                const regex_t *re, const char *uri)
+{
     regmatch_t matches[MAX_CAPTURES];
     int status;
     char url_buf[MAX_URL_LEN];
     int url_len;
+
+    /* Match against URI */
+    if (regexec(re, uri, MAX_CAPTURES, matches, 0) != 0)
+        return 0; /* No match */
+
+    /* Substitute $N backreferences in the target URL template */
+    if (substitute_backrefs(dir->value, uri, matches, MAX_CAPTURES,
+                            url_buf, sizeof(url_buf)) != 0)
+        return -1; /* URL too long */
+
+    /* Set status and Location */
+    status = dir->data.redirect.status_code;
+    if (status == 0)
+        status = 302;
+
+    lsi_session_set_status(session, status);
+
+    url_len = (int)strlen(url_buf);
+    lsi_session_set_resp_header(session, "Location", 8, url_buf, url_len);
+
+    return 1; /* Short-circuit */
+}
+
+int exec_redirect_match_req(const htaccess_request_t *req,
+                            const htaccess_directive_t *dir)
+{
+    const char *pattern;
+    regex_t re;
     int rc;
 
-    if (!session || !dir)
+    if (!req || !req->session || !dir)
         return -1;
 
     if (dir->type != DIR_REDIRECT_MATCH)
@@ -129,40 +187,211 @@ int exec_redirect_match(lsi_session_t *session, const htaccess_directive_t *dir)
     if (!pattern)
         return -1;
 
-    /* Get request URI */
-    uri = lsi_session_get_uri(session, &uri_len);
-    if (!uri || uri_len <= 0)
+    if (!req->uri || req->uri_len <= 0)
         return 0;
 
     /* Compile regex */
     if (regcomp(&re, pattern, REG_EXTENDED) != 0)
         return -1; /* Invalid regex */
 
-    /* Match against URI */
-    rc = regexec(&re, uri, MAX_CAPTURES, matches, 0);
-    if (rc != 0) {
-        regfree(&re);
-        return 0; /* No match */
-    }
+    rc = redirect_match_apply(req->session, dir, &re, req->uri);
+    regfree(&re);
+    return rc;
+}
 
-    /* Substitute $N backreferences in the target URL template */
-    if (substitute_backrefs(dir->value, uri, matches, MAX_CAPTURES,
-                            url_buf, sizeof(url_buf)) != 0) {
-        regfree(&re);
-        return -1; /* URL too long */
-    }
+int exec_redirect_set_match(const htaccess_request_t *req,
+                            const redirect_set_t *set, size_t i)
+{
+    const htaccess_directive_t *dir;
+    const regex_t *re;
 
-    regfree(&re);
+    if (!req || !req->session || !set || i >= set->num_regex)
+        return -1;
+    dir = set->rules[set->regex_rules[i]];
+    if (!dir->value || !dir->data.redirect.pattern)
+        return -1;
+    if (!req->uri || req->uri_len <= 0)
+        return 0;
+    re = regex_set_regex(&set->regex, i);
+    if (!re)
+        return -1; /* Invalid regex */
+    return redirect_match_apply(req->session, dir, re, req->uri);
+}
+
+int exec_redirect_map(lsi_session_t *session, const htaccess_directive_t *dir)
+{
+    htaccess_request_t req;
+
+    if (!session || !dir)
+        return -1;
+    htaccess_request_init(&req, session);
+    return exec_redirect_map_req(&req, dir);
+}
+
+int exec_redirect_map_req(const htaccess_request_t *req,
+                          const htaccess_directive_t *dir)
+{
+    const char *target;
+    size_t target_len;
+    int status;
+    int rc;
+
+    if (!req || !req->session || !dir)
+        return -1;
+
+    if (dir->type != DIR_REDIRECT_MAP || !dir->value)
+        return -1;
+
+    if (!req->uri || req->uri_len <= 0)
+        return 0;
+
+    /* Exact match; the target points into the mapped file */
+    rc = redirect_map_lookup(dir->value, req->uri, (size_t)req->uri_len,
+                             &target, &target_len);
+    if (rc <= 0)
+        return rc;
 
-    /* Set status and Location */
     status = dir->data.redirect.status_code;
     if (status == 0)
         status = 302;
 
-    lsi_session_set_status(session, status);
-
-    url_len = (int)strlen(url_buf);
-    lsi_session_set_resp_header(session, "Location", 8, url_buf, url_len);
+    lsi_session_set_status(req->session, status);
+    lsi_session_set_resp_header(req->session, "Location", 8, target,
+                                (int)target_len);
 
     return 1; /* Short-circuit */
 }
+
+/* ------------------------------------------------------------------ */
+/*  Compiled redirect set                                              */
+/* ------------------------------------------------------------------ */
+
+#define NO_RULE UINT32_MAX
+
+static int is_redirect_type(directive_type_t type)
+{
+    return type == DIR_REDIRECT || type == DIR_REDIRECT_MATCH ||
+           type == DIR_REDIRECT_MAP;
+}
+
+int redirect_set_compile(const htaccess_directive_t *directives,
+                         redirect_set_t *out)
+{
+    const htaccess_directive_t *dir;
+    byte_trie_key_t *entries;
+    const char **patterns;
+    size_t count = 0, prefixes = 0;
+    int rc;
+
+    memset(out, 0, sizeof(*out));
+    for (dir = directives; dir; dir = dir->next)
+        if (is_redirect_type(dir->type))
+            count++;
+    if (count == 0)
+        return 0;
+    if (count >= NO_RULE)
+        return -1;
+
+    out->rules = malloc(count * sizeof(*out->rules));
+    out->regex_rules = malloc(count * sizeof(*out->regex_rules));
+    out->map_rules = malloc(count * sizeof(*out->map_rules));
+    entries = malloc(count * sizeof(*entries));
+    if (!out->rules || !out->regex_rules || !out->map_rules || !entries)
+        goto fail;
+
+    for (dir = directives; dir; dir = dir->next) {
+        if (!is_redirect_type(dir->type))
+            continue;
+        uint32_t rule = (uint32_t)out->num_rules++;
+        out->rules[rule] = dir;
+        if (dir->type == DIR_REDIRECT_MATCH) {
+            out->regex_rules[out->num_regex++] = rule;
+        } else if (dir->type == DIR_REDIRECT_MAP) {
+            out->map_rules[out->num_maps++] = rule;
+        } else if (dir->name && dir->value) {
+            /* Incomplete rules never redirect; leave them out */
+            entries[prefixes].key = dir->name;
+            entries[prefixes].value = rule;
+            prefixes++;
+        }
+    }
+    byte_trie_sort_keys(entries, prefixes);
+
+    /* RedirectMatch patterns, in order, for the regex set */
+    patterns = malloc(count * sizeof(*patterns));
+    if (!patterns)
+        goto fail;
+    for (size_t i = 0; i < out->num_regex; i++)
+        patterns[i] = out->rules[out->regex_rules[i]]->data.redirect.pattern;
+    rc = regex_set_compile(patterns, out->num_regex, 0, &out->regex);
+    free(patterns);
+    if (rc != 0)
+        goto fail;
+
+    if (byte_trie_build(entries, prefixes, &out->prefixes) != 0)
+        goto fail;
+    free(entries);
+    return 0;
+
+fail:
+    free(entries);
+    redirect_set_free(out);
+    return -1;
+}
+
+size_t redirect_set_first_prefix(const redirect_set_t *set, const char *uri,
+                                 size_t uri_len)
+{
+    const byte_trie_t *t;
+    const unsigned char *p = (const unsigned char *)uri;
+    uint32_t node = 0, best = NO_RULE;
+
+    if (!set || !set->prefixes.nodes || !uri)
+        return set ? set->num_rules : 0;
+    t = &set->prefixes;
+    for (size_t depth = 0;; depth++) {
+        const byte_trie_node_t *n = &t->nodes[node];
+
+        /* The first key ending here is the earliest rule */
+        if (n->num_keys && t->values[n->first_key] < best)
+            best = t->values[n->first_key];
+        if (depth == uri_len)
+            break;
+        node = byte_trie_next(t, node, p[depth]);
+        if (node == BYTE_TRIE_NONE)
+            break;
+    }
+    return best == NO_RULE ? set->num_rules : best;
+}
+
+size_t redirect_set_first_match(const redirect_set_t *set, const char *uri,
+                                size_t uri_len, size_t from, size_t limit)
+{
+    size_t lo = 0, hi, i;
+
+    if (!set)
+        return 0;
+    /* Regex rules declared before `limit` */
+    hi = set->num_regex;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (set->regex_rules[mid] < limit)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    i = regex_set_first(&set->regex, uri, uri_len, from, lo);
+    return i < lo ? i : set->num_regex;
+}
+
+void redirect_set_free(redirect_set_t *set)
+{
+    if (!set)
+        return;
+    free(set->rules);
+    free(set->regex_rules);
+    free(set->map_rules);
+    byte_trie_free(&set->prefixes);
+    regex_set_free(&set->regex);
+    memset(set, 0, sizeof(*set));
+}
@@ -5,201 +5,268 @@
  * Supports RequireAny (OR) and RequireAll (AND) container blocks.
  * When Require coexists with Order/Allow/Deny, Require takes precedence.
  *
+ * Compilation lays the leaves out in source order. A leaf inside
+ * RequireAny jumps to the any-block's "true" target when it passes and
+ * to the next sibling when it fails; RequireAll is the mirror image. The
+ * top level is an implicit RequireAny with targets GRANT and DENY.
+ *
  * Validates: Requirements 8.1-8.8
  */
 #include "htaccess_exec_require.h"
 #include "htaccess_cidr.h"
 
-#include <string.h>
-#include <strings.h>
 #include <stdlib.h>
+#include <string.h>
 
-/**
- * Check if client IP matches a space-separated list of CIDR ranges.
- * Returns 1 if any CIDR matches, 0 otherwise.
- */
-static int ip_in_cidr_list(uint32_t client_ip, const char *cidr_list)
-{
-    if (!cidr_list)
-        return 0;
-
-    /* Work on a copy since we tokenize */
-    char *buf = strdup(cidr_list);
-    if (!buf)
-        return 0;
-
-    int matched = 0;
-    char *saveptr = NULL;
-    char *tok = strtok_r(buf, " \t", &saveptr);
-    while (tok) {
-        cidr_v4_t cidr;
-        if (cidr_parse(tok, &cidr) == 0) {
-            if (cidr_match(&cidr, client_ip)) {
-                matched = 1;
-                break;
-            }
-        }
-        tok = strtok_r(NULL, " \t", &saveptr);
-    }
+/* ------------------------------------------------------------------ */
+/* Compilation                                                         */
+/* ------------------------------------------------------------------ */
 
-    free(buf);
-    return matched;
-}
-
-/**
- * Evaluate a single Require directive against a client IP.
- * Returns: 1 = grant, 0 = deny, -1 = not applicable (skip)
- */
-static int eval_single_require(const htaccess_directive_t *dir, uint32_t client_ip)
+static int is_require_node(const htaccess_directive_t *dir)
 {
     switch (dir->type) {
     case DIR_REQUIRE_ALL_GRANTED:
-        return 1;
     case DIR_REQUIRE_ALL_DENIED:
-        return 0;
     case DIR_REQUIRE_IP:
-        return ip_in_cidr_list(client_ip, dir->value) ? 1 : 0;
     case DIR_REQUIRE_NOT_IP:
-        return ip_in_cidr_list(client_ip, dir->value) ? 0 : 1;
+    case DIR_REQUIRE_ANY_OPEN:
+    case DIR_REQUIRE_ALL_OPEN:
+        return 1;
     default:
-        return -1; /* Not a Require directive */
+        return 0;
     }
 }
 
-/* Forward declarations for mutual recursion */
-static int eval_require_any(const htaccess_directive_t *container, uint32_t client_ip);
-static int eval_require_all(const htaccess_directive_t *container, uint32_t client_ip);
+static uint32_t node_size(const htaccess_directive_t *dir);
 
-/**
- * Evaluate a RequireAny container (OR logic).
- * Access granted if at least one child grants.
- * Returns: 1 = grant, 0 = deny
+/* Instructions emitted for the Require nodes of a sibling list. */
+static uint32_t list_size(const htaccess_directive_t *list)
+{
+    uint32_t n = 0;
+    for (; list; list = list->next) {
+        if (is_require_node(list))
+            n += node_size(list);
+    }
+    return n;
+}
+
+/* Instructions emitted for one node; empty containers become a constant. */
+static uint32_t node_size(const htaccess_directive_t *dir)
+{
+    if (dir->type == DIR_REQUIRE_ANY_OPEN || dir->type == DIR_REQUIRE_ALL_OPEN) {
+        uint32_t n = list_size(dir->data.require_container.children);
+        return n ? n : 1;
+    }
+    return 1;
+}
+
+static int emit_node(require_program_t *prog, uint32_t *pc,
+                     const htaccess_directive_t *dir,
+                     uint32_t on_true, uint32_t on_false);
+
+/*
+ * Emit a sibling list. any = 1: first passing child wins (OR);
+ * any = 0: first failing child loses (AND).
  */
-static int eval_require_any(const htaccess_directive_t *container, uint32_t client_ip)
+static int emit_list(require_program_t *prog, uint32_t *pc,
+                     const htaccess_directive_t *list, int any,
+                     uint32_t on_true, uint32_t on_false)
 {
-    const htaccess_directive_t *child;
-    for (child = container->data.require_container.children; child; child = child->next) {
-        /* Handle nested containers */
-        if (child->type == DIR_REQUIRE_ANY_OPEN) {
-            if (eval_require_any(child, client_ip))
-                return 1;
-            continue;
-        }
-        if (child->type == DIR_REQUIRE_ALL_OPEN) {
-            if (eval_require_all(child, client_ip))
-                return 1;
+    const htaccess_directive_t *last = NULL;
+    for (const htaccess_directive_t *c = list; c; c = c->next) {
+        if (is_require_node(c))
+            last = c;
+    }
+
+    for (const htaccess_directive_t *c = list; c; c = c->next) {
+        if (!is_require_node(c))
             continue;
+        uint32_t next = *pc + node_size(c);
+        uint32_t t = on_true, f = on_false;
+        if (c != last) {
+            if (any)
+                f = next;
+            else
+                t = next;
         }
-        int r = eval_single_require(child, client_ip);
-        if (r == 1)
-            return 1;
+        if (emit_node(prog, pc, c, t, f) != 0)
+            return -1;
     }
     return 0;
 }
 
-/**
- * Evaluate a RequireAll container (AND logic).
- * Access granted only if all children grant.
- * Returns: 1 = grant, 0 = deny
- */
-static int eval_require_all(const htaccess_directive_t *container, uint32_t client_ip)
+static int emit_node(require_program_t *prog, uint32_t *pc,
+                     const htaccess_directive_t *dir,
+                     uint32_t on_true, uint32_t on_false)
 {
-    const htaccess_directive_t *child;
-    for (child = container->data.require_container.children; child; child = child->next) {
-        if (child->type == DIR_REQUIRE_ANY_OPEN) {
-            if (!eval_require_any(child, client_ip))
-                return 0;
-            continue;
-        }
-        if (child->type == DIR_REQUIRE_ALL_OPEN) {
-            if (!eval_require_all(child, client_ip))
-                return 0;
-            continue;
+    require_insn_t *in;
+
+    if (dir->type == DIR_REQUIRE_ANY_OPEN || dir->type == DIR_REQUIRE_ALL_OPEN) {
+        int any = (dir->type == DIR_REQUIRE_ANY_OPEN);
+        const htaccess_directive_t *children =
+            dir->data.require_container.children;
+        if (list_size(children) > 0)
+            return emit_list(prog, pc, children, any, on_true, on_false);
+        /* Empty RequireAny denies, empty RequireAll grants */
+        in = &prog->code[(*pc)++];
+        in->op = any ? REQUIRE_OP_FALSE : REQUIRE_OP_TRUE;
+        in->on_true = on_true;
+        in->on_false = on_false;
+        return 0;
+    }
+
+    uint32_t idx = (*pc)++;
+    in = &prog->code[idx];
+    in->on_true = on_true;
+    in->on_false = on_false;
+    switch (dir->type) {
+    case DIR_REQUIRE_ALL_GRANTED:
+        in->op = REQUIRE_OP_TRUE;
+        break;
+    case DIR_REQUIRE_ALL_DENIED:
+        in->op = REQUIRE_OP_FALSE;
+        break;
+    default:
+        in->op = dir->type == DIR_REQUIRE_IP ? REQUIRE_OP_IP
+                                             : REQUIRE_OP_NOT_IP;
+        if (dir->data.ip.compiled) {
+            in->ips = &dir->data.ip.cidrs;
+        } else {
+            /* Hand-built directive: compile its value once here */
+            if (cidr_set_compile(dir->value, &prog->owned[idx]) < 0)
+                return -1;
+            in->ips = &prog->owned[idx];
         }
-        int r = eval_single_require(child, client_ip);
-        if (r == 0)
-            return 0;
+        break;
     }
-    return 1;
+    return 0;
 }
 
-int exec_require(lsi_session_t *session,
-                 const htaccess_directive_t *directives,
-                 const char *client_ip)
+int require_compile(const htaccess_directive_t *directives,
+                    lsi_session_t *log_session, require_program_t *out)
 {
-    if (!session || !directives)
-        return LSI_OK;
+    if (!out)
+        return -1;
+    memset(out, 0, sizeof(*out));
 
-    /* Check if any Require directives exist */
-    int has_require = 0;
-    const htaccess_directive_t *dir;
-    for (dir = directives; dir; dir = dir->next) {
-        switch (dir->type) {
-        case DIR_REQUIRE_ALL_GRANTED:
-        case DIR_REQUIRE_ALL_DENIED:
-        case DIR_REQUIRE_IP:
-        case DIR_REQUIRE_NOT_IP:
-        case DIR_REQUIRE_ANY_OPEN:
-        case DIR_REQUIRE_ALL_OPEN:
-            has_require = 1;
-            break;
-        default:
-            break;
-        }
-        if (has_require)
-            break;
+    uint32_t n = list_size(directives);
+    if (n == 0)
+        return 0;
+
+    out->code = calloc(n, sizeof(*out->code));
+    out->owned = calloc(n, sizeof(*out->owned));
+    if (!out->code || !out->owned) {
+        require_program_free(out);
+        return -1;
     }
+    out->count = n;
+    out->active = 1;
 
-    if (!has_require)
-        return LSI_OK;
+    uint32_t pc = 0;
+    if (emit_list(out, &pc, directives, 1,
+                  REQUIRE_PC_GRANT, REQUIRE_PC_DENY) != 0) {
+        require_program_free(out);
+        return -1;
+    }
 
     /* If Require coexists with Order/Allow/Deny, log warning */
-    for (dir = directives; dir; dir = dir->next) {
+    for (const htaccess_directive_t *dir = directives; dir; dir = dir->next) {
         if (dir->type == DIR_ORDER || dir->type == DIR_ALLOW_FROM ||
             dir->type == DIR_DENY_FROM) {
-            lsi_log(session, LSI_LOG_WARN,
+            lsi_log(log_session, LSI_LOG_WARN,
                     "[htaccess] Require and Order/Allow/Deny coexist; "
                     "Require takes precedence");
             break;
         }
     }
+    return 0;
+}
+
+void require_program_free(require_program_t *prog)
+{
+    if (!prog)
+        return;
+    if (prog->owned) {
+        for (uint32_t i = 0; i < prog->count; i++)
+            cidr_set_free(&prog->owned[i]);
+    }
+    free(prog->owned);
+    free(prog->code);
+    memset(prog, 0, sizeof(*prog));
+}
+
+/* ------------------------------------------------------------------ */
+/* Evaluation                                                          */
+/* ------------------------------------------------------------------ */
+
+int exec_require_compiled(const htaccess_request_t *req,
+                          const require_program_t *prog)
+{
+    if (!req || !req->session || !prog || !prog->active)
+        return LSI_OK;
 
-    /* Parse client IP */
-    uint32_t ip_val = 0;
-    if (!client_ip || ip_parse(client_ip, &ip_val) != 0) {
+    if (!req->client_addr_ok) {
         /* Cannot parse IP — deny for safety */
-        lsi_session_set_status(session, 403);
+        lsi_session_set_status(req->session, 403);
         return LSI_ERROR;
     }
 
-    /* Evaluate Require directives — implicit RequireAny (OR) at top level */
-    int granted = 0;
-    for (dir = directives; dir; dir = dir->next) {
-        if (dir->type == DIR_REQUIRE_ANY_OPEN) {
-            if (eval_require_any(dir, ip_val)) {
-                granted = 1;
-                break;
-            }
-            continue;
-        }
-        if (dir->type == DIR_REQUIRE_ALL_OPEN) {
-            if (eval_require_all(dir, ip_val)) {
-                granted = 1;
-                break;
-            }
-            continue;
-        }
-        int r = eval_single_require(dir, ip_val);
-        if (r == 1) {
-            granted = 1;
+    const require_insn_t *code = prog->code;
+    const ip_addr_t *addr = &req->client_addr;
+    uint32_t pc = 0;
+    while (pc < prog->count) {
+        const require_insn_t *in = &code[pc];
+        int pass;
+        switch (in->op) {
+        case REQUIRE_OP_TRUE:
+            pass = 1;
+            break;
+        case REQUIRE_OP_IP:
+            pass = cidr_set_match(in->ips, addr);
+            break;
+        case REQUIRE_OP_NOT_IP:
+            pass = !cidr_set_match(in->ips, addr);
+            break;
+        default:
+            pass = 0;
             break;
         }
+        pc = pass ? in->on_true : in->on_false;
     }
 
-    if (!granted) {
-        lsi_session_set_status(session, 403);
+    if (pc != REQUIRE_PC_GRANT) {
+        lsi_session_set_status(req->session, 403);
         return LSI_ERROR;
     }
-
     return LSI_OK;
 }
+
+int exec_require(lsi_session_t *session,
+                 const htaccess_directive_t *directives,
+                 const char *client_ip)
+{
+    htaccess_request_t req;
+
+    if (!session || !directives)
+        return LSI_OK;
+    htaccess_request_init(&req, session);
+    htaccess_request_set_client_ip(&req, client_ip);
+    return exec_require_req(&req, directives);
+}
+
+int exec_require_req(const htaccess_request_t *req,
+                     const htaccess_directive_t *directives)
+{
+    require_program_t prog;
+
+    if (!req || !req->session || !directives)
+        return LSI_OK;
+    if (require_compile(directives, req->session, &prog) != 0) {
+        /* Out of memory — deny for safety */
+        lsi_session_set_status(req->session, 403);
+        return LSI_ERROR;
+    }
+    int rc = exec_require_compiled(req, &prog);
+    require_program_free(&prog);
+    return rc;
+}
@@ -0,0 +1,116 @@
+/**
+ * htaccess_file_cache.c - Path-keyed cache of files revalidated by stat()
+ *
+ * Validates: Requirements 7.1, 10.4
+ */
+#include "htaccess_file_cache.h"
+#include "htaccess_hash.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void file_ident_set(file_ident_t *id, const struct stat *st)
+{
+    id->mtime = st->st_mtim;
+    id->size = st->st_size;
+    id->dev = st->st_dev;
+    id->ino = st->st_ino;
+}
+
+int file_ident_matches(const file_ident_t *id, const struct stat *st)
+{
+    return id->mtime.tv_sec == st->st_mtim.tv_sec &&
+           id->mtime.tv_nsec == st->st_mtim.tv_nsec &&
+           id->size == st->st_size && id->dev == st->st_dev &&
+           id->ino == st->st_ino;
+}
+
+static void entry_release(file_cache_t *cache, file_cache_entry_t *e)
+{
+    free(e->path);
+    e->path = NULL;
+    cache->ops->release(e);
+}
+
+static int entry_current(const file_cache_t *cache,
+                         const file_cache_entry_t *e, const struct stat *st)
+{
+    if (cache->ops->current)
+        return cache->ops->current(e, st);
+    return file_ident_matches(&e->ident, st);
+}
+
+/* Build a record for `path` and give it its key. */
+static file_cache_entry_t *entry_load(file_cache_t *cache, const char *path,
+                                      const struct stat *st)
+{
+    file_cache_entry_t *e = cache->ops->load(path, st);
+
+    if (!e)
+        return NULL;
+    e->path = strdup(path);
+    if (!e->path) {
+        cache->ops->release(e);
+        return NULL;
+    }
+    return e;
+}
+
+file_cache_entry_t *file_cache_get(file_cache_t *cache, const char *path)
+{
+    size_t bucket = (size_t)(hash_fnv1a_str(path) % FILE_CACHE_BUCKETS);
+    file_cache_entry_t **link = &cache->buckets[bucket], *e, *fresh;
+    struct stat st;
+
+    while (*link && strcmp((*link)->path, path) != 0)
+        link = &(*link)->chain_next;
+    e = *link;
+
+    if (stat(path, &st) != 0) {
+        /* Gone: drop the cached copy */
+        if (e) {
+            *link = e->chain_next;
+            entry_release(cache, e);
+        }
+        return NULL;
+    }
+    if (e && entry_current(cache, e, &st))
+        return e;
+
+    if (e && !cache->ops->keep) {
+        /* Changed: drop the stale copy before building the new one */
+        *link = e->chain_next;
+        entry_release(cache, e);
+        e = NULL;
+    }
+    fresh = entry_load(cache, path, &st);
+    if (!fresh) {
+        if (e && cache->ops->keep(e, &st))
+            return e;
+        if (e) {
+            *link = e->chain_next;
+            entry_release(cache, e);
+        }
+        return NULL;
+    }
+    if (e) {
+        *link = e->chain_next;
+        entry_release(cache, e);
+    }
+    fresh->chain_next = cache->buckets[bucket];
+    cache->buckets[bucket] = fresh;
+    return fresh;
+}
+
+void file_cache_clear(file_cache_t *cache)
+{
+    for (size_t i = 0; i < FILE_CACHE_BUCKETS; i++) {
+        file_cache_entry_t *e = cache->buckets[i];
+        while (e) {
+            file_cache_entry_t *next = e->chain_next;
+            entry_release(cache, e);
+            e = next;
+        }
+        cache->buckets[i] = NULL;
+    }
+}
@@ -0,0 +1,65 @@
+/**
+ * htaccess_fileio.c - Whole-buffer file descriptor I/O
+ *
+ * Validates: Requirements 7.1, 10.4, 12.4
+ */
+#include "htaccess_fileio.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+int fileio_read_all(int fd, void *buf, size_t len)
+{
+    char *p = buf;
+
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+int fileio_write_all(int fd, const void *buf, size_t len)
+{
+    const char *p = buf;
+
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+char *fileio_read_file(const char *path, struct stat *st)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    char *buf = NULL;
+
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, st) == 0 && S_ISREG(st->st_mode) &&
+        (uint64_t)st->st_size < UINT32_MAX &&
+        (buf = malloc((size_t)st->st_size + 1)) != NULL) {
+        if (fileio_read_all(fd, buf, (size_t)st->st_size) == 0) {
+            buf[st->st_size] = '\0';
+        } else {
+            free(buf);
+            buf = NULL;
+        }
+    }
+    close(fd);
+    return buf;
+}
@@ -0,0 +1,31 @@
+/**
+ * htaccess_hash.c - FNV-1a hashing of names and keys
+ *
+ * Validates: Requirements 7.1, 9.1, 10.4
+ */
+#include "htaccess_hash.h"
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME  0x100000001b3ULL
+
+uint64_t hash_fnv1a(const char *data, size_t len)
+{
+    uint64_t h = FNV_OFFSET;
+
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)data[i];
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+uint64_t hash_fnv1a_str(const char *s)
+{
+    uint64_t h = FNV_OFFSET;
+
+    for (; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= FNV_PRIME;
+    }
+    return h;
+}
@@ -0,0 +1,494 @@
+/**
+ * htaccess_hitters.c - Heavy-hitter telemetry implementation
+ *
+ * The shared region holds a Count-Min sketch (HITTERS_CM_DEPTH rows of
+ * 32-bit counters, one per row hashed with the Kirsch-Mitzenmacher double
+ * hashing scheme) and two Space-Saving tables of HITTERS_TOP_K entries.
+ *
+ * Sketch counters are bumped with atomic adds and need no lock. The
+ * Space-Saving tables are updated under a small spinlock owned by the
+ * worker's PID; a worker that cannot take it within a few spins drops
+ * that update from the tables (the sketch still counts it), and a lock
+ * left behind by a dead worker is broken. Readers use the same bounded
+ * attempt and fail rather than wait, and the text export runs from a
+ * worker timer (mod_htaccess.c), not from the request path. Telemetry
+ * never makes a request wait.
+ *
+ * Validates: Requirements 12.1, 12.2
+ */
+#include "htaccess_hitters.h"
+#include "htaccess_shm.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+/* ------------------------------------------------------------------ */
+/*  Shared layout                                                      */
+/* ------------------------------------------------------------------ */
+
+/** "OLHH" */
+#define HITTERS_MAGIC 0x4F4C4848u
+
+/** Lock attempts before an update gives up on the top-K tables. */
+#define HITTERS_LOCK_SPINS 256
+
+#define CM_MASK (HITTERS_CM_WIDTH - 1)
+
+_Static_assert((HITTERS_CM_WIDTH & CM_MASK) == 0,
+               "sketch width must be a power of two");
+
+typedef struct {
+    uint64_t hash;     /* Key hash, 0 = unused entry */
+    uint64_t count;
+    uint64_t error;
+    union {
+        ip_addr_t addr;
+        char      path[HITTERS_PATH_MAX + 1];
+    } key;
+} hh_slot_t;
+
+typedef struct {
+    uint32_t  magic;        /* HITTERS_MAGIC */
+    uint32_t  version;      /* HITTERS_LAYOUT_VERSION */
+    uint32_t  width;        /* HITTERS_CM_WIDTH of the writer */
+    uint32_t  depth;        /* HITTERS_CM_DEPTH of the writer */
+    uint32_t  top_k;        /* HITTERS_TOP_K of the writer */
+    uint32_t  lock;         /* PID holding the top-K lock, 0 = free */
+    uint32_t  last_export;  /* Time of the last export (atomic) */
+    uint32_t  reserved;
+    uint64_t  total;        /* Attempts recorded (atomic) */
+    uint32_t  cm[HITTERS_CM_DEPTH][HITTERS_CM_WIDTH];
+    hh_slot_t top[2][HITTERS_TOP_K];
+} hh_region_t;
+
+static hh_region_t *g_region;
+static char g_export[PATH_MAX];
+
+/* ------------------------------------------------------------------ */
+/*  Hashing                                                            */
+/* ------------------------------------------------------------------ */
+
+/* Same hash as the brute force table, never 0 (0 marks an unused entry) */
+static uint64_t hash_addr(const ip_addr_t *addr)
+{
+    return shm_hash_addr(addr) | 1;
+}
+
+/* FNV-1a over the whole path; the seed keeps paths apart from addresses */
+static uint64_t hash_path(const char *path)
+{
+    uint64_t h = 0xcbf29ce484222325ULL ^ 0x5041544800000000ULL;
+
+    for (const unsigned char *p = (const unsigned char *)path; *p; p++) {
+        h ^= *p;
+        h *= 0x100000001b3ULL;
+    }
+    return shm_mix64(h) | 1;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Count-Min sketch                                                   */
+/* ------------------------------------------------------------------ */
+
+static uint32_t cm_index(uint64_t h, int row)
+{
+    uint32_t h1 = (uint32_t)h;
+    uint32_t h2 = (uint32_t)(h >> 32) | 1;
+    return (h1 + (uint32_t)row * h2) & CM_MASK;
+}
+
+static void cm_add(uint64_t h)
+{
+    for (int r = 0; r < HITTERS_CM_DEPTH; r++)
+        __atomic_add_fetch(&g_region->cm[r][cm_index(h, r)], 1,
+                           __ATOMIC_RELAXED);
+}
+
+static uint64_t cm_estimate(uint64_t h)
+{
+    uint32_t best = UINT32_MAX;
+
+    for (int r = 0; r < HITTERS_CM_DEPTH; r++) {
+        uint32_t c = __atomic_load_n(&g_region->cm[r][cm_index(h, r)],
+                                     __ATOMIC_RELAXED);
+        if (c < best)
+            best = c;
+    }
+    return best;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Space-Saving tables                                                */
+/* ------------------------------------------------------------------ */
+
+/* Take the top-K lock, breaking it if its holder has died. */
+static int lock_acquire(void)
+{
+    uint32_t self = (uint32_t)getpid();
+
+    for (int spin = 0; spin < HITTERS_LOCK_SPINS; spin++) {
+        uint32_t holder = 0;
+        if (__atomic_compare_exchange_n(&g_region->lock, &holder, self, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            return 1;
+        if (holder != self && kill((pid_t)holder, 0) != 0 &&
+            errno == ESRCH &&
+            __atomic_compare_exchange_n(&g_region->lock, &holder, self, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            return 1;
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+    return 0;
+}
+
+static void lock_release(void)
+{
+    __atomic_store_n(&g_region->lock, 0, __ATOMIC_RELEASE);
+}
+
+static int slot_matches(const hh_slot_t *s, hitters_kind_t kind, uint64_t h,
+                        const void *key)
+{
+    if (s->hash != h)
+        return 0;
+    if (kind == HITTERS_ADDR)
+        return memcmp(&s->key.addr, key, sizeof(ip_addr_t)) == 0;
+    return strncmp(s->key.path, (const char *)key, HITTERS_PATH_MAX) == 0;
+}
+
+static void slot_set_key(hh_slot_t *s, hitters_kind_t kind, uint64_t h,
+                         const void *key)
+{
+    s->hash = h;
+    memset(&s->key, 0, sizeof(s->key));
+    if (kind == HITTERS_ADDR)
+        memcpy(&s->key.addr, key, sizeof(ip_addr_t));
+    else
+        strncpy(s->key.path, (const char *)key, HITTERS_PATH_MAX);
+}
+
+/*
+ * Space-Saving step: bump the key's entry, take a free entry, or replace
+ * the entry with the lowest count, inheriting that count as its error.
+ */
+static void topk_add(hitters_kind_t kind, uint64_t h, const void *key)
+{
+    hh_slot_t *tab = g_region->top[kind];
+    hh_slot_t *min = NULL;
+
+    for (int i = 0; i < HITTERS_TOP_K; i++) {
+        hh_slot_t *s = &tab[i];
+        if (s->hash == 0) {
+            slot_set_key(s, kind, h, key);
+            s->count = 1;
+            s->error = 0;
+            return;
+        }
+        if (slot_matches(s, kind, h, key)) {
+            s->count++;
+            return;
+        }
+        if (!min || s->count < min->count)
+            min = s;
+    }
+    slot_set_key(min, kind, h, key);
+    min->error = min->count;
+    min->count++;
+}
+
+static int entry_cmp(const void *a, const void *b)
+{
+    const hitters_entry_t *x = (const hitters_entry_t *)a;
+    const hitters_entry_t *y = (const hitters_entry_t *)b;
+    return x->count < y->count ? 1 : x->count > y->count ? -1 : 0;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Export                                                             */
+/* ------------------------------------------------------------------ */
+
+static void format_addr(const ip_addr_t *addr, char *buf, size_t len)
+{
+    if (ip_addr_is_v4(addr)) {
+        struct in_addr v4;
+        v4.s_addr = htonl((uint32_t)addr->lo);
+        inet_ntop(AF_INET, &v4, buf, (socklen_t)len);
+    } else {
+        unsigned char raw[16];
+        for (int i = 0; i < 8; i++) {
+            raw[i] = (unsigned char)(addr->hi >> (56 - 8 * i));
+            raw[8 + i] = (unsigned char)(addr->lo >> (56 - 8 * i));
+        }
+        inet_ntop(AF_INET6, raw, buf, (socklen_t)len);
+    }
+}
+
+static int write_table(FILE *fp, hitters_kind_t kind)
+{
+    hitters_entry_t top[HITTERS_TOP_K];
+    int n = hitters_top(kind, top, HITTERS_TOP_K);
+
+    if (n < 0)
+        return -1;
+    for (int i = 0; i < n; i++) {
+        char addr[INET6_ADDRSTRLEN];
+        const char *key = top[i].path;
+        if (kind == HITTERS_ADDR) {
+            format_addr(&top[i].addr, addr, sizeof(addr));
+            key = addr;
+        }
+        if (fprintf(fp, "%s %llu %llu %s\n",
+                    kind == HITTERS_ADDR ? "addr" : "path",
+                    (unsigned long long)top[i].count,
+                    (unsigned long long)top[i].error, key) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Backing file                                                       */
+/* ------------------------------------------------------------------ */
+
+static int header_matches(const hh_region_t *r)
+{
+    return r->magic == HITTERS_MAGIC &&
+           r->version == HITTERS_LAYOUT_VERSION &&
+           r->width == HITTERS_CM_WIDTH && r->depth == HITTERS_CM_DEPTH &&
+           r->top_k == HITTERS_TOP_K;
+}
+
+static void format_region(hh_region_t *r)
+{
+    memset(r, 0, sizeof(*r));
+    r->version = HITTERS_LAYOUT_VERSION;
+    r->width = HITTERS_CM_WIDTH;
+    r->depth = HITTERS_CM_DEPTH;
+    r->top_k = HITTERS_TOP_K;
+    __atomic_store_n(&r->magic, HITTERS_MAGIC, __ATOMIC_RELEASE);
+}
+
+/* Map the backing file under an exclusive flock, formatting it if needed */
+static void *attach_file(int fd)
+{
+    struct stat st;
+    void *map = MAP_FAILED;
+
+    if (flock(fd, LOCK_EX) != 0)
+        return MAP_FAILED;
+    if (fstat(fd, &st) != 0)
+        goto out;
+    if ((size_t)st.st_size != sizeof(hh_region_t) &&
+        ftruncate(fd, (off_t)sizeof(hh_region_t)) != 0)
+        goto out;
+    map = mmap(NULL, sizeof(hh_region_t), PROT_READ | PROT_WRITE,
+               MAP_SHARED, fd, 0);
+    if (map != MAP_FAILED && !header_matches((hh_region_t *)map))
+        format_region((hh_region_t *)map);
+out:
+    flock(fd, LOCK_UN);
+    return map;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Public API                                                         */
+/* ------------------------------------------------------------------ */
+
+int hitters_init(const char *dir)
+{
+    void *map;
+
+    hitters_destroy();
+
+    if (!dir) {
+        map = mmap(NULL, sizeof(hh_region_t), PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (map == MAP_FAILED)
+            return -1;
+        format_region((hh_region_t *)map);
+        g_region = (hh_region_t *)map;
+        return 0;
+    }
+
+    char base[PATH_MAX], file[PATH_MAX];
+    size_t len = strlen(dir);
+    while (len > 1 && dir[len - 1] == '/')
+        len--;
+    if (snprintf(base, sizeof(base), "%.*s", (int)len, dir) >=
+            (int)sizeof(base) ||
+        snprintf(file, sizeof(file), "%s/%s", base, HITTERS_FILE_NAME) >=
+            (int)sizeof(file) ||
+        snprintf(g_export, sizeof(g_export), "%s/%s", base,
+                 HITTERS_EXPORT_NAME) >= (int)sizeof(g_export)) {
+        g_export[0] = '\0';
+        return -1;
+    }
+    if (shm_make_dirs(base) != 0) {
+        g_export[0] = '\0';
+        return -1;
+    }
+
+    int fd = open(file, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        g_export[0] = '\0';
+        return -1;
+    }
+    map = attach_file(fd);
+    close(fd);
+    if (map == MAP_FAILED) {
+        g_export[0] = '\0';
+        return -1;
+    }
+    g_region = (hh_region_t *)map;
+    return 0;
+}
+
+void hitters_record(const ip_addr_t *addr, const char *path)
+{
+    uint64_t ha = 0, hp = 0;
+
+    if (!g_region || (!addr && !path))
+        return;
+    __atomic_add_fetch(&g_region->total, 1, __ATOMIC_RELAXED);
+    if (addr) {
+        ha = hash_addr(addr);
+        cm_add(ha);
+    }
+    if (path) {
+        hp = hash_path(path);
+        cm_add(hp);
+    }
+
+    if (!lock_acquire())
+        return;
+    if (addr)
+        topk_add(HITTERS_ADDR, ha, addr);
+    if (path)
+        topk_add(HITTERS_PATH, hp, path);
+    lock_release();
+}
+
+uint64_t hitters_estimate_addr(const ip_addr_t *addr)
+{
+    if (!g_region || !addr)
+        return 0;
+    return cm_estimate(hash_addr(addr));
+}
+
+uint64_t hitters_estimate_path(const char *path)
+{
+    if (!g_region || !path)
+        return 0;
+    return cm_estimate(hash_path(path));
+}
+
+int hitters_top(hitters_kind_t kind, hitters_entry_t *out, int n)
+{
+    hitters_entry_t all[HITTERS_TOP_K];
+    int count = 0;
+
+    if (!g_region || (kind != HITTERS_ADDR && kind != HITTERS_PATH))
+        return -1;
+    if (!out || n <= 0)
+        return 0;
+
+    /* A busy or stuck lock holder makes the read fail, never wait */
+    if (!lock_acquire())
+        return -1;
+    for (int i = 0; i < HITTERS_TOP_K; i++) {
+        const hh_slot_t *s = &g_region->top[kind][i];
+        if (s->hash == 0)
+            continue;
+        memset(&all[count], 0, sizeof(all[count]));
+        all[count].count = s->count;
+        all[count].error = s->error;
+        if (kind == HITTERS_ADDR)
+            all[count].addr = s->key.addr;
+        else
+            memcpy(all[count].path, s->key.path, sizeof(all[count].path));
+        count++;
+    }
+    lock_release();
+
+    qsort(all, (size_t)count, sizeof(all[0]), entry_cmp);
+    if (count > n)
+        count = n;
+    memcpy(out, all, (size_t)count * sizeof(all[0]));
+    return count;
+}
+
+int hitters_export(const char *file)
+{
+    char tmp[PATH_MAX];
+    FILE *fp;
+    int rc;
+
+    if (!g_region || !file)
+        return -1;
+    if (snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", file, (long)getpid()) >=
+        (int)sizeof(tmp))
+        return -1;
+    fp = fopen(tmp, "w");
+    if (!fp)
+        return -1;
+
+    rc = fprintf(fp, "# total %llu\n",
+                 (unsigned long long)__atomic_load_n(&g_region->total,
+                                                     __ATOMIC_RELAXED)) < 0
+             ? -1 : 0;
+    if (rc == 0)
+        rc = write_table(fp, HITTERS_ADDR);
+    if (rc == 0)
+        rc = write_table(fp, HITTERS_PATH);
+    if (fclose(fp) != 0)
+        rc = -1;
+    if (rc == 0 && rename(tmp, file) != 0)
+        rc = -1;
+    if (rc != 0)
+        unlink(tmp);
+    return rc;
+}
+
+int hitters_maybe_export(time_t now)
+{
+    uint32_t last, mine;
+
+    if (!g_region || !g_export[0])
+        return 0;
+    last = __atomic_load_n(&g_region->last_export, __ATOMIC_RELAXED);
+    if ((time_t)last + HITTERS_EXPORT_INTERVAL > now)
+        return 0;
+    /* One worker per interval wins the export */
+    if (!__atomic_compare_exchange_n(&g_region->last_export, &last,
+                                     (uint32_t)now, 0, __ATOMIC_RELAXED,
+                                     __ATOMIC_RELAXED))
+        return 0;
+    if (hitters_export(g_export) == 0)
+        return 1;
+    /* Tables busy or write failed: let the next tick try again */
+    mine = (uint32_t)now;
+    __atomic_compare_exchange_n(&g_region->last_export, &mine, last, 0,
+                                __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    return 0;
+}
+
+void hitters_destroy(void)
+{
+    if (g_region)
+        munmap(g_region, sizeof(hh_region_t));
+    g_region = NULL;
+    g_export[0] = '\0';
+}
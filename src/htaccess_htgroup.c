@@ -0,0 +1,291 @@
+/**
+ * htaccess_htgroup.c - AuthGroupFile cache implementation
+ *
+ * A compiled file keeps its content in one buffer with the separators
+ * overwritten by NULs, two name tables (groups and members) that intern
+ * names into dense ids, and a row-major bit matrix with one row of
+ * ceil(groups / 64) words per member. The name tables use the same
+ * open-addressing layout as the htpasswd user index (linear probing,
+ * FNV-1a, at most half full); files live in the shared path-keyed file
+ * cache (htaccess_file_cache.c).
+ *
+ * Validates: Requirements 10.4
+ */
+#include "htaccess_htgroup.h"
+#include "htaccess_file_cache.h"
+#include "htaccess_fileio.h"
+#include "htaccess_hash.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/** One interned name, pointing into the file buffer. */
+typedef struct {
+    const char *name;
+    uint64_t    h;
+} htgroup_name_t;
+
+/** Names in id order plus their hash index. */
+typedef struct {
+    htgroup_name_t *names;
+    size_t          count;
+    uint32_t       *index;      /* Id + 1, 0 = empty */
+    size_t          index_mask; /* Index size - 1 (power of two) */
+} name_table_t;
+
+/** One compiled file. */
+typedef struct {
+    file_cache_entry_t entry;       /* First: keyed by AuthGroupFile path */
+    char *content;                  /* File content, separators NUL'ed */
+    name_table_t groups;
+    name_table_t users;
+    size_t words;                   /* Bitset words per user */
+    uint64_t *bits;                 /* users.count rows of `words` */
+} htgroup_file_t;
+
+static htgroup_stats_t g_stats;
+
+/* ------------------------------------------------------------------ */
+/* Name tables                                                         */
+/* ------------------------------------------------------------------ */
+
+static int table_init(name_table_t *t, size_t max)
+{
+    size_t cap = 8;
+
+    while (cap < max * 2)
+        cap <<= 1;
+    t->names = malloc((max ? max : 1) * sizeof(htgroup_name_t));
+    t->index = calloc(cap, sizeof(uint32_t));
+    t->index_mask = cap - 1;
+    t->count = 0;
+    return t->names && t->index ? 0 : -1;
+}
+
+static void table_free(name_table_t *t)
+{
+    free(t->names);
+    free(t->index);
+}
+
+/* Index slot holding `name`, or the empty slot where it would go. */
+static size_t table_slot(const name_table_t *t, const char *name,
+                         size_t len, uint64_t h)
+{
+    size_t i = (size_t)h & t->index_mask;
+
+    for (;; i = (i + 1) & t->index_mask) {
+        uint32_t id = t->index[i];
+        if (id == 0)
+            return i;
+        const htgroup_name_t *n = &t->names[id - 1];
+        if (n->h == h && strncmp(n->name, name, len) == 0 &&
+            n->name[len] == '\0')
+            return i;
+    }
+}
+
+/* Id + 1 of `name` (`len` bytes, not necessarily terminated), 0 if absent */
+static uint32_t table_find(const name_table_t *t, const char *name,
+                           size_t len)
+{
+    return t->index[table_slot(t, name, len, hash_fnv1a(name, len))];
+}
+
+/* Id of the NUL-terminated `name`, added if new. */
+static uint32_t table_intern(name_table_t *t, const char *name)
+{
+    size_t len = strlen(name);
+    uint64_t h = hash_fnv1a(name, len);
+    size_t i = table_slot(t, name, len, h);
+
+    if (!t->index[i]) {
+        t->names[t->count].name = name;
+        t->names[t->count].h = h;
+        t->index[i] = (uint32_t)(++t->count);
+    }
+    return t->index[i] - 1;
+}
+
+/* ------------------------------------------------------------------ */
+/* Compiled files                                                      */
+/* ------------------------------------------------------------------ */
+
+static void file_release(htgroup_file_t *f)
+{
+    free(f->content);
+    table_free(&f->groups);
+    table_free(&f->users);
+    free(f->bits);
+    free(f);
+}
+
+static void file_free(file_cache_entry_t *e)
+{
+    htgroup_file_t *f = (htgroup_file_t *)e;
+
+    g_stats.files--;
+    g_stats.groups -= f->groups.count;
+    g_stats.users -= f->users.count;
+    file_release(f);
+}
+
+static int is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/*
+ * Intern groups and members and fill the bit matrix. Lines without a ':'
+ * and comment lines are skipped.
+ */
+static int file_compile(htgroup_file_t *f, size_t len)
+{
+    char *p = f->content, *end = f->content + len;
+    size_t lines = 1, tokens = 0, n_pairs = 0;
+    uint32_t *pairs;   /* (group id, user id) for every membership */
+    int in_token = 0;
+
+    /* Upper bounds: one group per line, one member per token */
+    for (char *q = p; q < end; q++) {
+        if (*q == '\n')
+            lines++;
+        int sep = *q == '\n' || is_space(*q) || *q == ':';
+        if (!sep && !in_token)
+            tokens++;
+        in_token = !sep;
+    }
+    if (table_init(&f->groups, lines) != 0 ||
+        table_init(&f->users, tokens) != 0)
+        return -1;
+    pairs = malloc((tokens ? tokens : 1) * 2 * sizeof(uint32_t));
+    if (!pairs)
+        return -1;
+
+    while (p < end) {
+        char *eol = memchr(p, '\n', (size_t)(end - p));
+        char *next = eol ? eol + 1 : end;
+        if (!eol)
+            eol = end;
+        *eol = '\0';
+
+        while (p < eol && is_space(*p))
+            p++;
+        char *colon = *p != '#' ? memchr(p, ':', (size_t)(eol - p)) : NULL;
+        if (colon) {
+            char *gend = colon;
+            while (gend > p && is_space(gend[-1]))
+                gend--;
+            *gend = '\0';
+            if (*p) {
+                uint32_t gid = table_intern(&f->groups, p);
+                char *m = colon + 1;
+                while (m < eol) {
+                    while (m < eol && is_space(*m))
+                        m++;
+                    if (m == eol)
+                        break;
+                    char *mend = m;
+                    while (mend < eol && !is_space(*mend))
+                        mend++;
+                    *mend = '\0';
+                    pairs[n_pairs * 2] = gid;
+                    pairs[n_pairs * 2 + 1] = table_intern(&f->users, m);
+                    n_pairs++;
+                    m = mend + 1;
+                }
+            }
+        }
+        p = next;
+    }
+
+    f->words = (f->groups.count + 63) / 64;
+    f->bits = calloc(f->users.count * f->words + 1, sizeof(uint64_t));
+    if (!f->bits) {
+        free(pairs);
+        return -1;
+    }
+    for (size_t i = 0; i < n_pairs; i++) {
+        uint32_t gid = pairs[i * 2], uid = pairs[i * 2 + 1];
+        f->bits[uid * f->words + gid / 64] |= 1ULL << (gid % 64);
+    }
+    free(pairs);
+    return 0;
+}
+
+/* Read and compile `path`. Returns NULL if it cannot be read. */
+static file_cache_entry_t *file_load(const char *path, const struct stat *st)
+{
+    struct stat fst;
+    htgroup_file_t *f = calloc(1, sizeof(*f));
+
+    (void)st;
+    if (!f)
+        return NULL;
+    f->content = fileio_read_file(path, &fst);
+    if (!f->content || file_compile(f, (size_t)fst.st_size) != 0) {
+        file_release(f);
+        return NULL;
+    }
+    file_ident_set(&f->entry.ident, &fst);
+    g_stats.loads++;
+    g_stats.files++;
+    g_stats.groups += f->groups.count;
+    g_stats.users += f->users.count;
+    return &f->entry;
+}
+
+static const file_cache_ops_t g_file_ops = { file_load, file_free, NULL,
+                                              NULL };
+static file_cache_t g_files = FILE_CACHE_INIT(&g_file_ops);
+
+/* ------------------------------------------------------------------ */
+/* Public API                                                          */
+/* ------------------------------------------------------------------ */
+
+int htgroup_cache_check(const char *path, const char *user,
+                        const char *groups)
+{
+    htgroup_file_t *f;
+    uint32_t uid;
+
+    if (!path || !user || !groups)
+        return -1;
+    f = (htgroup_file_t *)file_cache_get(&g_files, path);
+    if (!f)
+        return -1;
+
+    g_stats.checks++;
+    uid = table_find(&f->users, user, strlen(user));
+    if (!uid)
+        return 0;
+    const uint64_t *row = &f->bits[(uid - 1) * f->words];
+
+    for (const char *g = groups; *g;) {
+        size_t len;
+        while (*g == ' ' || *g == '\t')
+            g++;
+        len = strcspn(g, " \t");
+        if (len) {
+            uint32_t gid = table_find(&f->groups, g, len);
+            if (gid && (row[(gid - 1) / 64] >> ((gid - 1) % 64) & 1))
+                return 1;
+        }
+        g += len;
+    }
+    return 0;
+}
+
+int htgroup_cache_get_stats(htgroup_stats_t *out)
+{
+    if (!out)
+        return -1;
+    *out = g_stats;
+    return 0;
+}
+
+void htgroup_cache_destroy(void)
+{
+    file_cache_clear(&g_files);
+    memset(&g_stats, 0, sizeof(g_stats));
+}
@@ -0,0 +1,349 @@
+/**
+ * htaccess_htpasswd.c - AuthUserFile cache implementation
+ *
+ * Each cached file keeps its whole content in one buffer, with the
+ * separators overwritten by NULs so user names and hashes can be used in
+ * place. Users are indexed by an open-addressing table of entry indices
+ * (linear probing, FNV-1a hash, at most half full). Files themselves live
+ * in the shared path-keyed file cache (htaccess_file_cache.c).
+ *
+ * Verified credentials live in a set-associative table of (tag, expiry)
+ * pairs. The tag is SipHash-2-4 over "path\0user\0password\0hash" with
+ * a key drawn from getrandom() on first use; the input buffer is wiped
+ * after hashing. Without a key the table stays disabled.
+ *
+ * Validates: Requirements 10.4
+ */
+#include "htaccess_htpasswd.h"
+#include "htaccess_file_cache.h"
+#include "htaccess_fileio.h"
+#include "htaccess_hash.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+
+/** Longest "path\0user\0password\0hash" input the tag is computed on. */
+#define VERIFIED_INPUT_MAX 2048
+
+/** One "user:hash" line, pointing into the file buffer. */
+typedef struct {
+    const char     *user;
+    const char     *hash;
+    pwhash_format_t format; /* Detected when the file is loaded */
+    uint64_t        h;      /* Hash of the user name */
+} htpasswd_user_t;
+
+/** One parsed file. */
+typedef struct {
+    file_cache_entry_t entry;       /* First: keyed by AuthUserFile path */
+    char *content;                  /* File content, separators NUL'ed */
+    htpasswd_user_t *users;         /* Entries in file order */
+    size_t num_users;
+    uint32_t *index;                /* Entry index + 1, 0 = empty */
+    size_t index_mask;              /* Index size - 1 (power of two) */
+} htpasswd_file_t;
+
+/** One remembered verification; tag 0 marks a free slot. */
+typedef struct {
+    uint64_t tag;
+    time_t   expires;
+} htpasswd_verified_t;
+
+static htpasswd_stats_t g_stats;
+
+static htpasswd_verified_t g_verified[HTPASSWD_VERIFIED_SLOTS];
+static int g_verified_ttl = HTPASSWD_VERIFIED_TTL;
+static uint64_t g_sip_key[2];
+static int g_sip_keyed;   /* 1 keyed, -1 no randomness available */
+
+/* ------------------------------------------------------------------ */
+/* Parsed files                                                        */
+/* ------------------------------------------------------------------ */
+
+static void file_release(htpasswd_file_t *f)
+{
+    free(f->content);
+    free(f->users);
+    free(f->index);
+    free(f);
+}
+
+static void file_free(file_cache_entry_t *e)
+{
+    htpasswd_file_t *f = (htpasswd_file_t *)e;
+
+    g_stats.files--;
+    g_stats.users -= f->num_users;
+    file_release(f);
+}
+
+static const htpasswd_user_t *file_find(const htpasswd_file_t *f,
+                                        const char *user)
+{
+    uint64_t h = hash_fnv1a_str(user);
+    size_t i = (size_t)h & f->index_mask;
+
+    for (;; i = (i + 1) & f->index_mask) {
+        uint32_t slot = f->index[i];
+        if (slot == 0)
+            return NULL;
+        const htpasswd_user_t *u = &f->users[slot - 1];
+        if (u->h == h && strcmp(u->user, user) == 0)
+            return u;
+    }
+}
+
+/*
+ * Split the content into entries and build the user index. Lines without
+ * a ':' are skipped, like the line scanner this replaces did.
+ */
+static int file_index(htpasswd_file_t *f, size_t len)
+{
+    size_t lines = 1, cap = 8;
+    char *p = f->content, *end = f->content + len;
+
+    for (char *q = p; (q = memchr(q, '\n', (size_t)(end - q))); q++)
+        lines++;
+    while (cap < lines * 2)
+        cap <<= 1;
+    f->users = malloc(lines * sizeof(htpasswd_user_t));
+    f->index = calloc(cap, sizeof(uint32_t));
+    if (!f->users || !f->index)
+        return -1;
+    f->index_mask = cap - 1;
+
+    while (p < end) {
+        char *eol = memchr(p, '\n', (size_t)(end - p));
+        char *next = eol ? eol + 1 : end;
+        if (!eol)
+            eol = end;
+        while (eol > p && eol[-1] == '\r')
+            eol--;
+        *eol = '\0';
+
+        char *colon = p[0] != '#' ? memchr(p, ':', (size_t)(eol - p)) : NULL;
+        if (colon) {
+            htpasswd_user_t *u = &f->users[f->num_users];
+            *colon = '\0';
+            u->user = p;
+            u->hash = colon + 1;
+            u->format = pwhash_detect(u->hash);
+            u->h = hash_fnv1a_str(p);
+            if (!file_find(f, p)) {
+                size_t i = (size_t)u->h & f->index_mask;
+                while (f->index[i])
+                    i = (i + 1) & f->index_mask;
+                f->index[i] = (uint32_t)(++f->num_users);
+            }
+        }
+        p = next;
+    }
+    return 0;
+}
+
+/* Read and index `path`. Returns NULL if it cannot be read. */
+static file_cache_entry_t *file_load(const char *path, const struct stat *st)
+{
+    struct stat fst;
+    htpasswd_file_t *f = calloc(1, sizeof(*f));
+
+    (void)st;
+    if (!f)
+        return NULL;
+    f->content = fileio_read_file(path, &fst);
+    if (!f->content || file_index(f, (size_t)fst.st_size) != 0) {
+        file_release(f);
+        return NULL;
+    }
+    file_ident_set(&f->entry.ident, &fst);
+    g_stats.loads++;
+    g_stats.files++;
+    g_stats.users += f->num_users;
+    return &f->entry;
+}
+
+static const file_cache_ops_t g_file_ops = { file_load, file_free, NULL,
+                                              NULL };
+static file_cache_t g_files = FILE_CACHE_INIT(&g_file_ops);
+
+/* ------------------------------------------------------------------ */
+/* Verified credentials                                                */
+/* ------------------------------------------------------------------ */
+
+#define ROTL64(x, b) (((x) << (b)) | ((x) >> (64 - (b))))
+
+#define SIPROUND(v0, v1, v2, v3)                                        \
+    do {                                                                \
+        v0 += v1; v1 = ROTL64(v1, 13); v1 ^= v0; v0 = ROTL64(v0, 32);   \
+        v2 += v3; v3 = ROTL64(v3, 16); v3 ^= v2;                        \
+        v0 += v3; v3 = ROTL64(v3, 21); v3 ^= v0;                        \
+        v2 += v1; v1 = ROTL64(v1, 17); v1 ^= v2; v2 = ROTL64(v2, 32);   \
+    } while (0)
+
+/* SipHash-2-4 of `len` bytes under `key`. */
+static uint64_t siphash24(const uint64_t key[2], const unsigned char *in,
+                          size_t len)
+{
+    uint64_t v0 = 0x736f6d6570736575ULL ^ key[0];
+    uint64_t v1 = 0x646f72616e646f6dULL ^ key[1];
+    uint64_t v2 = 0x6c7967656e657261ULL ^ key[0];
+    uint64_t v3 = 0x7465646279746573ULL ^ key[1];
+    uint64_t b = (uint64_t)len << 56, m;
+    size_t i, tail = len & 7;
+
+    for (i = 0; i + 8 <= len; i += 8) {
+        memcpy(&m, in + i, 8);   /* Little-endian hosts only */
+        v3 ^= m;
+        SIPROUND(v0, v1, v2, v3);
+        SIPROUND(v0, v1, v2, v3);
+        v0 ^= m;
+    }
+    for (size_t t = 0; t < tail; t++)
+        b |= (uint64_t)in[i + t] << (8 * t);
+    v3 ^= b;
+    SIPROUND(v0, v1, v2, v3);
+    SIPROUND(v0, v1, v2, v3);
+    v0 ^= b;
+    v2 ^= 0xff;
+    for (int r = 0; r < 4; r++)
+        SIPROUND(v0, v1, v2, v3);
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+/*
+ * Tag of a credential, or 0 when the table is disabled or the input is
+ * too long to remember.
+ */
+static uint64_t verified_tag(const char *path, const char *user,
+                             const char *password, const char *hash)
+{
+    const char *parts[4] = {path, user, password, hash};
+    unsigned char buf[VERIFIED_INPUT_MAX];
+    size_t len = 0;
+    uint64_t tag;
+
+    if (g_verified_ttl <= 0 || !path || !user || !password || !hash)
+        return 0;
+    if (g_sip_keyed == 0)
+        g_sip_keyed = getrandom(g_sip_key, sizeof(g_sip_key), 0) ==
+                      (ssize_t)sizeof(g_sip_key) ? 1 : -1;
+    if (g_sip_keyed < 0)
+        return 0;
+
+    for (int i = 0; i < 4; i++) {
+        size_t n = strlen(parts[i]) + 1;
+        if (n > sizeof(buf) - len) {
+            explicit_bzero(buf, len);
+            return 0;
+        }
+        memcpy(buf + len, parts[i], n);
+        len += n;
+    }
+    tag = siphash24(g_sip_key, buf, len);
+    explicit_bzero(buf, len);
+    return tag ? tag : 1;
+}
+
+static htpasswd_verified_t *verified_set(uint64_t tag)
+{
+    size_t sets = HTPASSWD_VERIFIED_SLOTS / HTPASSWD_VERIFIED_WAYS;
+    return &g_verified[(size_t)(tag % sets) * HTPASSWD_VERIFIED_WAYS];
+}
+
+/* ------------------------------------------------------------------ */
+/* Public API                                                          */
+/* ------------------------------------------------------------------ */
+
+int htpasswd_cache_lookup(const char *path, const char *user,
+                          char *hash, size_t hash_len)
+{
+    return htpasswd_cache_lookup_format(path, user, hash, hash_len, NULL);
+}
+
+int htpasswd_cache_lookup_format(const char *path, const char *user,
+                                 char *hash, size_t hash_len,
+                                 pwhash_format_t *format)
+{
+    htpasswd_file_t *f;
+
+    if (!path || !user || !hash || hash_len == 0)
+        return -1;
+    f = (htpasswd_file_t *)file_cache_get(&g_files, path);
+    if (!f)
+        return -1;
+
+    g_stats.lookups++;
+    const htpasswd_user_t *u = file_find(f, user);
+    if (!u || strlen(u->hash) >= hash_len)
+        return 0;
+    strcpy(hash, u->hash);
+    if (format)
+        *format = u->format;
+    return 1;
+}
+
+int htpasswd_verified_check(const char *path, const char *user,
+                            const char *password, const char *hash,
+                            time_t now)
+{
+    uint64_t tag = verified_tag(path, user, password, hash);
+
+    if (tag) {
+        htpasswd_verified_t *set = verified_set(tag);
+        for (int w = 0; w < HTPASSWD_VERIFIED_WAYS; w++) {
+            if (set[w].tag == tag && set[w].expires > now) {
+                g_stats.verified_hits++;
+                return 1;
+            }
+        }
+    }
+    g_stats.verified_misses++;
+    return 0;
+}
+
+void htpasswd_verified_store(const char *path, const char *user,
+                             const char *password, const char *hash,
+                             time_t now)
+{
+    uint64_t tag = verified_tag(path, user, password, hash);
+    htpasswd_verified_t *set, *victim;
+
+    if (!tag)
+        return;
+    set = verified_set(tag);
+    victim = &set[0];
+    for (int w = 0; w < HTPASSWD_VERIFIED_WAYS; w++) {
+        if (set[w].tag == tag) {
+            victim = &set[w];
+            break;
+        }
+        if (set[w].expires < victim->expires)
+            victim = &set[w];
+    }
+    victim->tag = tag;
+    victim->expires = now + g_verified_ttl;
+}
+
+void htpasswd_verified_set_ttl(int seconds)
+{
+    g_verified_ttl = seconds > 0 ? seconds : 0;
+    if (!g_verified_ttl)
+        memset(g_verified, 0, sizeof(g_verified));
+}
+
+int htpasswd_cache_get_stats(htpasswd_stats_t *out)
+{
+    if (!out)
+        return -1;
+    *out = g_stats;
+    return 0;
+}
+
+void htpasswd_cache_destroy(void)
+{
+    file_cache_clear(&g_files);
+    memset(&g_stats, 0, sizeof(g_stats));
+    memset(g_verified, 0, sizeof(g_verified));
+    g_verified_ttl = HTPASSWD_VERIFIED_TTL;
+}
@@ -12,6 +12,7 @@
 #include "ls.h"
 
 #include <ctype.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
@@ -138,6 +139,17 @@ static htaccess_directive_t *alloc_directive(directive_type_t type, int line)
     return d;
 }
 
+/**
+ * Compile the value of an IP-bearing directive into its CIDR set so the
+ * request path never re-parses it. On allocation failure the directive
+ * stays uncompiled and executors fall back to matching against the value
+ * string.
+ */
+static void compile_ip_value(htaccess_directive_t *d)
+{
+    d->data.ip.compiled = cidr_set_compile(d->value, &d->data.ip.cidrs) >= 0;
+}
+
 /** Append directive to tail of list. */
 static void append_directive(htaccess_directive_t **head,
                              htaccess_directive_t **tail,
@@ -403,6 +415,7 @@ static htaccess_directive_t *parse_allow_from(const char *args, int line)
     htaccess_directive_t *d = alloc_directive(DIR_ALLOW_FROM, line);
     if (!d) { free(value); return NULL; }
     d->value = value;
+    compile_ip_value(d);
     return d;
 }
 
@@ -423,6 +436,7 @@ static htaccess_directive_t *parse_deny_from(const char *args, int line)
     htaccess_directive_t *d = alloc_directive(DIR_DENY_FROM, line);
     if (!d) { free(value); return NULL; }
     d->value = value;
+    compile_ip_value(d);
     return d;
 }
 
@@ -523,6 +537,35 @@ static htaccess_directive_t *parse_redirect_match(const char *args, int line)
     return d;
 }
 
+/**
+ * Parse: RedirectMap [status] <map-file>
+ */
+static htaccess_directive_t *parse_redirect_map(const char *args, int line)
+{
+    const char *p = skip_ws(args);
+    char *tok1 = next_token(&p);
+    if (!tok1)
+        return NULL;
+
+    int status_code = 302;
+    char *endp;
+    long code = strtol(tok1, &endp, 10);
+    if (*endp == '\0' && code >= 100 && code <= 599) {
+        status_code = (int)code;
+        free(tok1);
+        tok1 = next_token(&p);
+        if (!tok1)
+            return NULL;
+    }
+
+    htaccess_directive_t *d = alloc_directive(DIR_REDIRECT_MAP, line);
+    if (!d) { free(tok1); return NULL; }
+    d->value = tok1;
+    d->data.redirect.status_code = status_code;
+    d->data.redirect.pattern = NULL;
+    return d;
+}
+
 /**
  * Parse: ErrorDocument <code> <path|url|"message">
  */
@@ -841,6 +884,114 @@ static htaccess_directive_t *parse_brute_force_action(const char *args, int line
     return d;
 }
 
+/**
+ * Parse: BruteForceIPv4Prefix <N> | BruteForceIPv6Prefix <N>
+ * N is a prefix length in [0..max]; 0 turns aggregation off.
+ */
+static htaccess_directive_t *parse_brute_force_prefix(const char *args,
+                                                      int line,
+                                                      directive_type_t type,
+                                                      long max)
+{
+    const char *p = skip_ws(args);
+    char *val = next_token(&p);
+    if (!val)
+        return NULL;
+
+    char *endp;
+    long n = strtol(val, &endp, 10);
+    if (*endp != '\0' || n < 0 || n > max) {
+        free(val);
+        return NULL;
+    }
+    free(val);
+
+    htaccess_directive_t *d = alloc_directive(type, line);
+    if (!d)
+        return NULL;
+    d->data.brute_force.prefix_len = (int)n;
+    return d;
+}
+
+/**
+ * Parse: BruteForcePrefixAttempts <N>
+ */
+static htaccess_directive_t *parse_brute_force_prefix_attempts(
+    const char *args, int line)
+{
+    const char *p = skip_ws(args);
+    char *val = next_token(&p);
+    if (!val)
+        return NULL;
+
+    char *endp;
+    long n = strtol(val, &endp, 10);
+    if (*endp != '\0' || n <= 0) {
+        free(val);
+        return NULL;
+    }
+    free(val);
+
+    htaccess_directive_t *d = alloc_directive(DIR_BRUTE_FORCE_PREFIX_ATTEMPTS,
+                                              line);
+    if (!d)
+        return NULL;
+    d->data.brute_force.allowed_attempts = (int)n;
+    return d;
+}
+
+/**
+ * Parse: BruteForceFailureStatus <code> [<code> ...]
+ * Each code must be an HTTP status (100-599); value keeps the codes
+ * separated by single spaces.
+ */
+static htaccess_directive_t *parse_brute_force_failure_status(
+    const char *args, int line)
+{
+    const char *p = skip_ws(args);
+    char *codes = rest_of_line(&p);
+    if (!codes)
+        return NULL;
+
+    char *out = malloc(strlen(codes) + 1);
+    if (!out) {
+        free(codes);
+        return NULL;
+    }
+    size_t len = 0;
+    const char *s = codes;
+    for (;;) {
+        while (isspace((unsigned char)*s))
+            s++;
+        if (!*s)
+            break;
+        char *endp;
+        long n = strtol(s, &endp, 10);
+        if (endp == s || (*endp && !isspace((unsigned char)*endp)) ||
+            n < 100 || n > 599) {
+            free(out);
+            free(codes);
+            return NULL;
+        }
+        len += (size_t)sprintf(out + len, len ? " %ld" : "%ld", n);
+        s = endp;
+    }
+    free(codes);
+    if (len == 0) {
+        free(out);
+        return NULL;
+    }
+
+    htaccess_directive_t *d = alloc_directive(DIR_BRUTE_FORCE_FAILURE_STATUS,
+                                              line);
+    if (!d) {
+        free(out);
+        return NULL;
+    }
+    d->value = out;
+    return d;
+}
+
 /**
  * Parse: Options [+|-]Flag1 [+|-]Flag2 ...
  * Supported flags: Indexes, FollowSymLinks, MultiViews, ExecCGI
@@ -932,6 +1083,7 @@ static htaccess_directive_t *parse_brute_force_throttle(const char *args, int li
 /**
  * Parse: Require all granted | Require all denied | Require ip <cidr>
  *        Require not ip <cidr> | Require valid-user
+ *        Require user <name>... | Require group <name>...
  */
 static htaccess_directive_t *parse_require(const char *args, int line)
 {
@@ -960,6 +1112,7 @@ static htaccess_directive_t *parse_require(const char *args, int line)
             htaccess_directive_t *d = alloc_directive(DIR_REQUIRE_NOT_IP, line);
             if (!d) { free(val); return NULL; }
             d->value = val;
+            compile_ip_value(d);
             return d;
         }
         return NULL;
@@ -973,6 +1126,7 @@ static htaccess_directive_t *parse_require(const char *args, int line)
         htaccess_directive_t *d = alloc_directive(DIR_REQUIRE_IP, line);
         if (!d) { free(val); return NULL; }
         d->value = val;
+        compile_ip_value(d);
         return d;
     }
 
@@ -981,6 +1135,22 @@ static htaccess_directive_t *parse_require(const char *args, int line)
     if (after)
         return alloc_directive(DIR_REQUIRE_VALID_USER, line);
 
+    /* Require user <name>... / Require group <name>... */
+    directive_type_t list_type = DIR_REQUIRE_USER;
+    after = match_kw(p, "user");
+    if (!after) {
+        list_type = DIR_REQUIRE_GROUP;
+        after = match_kw(p, "group");
+    }
+    if (after) {
+        char *val = rest_of_line(&after);
+        if (!val) return NULL;
+        htaccess_directive_t *d = alloc_directive(list_type, line);
+        if (!d) { free(val); return NULL; }
+        d->value = val;
+        return d;
+    }
+
     return NULL;
 }
 
@@ -1047,6 +1217,11 @@ static htaccess_directive_t *parse_line(const char *line, int line_num)
     if (after)
         return parse_redirect_match(after, line_num);
 
+    /* RedirectMap */
+    after = match_kw(p, "RedirectMap");
+    if (after)
+        return parse_redirect_map(after, line_num);
+
     /* Redirect */
     after = match_kw(p, "Redirect");
     if (after)
@@ -1132,6 +1307,7 @@ static htaccess_directive_t *parse_line(const char *line, int line_num)
         htaccess_directive_t *d = alloc_directive(DIR_BRUTE_FORCE_WHITELIST, line_num);
         if (!d) { free(val); return NULL; }
         d->value = val;
+        compile_ip_value(d);
         return d;
     }
 
@@ -1146,6 +1322,28 @@ static htaccess_directive_t *parse_line(const char *line, int line_num)
         return d;
     }
 
+    /* BruteForceIPv4Prefix */
+    after = match_kw(p, "BruteForceIPv4Prefix");
+    if (after)
+        return parse_brute_force_prefix(after, line_num,
+                                        DIR_BRUTE_FORCE_IPV4_PREFIX, 32);
+
+    /* BruteForceIPv6Prefix (aggregate keys hold at most 64 network bits) */
+    after = match_kw(p, "BruteForceIPv6Prefix");
+    if (after)
+        return parse_brute_force_prefix(after, line_num,
+                                        DIR_BRUTE_FORCE_IPV6_PREFIX, 64);
+
+    /* BruteForcePrefixAttempts */
+    after = match_kw(p, "BruteForcePrefixAttempts");
+    if (after)
+        return parse_brute_force_prefix_attempts(after, line_num);
+
+    /* BruteForceFailureStatus */
+    after = match_kw(p, "BruteForceFailureStatus");
+    if (after)
+        return parse_brute_force_failure_status(after, line_num);
+
     /* Options */
     after = match_kw(p, "Options");
     if (after)
@@ -1189,6 +1387,18 @@ static htaccess_directive_t *parse_line(const char *line, int line_num)
         return d;
     }
 
+    /* AuthGroupFile */
+    after = match_kw(p, "AuthGroupFile");
+    if (after) {
+        char *val = rest_of_line(&after);
+        if (!val) return NULL;
+        htaccess_directive_t *d = alloc_directive(DIR_AUTH_GROUP_FILE,
+                                                  line_num);
+        if (!d) { free(val); return NULL; }
+        d->value = val;
+        return d;
+    }
+
     /* AddHandler handler-name ext1 ext2 ... */
     after = match_kw(p, "AddHandler");
     if (after) {
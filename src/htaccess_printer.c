@@ -196,6 +196,18 @@ static int print_directive(strbuf_t *sb, const htaccess_directive_t *d)
         if (strbuf_append(sb, d->value) != 0) return -1;
         break;
 
+    case DIR_REDIRECT_MAP:
+        if (strbuf_append(sb, "RedirectMap") != 0) return -1;
+        if (d->data.redirect.status_code != 302) {
+            snprintf(tmp, sizeof(tmp), " %d", d->data.redirect.status_code);
+            if (strbuf_append(sb, tmp) != 0) return -1;
+        }
+        if (strbuf_append(sb, " ") != 0) return -1;
+        if (d->value) {
+            if (strbuf_append(sb, d->value) != 0) return -1;
+        }
+        break;
+
     /* --- ErrorDocument --- */
     case DIR_ERROR_DOCUMENT:
         snprintf(tmp, sizeof(tmp), "ErrorDocument %d ", d->data.error_doc.error_code);
@@ -345,6 +357,20 @@ static int print_directive(strbuf_t *sb, const htaccess_directive_t *d)
         if (strbuf_append(sb, "Require valid-user") != 0) return -1;
         break;
 
+    case DIR_REQUIRE_USER:
+        if (strbuf_append(sb, "Require user ") != 0) return -1;
+        if (d->value) {
+            if (strbuf_append(sb, d->value) != 0) return -1;
+        }
+        break;
+
+    case DIR_REQUIRE_GROUP:
+        if (strbuf_append(sb, "Require group ") != 0) return -1;
+        if (d->value) {
+            if (strbuf_append(sb, d->value) != 0) return -1;
+        }
+        break;
+
     /* --- Auth directives --- */
     case DIR_AUTH_TYPE:
         if (strbuf_append(sb, "AuthType ") != 0) return -1;
@@ -368,6 +394,13 @@ static int print_directive(strbuf_t *sb, const htaccess_directive_t *d)
         }
         break;
 
+    case DIR_AUTH_GROUP_FILE:
+        if (strbuf_append(sb, "AuthGroupFile ") != 0) return -1;
+        if (d->value) {
+            if (strbuf_append(sb, d->value) != 0) return -1;
+        }
+        break;
+
     case DIR_REQUIRE_ANY_OPEN:
         if (strbuf_append(sb, "<RequireAny>\n") != 0) return -1;
         for (const htaccess_directive_t *child = d->data.require_container.children;
@@ -500,6 +533,31 @@ static int print_directive(strbuf_t *sb, const htaccess_directive_t *d)
         }
         break;
 
+    case DIR_BRUTE_FORCE_IPV4_PREFIX:
+        snprintf(tmp, sizeof(tmp), "BruteForceIPv4Prefix %d",
+                 d->data.brute_force.prefix_len);
+        if (strbuf_append(sb, tmp) != 0) return -1;
+        break;
+
+    case DIR_BRUTE_FORCE_IPV6_PREFIX:
+        snprintf(tmp, sizeof(tmp), "BruteForceIPv6Prefix %d",
+                 d->data.brute_force.prefix_len);
+        if (strbuf_append(sb, tmp) != 0) return -1;
+        break;
+
+    case DIR_BRUTE_FORCE_PREFIX_ATTEMPTS:
+        snprintf(tmp, sizeof(tmp), "BruteForcePrefixAttempts %d",
+                 d->data.brute_force.allowed_attempts);
+        if (strbuf_append(sb, tmp) != 0) return -1;
+        break;
+
+    case DIR_BRUTE_FORCE_FAILURE_STATUS:
+        if (strbuf_append(sb, "BruteForceFailureStatus ") != 0) return -1;
+        if (d->value) {
+            if (strbuf_append(sb, d->value) != 0) return -1;
+        }
+        break;
+
     /* --- Handler/Type directives --- */
     case DIR_ADD_HANDLER:
         if (strbuf_append(sb, "AddHandler ") != 0) return -1;
@@ -0,0 +1,833 @@
+/**
+ * htaccess_pwhash.c - Native htpasswd hash verifiers
+ *
+ * Carries small MD5, SHA-1, SHA-256 and SHA-512 implementations and
+ * builds the crypt-style schemes on top of them:
+ *   - MD5-crypt (PHK) for "$1$" and Apache's "$apr1$" variant, which only
+ *     differs in its magic string;
+ *   - SHA-crypt (Drepper) for "$5$" and "$6$";
+ *   - "{SHA}", base64 of the plain SHA-1 digest.
+ * A verifier recomputes the full hash string from the stored salt and
+ * parameters and compares it in constant time. All state lives on the
+ * stack, so the verifiers are reentrant.
+ *
+ * Validates: Requirements 10.4
+ */
+#include "htaccess_pwhash.h"
+
+#include <crypt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* SHA-crypt parameters (from the specification) */
+#define SHA_CRYPT_ROUNDS_DEFAULT 5000
+#define SHA_CRYPT_ROUNDS_MIN     1000
+#define SHA_CRYPT_ROUNDS_MAX     999999999UL
+#define SHA_CRYPT_SALT_MAX       16
+#define MD5_CRYPT_SALT_MAX       8
+
+/* Longest hash string any native verifier produces */
+#define PWHASH_OUT_MAX 128
+
+static const char itoa64[] =
+    "./0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+
+/* ------------------------------------------------------------------ */
+/* MD5 (RFC 1321)                                                      */
+/* ------------------------------------------------------------------ */
+
+typedef struct {
+    uint32_t h[4];
+    uint64_t len;
+    unsigned char buf[64];
+} md5_ctx_t;
+
+#define ROL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static void md5_block(md5_ctx_t *c, const unsigned char *p)
+{
+    static const uint32_t K[64] = {
+        0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf,
+        0x4787c62a, 0xa8304613, 0xfd469501, 0x698098d8, 0x8b44f7af,
+        0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e,
+        0x49b40821, 0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
+        0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8, 0x21e1cde6,
+        0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8,
+        0x676f02d9, 0x8d2a4c8a, 0xfffa3942, 0x8771f681, 0x6d9d6122,
+        0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+        0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039,
+        0xe6db99e5, 0x1fa27cf8, 0xc4ac5665, 0xf4292244, 0x432aff97,
+        0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d,
+        0x85845dd1, 0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+        0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+    };
+    uint32_t m[16], a = c->h[0], b = c->h[1], cc = c->h[2], d = c->h[3];
+    int i;
+
+    for (i = 0; i < 16; i++)
+        m[i] = (uint32_t)p[i * 4] | (uint32_t)p[i * 4 + 1] << 8 |
+               (uint32_t)p[i * 4 + 2] << 16 | (uint32_t)p[i * 4 + 3] << 24;
+
+    /* Four steps per pass, rotating the roles of a, b, c and d */
+#define MD5_STEP(F, a, b, c, d, g, r) \
+        (a = b + ROL32(a + F(b, c, d) + K[i] + m[g], r), i++)
+#define MD5_F(x, y, z) (((x) & (y)) | (~(x) & (z)))
+#define MD5_G(x, y, z) (((z) & (x)) | (~(z) & (y)))
+#define MD5_H(x, y, z) ((x) ^ (y) ^ (z))
+#define MD5_I(x, y, z) ((y) ^ ((x) | ~(z)))
+    for (i = 0; i < 16;) {
+        MD5_STEP(MD5_F, a, b, cc, d, i, 7);
+        MD5_STEP(MD5_F, d, a, b, cc, i, 12);
+        MD5_STEP(MD5_F, cc, d, a, b, i, 17);
+        MD5_STEP(MD5_F, b, cc, d, a, i, 22);
+    }
+    while (i < 32) {
+        MD5_STEP(MD5_G, a, b, cc, d, (5 * i + 1) & 15, 5);
+        MD5_STEP(MD5_G, d, a, b, cc, (5 * i + 1) & 15, 9);
+        MD5_STEP(MD5_G, cc, d, a, b, (5 * i + 1) & 15, 14);
+        MD5_STEP(MD5_G, b, cc, d, a, (5 * i + 1) & 15, 20);
+    }
+    while (i < 48) {
+        MD5_STEP(MD5_H, a, b, cc, d, (3 * i + 5) & 15, 4);
+        MD5_STEP(MD5_H, d, a, b, cc, (3 * i + 5) & 15, 11);
+        MD5_STEP(MD5_H, cc, d, a, b, (3 * i + 5) & 15, 16);
+        MD5_STEP(MD5_H, b, cc, d, a, (3 * i + 5) & 15, 23);
+    }
+    while (i < 64) {
+        MD5_STEP(MD5_I, a, b, cc, d, (7 * i) & 15, 6);
+        MD5_STEP(MD5_I, d, a, b, cc, (7 * i) & 15, 10);
+        MD5_STEP(MD5_I, cc, d, a, b, (7 * i) & 15, 15);
+        MD5_STEP(MD5_I, b, cc, d, a, (7 * i) & 15, 21);
+    }
+#undef MD5_STEP
+#undef MD5_F
+#undef MD5_G
+#undef MD5_H
+#undef MD5_I
+    c->h[0] += a;
+    c->h[1] += b;
+    c->h[2] += cc;
+    c->h[3] += d;
+}
+
+static void md5_init(md5_ctx_t *c)
+{
+    c->h[0] = 0x67452301;
+    c->h[1] = 0xefcdab89;
+    c->h[2] = 0x98badcfe;
+    c->h[3] = 0x10325476;
+    c->len = 0;
+}
+
+static void md5_update(md5_ctx_t *c, const void *data, size_t n)
+{
+    const unsigned char *p = data;
+    size_t fill = (size_t)(c->len & 63);
+
+    c->len += n;
+    if (fill) {
+        size_t take = 64 - fill < n ? 64 - fill : n;
+        memcpy(c->buf + fill, p, take);
+        p += take;
+        n -= take;
+        if (fill + take < 64)
+            return;
+        md5_block(c, c->buf);
+    }
+    for (; n >= 64; p += 64, n -= 64)
+        md5_block(c, p);
+    memcpy(c->buf, p, n);
+}
+
+static void md5_final(md5_ctx_t *c, unsigned char out[16])
+{
+    static const unsigned char pad[64] = {0x80};
+    uint64_t bits = c->len * 8;
+    unsigned char lenb[8];
+
+    for (int i = 0; i < 8; i++)
+        lenb[i] = (unsigned char)(bits >> (8 * i));
+    md5_update(c, pad, 1 + ((119 - (size_t)(c->len & 63)) & 63));
+    md5_update(c, lenb, 8);
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            out[i * 4 + j] = (unsigned char)(c->h[i] >> (8 * j));
+}
+
+/* ------------------------------------------------------------------ */
+/* SHA-1 (FIPS 180-4)                                                  */
+/* ------------------------------------------------------------------ */
+
+static void sha1(const void *data, size_t n, unsigned char out[20])
+{
+    uint32_t h[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476,
+                     0xc3d2e1f0};
+    const unsigned char *p = data;
+    unsigned char block[128];
+    size_t full = n & ~(size_t)63, rest = n - full, tail;
+    uint64_t bits = (uint64_t)n * 8;
+
+    /* Padded tail: one or two blocks */
+    memset(block, 0, sizeof(block));
+    memcpy(block, p + full, rest);
+    block[rest] = 0x80;
+    tail = rest < 56 ? 64 : 128;
+    for (int i = 0; i < 8; i++)
+        block[tail - 1 - i] = (unsigned char)(bits >> (8 * i));
+
+    for (size_t off = 0; off < full + tail; off += 64) {
+        const unsigned char *b = off < full ? p + off : block + (off - full);
+        uint32_t w[80], a = h[0], bb = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 16; i++)
+            w[i] = (uint32_t)b[i * 4] << 24 | (uint32_t)b[i * 4 + 1] << 16 |
+                   (uint32_t)b[i * 4 + 2] << 8 | (uint32_t)b[i * 4 + 3];
+        for (int i = 16; i < 80; i++)
+            w[i] = ROL32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (bb & c) | (~bb & d);
+                k = 0x5a827999;
+            } else if (i < 40) {
+                f = bb ^ c ^ d;
+                k = 0x6ed9eba1;
+            } else if (i < 60) {
+                f = (bb & c) | (bb & d) | (c & d);
+                k = 0x8f1bbcdc;
+            } else {
+                f = bb ^ c ^ d;
+                k = 0xca62c1d6;
+            }
+            uint32_t t = ROL32(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = ROL32(bb, 30);
+            bb = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += bb;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+    for (int i = 0; i < 5; i++)
+        for (int j = 0; j < 4; j++)
+            out[i * 4 + j] = (unsigned char)(h[i] >> (24 - 8 * j));
+}
+
+/* ------------------------------------------------------------------ */
+/* SHA-256 and SHA-512 (FIPS 180-4)                                    */
+/* ------------------------------------------------------------------ */
+
+typedef struct {
+    uint32_t h[8];
+    uint64_t len;
+    unsigned char buf[64];
+} sha256_ctx_t;
+
+typedef struct {
+    uint64_t h[8];
+    uint64_t len;
+    unsigned char buf[128];
+} sha512_ctx_t;
+
+#define ROR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define ROR64(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
+
+static void sha256_block(sha256_ctx_t *c, const unsigned char *p)
+{
+    static const uint32_t K[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b,
+        0x59f111f1, 0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01,
+        0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7,
+        0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+        0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152,
+        0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+        0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc,
+        0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819,
+        0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116, 0x1e376c08,
+        0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f,
+        0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+        0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+    };
+    uint32_t w[64];
+
+    for (int i = 0; i < 16; i++)
+        w[i] = (uint32_t)p[i * 4] << 24 | (uint32_t)p[i * 4 + 1] << 16 |
+               (uint32_t)p[i * 4 + 2] << 8 | (uint32_t)p[i * 4 + 3];
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROR32(w[i - 15], 7) ^ ROR32(w[i - 15], 18) ^
+                      (w[i - 15] >> 3);
+        uint32_t s1 = ROR32(w[i - 2], 17) ^ ROR32(w[i - 2], 19) ^
+                      (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = c->h[0], b = c->h[1], cc = c->h[2], d = c->h[3];
+    uint32_t e = c->h[4], f = c->h[5], g = c->h[6], h = c->h[7];
+
+    /* Eight rounds per pass, rotating the roles instead of the values */
+#define SHA256_ROUND(a, b, c, d, e, f, g, h, j) do { \
+        uint32_t t1 = h + (ROR32(e, 6) ^ ROR32(e, 11) ^ ROR32(e, 25)) + \
+                      ((e & f) ^ (~e & g)) + K[i + j] + w[i + j]; \
+        d += t1; \
+        h = t1 + (ROR32(a, 2) ^ ROR32(a, 13) ^ ROR32(a, 22)) + \
+            ((a & b) ^ (a & c) ^ (b & c)); \
+    } while (0)
+    for (int i = 0; i < 64; i += 8) {
+        SHA256_ROUND(a, b, cc, d, e, f, g, h, 0);
+        SHA256_ROUND(h, a, b, cc, d, e, f, g, 1);
+        SHA256_ROUND(g, h, a, b, cc, d, e, f, 2);
+        SHA256_ROUND(f, g, h, a, b, cc, d, e, 3);
+        SHA256_ROUND(e, f, g, h, a, b, cc, d, 4);
+        SHA256_ROUND(d, e, f, g, h, a, b, cc, 5);
+        SHA256_ROUND(cc, d, e, f, g, h, a, b, 6);
+        SHA256_ROUND(b, cc, d, e, f, g, h, a, 7);
+    }
+#undef SHA256_ROUND
+    c->h[0] += a;
+    c->h[1] += b;
+    c->h[2] += cc;
+    c->h[3] += d;
+    c->h[4] += e;
+    c->h[5] += f;
+    c->h[6] += g;
+    c->h[7] += h;
+}
+
+static void sha512_block(sha512_ctx_t *c, const unsigned char *p)
+{
+    static const uint64_t K[80] = {
+        0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL,
+        0xe9b5dba58189dbbcULL, 0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+        0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL, 0xd807aa98a3030242ULL,
+        0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+        0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL,
+        0xc19bf174cf692694ULL, 0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+        0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL, 0x2de92c6f592b0275ULL,
+        0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+        0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL,
+        0xbf597fc7beef0ee4ULL, 0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+        0x06ca6351e003826fULL, 0x142929670a0e6e70ULL, 0x27b70a8546d22ffcULL,
+        0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+        0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL,
+        0x92722c851482353bULL, 0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+        0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL, 0xd192e819d6ef5218ULL,
+        0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+        0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL,
+        0x34b0bcb5e19b48a8ULL, 0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+        0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL, 0x748f82ee5defb2fcULL,
+        0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+        0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL,
+        0xc67178f2e372532bULL, 0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+        0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL, 0x06f067aa72176fbaULL,
+        0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+        0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL,
+        0x431d67c49c100d4cULL, 0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+        0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL,
+    };
+    uint64_t w[80];
+
+    for (int i = 0; i < 16; i++) {
+        w[i] = 0;
+        for (int j = 0; j < 8; j++)
+            w[i] = w[i] << 8 | p[i * 8 + j];
+    }
+    for (int i = 16; i < 80; i++) {
+        uint64_t s0 = ROR64(w[i - 15], 1) ^ ROR64(w[i - 15], 8) ^
+                      (w[i - 15] >> 7);
+        uint64_t s1 = ROR64(w[i - 2], 19) ^ ROR64(w[i - 2], 61) ^
+                      (w[i - 2] >> 6);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint64_t a = c->h[0], b = c->h[1], cc = c->h[2], d = c->h[3];
+    uint64_t e = c->h[4], f = c->h[5], g = c->h[6], h = c->h[7];
+
+#define SHA512_ROUND(a, b, c, d, e, f, g, h, j) do { \
+        uint64_t t1 = h + (ROR64(e, 14) ^ ROR64(e, 18) ^ ROR64(e, 41)) + \
+                      ((e & f) ^ (~e & g)) + K[i + j] + w[i + j]; \
+        d += t1; \
+        h = t1 + (ROR64(a, 28) ^ ROR64(a, 34) ^ ROR64(a, 39)) + \
+            ((a & b) ^ (a & c) ^ (b & c)); \
+    } while (0)
+    for (int i = 0; i < 80; i += 8) {
+        SHA512_ROUND(a, b, cc, d, e, f, g, h, 0);
+        SHA512_ROUND(h, a, b, cc, d, e, f, g, 1);
+        SHA512_ROUND(g, h, a, b, cc, d, e, f, 2);
+        SHA512_ROUND(f, g, h, a, b, cc, d, e, 3);
+        SHA512_ROUND(e, f, g, h, a, b, cc, d, 4);
+        SHA512_ROUND(d, e, f, g, h, a, b, cc, 5);
+        SHA512_ROUND(cc, d, e, f, g, h, a, b, 6);
+        SHA512_ROUND(b, cc, d, e, f, g, h, a, 7);
+    }
+#undef SHA512_ROUND
+    c->h[0] += a;
+    c->h[1] += b;
+    c->h[2] += cc;
+    c->h[3] += d;
+    c->h[4] += e;
+    c->h[5] += f;
+    c->h[6] += g;
+    c->h[7] += h;
+}
+
+static void sha256_init(sha256_ctx_t *c)
+{
+    static const uint32_t iv[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(c->h, iv, sizeof(iv));
+    c->len = 0;
+}
+
+static void sha512_init(sha512_ctx_t *c)
+{
+    static const uint64_t iv[8] = {
+        0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL,
+        0xa54ff53a5f1d36f1ULL, 0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+        0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL,
+    };
+    memcpy(c->h, iv, sizeof(iv));
+    c->len = 0;
+}
+
+static void sha256_update(sha256_ctx_t *c, const void *data, size_t n)
+{
+    const unsigned char *p = data;
+    size_t fill = (size_t)(c->len & 63);
+
+    c->len += n;
+    if (fill) {
+        size_t take = 64 - fill < n ? 64 - fill : n;
+        memcpy(c->buf + fill, p, take);
+        p += take;
+        n -= take;
+        if (fill + take < 64)
+            return;
+        sha256_block(c, c->buf);
+    }
+    for (; n >= 64; p += 64, n -= 64)
+        sha256_block(c, p);
+    memcpy(c->buf, p, n);
+}
+
+static void sha512_update(sha512_ctx_t *c, const void *data, size_t n)
+{
+    const unsigned char *p = data;
+    size_t fill = (size_t)(c->len & 127);
+
+    c->len += n;
+    if (fill) {
+        size_t take = 128 - fill < n ? 128 - fill : n;
+        memcpy(c->buf + fill, p, take);
+        p += take;
+        n -= take;
+        if (fill + take < 128)
+            return;
+        sha512_block(c, c->buf);
+    }
+    for (; n >= 128; p += 128, n -= 128)
+        sha512_block(c, p);
+    memcpy(c->buf, p, n);
+}
+
+static void sha256_final(sha256_ctx_t *c, unsigned char *out)
+{
+    static const unsigned char pad[64] = {0x80};
+    uint64_t bits = c->len * 8;
+    unsigned char lenb[8];
+
+    for (int i = 0; i < 8; i++)
+        lenb[i] = (unsigned char)(bits >> (56 - 8 * i));
+    sha256_update(c, pad, 1 + ((119 - (size_t)(c->len & 63)) & 63));
+    sha256_update(c, lenb, 8);
+    for (int i = 0; i < 8; i++)
+        for (int j = 0; j < 4; j++)
+            out[i * 4 + j] = (unsigned char)(c->h[i] >> (24 - 8 * j));
+}
+
+static void sha512_final(sha512_ctx_t *c, unsigned char *out)
+{
+    static const unsigned char pad[128] = {0x80};
+    uint64_t bits = c->len * 8;
+    unsigned char lenb[16] = {0};
+
+    /* Messages here are far below 2^64 bits: the high half stays 0 */
+    for (int i = 0; i < 8; i++)
+        lenb[8 + i] = (unsigned char)(bits >> (56 - 8 * i));
+    sha512_update(c, pad, 1 + ((239 - (size_t)(c->len & 127)) & 127));
+    sha512_update(c, lenb, 16);
+    for (int i = 0; i < 8; i++)
+        for (int j = 0; j < 8; j++)
+            out[i * 8 + j] = (unsigned char)(c->h[i] >> (56 - 8 * j));
+}
+
+/* ------------------------------------------------------------------ */
+/* Helpers                                                             */
+/* ------------------------------------------------------------------ */
+
+/* Append `n` crypt-base64 characters of `v`, low bits first. */
+static char *to64(char *out, uint32_t v, int n)
+{
+    while (n-- > 0) {
+        *out++ = itoa64[v & 0x3f];
+        v >>= 6;
+    }
+    return out;
+}
+
+/* Compare two strings without an early exit on the first difference. */
+static int ct_streq(const char *a, const char *b)
+{
+    size_t la = strlen(a), lb = strlen(b);
+    unsigned char diff = (unsigned char)(la != lb);
+
+    for (size_t i = 0; i < la && i < lb; i++)
+        diff |= (unsigned char)(a[i] ^ b[i]);
+    return diff == 0;
+}
+
+/* Length of the salt at `s`: up to `max` bytes, ending at '$' or NUL. */
+static size_t salt_len(const char *s, size_t max)
+{
+    size_t n = 0;
+    while (n < max && s[n] && s[n] != '$')
+        n++;
+    return n;
+}
+
+/* ------------------------------------------------------------------ */
+/* MD5-crypt ($1$, $apr1$)                                             */
+/* ------------------------------------------------------------------ */
+
+static int md5_crypt(const char *pw, const char *hash, const char *magic,
+                     char *out)
+{
+    size_t ml = strlen(magic), pl = strlen(pw), sl;
+    const char *salt = hash + ml;
+    unsigned char f[16];
+    md5_ctx_t ctx, alt;
+    char *o;
+
+    sl = salt_len(salt, MD5_CRYPT_SALT_MAX);
+
+    md5_init(&ctx);
+    md5_update(&ctx, pw, pl);
+    md5_update(&ctx, magic, ml);
+    md5_update(&ctx, salt, sl);
+
+    md5_init(&alt);
+    md5_update(&alt, pw, pl);
+    md5_update(&alt, salt, sl);
+    md5_update(&alt, pw, pl);
+    md5_final(&alt, f);
+    for (size_t n = pl; n > 0; n -= n > 16 ? 16 : n)
+        md5_update(&ctx, f, n > 16 ? 16 : n);
+    memset(f, 0, sizeof(f));
+    for (size_t i = pl; i; i >>= 1)
+        md5_update(&ctx, (i & 1) ? (const void *)f : (const void *)pw, 1);
+    md5_final(&ctx, f);
+
+    for (int i = 0; i < 1000; i++) {
+        md5_init(&ctx);
+        if (i & 1)
+            md5_update(&ctx, pw, pl);
+        else
+            md5_update(&ctx, f, 16);
+        if (i % 3)
+            md5_update(&ctx, salt, sl);
+        if (i % 7)
+            md5_update(&ctx, pw, pl);
+        if (i & 1)
+            md5_update(&ctx, f, 16);
+        else
+            md5_update(&ctx, pw, pl);
+        md5_final(&ctx, f);
+    }
+
+    o = out + sprintf(out, "%s%.*s$", magic, (int)sl, salt);
+    o = to64(o, (uint32_t)f[0] << 16 | (uint32_t)f[6] << 8 | f[12], 4);
+    o = to64(o, (uint32_t)f[1] << 16 | (uint32_t)f[7] << 8 | f[13], 4);
+    o = to64(o, (uint32_t)f[2] << 16 | (uint32_t)f[8] << 8 | f[14], 4);
+    o = to64(o, (uint32_t)f[3] << 16 | (uint32_t)f[9] << 8 | f[15], 4);
+    o = to64(o, (uint32_t)f[4] << 16 | (uint32_t)f[10] << 8 | f[5], 4);
+    o = to64(o, f[11], 2);
+    *o = '\0';
+    return 0;
+}
+
+/* ------------------------------------------------------------------ */
+/* SHA-crypt ($5$, $6$)                                                */
+/* ------------------------------------------------------------------ */
+
+/* One digest context of either size */
+typedef struct {
+    int wide;              /* 1 for SHA-512 */
+    sha256_ctx_t c256;
+    sha512_ctx_t c512;
+} sha_ctx_t;
+
+static void sha_init(sha_ctx_t *c, int wide)
+{
+    c->wide = wide;
+    if (wide)
+        sha512_init(&c->c512);
+    else
+        sha256_init(&c->c256);
+}
+
+static void sha_update(sha_ctx_t *c, const void *p, size_t n)
+{
+    if (c->wide)
+        sha512_update(&c->c512, p, n);
+    else
+        sha256_update(&c->c256, p, n);
+}
+
+static void sha_final(sha_ctx_t *c, unsigned char *out)
+{
+    if (c->wide)
+        sha512_final(&c->c512, out);
+    else
+        sha256_final(&c->c256, out);
+}
+
+/* Byte order of the final encoding, three bytes per group */
+static const unsigned char sha256_order[] = {
+    0, 10, 20, 21, 1, 11, 12, 22, 2, 3, 13, 23, 24, 4, 14,
+    15, 25, 5, 6, 16, 26, 27, 7, 17, 18, 28, 8, 9, 19, 29,
+};
+static const unsigned char sha512_order[] = {
+    0, 21, 42, 22, 43, 1, 44, 2, 23, 3, 24, 45, 25, 46, 4,
+    47, 5, 26, 6, 27, 48, 28, 49, 7, 50, 8, 29, 9, 30, 51,
+    31, 52, 10, 53, 11, 32, 12, 33, 54, 34, 55, 13, 56, 14, 35,
+    15, 36, 57, 37, 58, 16, 59, 17, 38, 18, 39, 60, 40, 61, 19,
+    62, 20, 41,
+};
+
+static int sha_crypt(const char *pw, const char *hash, int wide, char *out)
+{
+    const char *magic = wide ? "$6$" : "$5$";
+    const char *p = hash + 3, *salt;
+    size_t hl = wide ? 64 : 32, pl = strlen(pw), sl;
+    unsigned long rounds = SHA_CRYPT_ROUNDS_DEFAULT;
+    int custom = 0;
+    unsigned char a[64], dp[64], ds[64];
+    unsigned char *P, *S;
+    sha_ctx_t ctx, alt;
+    size_t n;
+    char *o;
+
+    if (strncmp(p, "rounds=", 7) == 0) {
+        char *end;
+        rounds = strtoul(p + 7, &end, 10);
+        /* Out of range: rejected like libxcrypt does, not clamped */
+        if (end == p + 7 || *end != '$' || p[7] < '0' || p[7] > '9' ||
+            rounds < SHA_CRYPT_ROUNDS_MIN || rounds > SHA_CRYPT_ROUNDS_MAX)
+            return -1;
+        custom = 1;
+        p = end + 1;
+    }
+    salt = p;
+    sl = salt_len(salt, SHA_CRYPT_SALT_MAX);
+
+    /* B: digest of password, salt, password */
+    sha_init(&alt, wide);
+    sha_update(&alt, pw, pl);
+    sha_update(&alt, salt, sl);
+    sha_update(&alt, pw, pl);
+    sha_final(&alt, a);
+
+    /* A */
+    sha_init(&ctx, wide);
+    sha_update(&ctx, pw, pl);
+    sha_update(&ctx, salt, sl);
+    for (n = pl; n > hl; n -= hl)
+        sha_update(&ctx, a, hl);
+    sha_update(&ctx, a, n);
+    for (n = pl; n > 0; n >>= 1) {
+        if (n & 1)
+            sha_update(&ctx, a, hl);
+        else
+            sha_update(&ctx, pw, pl);
+    }
+    sha_final(&ctx, a);
+
+    /* P and S sequences */
+    sha_init(&ctx, wide);
+    for (n = 0; n < pl; n++)
+        sha_update(&ctx, pw, pl);
+    sha_final(&ctx, dp);
+    sha_init(&ctx, wide);
+    for (n = 0; n < 16 + (size_t)a[0]; n++)
+        sha_update(&ctx, salt, sl);
+    sha_final(&ctx, ds);
+
+    P = malloc(pl + 1);
+    S = malloc(sl + 1);
+    if (!P || !S) {
+        free(P);
+        free(S);
+        return -1;
+    }
+    for (n = 0; n < pl; n++)
+        P[n] = dp[n % hl];
+    for (n = 0; n < sl; n++)
+        S[n] = ds[n % hl];
+
+    for (unsigned long r = 0; r < rounds; r++) {
+        sha_init(&ctx, wide);
+        if (r & 1)
+            sha_update(&ctx, P, pl);
+        else
+            sha_update(&ctx, a, hl);
+        if (r % 3)
+            sha_update(&ctx, S, sl);
+        if (r % 7)
+            sha_update(&ctx, P, pl);
+        if (r & 1)
+            sha_update(&ctx, a, hl);
+        else
+            sha_update(&ctx, P, pl);
+        sha_final(&ctx, a);
+    }
+    explicit_bzero(P, pl);
+    free(P);
+    free(S);
+
+    o = out + sprintf(out, "%s", magic);
+    if (custom)
+        o += sprintf(o, "rounds=%lu$", rounds);
+    o += sprintf(o, "%.*s$", (int)sl, salt);
+    if (wide) {
+        for (size_t i = 0; i < sizeof(sha512_order); i += 3)
+            o = to64(o, (uint32_t)a[sha512_order[i]] << 16 |
+                        (uint32_t)a[sha512_order[i + 1]] << 8 |
+                        a[sha512_order[i + 2]], 4);
+        o = to64(o, a[63], 2);
+    } else {
+        for (size_t i = 0; i < sizeof(sha256_order); i += 3)
+            o = to64(o, (uint32_t)a[sha256_order[i]] << 16 |
+                        (uint32_t)a[sha256_order[i + 1]] << 8 |
+                        a[sha256_order[i + 2]], 4);
+        o = to64(o, (uint32_t)a[31] << 8 | a[30], 3);
+    }
+    *o = '\0';
+    return 0;
+}
+
+/* ------------------------------------------------------------------ */
+/* {SHA}                                                               */
+/* ------------------------------------------------------------------ */
+
+static int sha1_verify(const char *hash, const char *pw)
+{
+    static const char b64[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    unsigned char d[21];
+    char out[29], *o = out;
+
+    sha1(pw, strlen(pw), d);
+    d[20] = 0;
+    for (int i = 0; i < 21; i += 3) {
+        uint32_t v = (uint32_t)d[i] << 16 | (uint32_t)d[i + 1] << 8 |
+                     (i + 2 < 21 ? d[i + 2] : 0);
+        *o++ = b64[(v >> 18) & 63];
+        *o++ = b64[(v >> 12) & 63];
+        *o++ = b64[(v >> 6) & 63];
+        *o++ = b64[v & 63];
+    }
+    out[27] = '=';   /* 20 bytes: one pad character */
+    out[28] = '\0';
+    return ct_streq(out, hash + 5);
+}
+
+/* ------------------------------------------------------------------ */
+/* Public API                                                          */
+/* ------------------------------------------------------------------ */
+
+pwhash_format_t pwhash_detect(const char *hash)
+{
+    if (!hash)
+        return PWHASH_CRYPT;
+    if (strncmp(hash, "$apr1$", 6) == 0)
+        return PWHASH_APR1;
+    if (strncmp(hash, "$1$", 3) == 0)
+        return PWHASH_MD5_CRYPT;
+    if (strncmp(hash, "{SHA}", 5) == 0)
+        return PWHASH_SHA1;
+    if (strncmp(hash, "$5$", 3) == 0)
+        return PWHASH_SHA256_CRYPT;
+    if (strncmp(hash, "$6$", 3) == 0)
+        return PWHASH_SHA512_CRYPT;
+    return PWHASH_CRYPT;
+}
+
+const char *pwhash_format_name(pwhash_format_t format)
+{
+    switch (format) {
+    case PWHASH_APR1:         return "apr1";
+    case PWHASH_MD5_CRYPT:    return "md5-crypt";
+    case PWHASH_SHA1:         return "sha1";
+    case PWHASH_SHA256_CRYPT: return "sha256-crypt";
+    case PWHASH_SHA512_CRYPT: return "sha512-crypt";
+    default:                  return "crypt";
+    }
+}
+
+int pwhash_is_fast(pwhash_format_t format)
+{
+    return format == PWHASH_APR1 || format == PWHASH_MD5_CRYPT ||
+           format == PWHASH_SHA1;
+}
+
+int pwhash_verify(pwhash_format_t format, const char *hash,
+                  const char *password)
+{
+    char out[PWHASH_OUT_MAX];
+    int rc;
+
+    if (!hash || !password)
+        return -1;
+
+    switch (format) {
+    case PWHASH_APR1:
+        rc = md5_crypt(password, hash, "$apr1$", out);
+        break;
+    case PWHASH_MD5_CRYPT:
+        rc = md5_crypt(password, hash, "$1$", out);
+        break;
+    case PWHASH_SHA1:
+        return sha1_verify(hash, password);
+    case PWHASH_SHA256_CRYPT:
+    case PWHASH_SHA512_CRYPT:
+        rc = sha_crypt(password, hash, format == PWHASH_SHA512_CRYPT, out);
+        break;
+    default: {
+        /* libc fallback; crypt_data is large, keep it off the stack */
+        struct crypt_data *data = calloc(1, sizeof(*data));
+        const char *res;
+        if (!data)
+            return -1;
+        res = crypt_r(password, hash, data);
+        rc = res && res[0] != '*' ? ct_streq(res, hash) : -1;
+        explicit_bzero(data, sizeof(*data));
+        free(data);
+        return rc;
+    }
+    }
+    if (rc != 0)
+        return -1;
+    rc = ct_streq(out, hash);
+    explicit_bzero(out, sizeof(out));
+    return rc;
+}
+
+int pwhash_check(const char *hash, const char *password)
+{
+    return pwhash_verify(pwhash_detect(hash), hash, password);
+}
@@ -0,0 +1,754 @@
+/**
+ * htaccess_redirect_map.c - Compiled RedirectMap files
+ *
+ * Compiled file layout (host byte order, every section 8-byte aligned):
+ *
+ *   rmap_header_t
+ *   rmap_slot_t   slots[num_slots]     open addressing, linear probing
+ *   rmap_entry_t  entries[num_entries] in map file order
+ *   char          strings[]            keys and targets, not terminated
+ *
+ * A slot holds the upper half of the key's FNV-1a hash and the entry
+ * index + 1 (0 = empty); the table is at most half full. The header and
+ * every entry are validated once when a file is loaded, so lookups only
+ * bound-check the slot's entry index. Maps are cached by path in the
+ * shared file cache (htaccess_file_cache.c), like AuthGroupFile files.
+ *
+ * A large map whose text changed is rebuilt by a task on the runner's
+ * thread, which only reads the text and writes the compiled file. The
+ * build record it fills is owned by the event loop again once the
+ * completion callback has run, so no lock is needed: the stale copy is
+ * dropped when its compiled file changes or its build record is done.
+ *
+ * Validates: Requirements 7.1, 7.3
+ */
+#include "htaccess_redirect_map.h"
+#include "htaccess_file_cache.h"
+#include "htaccess_fileio.h"
+#include "htaccess_hash.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define RMAP_MAGIC   "OLSRMAP"
+#define RMAP_VERSION 1
+
+typedef struct {
+    char     magic[8];      /* RMAP_MAGIC, NUL-padded */
+    uint32_t version;
+    uint32_t num_slots;     /* Power of two */
+    uint64_t num_entries;
+    uint64_t src_size;      /* Identity of the map text compiled */
+    int64_t  src_mtime_sec;
+    int64_t  src_mtime_nsec;
+    uint64_t src_dev;
+    uint64_t src_ino;
+    uint64_t strings_len;
+} rmap_header_t;
+
+typedef struct {
+    uint32_t hash;          /* Upper 32 bits of the key hash */
+    uint32_t entry;         /* Entry index + 1, 0 = empty */
+} rmap_slot_t;
+
+typedef struct {
+    uint32_t key_off;       /* Offsets into the string section */
+    uint32_t key_len;
+    uint32_t target_off;
+    uint32_t target_len;
+} rmap_entry_t;
+
+/** One cached map. */
+typedef struct {
+    file_cache_entry_t entry;       /* First: keyed by map text path */
+    void *base;                     /* Compiled image */
+    size_t len;
+    int mapped;                     /* 1: mmap()ed file, 0: heap image */
+    int stale;                      /* Image of older text than `mtime` */
+    char *dst;                      /* Compiled file path */
+    struct timespec c_mtime;        /* Identity of the compiled file */
+    off_t c_size;
+    ino_t c_ino;
+    const rmap_header_t *hdr;
+    const rmap_slot_t *slots;
+    const rmap_entry_t *entries;
+    const char *strings;
+} redirect_map_t;
+
+enum { BUILD_RUNNING, BUILD_DONE, BUILD_FAILED };
+
+/** A compile of a large map run by the runner. */
+typedef struct map_build {
+    char *path;                     /* Map text */
+    char *dst;                      /* Compiled file to replace */
+    file_ident_t want;              /* Text that asked for the build */
+    struct stat st;                 /* Text compiled (set by the task) */
+    void *img;                      /* Image that could not be written */
+    size_t len;
+    int state;                      /* BUILD_* */
+    int orphan;                     /* Cache destroyed while running */
+    struct map_build *next;
+} map_build_t;
+
+static redirect_map_stats_t g_stats;
+static redirect_map_runner_t g_runner;
+static map_build_t *g_builds;
+
+/* ------------------------------------------------------------------ */
+/*  Compilation                                                        */
+/* ------------------------------------------------------------------ */
+
+typedef struct {
+    const char *key;
+    size_t      key_len;
+    const char *target;
+    size_t      target_len;
+} map_line_t;
+
+static int is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/* Split the text into "<key> <target>" pairs; returns the pair count */
+static size_t parse_lines(const char *text, size_t len, map_line_t *out)
+{
+    const char *p = text, *end = text + len;
+    size_t n = 0;
+
+    while (p < end) {
+        const char *eol = memchr(p, '\n', (size_t)(end - p));
+        const char *next = eol ? eol + 1 : end;
+        const char *k, *t;
+
+        if (!eol)
+            eol = end;
+        while (p < eol && is_blank(*p))
+            p++;
+        if (p < eol && *p != '#') {
+            k = p;
+            while (p < eol && !is_blank(*p))
+                p++;
+            out[n].key = k;
+            out[n].key_len = (size_t)(p - k);
+            while (p < eol && is_blank(*p))
+                p++;
+            t = p;
+            while (p < eol && !is_blank(*p))
+                p++;
+            out[n].target = t;
+            out[n].target_len = (size_t)(p - t);
+            if (out[n].target_len > 0)
+                n++;
+        }
+        p = next;
+    }
+    return n;
+}
+
+static size_t align8(size_t n)
+{
+    return (n + 7) & ~(size_t)7;
+}
+
+/*
+ * Build the compiled image of `text` in one heap buffer. `st` identifies
+ * the text and is recorded in the header.
+ */
+static void *build_image(const char *text, size_t len, const struct stat *st,
+                         size_t *image_len)
+{
+    size_t lines = 1, n, kept = 0, strings = 0, slots = 8, total;
+    map_line_t *pairs;
+    uint32_t *order;    /* Indices of the kept pairs */
+    unsigned char *img;
+
+    for (size_t i = 0; i < len; i++)
+        if (text[i] == '\n')
+            lines++;
+    pairs = malloc(lines * sizeof(*pairs));
+    order = malloc(lines * sizeof(*order));
+    if (!pairs || !order) {
+        free(pairs);
+        free(order);
+        return NULL;
+    }
+    n = parse_lines(text, len, pairs);
+    while (slots < n * 2)
+        slots <<= 1;
+
+    total = sizeof(rmap_header_t) + slots * sizeof(rmap_slot_t) +
+            n * sizeof(rmap_entry_t) + align8(len);
+    img = calloc(1, total);
+    if (!img || slots > UINT32_MAX) {
+        free(img);
+        free(pairs);
+        free(order);
+        return NULL;
+    }
+
+    rmap_header_t *hdr = (rmap_header_t *)img;
+    rmap_slot_t *slot = (rmap_slot_t *)(img + sizeof(*hdr));
+    rmap_entry_t *entry = (rmap_entry_t *)(slot + slots);
+    char *str = (char *)(entry + n);
+
+    /* Insert in file order; a key already present keeps its first line */
+    for (size_t i = 0; i < n; i++) {
+        uint64_t h = hash_fnv1a(pairs[i].key, pairs[i].key_len);
+        size_t s = (size_t)h & (slots - 1);
+        int dup = 0;
+
+        for (; slot[s].entry; s = (s + 1) & (slots - 1)) {
+            const map_line_t *o = &pairs[order[slot[s].entry - 1]];
+            if (slot[s].hash == (uint32_t)(h >> 32) &&
+                o->key_len == pairs[i].key_len &&
+                memcmp(o->key, pairs[i].key, o->key_len) == 0) {
+                dup = 1;
+                break;
+            }
+        }
+        if (dup)
+            continue;
+        order[kept] = (uint32_t)i;
+        slot[s].hash = (uint32_t)(h >> 32);
+        slot[s].entry = (uint32_t)++kept;
+
+        entry[kept - 1].key_off = (uint32_t)strings;
+        entry[kept - 1].key_len = (uint32_t)pairs[i].key_len;
+        memcpy(str + strings, pairs[i].key, pairs[i].key_len);
+        strings += pairs[i].key_len;
+        entry[kept - 1].target_off = (uint32_t)strings;
+        entry[kept - 1].target_len = (uint32_t)pairs[i].target_len;
+        memcpy(str + strings, pairs[i].target, pairs[i].target_len);
+        strings += pairs[i].target_len;
+    }
+    free(pairs);
+    free(order);
+
+    /* Duplicates leave unused entries; move the strings down over them */
+    if (kept < n) {
+        char *moved = (char *)(entry + kept);
+        memmove(moved, str, strings);
+        memset(moved + strings, 0, align8(strings) - strings);
+    }
+
+    memcpy(hdr->magic, RMAP_MAGIC, sizeof(RMAP_MAGIC));
+    hdr->version = RMAP_VERSION;
+    hdr->num_slots = (uint32_t)slots;
+    hdr->num_entries = kept;
+    hdr->src_size = (uint64_t)st->st_size;
+    hdr->src_mtime_sec = (int64_t)st->st_mtim.tv_sec;
+    hdr->src_mtime_nsec = (int64_t)st->st_mtim.tv_nsec;
+    hdr->src_dev = (uint64_t)st->st_dev;
+    hdr->src_ino = (uint64_t)st->st_ino;
+    hdr->strings_len = strings;
+
+    *image_len = sizeof(*hdr) + slots * sizeof(rmap_slot_t) +
+                 kept * sizeof(rmap_entry_t) + align8(strings);
+    return img;
+}
+
+/* Read and compile the map text at `src`; `st` receives its identity */
+static void *compile_text(const char *src, struct stat *st,
+                          size_t *image_len)
+{
+    char *text = fileio_read_file(src, st);
+    void *img = NULL;
+
+    if (text)
+        img = build_image(text, (size_t)st->st_size, st, image_len);
+    free(text);
+    return img;
+}
+
+/* Write `img` to `dst` through a temporary file and rename() */
+static int write_image(const char *dst, const void *img, size_t len)
+{
+    size_t dst_len = strlen(dst);
+    char *tmp = malloc(dst_len + 8);
+    int fd, rc = -1;
+
+    if (!tmp)
+        return -1;
+    memcpy(tmp, dst, dst_len);
+    memcpy(tmp + dst_len, ".XXXXXX", 8);
+    fd = mkstemp(tmp);
+    if (fd >= 0) {
+        if (fchmod(fd, 0644) == 0 && fileio_write_all(fd, img, len) == 0 &&
+            close(fd) == 0) {
+            fd = -1;
+            rc = rename(tmp, dst);
+        }
+        if (fd >= 0)
+            close(fd);
+        if (rc != 0)
+            unlink(tmp);
+    }
+    free(tmp);
+    return rc;
+}
+
+long redirect_map_compile(const char *src, const char *dst)
+{
+    struct stat st;
+    size_t len;
+    void *img;
+    long entries;
+
+    if (!src || !dst)
+        return -1;
+    img = compile_text(src, &st, &len);
+    if (!img)
+        return -1;
+    entries = (long)((const rmap_header_t *)img)->num_entries;
+    if (write_image(dst, img, len) != 0)
+        entries = -1;
+    free(img);
+    return entries;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Cached maps                                                        */
+/* ------------------------------------------------------------------ */
+
+/* 1 if the compiled header was built from the text behind `st` */
+static int header_matches(const rmap_header_t *h, const struct stat *st)
+{
+    return h->src_size == (uint64_t)st->st_size &&
+           h->src_mtime_sec == (int64_t)st->st_mtim.tv_sec &&
+           h->src_mtime_nsec == (int64_t)st->st_mtim.tv_nsec &&
+           h->src_dev == (uint64_t)st->st_dev &&
+           h->src_ino == (uint64_t)st->st_ino;
+}
+
+/*
+ * Point `m`'s section pointers into `base` after checking that the image
+ * is well formed and, unless `st` is NULL, describes the text behind it.
+ */
+static int attach_image(redirect_map_t *m, void *base, size_t len,
+                        const struct stat *st)
+{
+    const rmap_header_t *h = base;
+    size_t slots_bytes, entries_bytes;
+
+    if (len < sizeof(*h) || memcmp(h->magic, RMAP_MAGIC,
+                                   sizeof(RMAP_MAGIC)) != 0 ||
+        h->version != RMAP_VERSION || (st && !header_matches(h, st)) ||
+        h->num_slots == 0 || (h->num_slots & (h->num_slots - 1)) ||
+        h->num_entries >= h->num_slots)
+        return -1;
+    slots_bytes = (size_t)h->num_slots * sizeof(rmap_slot_t);
+    entries_bytes = (size_t)h->num_entries * sizeof(rmap_entry_t);
+    if (len != sizeof(*h) + slots_bytes + entries_bytes +
+               align8(h->strings_len))
+        return -1;
+
+    m->hdr = h;
+    m->slots = (const rmap_slot_t *)(h + 1);
+    m->entries = (const rmap_entry_t *)(m->slots + h->num_slots);
+    m->strings = (const char *)(m->entries + h->num_entries);
+    for (uint64_t i = 0; i < h->num_entries; i++) {
+        const rmap_entry_t *e = &m->entries[i];
+        if ((uint64_t)e->key_off + e->key_len > h->strings_len ||
+            (uint64_t)e->target_off + e->target_len > h->strings_len)
+            return -1;
+    }
+    m->base = base;
+    m->len = len;
+    return 0;
+}
+
+/* 1 if the file behind `st` may be mapped: only this server can write it */
+static int owned_by_server(const struct stat *st)
+{
+    return st->st_uid == geteuid() &&
+           (st->st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+
+/*
+ * Load the compiled file `dst`: mapped if the server owns it, otherwise
+ * copied into memory, so that another user truncating it cannot fault
+ * the worker. With `st` the image must describe the text behind it; a
+ * NULL `st` accepts an image of any text. `cst` receives the identity of
+ * the compiled file, or zeroes if it cannot be opened.
+ */
+static int load_compiled(redirect_map_t *m, const char *dst,
+                         const struct stat *st, struct stat *cst)
+{
+    void *base;
+    size_t len;
+    int fd = open(dst, O_RDONLY | O_CLOEXEC);
+
+    memset(cst, 0, sizeof(*cst));
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, cst) != 0 || !S_ISREG(cst->st_mode) ||
+        (size_t)cst->st_size < sizeof(rmap_header_t)) {
+        close(fd);
+        return -1;
+    }
+    len = (size_t)cst->st_size;
+    if (owned_by_server(cst)) {
+        base = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+        m->mapped = base != MAP_FAILED;
+        if (!m->mapped)
+            base = NULL;
+    } else {
+        base = malloc(len);
+        if (base && fileio_read_all(fd, base, len) != 0) {
+            free(base);
+            base = NULL;
+        }
+        m->mapped = 0;
+    }
+    close(fd);
+    if (!base)
+        return -1;
+    if (attach_image(m, base, len, st) != 0) {
+        if (m->mapped)
+            munmap(base, len);
+        else
+            free(base);
+        m->mapped = 0;
+        return -1;
+    }
+    if (!m->mapped)
+        g_stats.copies++;
+    return 0;
+}
+
+static void map_release(redirect_map_t *m)
+{
+    if (m->hdr) {
+        g_stats.maps--;
+        g_stats.entries -= (size_t)m->hdr->num_entries;
+    }
+    if (m->mapped)
+        munmap(m->base, m->len);
+    else
+        free(m->base);
+    free(m->dst);
+    free(m);
+}
+
+static void map_free(file_cache_entry_t *e)
+{
+    map_release((redirect_map_t *)e);
+}
+
+/* Record `st` as the text and `cst` as the compiled file `m` stands for */
+static void map_set_identity(redirect_map_t *m, const struct stat *st,
+                             const struct stat *cst)
+{
+    file_ident_set(&m->entry.ident, st);
+    m->c_mtime = cst->st_mtim;
+    m->c_size = cst->st_size;
+    m->c_ino = cst->st_ino;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Rebuilds off the event loop                                        */
+/* ------------------------------------------------------------------ */
+
+static int ident_equal(const file_ident_t *a, const file_ident_t *b)
+{
+    return a->mtime.tv_sec == b->mtime.tv_sec &&
+           a->mtime.tv_nsec == b->mtime.tv_nsec && a->size == b->size &&
+           a->dev == b->dev && a->ino == b->ino;
+}
+
+static void build_free(map_build_t *b)
+{
+    free(b->img);
+    free(b->dst);
+    free(b->path);
+    free(b);
+}
+
+static map_build_t *build_find(const char *path)
+{
+    for (map_build_t *b = g_builds; b; b = b->next)
+        if (strcmp(b->path, path) == 0)
+            return b;
+    return NULL;
+}
+
+static void build_unlink(map_build_t *b)
+{
+    map_build_t **pp = &g_builds;
+
+    while (*pp != b)
+        pp = &(*pp)->next;
+    *pp = b->next;
+}
+
+/* Runner thread: compile the text and replace the compiled file */
+static int build_task(void *arg)
+{
+    map_build_t *b = arg;
+    void *img = compile_text(b->path, &b->st, &b->len);
+
+    if (!img)
+        return -1;
+    if (write_image(b->dst, img, b->len) == 0) {
+        free(img);
+        return 1;
+    }
+    b->img = img;
+    return 0;
+}
+
+/* Event loop: the next lookup of the map picks the result up */
+static void build_done(void *arg, int result)
+{
+    map_build_t *b = arg;
+
+    if (b->orphan) {
+        build_free(b);
+        return;
+    }
+    b->state = result < 0 ? BUILD_FAILED : BUILD_DONE;
+    if (result >= 0)
+        g_stats.builds++;
+}
+
+/*
+ * Start compiling the current text of the stale map `m` unless a build
+ * of it is running, done but not yet picked up, or failed for this text.
+ * A runner that cannot take the task is asked again on the next lookup.
+ */
+static void map_rebuild(redirect_map_t *m)
+{
+    map_build_t *b = build_find(m->entry.path);
+
+    if (!g_runner)
+        return;
+    if (b) {
+        if (b->state != BUILD_FAILED || ident_equal(&b->want, &m->entry.ident))
+            return;
+        build_unlink(b);
+        build_free(b);
+    }
+    b = calloc(1, sizeof(*b));
+    if (!b || !(b->path = strdup(m->entry.path)) ||
+        !(b->dst = strdup(m->dst)))
+        goto fail;
+    b->want = m->entry.ident;
+    b->state = BUILD_RUNNING;
+    if (g_runner(build_task, build_done, b) != 0)
+        goto fail;
+    b->next = g_builds;
+    g_builds = b;
+    g_stats.rebuilds++;
+    return;
+
+fail:
+    if (b)
+        build_free(b);
+}
+
+/*
+ * Drop the finished build of `path`, if any. With `m`, first adopt the
+ * image it kept in memory if that describes the text behind `st`; a
+ * failed build of that same text is kept so it is not retried.
+ */
+static int build_take(redirect_map_t *m, const char *path,
+                      const struct stat *st, struct stat *tst)
+{
+    map_build_t *b = build_find(path);
+    int rc = -1;
+
+    if (!b || b->state == BUILD_RUNNING)
+        return -1;
+    if (m && b->img && attach_image(m, b->img, b->len, st) == 0) {
+        b->img = NULL;
+        *tst = b->st;
+        rc = 0;
+    }
+    if (!m || b->state == BUILD_DONE || !file_ident_matches(&b->want, st)) {
+        build_unlink(b);
+        build_free(b);
+    }
+    return rc;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Cache callbacks                                                    */
+/* ------------------------------------------------------------------ */
+
+/*
+ * Load `path`, whose text is described by `st`: from its compiled file
+ * if that is current, else from an image rebuilt off the event loop,
+ * else, for a large text that a runner can rebuild, from a compiled
+ * file of older text (served stale meanwhile), else by compiling the
+ * text here.
+ */
+static file_cache_entry_t *map_load(const char *path, const struct stat *st)
+{
+    size_t path_len = strlen(path);
+    redirect_map_t *m = calloc(1, sizeof(*m));
+    struct stat tst = *st, cst;
+
+    if (!m || !(m->dst = malloc(path_len + sizeof(REDIRECT_MAP_SUFFIX))))
+        goto fail;
+    memcpy(m->dst, path, path_len);
+    memcpy(m->dst + path_len, REDIRECT_MAP_SUFFIX,
+           sizeof(REDIRECT_MAP_SUFFIX));
+
+    if (load_compiled(m, m->dst, st, &cst) == 0) {
+        g_stats.opens++;
+        build_take(NULL, path, st, &tst);
+    } else if (build_take(m, path, st, &tst) == 0) {
+        /* Rebuilt, but the compiled file could not be written */
+    } else if ((uint64_t)st->st_size > REDIRECT_MAP_INLINE_MAX && g_runner &&
+               load_compiled(m, m->dst, NULL, &cst) == 0) {
+        m->stale = 1;
+        g_stats.stale++;
+    } else {
+        size_t len;
+        void *img = compile_text(path, &tst, &len);
+        if (!img)
+            goto fail;
+        g_stats.builds++;
+        /* Share the compiled file if it can be written; else keep it */
+        if (write_image(m->dst, img, len) == 0 &&
+            load_compiled(m, m->dst, &tst, &cst) == 0) {
+            free(img);
+        } else if (attach_image(m, img, len, &tst) != 0) {
+            free(img);
+            goto fail;
+        }
+    }
+
+    map_set_identity(m, &tst, &cst);
+    g_stats.maps++;
+    g_stats.entries += (size_t)m->hdr->num_entries;
+    return &m->entry;
+
+fail:
+    if (m)
+        free(m->dst);
+    free(m);
+    return NULL;
+}
+
+/*
+ * 1 if the cached copy still describes the text behind `st`; a stale copy
+ * is also dropped once its compiled file has been replaced or its
+ * rebuild has finished.
+ */
+static int map_current(const file_cache_entry_t *e, const struct stat *st)
+{
+    const redirect_map_t *m = (const redirect_map_t *)e;
+    const map_build_t *b;
+    struct stat cst;
+
+    if (!file_ident_matches(&m->entry.ident, st))
+        return 0;
+    if (!m->stale)
+        return 1;
+    b = build_find(m->entry.path);
+    if (b && b->state == BUILD_DONE)
+        return 0;
+    if (stat(m->dst, &cst) != 0)
+        memset(&cst, 0, sizeof(cst));
+    return m->c_mtime.tv_sec == cst.st_mtim.tv_sec &&
+           m->c_mtime.tv_nsec == cst.st_mtim.tv_nsec &&
+           m->c_size == cst.st_size && m->c_ino == cst.st_ino;
+}
+
+/*
+ * Changed text that cannot be compiled: keep serving the copy we have
+ * until the text or its compiled file changes.
+ */
+static int map_keep(file_cache_entry_t *e, const struct stat *st)
+{
+    redirect_map_t *m = (redirect_map_t *)e;
+    struct stat cst;
+
+    if (!m->stale)
+        g_stats.stale++;
+    m->stale = 1;
+    if (stat(m->dst, &cst) != 0)
+        memset(&cst, 0, sizeof(cst));
+    map_set_identity(m, st, &cst);
+    return 1;
+}
+
+static const file_cache_ops_t g_map_ops = { map_load, map_free, map_current,
+                                             map_keep };
+static file_cache_t g_maps = FILE_CACHE_INIT(&g_map_ops);
+
+/* ------------------------------------------------------------------ */
+/*  Public API                                                         */
+/* ------------------------------------------------------------------ */
+
+int redirect_map_lookup(const char *path, const char *uri, size_t uri_len,
+                        const char **target, size_t *target_len)
+{
+    redirect_map_t *m;
+    uint64_t h;
+    uint32_t mask;
+
+    if (!path || !uri || !target || !target_len)
+        return -1;
+    m = (redirect_map_t *)file_cache_get(&g_maps, path);
+    if (!m)
+        return -1;
+    if (m->stale)
+        map_rebuild(m);
+
+    g_stats.lookups++;
+    h = hash_fnv1a(uri, uri_len);
+    mask = m->hdr->num_slots - 1;
+    /* Bounded so that a damaged file without empty slots cannot hang */
+    for (uint32_t s = (uint32_t)h & mask, n = 0; n <= mask;
+         s = (s + 1) & mask, n++) {
+        const rmap_slot_t *slot = &m->slots[s];
+        if (slot->entry == 0 || slot->entry > m->hdr->num_entries)
+            return 0;
+        if (slot->hash != (uint32_t)(h >> 32))
+            continue;
+        const rmap_entry_t *e = &m->entries[slot->entry - 1];
+        if (e->key_len == uri_len &&
+            memcmp(m->strings + e->key_off, uri, uri_len) == 0) {
+            *target = m->strings + e->target_off;
+            *target_len = e->target_len;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void redirect_map_set_runner(redirect_map_runner_t run)
+{
+    g_runner = run;
+}
+
+int redirect_map_get_stats(redirect_map_stats_t *out)
+{
+    if (!out)
+        return -1;
+    *out = g_stats;
+    return 0;
+}
+
+void redirect_map_cache_destroy(void)
+{
+    file_cache_clear(&g_maps);
+    while (g_builds) {
+        map_build_t *b = g_builds;
+        g_builds = b->next;
+        /* The runner still holds a running build; build_done frees it */
+        if (b->state == BUILD_RUNNING)
+            b->orphan = 1;
+        else
+            build_free(b);
+    }
+    memset(&g_stats, 0, sizeof(g_stats));
+}
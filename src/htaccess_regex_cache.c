@@ -0,0 +1,120 @@
+/**
+ * htaccess_regex_cache.c - Compiled pattern cache
+ *
+ * Each slot owns one compiled pattern: its text (the key), the regex_t
+ * and the prefilter. Patterns that fail to compile are cached too, so an
+ * invalid pattern costs one regcomp() rather than one per request. If an
+ * entry cannot be allocated the pattern is compiled for the call alone.
+ *
+ * Validates: Requirements 9.1, 11.1
+ */
+#include "htaccess_regex_cache.h"
+#include "htaccess_hash.h"
+#include "htaccess_regex_set.h"
+
+#include <regex.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    char             *pattern;  /* Pattern text (the key) */
+    uint64_t          hash;
+    int               ok;       /* 0 if the pattern failed to compile */
+    regex_t           re;
+    regex_prefilter_t pf;
+} regex_cache_entry_t;
+
+static regex_cache_entry_t *g_slots[REGEX_CACHE_SLOTS];
+static regex_cache_stats_t g_stats;
+
+static void entry_free(regex_cache_entry_t *e)
+{
+    if (!e)
+        return;
+    if (e->ok)
+        regfree(&e->re);
+    free(e->pattern);
+    free(e);
+}
+
+/* Compile without caching; used when memory is short */
+static int match_uncached(const char *pattern, const char *subject)
+{
+    regex_t re;
+    int rc;
+
+    if (regcomp(&re, pattern, REG_EXTENDED | REG_NOSUB) != 0)
+        return -1;
+    rc = regexec(&re, subject, 0, NULL, 0);
+    regfree(&re);
+    return rc == 0;
+}
+
+/* Cached entry for pattern, compiling it into its slot if needed */
+static regex_cache_entry_t *entry_get(const char *pattern)
+{
+    uint64_t h = hash_fnv1a_str(pattern);
+    regex_cache_entry_t **slot = &g_slots[h & (REGEX_CACHE_SLOTS - 1)];
+    regex_cache_entry_t *e = *slot;
+
+    if (e && e->hash == h && strcmp(e->pattern, pattern) == 0)
+        return e;
+
+    e = calloc(1, sizeof(*e));
+    if (!e)
+        return NULL;
+    e->pattern = strdup(pattern);
+    if (!e->pattern) {
+        free(e);
+        return NULL;
+    }
+    e->hash = h;
+    e->ok = regcomp(&e->re, pattern, REG_EXTENDED | REG_NOSUB) == 0;
+    if (e->ok)
+        regex_prefilter_compile(pattern, 0, &e->pf);
+    g_stats.compiles++;
+
+    if (*slot)
+        entry_free(*slot);
+    else
+        g_stats.patterns++;
+    *slot = e;
+    return e;
+}
+
+int regex_cache_match(const char *pattern, const char *subject)
+{
+    regex_cache_entry_t *e;
+
+    if (!pattern || !subject)
+        return -1;
+    e = entry_get(pattern);
+    if (!e)
+        return match_uncached(pattern, subject);
+    if (!e->ok)
+        return -1;
+    /* regexec() reads the subject up to its NUL; so does the prefilter */
+    if (!regex_prefilter_match(&e->pf, subject, strlen(subject))) {
+        g_stats.rejected++;
+        return 0;
+    }
+    g_stats.execs++;
+    return regexec(&e->re, subject, 0, NULL, 0) == 0;
+}
+
+int regex_cache_get_stats(regex_cache_stats_t *out)
+{
+    if (!out)
+        return -1;
+    *out = g_stats;
+    return 0;
+}
+
+void regex_cache_destroy(void)
+{
+    for (size_t i = 0; i < REGEX_CACHE_SLOTS; i++) {
+        entry_free(g_slots[i]);
+        g_slots[i] = NULL;
+    }
+    memset(&g_stats, 0, sizeof(g_stats));
+}
@@ -0,0 +1,504 @@
+/**
+ * htaccess_regex_set.c - Ordered regex set with a literal prefilter
+ *
+ * The automaton's goto trie is a shared byte trie (htaccess_byte_trie.h)
+ * keyed by the literals, with pattern indices as values, so the patterns
+ * ending in a state are a contiguous range. Failure and dictionary links
+ * are then filled in breadth-first order.
+ *
+ * A lookup marks candidates in a bitset (on the stack for sets of up to
+ * REGEX_SET_STACK_WORDS * 64 patterns). The first time a state with
+ * outputs is reached all of its patterns and those of its dictionary
+ * chain are marked, so the next visit stops at the first output.
+ * Candidates whose literal is anchored are then checked in place with
+ * memcmp() before regexec() runs.
+ *
+ * Validates: Requirements 7.2, 7.5
+ */
+#include "htaccess_regex_set.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_STATE BYTE_TRIE_NONE
+
+/** Candidate bitset words kept on the stack during a lookup. */
+#define REGEX_SET_STACK_WORDS 64
+
+/* ------------------------------------------------------------------ */
+/*  Literal extraction                                                 */
+/* ------------------------------------------------------------------ */
+
+/* Literals found in one pass over a pattern */
+typedef struct {
+    char   best[REGEX_LITERAL_MAX + 1];    /* Longest required literal */
+    size_t best_len;
+    char   prefix[REGEX_LITERAL_MAX + 1];  /* Required right after '^' */
+    size_t prefix_len;
+    char   suffix[REGEX_LITERAL_MAX + 1];  /* Required right before '$' */
+    size_t suffix_len;
+    int    exact;                          /* Pattern is "^literal$" */
+} literal_info_t;
+
+/* End of the bracket expression opening at p, or NULL if unterminated */
+static const char *skip_bracket(const char *p)
+{
+    p++;
+    if (*p == '^')
+        p++;
+    if (*p == ']')
+        p++;
+    while (*p && *p != ']') {
+        if (*p == '[' && (p[1] == ':' || p[1] == '.' || p[1] == '=')) {
+            char close = p[1];
+            p += 2;
+            while (*p && !(*p == close && p[1] == ']'))
+                p++;
+            if (!*p)
+                return NULL;
+            p++;
+        }
+        p++;
+    }
+    return *p ? p : NULL;
+}
+
+/*
+ * Record a finished run of literal characters that began at `start`:
+ * keep the longest one, and the first one if it directly follows a
+ * leading '^'.
+ */
+static void end_run(literal_info_t *li, const char *pattern,
+                    const char *start, const char *cur, size_t cur_len)
+{
+    if (cur_len > li->best_len) {
+        memcpy(li->best, cur, cur_len);
+        li->best_len = cur_len;
+    }
+    if (cur_len > 0 && li->prefix_len == 0 && pattern[0] == '^' &&
+        start == pattern + 1) {
+        memcpy(li->prefix, cur, cur_len);
+        li->prefix_len = cur_len;
+    }
+}
+
+/* Returns 0, or -1 (nothing usable) if the pattern has alternatives */
+static int extract_literals(const char *pattern, literal_info_t *li)
+{
+    char cur[REGEX_LITERAL_MAX];
+    size_t cur_len = 0;
+    int depth = 0, last_literal = 0;
+    const char *p, *start = NULL;
+
+    memset(li, 0, sizeof(*li));
+    for (p = pattern; *p; p++) {
+        const char *tok = p;
+        char c = *p;
+        int literal = 0;
+
+        switch (c) {
+        case '|':
+            /* Any alternative may match instead: nothing is required */
+            return -1;
+        case '\\':
+            if (!p[1])
+                return -1;
+            c = *++p;
+            /*
+             * Backreferences, class escapes and glibc's word and buffer
+             * anchors (\< \> \` \') are not literals
+             */
+            literal = !isalnum((unsigned char)c) && !strchr("<>`'", c);
+            break;
+        case '[':
+            p = skip_bracket(p);
+            if (!p)
+                return -1;
+            break;
+        case '(':
+            depth++;
+            break;
+        case ')':
+            depth--;
+            break;
+        case '*':
+        case '?':
+        case '{':
+            /* The preceding character may be absent */
+            if (last_literal && cur_len > 0)
+                cur_len--;
+            if (c == '{') {
+                const char *q = p + 1;
+                while (isdigit((unsigned char)*q) || *q == ',')
+                    q++;
+                if (*q == '}')
+                    p = q;
+            }
+            break;
+        case '$':
+            /* A run ending at the final '$' ends every match */
+            if (!p[1] && last_literal && cur_len > 0) {
+                memcpy(li->suffix, cur, cur_len);
+                li->suffix_len = cur_len;
+                li->exact = pattern[0] == '^' && start == pattern + 1;
+            }
+            break;
+        case '+':
+        case '.':
+        case '^':
+            break;
+        default:
+            literal = 1;
+            break;
+        }
+
+        if (!literal || depth != 0) {
+            end_run(li, pattern, start, cur, cur_len);
+            cur_len = 0;
+            last_literal = 0;
+            continue;
+        }
+        if (cur_len == REGEX_LITERAL_MAX) {
+            end_run(li, pattern, start, cur, cur_len);
+            cur_len = 0;
+        }
+        if (cur_len == 0)
+            start = tok;
+        cur[cur_len++] = c;
+        last_literal = 1;
+    }
+    end_run(li, pattern, start, cur, cur_len);
+    return 0;
+}
+
+size_t regex_required_literal(const char *pattern, char *buf)
+{
+    literal_info_t li;
+
+    if (!pattern || !buf)
+        return 0;
+    if (extract_literals(pattern, &li) != 0)
+        li.best_len = 0;
+    memcpy(buf, li.best, li.best_len);
+    buf[li.best_len] = '\0';
+    return li.best_len;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Prefilter                                                          */
+/* ------------------------------------------------------------------ */
+
+static void fold_literal(char *s)
+{
+    for (; *s; s++)
+        *s = (char)tolower((unsigned char)*s);
+}
+
+void regex_prefilter_compile(const char *pattern, int cflags,
+                             regex_prefilter_t *out)
+{
+    literal_info_t li;
+    const char *lit = NULL;
+    size_t len = 0;
+
+    memset(out, 0, sizeof(*out));
+    if (!pattern || extract_literals(pattern, &li) != 0)
+        return;
+
+    if (li.exact) {
+        out->anchor = REGEX_ANCHOR_EXACT;
+        lit = li.prefix;
+        len = li.prefix_len;
+    } else if (li.prefix_len || li.suffix_len) {
+        int end = li.suffix_len > li.prefix_len;
+        out->anchor = end ? REGEX_ANCHOR_END : REGEX_ANCHOR_START;
+        lit = end ? li.suffix : li.prefix;
+        len = end ? li.suffix_len : li.prefix_len;
+    }
+    /* One memcmp() beats a search for a much longer literal only so far */
+    if (len * 2 < li.best_len) {
+        out->anchor = REGEX_ANCHOR_NONE;
+        lit = li.best;
+        len = li.best_len;
+    }
+    memcpy(out->lit, lit ? lit : "", len);
+    out->lit[len] = '\0';
+    out->len = (uint8_t)len;
+    out->icase = (cflags & REG_ICASE) != 0;
+    if (out->icase)
+        fold_literal(out->lit);
+}
+
+/* The n bytes at s equal the literal */
+static int literal_at(const regex_prefilter_t *pf, const char *s, size_t n)
+{
+    if (!pf->icase)
+        return memcmp(s, pf->lit, n) == 0;
+    for (size_t i = 0; i < n; i++)
+        if (tolower((unsigned char)s[i]) != (unsigned char)pf->lit[i])
+            return 0;
+    return 1;
+}
+
+/* The literal occurs in the len bytes at s */
+static int literal_in(const regex_prefilter_t *pf, const char *s, size_t len)
+{
+    const char *end = s + len - pf->len + 1;
+
+    if (pf->icase) {
+        for (; s < end; s++)
+            if (literal_at(pf, s, pf->len))
+                return 1;
+        return 0;
+    }
+    /* memchr() skips ahead to each occurrence of the first byte */
+    while (s < end) {
+        s = memchr(s, pf->lit[0], (size_t)(end - s));
+        if (!s)
+            return 0;
+        if (memcmp(s + 1, pf->lit + 1, pf->len - 1u) == 0)
+            return 1;
+        s++;
+    }
+    return 0;
+}
+
+int regex_prefilter_match(const regex_prefilter_t *pf, const char *subject,
+                          size_t len)
+{
+    if (!pf || pf->len == 0)
+        return 1;
+    if (!subject || len < pf->len)
+        return 0;
+    switch (pf->anchor) {
+    case REGEX_ANCHOR_START:
+        return literal_at(pf, subject, pf->len);
+    case REGEX_ANCHOR_END:
+        return literal_at(pf, subject + len - pf->len, pf->len);
+    case REGEX_ANCHOR_EXACT:
+        return len == pf->len && literal_at(pf, subject, len);
+    default:
+        return literal_in(pf, subject, len);
+    }
+}
+
+/* ------------------------------------------------------------------ */
+/*  Automaton construction                                             */
+/* ------------------------------------------------------------------ */
+
+/* Fill failure and dictionary links breadth first */
+static int link_states(regex_set_t *t)
+{
+    const byte_trie_t *g = &t->goto_trie;
+    uint32_t *queue = malloc(g->num_nodes * sizeof(uint32_t));
+    size_t head = 0, tail = 0;
+
+    if (!queue)
+        return -1;
+    t->links[0].fail = 0;
+    t->links[0].dict = NO_STATE;
+    queue[tail++] = 0;
+    while (head < tail) {
+        uint32_t u = queue[head++];
+        const byte_trie_node_t *un = &g->nodes[u];
+
+        for (uint16_t k = 0; k < un->num_edges; k++) {
+            const byte_trie_edge_t *e = &g->edges[un->first_edge + k];
+            regex_set_link_t *vl = &t->links[e->child];
+            uint32_t f = t->links[u].fail, to = NO_STATE;
+
+            if (u != 0) {
+                while ((to = byte_trie_next(g, f, e->byte)) == NO_STATE && f)
+                    f = t->links[f].fail;
+            }
+            vl->fail = to == NO_STATE ? 0 : to;
+            vl->dict = g->nodes[vl->fail].num_keys ? vl->fail
+                                                   : t->links[vl->fail].dict;
+            queue[tail++] = e->child;
+        }
+    }
+    free(queue);
+    return 0;
+}
+
+int regex_set_compile(const char *const *patterns, size_t count,
+                      int cflags, regex_set_t *out)
+{
+    char (*lits)[REGEX_LITERAL_MAX + 1];
+    byte_trie_key_t *keys;
+    size_t num_lits = 0;
+
+    memset(out, 0, sizeof(*out));
+    if (count >= NO_STATE)
+        return -1;
+    out->icase = (cflags & REG_ICASE) != 0;
+    out->words = (count + 63) / 64;
+    out->re = calloc(count ? count : 1, sizeof(regex_t));
+    out->ok = calloc(count ? count : 1, 1);
+    out->always = calloc(out->words ? out->words : 1, sizeof(uint64_t));
+    out->anchors = calloc(count ? count : 1, sizeof(regex_prefilter_t));
+    lits = malloc((count ? count : 1) * sizeof(*lits));
+    keys = malloc((count ? count : 1) * sizeof(*keys));
+    if (!out->re || !out->ok || !out->always || !out->anchors || !lits ||
+        !keys)
+        goto fail;
+    out->count = count;
+
+    for (size_t i = 0; i < count; i++) {
+        char *lit = lits[num_lits];
+        size_t len;
+
+        if (patterns[i] &&
+            regcomp(&out->re[i], patterns[i], cflags | REG_EXTENDED) == 0)
+            out->ok[i] = 1;
+        len = out->ok[i] ? regex_required_literal(patterns[i], lit) : 0;
+        if (len > 0) {
+            regex_prefilter_t *a = &out->anchors[i];
+            /* The automaton covers unanchored literals already */
+            regex_prefilter_compile(patterns[i], cflags, a);
+            if (a->anchor == REGEX_ANCHOR_NONE)
+                a->len = 0;
+        }
+        if (len == 0) {
+            out->always[i / 64] |= 1ULL << (i % 64);
+            continue;
+        }
+        if (out->icase)
+            fold_literal(lit);
+        keys[num_lits].key = lit;
+        keys[num_lits].value = (uint32_t)i;
+        num_lits++;
+    }
+    byte_trie_sort_keys(keys, num_lits);
+
+    if (byte_trie_build(keys, num_lits, &out->goto_trie) != 0)
+        goto fail;
+    free(keys);
+    free(lits);
+    keys = NULL;
+    lits = NULL;
+    out->links = malloc(out->goto_trie.num_nodes * sizeof(*out->links));
+    if (!out->links || link_states(out) != 0)
+        goto fail;
+    return 0;
+
+fail:
+    free(keys);
+    free(lits);
+    regex_set_free(out);
+    return -1;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Lookup                                                             */
+/* ------------------------------------------------------------------ */
+
+/* Mark every pattern whose literal occurs in the subject */
+static void scan_literals(const regex_set_t *t, const char *subject,
+                          size_t len, uint64_t *bits)
+{
+    const byte_trie_t *g = &t->goto_trie;
+    const unsigned char *p = (const unsigned char *)subject;
+    uint32_t state = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = t->icase ? (unsigned char)tolower(p[i]) : p[i];
+        uint32_t next;
+
+        while ((next = byte_trie_next(g, state, c)) == NO_STATE && state)
+            state = t->links[state].fail;
+        state = next == NO_STATE ? 0 : next;
+
+        uint32_t s = g->nodes[state].num_keys ? state
+                                              : t->links[state].dict;
+        while (s != NO_STATE) {
+            const byte_trie_node_t *n = &g->nodes[s];
+            const uint32_t *out = g->values + n->first_key;
+            if (bits[out[0] / 64] >> (out[0] % 64) & 1)
+                break;  /* This state and its chain are already marked */
+            for (uint32_t k = 0; k < n->num_keys; k++)
+                bits[out[k] / 64] |= 1ULL << (out[k] % 64);
+            s = t->links[s].dict;
+        }
+    }
+}
+
+size_t regex_set_first(const regex_set_t *set, const char *subject,
+                       size_t len, size_t from, size_t limit)
+{
+    uint64_t stack_bits[REGEX_SET_STACK_WORDS];
+    uint64_t *bits = NULL;
+    size_t found;
+
+    if (!set || !subject || !set->re)
+        return limit;
+    if (limit > set->count)
+        limit = set->count;
+    if (from >= limit)
+        return limit;
+    found = limit;
+
+    /* Without memory for the bitset every pattern is a candidate */
+    if (set->goto_trie.num_nodes > 1) {
+        bits = set->words <= REGEX_SET_STACK_WORDS
+                   ? stack_bits : malloc(set->words * sizeof(uint64_t));
+        if (bits) {
+            memset(bits, 0, set->words * sizeof(uint64_t));
+            scan_literals(set, subject, len, bits);
+        }
+    }
+
+    for (size_t w = from / 64; w * 64 < limit; w++) {
+        uint64_t cand = set->always[w];
+        if (bits)
+            cand |= bits[w];
+        else if (set->goto_trie.num_nodes > 1)
+            cand = ~0ULL;
+        if (w == from / 64)
+            cand &= ~0ULL << (from % 64);
+        while (cand) {
+            size_t i = w * 64 + (size_t)__builtin_ctzll(cand);
+            cand &= cand - 1;
+            if (i >= limit)
+                break;
+            if (!set->ok[i]) {
+                found = i;
+                goto done;
+            }
+            if (!regex_prefilter_match(&set->anchors[i], subject, len))
+                continue;
+            if (regexec(&set->re[i], subject, 0, NULL, 0) == 0) {
+                found = i;
+                goto done;
+            }
+        }
+    }
+done:
+    if (bits && bits != stack_bits)
+        free(bits);
+    return found;
+}
+
+const regex_t *regex_set_regex(const regex_set_t *set, size_t i)
+{
+    if (!set || i >= set->count || !set->ok[i])
+        return NULL;
+    return &set->re[i];
+}
+
+void regex_set_free(regex_set_t *set)
+{
+    if (!set)
+        return;
+    for (size_t i = 0; i < set->count; i++)
+        if (set->ok[i])
+            regfree(&set->re[i]);
+    free(set->re);
+    free(set->ok);
+    free(set->always);
+    byte_trie_free(&set->goto_trie);
+    free(set->links);
+    free(set->anchors);
+    memset(set, 0, sizeof(*set));
+}
@@ -0,0 +1,48 @@
+/**
+ * htaccess_request.c - Per-request context implementation
+ *
+ * Validates: Requirements 6.6, 8.1, 11.1, 12.1
+ */
+#include "htaccess_request.h"
+
+#include <string.h>
+
+void htaccess_request_init(htaccess_request_t *req, lsi_session_t *session)
+{
+    if (!req)
+        return;
+    memset(req, 0, sizeof(*req));
+    req->session = session;
+    if (!session)
+        return;
+
+    req->doc_root = lsi_session_get_doc_root(session, &req->doc_root_len);
+    req->uri = lsi_session_get_uri(session, &req->uri_len);
+    req->method = lsi_session_get_method(session, &req->method_len);
+
+    if (req->uri && req->uri_len > 0) {
+        int i = req->uri_len;
+        while (i > 0 && req->uri[i - 1] != '/')
+            i--;
+        req->filename = req->uri + i;
+    }
+
+    int ip_len = 0;
+    const char *ip = lsi_session_get_client_ip(session, &ip_len);
+    if (ip && ip_len > 0) {
+        req->client_ip = ip;
+        req->client_ip_len = ip_len;
+        req->client_addr_ok = (ip_addr_parse(ip, &req->client_addr) == 0);
+    }
+}
+
+void htaccess_request_set_client_ip(htaccess_request_t *req,
+                                    const char *client_ip)
+{
+    if (!req)
+        return;
+    req->client_ip = client_ip;
+    req->client_ip_len = client_ip ? (int)strlen(client_ip) : 0;
+    req->client_addr_ok = client_ip &&
+                          ip_addr_parse(client_ip, &req->client_addr) == 0;
+}
@@ -0,0 +1,111 @@
+/**
+ * htaccess_session_map.c - Records of suspended requests, by session
+ *
+ * The bucket array doubles once the table holds more records than
+ * buckets, so chains stay short; it never shrinks, which keeps a table
+ * that saw a burst ready for the next one.
+ *
+ * Validates: Requirements 10.4, 12.5
+ */
+#include "htaccess_session_map.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/** Buckets allocated by the first add. */
+#define SESSION_MAP_MIN_BUCKETS 64
+
+static size_t bucket_of(const lsi_session_t *session, size_t nbuckets)
+{
+    /* Fibonacci hashing; the high bits mix in every pointer bit */
+    uint64_t h = (uint64_t)(uintptr_t)session * 0x9E3779B97F4A7C15ULL;
+    return (size_t)(h >> 32) & (nbuckets - 1);
+}
+
+/* Rehash into twice as many buckets; keep the old array on failure. */
+static void grow(session_map_t *map)
+{
+    size_t n = map->nbuckets * 2;
+    session_link_t **b = calloc(n, sizeof(*b));
+
+    if (!b)
+        return;
+    for (size_t i = 0; i < map->nbuckets; i++) {
+        session_link_t *l = map->buckets[i];
+        while (l) {
+            session_link_t *next = l->next;
+            size_t j = bucket_of(l->session, n);
+            l->next = b[j];
+            b[j] = l;
+            l = next;
+        }
+    }
+    free(map->buckets);
+    map->buckets = b;
+    map->nbuckets = n;
+}
+
+int session_map_add(session_map_t *map, session_link_t *link)
+{
+    size_t i;
+
+    if (!map->buckets) {
+        map->buckets = calloc(SESSION_MAP_MIN_BUCKETS,
+                              sizeof(*map->buckets));
+        if (!map->buckets)
+            return -1;
+        map->nbuckets = SESSION_MAP_MIN_BUCKETS;
+    } else if (map->count >= map->nbuckets) {
+        grow(map);
+    }
+    i = bucket_of(link->session, map->nbuckets);
+    link->next = map->buckets[i];
+    map->buckets[i] = link;
+    map->count++;
+    return 0;
+}
+
+void session_map_remove(session_map_t *map, session_link_t *link)
+{
+    session_link_t **pp;
+
+    if (!map->buckets)
+        return;
+    pp = &map->buckets[bucket_of(link->session, map->nbuckets)];
+    for (; *pp; pp = &(*pp)->next) {
+        if (*pp == link) {
+            *pp = link->next;
+            link->next = NULL;
+            map->count--;
+            return;
+        }
+    }
+}
+
+session_link_t *session_map_take(session_map_t *map,
+                                 const lsi_session_t *session)
+{
+    session_link_t **pp;
+
+    if (!map->buckets)
+        return NULL;
+    pp = &map->buckets[bucket_of(session, map->nbuckets)];
+    for (; *pp; pp = &(*pp)->next) {
+        session_link_t *l = *pp;
+        if (l->session == session) {
+            *pp = l->next;
+            l->next = NULL;
+            map->count--;
+            return l;
+        }
+    }
+    return NULL;
+}
+
+void session_map_free(session_map_t *map)
+{
+    free(map->buckets);
+    map->buckets = NULL;
+    map->nbuckets = 0;
+    map->count = 0;
+}
@@ -1,201 +1,1886 @@
 /**
  * htaccess_shm.c - Shared memory management implementation
  *
- * In-memory hash table implementation for brute force IP tracking.
- * Uses a simple open-addressing hash table with linear probing.
+ * Open-addressing hash table placed in a shared mapping so all worker
+ * processes update the same records. Slots come in groups of 16 with one
+ * control byte each (Swiss-table layout); the probe sequence walks groups
+ * linearly from the key's home group.
  *
- * In production, this would be backed by /dev/shm/ols/ with file locks
- * for inter-process synchronization. The in-memory version is sufficient
- * for testing and single-process use.
+ * Control byte lifecycle: EMPTY -> CLAIMED (one process won the CAS and
+ * is writing the key) -> FULL | tag -> EMPTY. Readers that meet a CLAIMED
+ * byte wait briefly for it to become FULL. Two workers racing to insert
+ * the same address may claim different slots; before publishing, each
+ * re-scans the probe window and yields to a published copy or to a claim
+ * earlier in probe order, so the address ends up in one slot. The
+ * counters of a record live in one 64-bit word (window start << 32 |
+ * attempt count) updated with CAS.
+ *
+ * Deletion needs no tombstones: every group keeps an overflow count of
+ * the keys that probed past it because it was full. A lookup stops at the
+ * first group without the key whose overflow count is zero, so freeing a
+ * slot only decrements the counts along the deleted key's probe path.
+ *
+ * A key is never placed more than SHM_MAX_PROBE groups past its home
+ * group, so lookups and inserts touch a bounded number of groups however
+ * full the table gets. When those groups are full an insert evicts a
+ * record from them instead of failing: the victim is the one with the
+ * highest age-weighted score, already-expired records first, then old
+ * windows with few attempts. Actively blocked records are only taken when
+ * nothing else is found. The new key takes over the victim's slot in
+ * place.
+ *
+ * Expiry runs through a three-level hierarchical timing wheel (64 buckets
+ * of 1 s, 64 s and 4096 s). Every record sits in exactly one bucket list;
+ * a list is drained when the wheel reaches its bucket, and each entry is
+ * either freed or rescheduled against its current deadline. Callers
+ * advance the wheel with a work budget, so cleanup is spread over
+ * requests instead of sweeping the table. One process at a time holds
+ * the cleanup token.
+ *
+ * A snapshot file is a header, a bucket index and the base records
+ * (raw 32-byte slot images, native byte order) sorted by index bucket,
+ * followed by a log of records appended by later checkpoints. The index
+ * lets any worker find an address's base record with one bucket read,
+ * and each worker hashes the log, which SHM_SNAPSHOT_LOG_MAX keeps
+ * short, so a fresh table is restored lazily: formatting only maps the
+ * file. A lookup that misses the table while a restore is pending takes
+ * the address's newest record (one bit per record in the shared mapping
+ * makes sure each is taken once) and inserts it, or waits for the worker
+ * that took it; shm_restore() takes the remaining ones in chunks.
+ *
+ * Checkpoints are incremental: every change to a record sets its bit in
+ * its group's dirty mask, and a checkpoint appends the dirty records
+ * behind the log, then commits them by rewriting the header's log count.
+ * Data past the committed count (a checkpoint cut short) is ignored and
+ * overwritten by the next one. Compaction writes a new file with a new
+ * id through a temporary file and rename(); the table records the id of
+ * the file its changes are appended to.
  *
  * Validates: Requirements 12.2, 12.3, 12.4
  */
 #include "htaccess_shm.h"
+#include "htaccess_fileio.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 /* ------------------------------------------------------------------ */
-/*  Internal hash table structure                                      */
+/*  Shared layout                                                      */
 /* ------------------------------------------------------------------ */
 
+/** "OLBF" */
+#define SHM_MAGIC 0x4F4C4246u
+
+/** Slots per control group (one SSE2 compare). */
+#define SHM_GROUP 16
+
+/** Probes of a CLAIMED slot before yielding the CPU to its writer. */
+#define SHM_CLAIM_SPINS 4096
+
+/** Yields before a CLAIMED slot is treated as a foreign key. */
+#define SHM_CLAIM_YIELDS 1024
+
+/* Control byte values; FULL carries a 7-bit hash tag in the low bits */
+#define CTRL_EMPTY   0x00u
+#define CTRL_CLAIMED 0x01u
+#define CTRL_DELETED 0x02u  /* Given back while on the wheel */
+#define CTRL_FULL    0x80u
+
+/** Window word of a record that is being freed. */
+#define WINDOW_DEAD UINT64_MAX
+
+/* Timing wheel geometry: WHEEL_LEVELS levels of 2^WHEEL_BITS buckets */
+#define WHEEL_LEVELS 3
+#define WHEEL_BITS   6
+#define WHEEL_SIZE   (1u << WHEEL_BITS)
+#define WHEEL_MASK   (WHEEL_SIZE - 1)
+#define WHEEL_SPAN   (1u << (WHEEL_BITS * WHEEL_LEVELS))
+
+/* List links are slot index + 1 so that 0 terminates a list */
+#define LINK_NONE 0u
+
+/** Longest probe sequence, in groups; also the eviction window. */
+#define SHM_MAX_PROBE 8
+
+/** Victim selections tried before an insert gives up. */
+#define EVICT_TRIES 4
+
+/** "OLBS" */
+#define SNAP_MAGIC 0x4F4C4253u
+#define SNAP_VERSION 2
+
+/** Records per snapshot write. */
+#define SNAP_CHUNK 1024
+
+/** Average base records per snapshot index bucket. */
+#define SNAP_BUCKET_LOAD 2
+
+/** Snapshot records shm_restore() claims at a time (at most 64). */
+#define SNAP_RESTORE_CHUNK 64
+
+typedef struct {
+    uint32_t magic;       /* SHM_MAGIC */
+    uint32_t version;     /* SHM_LAYOUT_VERSION */
+    uint32_t slot_size;   /* sizeof(shm_slot_t) of the writer */
+    uint32_t snapshot_at; /* Time of the last snapshot claim (atomic) */
+    uint64_t capacity;    /* Number of slots, multiple of SHM_GROUP */
+    uint64_t count;       /* FULL slots (atomic) */
+    uint64_t evictions;   /* Records replaced by eviction (atomic) */
+    uint64_t expired;     /* Records freed by the wheel (atomic) */
+    uint64_t failures;    /* Inserts that found no slot (atomic) */
+    uint64_t restored;    /* Records loaded from the snapshot (atomic) */
+    uint64_t snap_id;     /* Snapshot file checkpoints extend, 0 = none */
+    uint64_t rs_id;       /* Snapshot file being restored */
+    uint64_t rs_next;     /* Next snapshot record to restore (atomic) */
+    uint64_t rs_left;     /* Snapshot records not yet restored (atomic) */
+    uint32_t wheel_time;  /* Last processed tick, 0 = wheel not started */
+    uint32_t cleaner;     /* PID holding the cleanup token, 0 = free */
+    uint32_t saver;       /* PID holding the checkpoint token, 0 = free */
+    uint32_t pending[WHEEL_LEVELS];           /* Drained, unprocessed */
+    uint32_t wheel[WHEEL_LEVELS][WHEEL_SIZE]; /* Bucket list heads */
+} shm_header_t;
+
+/* Two records per cache line; the slot array starts line-aligned */
+typedef struct {
+    ip_addr_t key;           /* Client address, written while CLAIMED */
+    uint64_t  window;        /* first_attempt << 32 | attempt_count */
+    uint32_t  blocked_until; /* Block expiry (atomic) */
+    uint32_t  expires;       /* End of the tracking window (atomic) */
+} shm_slot_t;
+
+_Static_assert(sizeof(shm_slot_t) == 32, "two records per cache line");
+
 typedef struct {
-    brute_force_record_t *records;  /* Array of records */
-    int                  *occupied; /* 1 if slot is in use, 0 otherwise */
-    size_t                capacity; /* Max number of records */
-    size_t                count;    /* Current number of records */
+    shm_header_t *hdr;       /* Start of the mapping, NULL if detached */
+    uint8_t      *ctrl;      /* capacity control bytes */
+    uint32_t     *overflow;  /* Per-group count of keys probing past it */
+    uint32_t     *next;      /* Per-slot timing wheel link */
+    uint16_t     *dirty;     /* Per group: slots changed since checkpoint */
+    uint64_t     *taken;     /* Per-snapshot-record bit: being restored */
+    uint64_t     *done;      /* Per-snapshot-record bit: restored */
+    shm_slot_t   *slots;
+    size_t        ngroups;
+    size_t        map_size;
+    int           fd;        /* Backing file, -1 for anonymous */
 } shm_store_t;
 
-static shm_store_t *g_store = NULL;
+static shm_store_t g_store = { NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+                                NULL, 0, 0, -1 };
+
+/*
+ * Snapshot file header. The index of 2^bucket_bits + 1 base offsets
+ * follows, then the base records and the log (see snap_records_off()).
+ */
+typedef struct {
+    uint32_t magic;        /* SNAP_MAGIC */
+    uint32_t version;      /* SNAP_VERSION */
+    uint32_t record_size;  /* sizeof(shm_slot_t) of the writer */
+    uint32_t bucket_bits;  /* Index buckets: top bits of the key hash */
+    uint64_t id;           /* Chosen at compaction, nonzero */
+    uint64_t count;        /* Base records */
+    uint64_t log_count;    /* Records appended since the compaction */
+    uint64_t saved_at;     /* Time of the last checkpoint */
+} shm_snap_header_t;
+
+/*
+ * This process's read-only mapping of the snapshot being restored.
+ * Records are numbered base first, then log, as in the file.
+ */
+static struct {
+    void             *map;
+    size_t            size;
+    const uint32_t   *index;   /* Base offset of each bucket, and count */
+    const shm_slot_t *base;
+    const shm_slot_t *log;
+    uint32_t          bits;
+    uint64_t          count;   /* Base records restored */
+    uint64_t          total;   /* Base and log records */
+    uint32_t         *newest;  /* Log hash: newest log position + 1 */
+    size_t            mask;    /* Size of `newest`, less one */
+} g_snap;
+
+/* Snapshot directory, empty when snapshots are off */
+static char g_snapshot_dir[PATH_MAX];
+
+static size_t align64(size_t n)
+{
+    return (n + 63) & ~(size_t)63;
+}
+
+/* Offsets of each region for a table of `capacity` slots. */
+typedef struct {
+    size_t ctrl;
+    size_t overflow;
+    size_t next;
+    size_t dirty;
+    size_t taken;
+    size_t done;
+    size_t slots;
+    size_t total;
+} shm_layout_t;
+
+static void layout_for(size_t capacity, shm_layout_t *l)
+{
+    l->ctrl = align64(sizeof(shm_header_t));
+    l->overflow = l->ctrl + align64(capacity);
+    l->next = l->overflow + align64(capacity / SHM_GROUP * sizeof(uint32_t));
+    l->dirty = l->next + align64(capacity * sizeof(uint32_t));
+    l->taken = l->dirty + align64(capacity / SHM_GROUP * sizeof(uint16_t));
+    l->done = l->taken + align64((capacity + SHM_SNAPSHOT_LOG_MAX + 63) /
+                                 64 * sizeof(uint64_t));
+    l->slots = l->done + (l->done - l->taken);
+    l->total = l->slots + capacity * sizeof(shm_slot_t);
+}
 
 /* ------------------------------------------------------------------ */
-/*  Hash function (djb2)                                               */
+/*  Helpers                                                            */
 /* ------------------------------------------------------------------ */
 
-static size_t hash_ip(const char *ip, size_t capacity)
+uint64_t shm_mix64(uint64_t h)
+{
+    /* murmur3 finalizer */
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+uint64_t shm_hash_addr(const ip_addr_t *a)
 {
-    unsigned long hash = 5381;
-    int c;
+    return shm_mix64(a->hi * 0x9E3779B97F4A7C15ULL ^ a->lo);
+}
+
+/* Bitmask of the slots in a group whose control byte equals `b`. */
+static unsigned group_match(const uint8_t *ctrl, uint8_t b)
+{
+#if defined(__SSE2__)
+    __m128i g = _mm_loadu_si128((const __m128i *)(const void *)ctrl);
+    __m128i m = _mm_cmpeq_epi8(g, _mm_set1_epi8((char)b));
+    return (unsigned)_mm_movemask_epi8(m);
+#else
+    unsigned mask = 0;
+    for (int i = 0; i < SHM_GROUP; i++) {
+        if (__atomic_load_n(&ctrl[i], __ATOMIC_RELAXED) == b)
+            mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+/* Bitmask of the FULL slots in a group. */
+static unsigned group_full(const uint8_t *ctrl)
+{
+#if defined(__SSE2__)
+    __m128i g = _mm_loadu_si128((const __m128i *)(const void *)ctrl);
+    return (unsigned)_mm_movemask_epi8(g);
+#else
+    unsigned mask = 0;
+    for (int i = 0; i < SHM_GROUP; i++) {
+        if (__atomic_load_n(&ctrl[i], __ATOMIC_RELAXED) & CTRL_FULL)
+            mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
 
-    while ((c = (unsigned char)*ip++) != 0)
-        hash = ((hash << 5) + hash) + (unsigned long)c;
+static int addr_equal(const ip_addr_t *a, const ip_addr_t *b)
+{
+    return a->hi == b->hi && a->lo == b->lo;
+}
 
-    return hash % capacity;
+static uint64_t pack_window(time_t first_attempt, int count)
+{
+    return ((uint64_t)(uint32_t)first_attempt << 32) | (uint32_t)count;
+}
+
+static void unpack_slot(const shm_slot_t *s, uint64_t w,
+                        brute_force_record_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->addr = s->key;
+    out->first_attempt = (time_t)(uint32_t)(w >> 32);
+    out->attempt_count = (int)(uint32_t)w;
+    out->blocked_until = (time_t)__atomic_load_n(&s->blocked_until,
+                                                 __ATOMIC_RELAXED);
+}
+
+/*
+ * Wait (bounded) for a CLAIMED control byte to change and return its
+ * new value. The writer may share our CPU, so spinning gives way to
+ * sched_yield(); a writer that died mid-claim only costs the bound.
+ */
+static uint8_t wait_published(const uint8_t *c)
+{
+    uint8_t v = __atomic_load_n(c, __ATOMIC_ACQUIRE);
+
+    for (int spin = 0; v == CTRL_CLAIMED && spin < SHM_CLAIM_SPINS; spin++)
+        v = __atomic_load_n(c, __ATOMIC_ACQUIRE);
+    for (int y = 0; v == CTRL_CLAIMED && y < SHM_CLAIM_YIELDS; y++) {
+        sched_yield();
+        v = __atomic_load_n(c, __ATOMIC_ACQUIRE);
+    }
+    return v;
+}
+
+/* Wait (bounded) for the CLAIMED slots of a group to be published. */
+static void wait_claimed(uint8_t *ctrl)
+{
+    unsigned claimed = group_match(ctrl, CTRL_CLAIMED);
+
+    while (claimed) {
+        int i = __builtin_ctz(claimed);
+        claimed &= claimed - 1;
+        wait_published(&ctrl[i]);
+    }
+}
+
+/* Look for `key` among the published slots of group `g`. */
+static shm_slot_t *group_find(size_t g, const ip_addr_t *key, uint8_t full)
+{
+    uint8_t *ctrl = g_store.ctrl + g * SHM_GROUP;
+    shm_slot_t *slots = g_store.slots + g * SHM_GROUP;
+    unsigned hit;
+
+    wait_claimed(ctrl);
+    hit = group_match(ctrl, full);
+    while (hit) {
+        int i = __builtin_ctz(hit);
+        hit &= hit - 1;
+        if (__atomic_load_n(&ctrl[i], __ATOMIC_ACQUIRE) == full &&
+            addr_equal(&slots[i].key, key))
+            return &slots[i];
+    }
+    return NULL;
+}
+
+/* Flag `s` for the next checkpoint, after changing it. */
+static void mark_dirty(const shm_slot_t *s)
+{
+    size_t idx = (size_t)(s - g_store.slots);
+    uint16_t *d = &g_store.dirty[idx / SHM_GROUP];
+    uint16_t bit = (uint16_t)(1u << (idx % SHM_GROUP));
+
+    if (!(__atomic_load_n(d, __ATOMIC_SEQ_CST) & bit))
+        __atomic_fetch_or(d, bit, __ATOMIC_SEQ_CST);
+}
+
+/* Set the record of a claimed slot before publishing it; NULL clears. */
+static void slot_fill(shm_slot_t *s, const shm_slot_t *init)
+{
+    __atomic_store_n(&s->blocked_until, init ? init->blocked_until : 0,
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&s->expires, init ? init->expires : 0,
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&s->window, init ? init->window : 0, __ATOMIC_RELEASE);
+}
+
+/* Drop the overflow counts of `n` groups starting at `g`. */
+static void overflow_release(size_t g, size_t n)
+{
+    while (n--) {
+        __atomic_sub_fetch(&g_store.overflow[g], 1, __ATOMIC_RELEASE);
+        g = (g + 1) % g_store.ngroups;
+    }
 }
 
 /* ------------------------------------------------------------------ */
-/*  Public API                                                         */
+/*  Timing wheel                                                       */
 /* ------------------------------------------------------------------ */
 
-int shm_init(const char *shm_path, size_t max_records)
+/*
+ * Push slot `idx` onto the bucket that fires at `deadline`, relative to
+ * wheel time `cur`. Deadlines beyond the wheel span go to the farthest
+ * bucket and are rescheduled when it fires.
+ */
+static void wheel_schedule(uint32_t idx, uint32_t deadline, uint32_t cur)
 {
-    (void)shm_path; /* Unused in in-memory implementation */
+    uint32_t *head;
+    uint32_t old;
+    int level = 0;
 
-    if (max_records == 0)
-        return -1;
+    if (deadline <= cur)
+        deadline = cur + 1;
+    if (deadline - cur >= WHEEL_SPAN)
+        deadline = cur + WHEEL_SPAN - 1;
 
-    if (g_store) {
-        shm_destroy(); /* Clean up previous instance */
+    while (level < WHEEL_LEVELS - 1 &&
+           deadline - cur >= 1u << (WHEEL_BITS * (level + 1)))
+        level++;
+    head = &g_store.hdr->wheel[level][(deadline >> (WHEEL_BITS * level)) &
+                                      WHEEL_MASK];
+
+    old = __atomic_load_n(head, __ATOMIC_RELAXED);
+    do {
+        g_store.next[idx] = old;
+    } while (!__atomic_compare_exchange_n(head, &old, idx + 1, 1,
+                                          __ATOMIC_RELEASE,
+                                          __ATOMIC_RELAXED));
+}
+
+/* Schedule a freshly published slot, starting the wheel if needed. */
+static void wheel_add(uint32_t idx, time_t now)
+{
+    uint32_t cur = __atomic_load_n(&g_store.hdr->wheel_time,
+                                   __ATOMIC_ACQUIRE);
+    if (cur == 0) {
+        uint32_t expected = 0;
+        cur = (uint32_t)now;
+        if (!__atomic_compare_exchange_n(&g_store.hdr->wheel_time, &expected,
+                                         cur, 0, __ATOMIC_ACQ_REL,
+                                         __ATOMIC_ACQUIRE))
+            cur = expected;
     }
+    /* Checked on the next tick; the creator sets the real deadline */
+    wheel_schedule(idx, (uint32_t)now + 1, cur);
+}
 
-    g_store = (shm_store_t *)calloc(1, sizeof(shm_store_t));
-    if (!g_store)
-        return -1;
+static int wheel_level_empty(int level)
+{
+    for (unsigned b = 0; b < WHEEL_SIZE; b++) {
+        if (__atomic_load_n(&g_store.hdr->wheel[level][b], __ATOMIC_RELAXED))
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * Free slot `idx` if its deadline is not after tick `t`, otherwise put it
+ * back on the wheel. Returns 1 if the slot was freed.
+ */
+static int wheel_expire_slot(uint32_t idx, uint32_t t)
+{
+    shm_slot_t *s = &g_store.slots[idx];
+    uint64_t w = __atomic_load_n(&s->window, __ATOMIC_SEQ_CST);
+    uint32_t deadline = __atomic_load_n(&s->expires, __ATOMIC_SEQ_CST);
+    uint32_t blocked = __atomic_load_n(&s->blocked_until, __ATOMIC_RELAXED);
+
+    uint8_t c = __atomic_load_n(&g_store.ctrl[idx], __ATOMIC_ACQUIRE);
+
+    if (blocked > deadline)
+        deadline = blocked;
+    if (c == CTRL_DELETED) {
+        /* Already uncounted by evict_into(): only leave the wheel */
+        __atomic_store_n(&g_store.ctrl[idx], CTRL_EMPTY, __ATOMIC_RELEASE);
+        return 0;
+    }
+    if (w == WINDOW_DEAD || !(c & CTRL_FULL)) {
+        /* Being taken over by an eviction: look again next tick */
+        wheel_schedule(idx, t + 1, t);
+        return 0;
+    }
+    if (deadline > t ||
+        !__atomic_compare_exchange_n(&s->window, &w, WINDOW_DEAD, 0,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        /* Still live, or touched while we looked: check again later */
+        wheel_schedule(idx, deadline, t);
+        return 0;
+    }
 
-    g_store->records = (brute_force_record_t *)calloc(max_records,
-                                                       sizeof(brute_force_record_t));
-    if (!g_store->records) {
-        free(g_store);
-        g_store = NULL;
+    size_t g = idx / SHM_GROUP;
+    size_t home = (size_t)(shm_hash_addr(&s->key) % g_store.ngroups);
+    __atomic_store_n(&g_store.ctrl[idx], CTRL_EMPTY, __ATOMIC_RELEASE);
+    overflow_release(home, (g + g_store.ngroups - home) % g_store.ngroups);
+    __atomic_sub_fetch(&g_store.hdr->count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&g_store.hdr->expired, 1, __ATOMIC_RELAXED);
+    return 1;
+}
+
+/*
+ * Take a process token (the cleanup or checkpoint token), breaking it if
+ * its holder has died.
+ */
+static int token_acquire(uint32_t *token)
+{
+    uint32_t self = (uint32_t)getpid();
+    uint32_t holder = 0;
+
+    if (__atomic_compare_exchange_n(token, &holder, self, 0,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return 1;
+    if (holder == self || kill((pid_t)holder, 0) == 0 || errno != ESRCH)
+        return 0;
+    return __atomic_compare_exchange_n(token, &holder, self, 0,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+static void token_release(uint32_t *token)
+{
+    __atomic_store_n(token, 0, __ATOMIC_RELEASE);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Eviction                                                           */
+/* ------------------------------------------------------------------ */
+
+/*
+ * Eviction score of a record; higher is a better victim. Records past
+ * their deadline score highest, actively blocked ones lowest (0). Others
+ * score by window age divided by attempt count.
+ */
+static uint64_t evict_score(const shm_slot_t *s, uint64_t w, time_t now)
+{
+    uint32_t deadline = __atomic_load_n(&s->expires, __ATOMIC_RELAXED);
+    uint32_t blocked = __atomic_load_n(&s->blocked_until, __ATOMIC_RELAXED);
+    uint32_t count = (uint32_t)w;
+    time_t age = now - (time_t)(uint32_t)(w >> 32);
+
+    if (blocked > deadline)
+        deadline = blocked;
+    if ((time_t)deadline <= now)
+        return UINT64_MAX;
+    if ((time_t)blocked > now)
+        return 0;
+    if (age < 0)
+        age = 0;
+    return ((uint64_t)age + 1) * 1024 / ((uint64_t)count + 1) + 1;
+}
+
+/*
+ * Pick a victim among the records of the `ngroups` groups starting at
+ * `home`. Returns the slot index, with its window word in *w_out, or -1.
+ */
+static long evict_pick(size_t home, size_t ngroups, time_t now,
+                       uint64_t *w_out)
+{
+    long best = -1;
+    uint64_t best_score = 0;
+    uint64_t best_w = 0;
+
+    for (size_t k = 0; k < ngroups; k++) {
+        size_t g = (home + k) % g_store.ngroups;
+        for (int i = 0; i < SHM_GROUP; i++) {
+            size_t idx = g * SHM_GROUP + (size_t)i;
+            if (!(__atomic_load_n(&g_store.ctrl[idx], __ATOMIC_ACQUIRE) &
+                  CTRL_FULL))
+                continue;
+            const shm_slot_t *s = &g_store.slots[idx];
+            uint64_t w = __atomic_load_n(&s->window, __ATOMIC_ACQUIRE);
+            if (w == WINDOW_DEAD)
+                continue;
+            uint64_t score = evict_score(s, w, now);
+            if (best < 0 || score > best_score) {
+                best = (long)idx;
+                best_score = score;
+                best_w = w;
+            }
+        }
+    }
+    *w_out = best_w;
+    return best;
+}
+
+static shm_slot_t *claim_rival(const ip_addr_t *key, uint8_t full,
+                               size_t home, size_t window, size_t mine);
+
+/*
+ * Replace a victim record within the key's probe window with `key` in
+ * place. The slot stays on the timing wheel, which reschedules it by the
+ * new record's deadline.
+ *
+ * Workers evicting for the same key at once resolve like inserters, via
+ * claim_rival(). A loser cannot mark its slot EMPTY while the slot is
+ * still linked on the wheel, so it marks it DELETED and the wheel frees
+ * it when it next reaches the slot.
+ */
+static shm_slot_t *evict_into(const ip_addr_t *key, uint8_t full,
+                              size_t home, size_t window, time_t now,
+                              const shm_slot_t *init)
+{
+    size_t ngroups = g_store.ngroups;
+
+    for (int attempt = 0; attempt < EVICT_TRIES; attempt++) {
+        uint64_t w;
+        long victim = evict_pick(home, window, now, &w);
+        if (victim < 0)
+            return NULL;
+
+        shm_slot_t *s = &g_store.slots[victim];
+        if (!__atomic_compare_exchange_n(&s->window, &w, WINDOW_DEAD, 0,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+            continue; /* Touched since we scored it */
+
+        size_t g = (size_t)victim / SHM_GROUP;
+        size_t dist = (g + ngroups - home) % ngroups;
+        size_t old_home = (size_t)(shm_hash_addr(&s->key) % ngroups);
+        shm_slot_t *rival;
+
+        __atomic_store_n(&g_store.ctrl[victim], CTRL_CLAIMED,
+                         __ATOMIC_SEQ_CST);
+        overflow_release(old_home, (g + ngroups - old_home) % ngroups);
+
+        /* The new key probes from its home group to the victim's */
+        for (size_t p = home; p != g; p = (p + 1) % ngroups)
+            __atomic_add_fetch(&g_store.overflow[p], 1, __ATOMIC_ACQ_REL);
+
+        s->key = *key;
+        rival = claim_rival(key, full, home, window,
+                            dist * SHM_GROUP + (size_t)victim % SHM_GROUP);
+        if (rival) {
+            /* Another worker inserted the key: give the slot back */
+            __atomic_store_n(&g_store.ctrl[victim], CTRL_DELETED,
+                             __ATOMIC_RELEASE);
+            overflow_release(home, dist);
+            __atomic_sub_fetch(&g_store.hdr->count, 1, __ATOMIC_RELAXED);
+            return rival;
+        }
+        slot_fill(s, init);
+        __atomic_store_n(&g_store.ctrl[victim], full, __ATOMIC_RELEASE);
+        __atomic_add_fetch(&g_store.hdr->evictions, 1, __ATOMIC_RELAXED);
+        return s;
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Probing                                                            */
+/* ------------------------------------------------------------------ */
+
+/*
+ * After claiming the slot at probe position `mine` (group offset from
+ * home * SHM_GROUP + slot) for `key` and writing the key, look for
+ * another copy of the key anywhere in its probe window. A published copy
+ * always wins. Of two unpublished claims the one earlier in probe order
+ * wins: we wait for earlier claims to publish and ignore later ones,
+ * which wait for us in turn, so two inserters never wait on each other.
+ * Returns the copy to use instead of ours, or NULL to publish ours.
+ */
+static shm_slot_t *claim_rival(const ip_addr_t *key, uint8_t full,
+                               size_t home, size_t window, size_t mine)
+{
+    /* Pairs with the rival's fence: one of us sees the other's claim */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    /*
+     * An earlier claim that turns out to be given back may have yielded
+     * to a copy in a group this pass already scanned: scan again.
+     */
+    for (int pass = 0; pass < 4; pass++) {
+        size_t g = home;
+        int waited = 0;
+
+        for (size_t probe = 0; probe < window;
+             probe++, g = (g + 1) % g_store.ngroups) {
+            uint8_t *ctrl = g_store.ctrl + g * SHM_GROUP;
+            shm_slot_t *slots = g_store.slots + g * SHM_GROUP;
+            unsigned cand = group_match(ctrl, full) |
+                            group_match(ctrl, CTRL_CLAIMED);
+
+            while (cand) {
+                int i = __builtin_ctz(cand);
+                size_t pos = probe * SHM_GROUP + (size_t)i;
+                uint8_t c;
+
+                cand &= cand - 1;
+                if (pos == mine)
+                    continue;
+                c = __atomic_load_n(&ctrl[i], __ATOMIC_ACQUIRE);
+                if (c == CTRL_CLAIMED && pos < mine) {
+                    c = wait_published(&ctrl[i]);
+                    waited = 1;
+                }
+                if (c == full && addr_equal(&slots[i].key, key))
+                    return &slots[i];
+            }
+        }
+        if (!waited)
+            break;
+    }
+    return NULL;
+}
+
+/*
+ * Find the slot for `key` in the table, claiming an empty one when
+ * `create` is set and evicting a record when there is none. A new slot
+ * is published holding the counters of `init` (empty if NULL). Returns
+ * NULL when not found (or no slot could be taken). find_slot() also
+ * looks in a snapshot still being restored.
+ */
+static shm_slot_t *find_slot_in(const ip_addr_t *key, int create,
+                                time_t now, const shm_slot_t *init)
+{
+    size_t ngroups = g_store.ngroups;
+    uint64_t h = shm_hash_addr(key);
+    uint8_t full = (uint8_t)(CTRL_FULL | (h >> 57));
+    size_t home = (size_t)(h % ngroups);
+    size_t window = ngroups < SHM_MAX_PROBE ? ngroups : SHM_MAX_PROBE;
+    size_t g = home;
+    shm_slot_t *s;
+
+    /* Lookup: the probe path ends at a group nothing overflowed past */
+    for (size_t probe = 0; probe < window; probe++, g = (g + 1) % ngroups) {
+        if ((s = group_find(g, key, full)) != NULL)
+            return s;
+        if (__atomic_load_n(&g_store.overflow[g], __ATOMIC_ACQUIRE) == 0)
+            break;
+    }
+    if (!create)
+        return NULL;
+
+    /* Insert into the first free slot within the probe window */
+    g = home;
+    for (size_t probe = 0; probe < window; probe++, g = (g + 1) % ngroups) {
+        uint8_t *ctrl = g_store.ctrl + g * SHM_GROUP;
+        unsigned empty;
+
+        while ((empty = group_match(ctrl, CTRL_EMPTY)) != 0) {
+            int i = __builtin_ctz(empty);
+            uint8_t expected = CTRL_EMPTY;
+            if (__atomic_compare_exchange_n(&ctrl[i], &expected,
+                                            CTRL_CLAIMED, 0,
+                                            __ATOMIC_SEQ_CST,
+                                            __ATOMIC_ACQUIRE)) {
+                uint32_t idx = (uint32_t)(g * SHM_GROUP + (size_t)i);
+                shm_slot_t *rival;
+                s = &g_store.slots[idx];
+                s->key = *key;
+                rival = claim_rival(key, full, home, window,
+                                    probe * SHM_GROUP + (size_t)i);
+                if (rival) {
+                    /* Another worker inserted the key: give ours back */
+                    __atomic_store_n(&ctrl[i], CTRL_EMPTY,
+                                     __ATOMIC_RELEASE);
+                    overflow_release(home, probe);
+                    return rival;
+                }
+                slot_fill(s, init);
+                __atomic_store_n(&ctrl[i], full, __ATOMIC_RELEASE);
+                __atomic_add_fetch(&g_store.hdr->count, 1, __ATOMIC_RELAXED);
+                wheel_add(idx, now);
+                return s;
+            }
+            /* Lost the race; the winner may be inserting the same key */
+            if ((s = group_find(g, key, full)) != NULL) {
+                overflow_release(home, probe);
+                return s;
+            }
+        }
+        /* Group full: later lookups for this key must probe past it */
+        __atomic_add_fetch(&g_store.overflow[g], 1, __ATOMIC_ACQ_REL);
+    }
+
+    overflow_release(home, window);
+    if ((s = evict_into(key, full, home, window, now, init)) != NULL)
+        return s;
+    __atomic_add_fetch(&g_store.hdr->failures, 1, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Backing file                                                       */
+/* ------------------------------------------------------------------ */
+
+int shm_make_dirs(const char *dir)
+{
+    char buf[PATH_MAX];
+    size_t len = strlen(dir);
+
+    if (len == 0 || len >= sizeof(buf))
         return -1;
+    memcpy(buf, dir, len + 1);
+    for (char *p = buf + 1; ; p++) {
+        if (*p == '/' || *p == '\0') {
+            char c = *p;
+            *p = '\0';
+            if (mkdir(buf, 0700) != 0 && errno != EEXIST)
+                return -1;
+            *p = c;
+            if (c == '\0')
+                break;
+        }
     }
+    return 0;
+}
+
+static int header_matches(const shm_header_t *hdr, size_t capacity)
+{
+    return hdr->magic == SHM_MAGIC &&
+           hdr->version == SHM_LAYOUT_VERSION &&
+           hdr->slot_size == sizeof(shm_slot_t) &&
+           hdr->capacity == capacity;
+}
 
-    g_store->occupied = (int *)calloc(max_records, sizeof(int));
-    if (!g_store->occupied) {
-        free(g_store->records);
-        free(g_store);
-        g_store = NULL;
+static void format_header(shm_header_t *hdr, size_t capacity)
+{
+    hdr->version = SHM_LAYOUT_VERSION;
+    hdr->slot_size = sizeof(shm_slot_t);
+    hdr->capacity = capacity;
+    hdr->count = 0;
+    __atomic_store_n(&hdr->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+}
+
+/* fd is still the file at path (not replaced while we waited) */
+static int is_current(int fd, const char *path)
+{
+    struct stat a, b;
+    return fstat(fd, &a) == 0 && stat(path, &b) == 0 &&
+           a.st_dev == b.st_dev && a.st_ino == b.st_ino;
+}
+
+/* Size a new file, map it and write the header */
+static void *format_file(int fd, size_t map_size, size_t capacity)
+{
+    void *map;
+
+    if (ftruncate(fd, (off_t)map_size) != 0)
+        return MAP_FAILED;
+    map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map != MAP_FAILED)
+        format_header((shm_header_t *)map, capacity);
+    return map;
+}
+
+/*
+ * Format a table in a temporary file and rename it over `path`. The old
+ * file is left untouched: processes that still map it (old workers of a
+ * graceful restart, workers configured for another capacity) keep a
+ * valid table until they re-attach. Returns the new file's descriptor,
+ * locked, in *fd_out.
+ */
+static void *replace_file(const char *path, size_t map_size,
+                          size_t capacity, int *fd_out)
+{
+    char tmp[PATH_MAX];
+    void *map;
+    int fd;
+
+    if (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) >= (int)sizeof(tmp))
+        return MAP_FAILED;
+    fd = mkstemp(tmp);
+    if (fd < 0)
+        return MAP_FAILED;
+    /* Locked before it is visible: attachers wait for the snapshot load */
+    if (flock(fd, LOCK_EX) != 0 ||
+        (map = format_file(fd, map_size, capacity)) == MAP_FAILED) {
+        unlink(tmp);
+        close(fd);
+        return MAP_FAILED;
+    }
+    if (rename(tmp, path) != 0) {
+        munmap(map, map_size);
+        unlink(tmp);
+        close(fd);
+        return MAP_FAILED;
+    }
+    *fd_out = fd;
+    return map;
+}
+
+/*
+ * Map the backing file at `path`, attaching to the table it holds when
+ * its layout matches ours. A file that was just created (still empty,
+ * so nobody can have it mapped) is formatted in place; any other file
+ * is replaced, never resized or cleared, because other processes may
+ * still be using it. Returns with *fd_out open and exclusively locked so
+ * concurrent workers do not format twice. Sets *fresh when the table was
+ * formatted.
+ */
+static void *attach_file(const char *path, size_t map_size,
+                         size_t capacity, int *fd_out, int *fresh)
+{
+    for (int tries = 0; tries < 8; tries++) {
+        struct stat st;
+        void *map;
+        int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+
+        if (fd < 0)
+            return MAP_FAILED;
+        if (flock(fd, LOCK_EX) != 0 || fstat(fd, &st) != 0) {
+            close(fd);
+            return MAP_FAILED;
+        }
+        if (!is_current(fd, path)) {
+            close(fd); /* Replaced while we waited for the lock */
+            continue;
+        }
+
+        *fresh = 1;
+        if (st.st_size == 0) {
+            map = format_file(fd, map_size, capacity);
+            if (map == MAP_FAILED) {
+                close(fd);
+                return MAP_FAILED;
+            }
+            *fd_out = fd;
+            return map;
+        }
+        if ((size_t)st.st_size == map_size) {
+            map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                       fd, 0);
+            if (map != MAP_FAILED &&
+                header_matches((shm_header_t *)map, capacity)) {
+                *fresh = 0;
+                *fd_out = fd;
+                return map;
+            }
+            if (map != MAP_FAILED)
+                munmap(map, map_size);
+        }
+        /* Another layout or capacity: the old lock dies with fd */
+        map = replace_file(path, map_size, capacity, fd_out);
+        close(fd);
+        return map;
+    }
+    return MAP_FAILED;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Snapshots                                                          */
+/* ------------------------------------------------------------------ */
+
+/* Deadline of a record: end of its window or block, whichever is later */
+static uint32_t slot_deadline(const shm_slot_t *s)
+{
+    uint32_t deadline = __atomic_load_n(&s->expires, __ATOMIC_RELAXED);
+    uint32_t blocked = __atomic_load_n(&s->blocked_until, __ATOMIC_RELAXED);
+    return blocked > deadline ? blocked : deadline;
+}
+
+static int snapshot_path(char *buf, size_t len, const char *suffix)
+{
+    return snprintf(buf, len, "%s/%s%s", g_snapshot_dir, SHM_SNAPSHOT_NAME,
+                    suffix) < (int)len ? 0 : -1;
+}
+
+/*
+ * Copy a record for the snapshot. Returns 0 when the slot held a record
+ * with a deadline after `now`, 1 when its deadline has passed, -1 when
+ * it is free or being taken over.
+ */
+static int snapshot_copy(const shm_slot_t *s, time_t now, shm_slot_t *out)
+{
+    for (int tries = 0; tries < 4; tries++) {
+        uint64_t w = __atomic_load_n(&s->window, __ATOMIC_ACQUIRE);
+        if (w == WINDOW_DEAD)
+            return -1;
+        out->key = s->key;
+        out->window = w;
+        out->expires = __atomic_load_n(&s->expires, __ATOMIC_RELAXED);
+        out->blocked_until = __atomic_load_n(&s->blocked_until,
+                                             __ATOMIC_RELAXED);
+        /* An eviction kills the window before rewriting the key */
+        if (__atomic_load_n(&s->window, __ATOMIC_ACQUIRE) == w)
+            return (time_t)slot_deadline(out) > now ? 0 : 1;
+    }
+    return -1;
+}
+
+/* Offset of the base records in a snapshot with 2^bits index buckets */
+static size_t snap_records_off(uint32_t bits)
+{
+    size_t off = sizeof(shm_snap_header_t) +
+                 (((size_t)1 << bits) + 1) * sizeof(uint32_t);
+    return (off + 7) & ~(size_t)7;
+}
+
+/* Index bucket of a key hash: its top `bits` bits */
+static size_t snap_bucket(uint64_t h, uint32_t bits)
+{
+    return bits ? (size_t)(h >> (64 - bits)) : 0;
+}
+
+static void snapshot_unmap(void)
+{
+    if (g_snap.map)
+        munmap(g_snap.map, g_snap.size);
+    free(g_snap.newest);
+    memset(&g_snap, 0, sizeof(g_snap));
+}
+
+/* Position of the newest log record for `key`, or -1 */
+static long log_find(const ip_addr_t *key)
+{
+    size_t i;
+
+    if (!g_snap.newest)
         return -1;
+    for (i = shm_hash_addr(key) & g_snap.mask; g_snap.newest[i];
+         i = (i + 1) & g_snap.mask) {
+        uint32_t k = g_snap.newest[i] - 1;
+        if (addr_equal(&g_snap.log[k].key, key))
+            return (long)k;
     }
+    return -1;
+}
 
-    g_store->capacity = max_records;
-    g_store->count = 0;
+/*
+ * Hash the log so that lookups find a key's newest log record, which
+ * supersedes its base record and older log records. Returns 0, or -1
+ * when out of memory.
+ */
+static int log_index(uint64_t log_count)
+{
+    size_t size = 16;
 
+    if (log_count == 0)
+        return 0;
+    while (size < 2 * log_count)
+        size *= 2;
+    g_snap.newest = calloc(size, sizeof(*g_snap.newest));
+    if (!g_snap.newest)
+        return -1;
+    g_snap.mask = size - 1;
+    for (uint32_t k = 0; k < log_count; k++) {
+        const ip_addr_t *key = &g_snap.log[k].key;
+        size_t i = shm_hash_addr(key) & g_snap.mask;
+
+        while (g_snap.newest[i] &&
+               !addr_equal(&g_snap.log[g_snap.newest[i] - 1].key, key))
+            i = (i + 1) & g_snap.mask;
+        g_snap.newest[i] = k + 1;
+    }
     return 0;
 }
 
-brute_force_record_t *shm_get_record(const char *ip)
+/*
+ * Map the snapshot file read-only for restoring. Returns its header, or
+ * NULL if it is missing or malformed, or is not snapshot `id` (unless
+ * `id` is 0). Base records past the table's capacity are not restored.
+ */
+static const shm_snap_header_t *snapshot_map(uint64_t id)
 {
-    size_t idx, start;
+    char file[PATH_MAX + 16];
+    const shm_snap_header_t *sh;
+    struct stat st;
+    size_t size, off;
+    void *map;
+    int fd;
+
+    if (!g_snapshot_dir[0] || snapshot_path(file, sizeof(file), "") != 0)
+        return NULL;
+    fd = open(file, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(*sh)) {
+        close(fd);
+        return NULL;
+    }
+    size = (size_t)st.st_size;
+    map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
 
-    if (!g_store || !ip)
+    sh = map;
+    if (sh->magic != SNAP_MAGIC || sh->version != SNAP_VERSION ||
+        sh->record_size != sizeof(shm_slot_t) || sh->bucket_bits > 31 ||
+        sh->id == 0 || (id != 0 && sh->id != id) ||
+        (off = snap_records_off(sh->bucket_bits)) > size ||
+        sh->count > (size - off) / sizeof(shm_slot_t) ||
+        sh->log_count > (size - off) / sizeof(shm_slot_t) - sh->count ||
+        sh->log_count > SHM_SNAPSHOT_LOG_MAX) {
+        munmap(map, size);
         return NULL;
+    }
+    g_snap.map = map;
+    g_snap.size = size;
+    g_snap.index = (const uint32_t *)(sh + 1);
+    g_snap.base = (const shm_slot_t *)(const void *)((const char *)map +
+                                                     off);
+    g_snap.log = g_snap.base + sh->count;
+    g_snap.bits = sh->bucket_bits;
+    g_snap.count = sh->count < g_store.hdr->capacity ? sh->count
+                                                      : g_store.hdr->capacity;
+    g_snap.total = g_snap.count + sh->log_count;
+    if (log_index(sh->log_count) != 0) {
+        snapshot_unmap();
+        return NULL;
+    }
+    return sh;
+}
 
-    start = hash_ip(ip, g_store->capacity);
-    idx = start;
+/* Position of the record to restore for `key`, or -1 */
+static long snapshot_find(const ip_addr_t *key)
+{
+    size_t b = snap_bucket(shm_hash_addr(key), g_snap.bits);
+    uint64_t end = g_snap.index[b + 1];
+    long k = log_find(key);
 
-    do {
-        if (g_store->occupied[idx] &&
-            strncmp(g_store->records[idx].ip, ip, sizeof(g_store->records[idx].ip) - 1) == 0) {
-            return &g_store->records[idx];
+    if (k >= 0)
+        return (long)g_snap.count + k;
+    if (end > g_snap.count)
+        end = g_snap.count;
+    for (uint64_t i = g_snap.index[b]; i < end; i++) {
+        if (addr_equal(&g_snap.base[i].key, key))
+            return (long)i;
+    }
+    return -1;
+}
+
+/* Record `i` of the snapshot, or NULL if a newer log record replaces it */
+static const shm_slot_t *snapshot_record(uint64_t i)
+{
+    const shm_slot_t *rec = i < g_snap.count ? &g_snap.base[i]
+                                             : &g_snap.log[i - g_snap.count];
+    long k = log_find(&rec->key);
+
+    if (k >= 0 && (uint64_t)k + g_snap.count != i)
+        return NULL;
+    return rec;
+}
+
+/* Claim snapshot record `i`; 0 if another worker has claimed it */
+static int snapshot_take(uint64_t i)
+{
+    uint64_t bit = 1ULL << (i % 64);
+
+    return !(__atomic_fetch_or(&g_store.taken[i / 64], bit,
+                               __ATOMIC_ACQ_REL) & bit);
+}
+
+static int snapshot_is_done(uint64_t i)
+{
+    return (__atomic_load_n(&g_store.done[i / 64], __ATOMIC_ACQUIRE) >>
+            (i % 64)) & 1;
+}
+
+/*
+ * Wait (bounded, like wait_published()) for the worker that claimed
+ * snapshot record `i` to finish restoring it. Returns 1 if it did.
+ */
+static int snapshot_wait(uint64_t i)
+{
+    int done = snapshot_is_done(i);
+
+    for (int spin = 0; !done && spin < SHM_CLAIM_SPINS; spin++)
+        done = snapshot_is_done(i);
+    for (int y = 0; !done && y < SHM_CLAIM_YIELDS; y++) {
+        sched_yield();
+        done = snapshot_is_done(i);
+    }
+    return done;
+}
+
+static void store_max(uint32_t *p, uint32_t v)
+{
+    uint32_t old = __atomic_load_n(p, __ATOMIC_RELAXED);
+
+    while (old < v && !__atomic_compare_exchange_n(p, &old, v, 1,
+                                                   __ATOMIC_SEQ_CST,
+                                                   __ATOMIC_RELAXED))
+        ;
+}
+
+/*
+ * Restore snapshot record `i`, claimed by this worker, unless its
+ * deadline is not after `now`. The slot is published holding the saved
+ * counters, so no worker can count on an empty copy. (A slot a worker
+ * created for the key after giving up on snapshot_wait() keeps the
+ * window it counts but takes over the saved block.)
+ */
+static shm_slot_t *snapshot_import(uint64_t i, time_t now)
+{
+    const shm_slot_t *rec = snapshot_record(i);
+    shm_slot_t *s = NULL;
+    uint64_t w = 0;
+
+    if ((time_t)slot_deadline(rec) > now &&
+        (s = find_slot_in(&rec->key, 1, now, rec)) != NULL) {
+        store_max(&s->expires, rec->expires);
+        store_max(&s->blocked_until, rec->blocked_until);
+        __atomic_compare_exchange_n(&s->window, &w, rec->window, 0,
+                                    __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+        /* The record is in the file unless a compaction is replacing it */
+        if (__atomic_load_n(&g_store.hdr->snap_id, __ATOMIC_SEQ_CST) !=
+            g_store.hdr->rs_id)
+            mark_dirty(s);
+        __atomic_add_fetch(&g_store.hdr->restored, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_or(&g_store.done[i / 64], 1ULL << (i % 64),
+                      __ATOMIC_RELEASE);
+    return s;
+}
+
+/* 1 while this process can restore records of a pending snapshot */
+static int restoring(void)
+{
+    return g_snap.map &&
+           __atomic_load_n(&g_store.hdr->rs_left, __ATOMIC_ACQUIRE) > 0;
+}
+
+/*
+ * Find the slot for `key` like find_slot_in(). While a snapshot is being
+ * restored, a key missing from the table is restored first if the
+ * snapshot has it, or waited for if another worker is restoring it.
+ */
+static shm_slot_t *find_slot(const ip_addr_t *key, int create, time_t now)
+{
+    shm_slot_t *s;
+    long i;
+
+    if (!restoring())
+        return find_slot_in(key, create, now, NULL);
+    if ((s = find_slot_in(key, 0, now, NULL)) != NULL)
+        return s;
+    i = snapshot_find(key);
+    if (i >= 0) {
+        if (snapshot_take((uint64_t)i)) {
+            s = snapshot_import((uint64_t)i, now ? now : time(NULL));
+            if (s)
+                return s;
+        } else if (snapshot_wait((uint64_t)i) &&
+                   (s = find_slot_in(key, 0, now, NULL)) != NULL) {
+            return s;
         }
-        if (!g_store->occupied[idx]) {
-            return NULL; /* Empty slot means IP not found */
+    }
+    return create ? find_slot_in(key, 1, now, NULL) : NULL;
+}
+
+/*
+ * Start restoring a freshly formatted table from the snapshot, leaving
+ * the records to find_slot() and shm_restore(). A missing or malformed
+ * snapshot leaves the table empty.
+ */
+static void snapshot_load(void)
+{
+    shm_header_t *hdr = g_store.hdr;
+    const shm_snap_header_t *sh = snapshot_map(0);
+
+    if (!sh)
+        return;
+    hdr->snap_id = sh->id;
+    hdr->rs_id = sh->id;
+    hdr->rs_next = 0;
+    __atomic_store_n(&hdr->rs_left, g_snap.total, __ATOMIC_RELEASE);
+    if (g_snap.total == 0)
+        snapshot_unmap();
+}
+
+/*
+ * Copy the records changed since the last checkpoint into a new array,
+ * including those whose deadline has passed so that they replace older
+ * live copies in the file. With `all`, copy every live record instead.
+ * A group's dirty mask is cleared before the group is copied, so a
+ * change made meanwhile is written by the next checkpoint. Returns NULL
+ * when out of memory.
+ */
+static shm_slot_t *snapshot_collect(int all, time_t now, size_t *n_out)
+{
+    size_t n = 0, cap = SNAP_CHUNK;
+    shm_slot_t *recs = malloc(cap * sizeof(*recs));
+
+    if (!recs)
+        return NULL;
+    for (size_t g = 0; g < g_store.ngroups; g++) {
+        uint16_t *d = &g_store.dirty[g];
+        unsigned changed = __atomic_load_n(d, __ATOMIC_SEQ_CST);
+        unsigned full;
+
+        if (changed)
+            changed = __atomic_exchange_n(d, 0, __ATOMIC_SEQ_CST);
+        if (!changed && !all)
+            continue;
+        if (n + SHM_GROUP > cap) {
+            shm_slot_t *grown = realloc(recs, 2 * cap * sizeof(*recs));
+            if (!grown) {
+                free(recs);
+                return NULL;
+            }
+            recs = grown;
+            cap *= 2;
         }
-        idx = (idx + 1) % g_store->capacity;
-    } while (idx != start);
+        /* Only FULL slots are visited; dying records are skipped */
+        full = group_full(g_store.ctrl + g * SHM_GROUP);
+        if (!all)
+            full &= changed;
+        while (full) {
+            int i = __builtin_ctz(full);
+            int rc = snapshot_copy(&g_store.slots[g * SHM_GROUP + (size_t)i],
+                                   now, &recs[n]);
+            full &= full - 1;
+            if (rc == 0 || (rc == 1 && !all))
+                n++;
+        }
+    }
+    *n_out = n;
+    return recs;
+}
 
-    return NULL; /* Table full, not found */
+/*
+ * Append `n` records to the log of the snapshot `file` and commit them
+ * by rewriting the header. Returns 0, or -1 if the file is not the one
+ * the table extends, its log would outgrow SHM_SNAPSHOT_LOG_MAX, or on
+ * I/O error.
+ */
+static int snapshot_append(const char *file, const shm_slot_t *recs,
+                           size_t n, time_t now)
+{
+    shm_snap_header_t sh;
+    off_t off;
+    int rc = -1;
+    int fd = open(file, O_RDWR | O_CLOEXEC);
+
+    if (fd < 0)
+        return -1;
+    if (fileio_read_all(fd, &sh, sizeof(sh)) == 0 &&
+        sh.magic == SNAP_MAGIC && sh.version == SNAP_VERSION &&
+        sh.record_size == sizeof(shm_slot_t) && sh.bucket_bits <= 31 &&
+        sh.id == __atomic_load_n(&g_store.hdr->snap_id, __ATOMIC_RELAXED) &&
+        sh.log_count + n <= SHM_SNAPSHOT_LOG_MAX) {
+        /* Past the committed log: overwrites what a failed append left */
+        off = (off_t)(snap_records_off(sh.bucket_bits) +
+                      (sh.count + sh.log_count) * sizeof(shm_slot_t));
+        sh.log_count += n;
+        sh.saved_at = (uint64_t)now;
+        if (lseek(fd, off, SEEK_SET) == off &&
+            fileio_write_all(fd, recs, n * sizeof(*recs)) == 0 &&
+            fsync(fd) == 0 &&
+            pwrite(fd, &sh, sizeof(sh), 0) == (ssize_t)sizeof(sh) &&
+            fsync(fd) == 0)
+            rc = 0;
+    }
+    close(fd);
+    return rc;
 }
 
-int shm_update_record(const char *ip, const brute_force_record_t *record)
+/* A new nonzero snapshot id */
+static uint64_t snapshot_new_id(void)
 {
-    size_t idx, start;
+    struct timespec ts;
+    uint64_t id;
 
-    if (!g_store || !ip || !record)
+    clock_gettime(CLOCK_REALTIME, &ts);
+    id = shm_mix64(((uint64_t)ts.tv_sec << 30) ^ (uint64_t)ts.tv_nsec ^
+                   ((uint64_t)getpid() << 40));
+    return id ? id : 1;
+}
+
+/*
+ * Write `recs` as the base of a new snapshot, sorted into index buckets,
+ * and rename it over `file`; the table's changes are appended to it from
+ * then on. Returns 0, or -1 on failure.
+ */
+static int snapshot_compact(const char *file, const shm_slot_t *recs,
+                            size_t n, time_t now)
+{
+    char tmp[PATH_MAX + 32];
+    static const char zeros[8];
+    shm_slot_t buf[SNAP_CHUNK];
+    shm_snap_header_t sh;
+    uint32_t bits = 0, *index, *bucket, *order;
+    size_t nb, pad, k = 0;
+    int fd, rc = -1;
+
+    while (((size_t)SNAP_BUCKET_LOAD << bits) < n)
+        bits++;
+    nb = (size_t)1 << bits;
+    index = calloc(nb + 1, sizeof(*index));
+    bucket = malloc((n ? n : 1) * sizeof(*bucket));
+    order = malloc((n ? n : 1) * sizeof(*order));
+    if (!index || !bucket || !order)
+        goto out;
+
+    /* Counting sort by bucket; index[b] ends up as bucket b's start */
+    for (size_t i = 0; i < n; i++) {
+        bucket[i] = (uint32_t)snap_bucket(shm_hash_addr(&recs[i].key), bits);
+        index[bucket[i] + 1]++;
+    }
+    for (size_t b = 0; b < nb; b++)
+        index[b + 1] += index[b];
+    for (size_t i = 0; i < n; i++)
+        order[index[bucket[i]]++] = (uint32_t)i;
+    for (size_t b = nb; b > 0; b--)
+        index[b] = index[b - 1];
+    index[0] = 0;
+
+    memset(&sh, 0, sizeof(sh));
+    sh.magic = SNAP_MAGIC;
+    sh.version = SNAP_VERSION;
+    sh.record_size = sizeof(shm_slot_t);
+    sh.bucket_bits = bits;
+    sh.id = snapshot_new_id();
+    sh.count = n;
+    sh.saved_at = (uint64_t)now;
+    pad = snap_records_off(bits) - sizeof(sh) - (nb + 1) * sizeof(*index);
+
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", file, (int)getpid());
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0)
+        goto out;
+    if (fileio_write_all(fd, &sh, sizeof(sh)) != 0 ||
+        fileio_write_all(fd, index, (nb + 1) * sizeof(*index)) != 0 ||
+        fileio_write_all(fd, zeros, pad) != 0)
+        goto fail;
+    for (size_t i = 0; i < n; i++) {
+        buf[k++] = recs[order[i]];
+        if ((k == SNAP_CHUNK || i + 1 == n) &&
+            fileio_write_all(fd, buf, k * sizeof(*buf)) != 0)
+            goto fail;
+        if (k == SNAP_CHUNK)
+            k = 0;
+    }
+    if (fsync(fd) != 0)
+        goto fail;
+    close(fd);
+    if (rename(tmp, file) != 0) {
+        unlink(tmp);
+        goto out;
+    }
+    __atomic_store_n(&g_store.hdr->snap_id, sh.id, __ATOMIC_RELAXED);
+    rc = 0;
+    goto out;
+
+fail:
+    close(fd);
+    unlink(tmp);
+out:
+    free(order);
+    free(bucket);
+    free(index);
+    return rc;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Public API                                                         */
+/* ------------------------------------------------------------------ */
+
+int shm_init(const char *shm_path, size_t max_records)
+{
+    shm_layout_t layout;
+    void *map;
+    int fd = -1;
+    int fresh = 0;
+
+    if (max_records == 0 || max_records >= UINT32_MAX)
         return -1;
 
-    /* Try to find existing record first */
-    start = hash_ip(ip, g_store->capacity);
-    idx = start;
+    if (g_store.hdr) {
+        shm_destroy(); /* Clean up previous instance */
+    }
+
+    max_records = (max_records + SHM_GROUP - 1) & ~(size_t)(SHM_GROUP - 1);
+    layout_for(max_records, &layout);
+
+    if (!shm_path) {
+        map = mmap(NULL, layout.total, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (map == MAP_FAILED)
+            return -1;
+        format_header((shm_header_t *)map, max_records);
+        fresh = 1;
+    } else {
+        char file[PATH_MAX];
+        size_t len = strlen(shm_path);
+        while (len > 1 && shm_path[len - 1] == '/')
+            len--;
+        if (snprintf(file, sizeof(file), "%.*s/%s", (int)len, shm_path,
+                     SHM_FILE_NAME) >= (int)sizeof(file))
+            return -1;
+        char dir[PATH_MAX];
+        snprintf(dir, sizeof(dir), "%.*s", (int)len, shm_path);
+        if (shm_make_dirs(dir) != 0)
+            return -1;
+
+        map = attach_file(file, layout.total, max_records, &fd, &fresh);
+        if (map == MAP_FAILED)
+            return -1;
+    }
+
+    g_store.hdr = (shm_header_t *)map;
+    g_store.ctrl = (uint8_t *)map + layout.ctrl;
+    g_store.overflow = (uint32_t *)(void *)((char *)map + layout.overflow);
+    g_store.next = (uint32_t *)(void *)((char *)map + layout.next);
+    g_store.dirty = (uint16_t *)(void *)((char *)map + layout.dirty);
+    g_store.taken = (uint64_t *)(void *)((char *)map + layout.taken);
+    g_store.done = (uint64_t *)(void *)((char *)map + layout.done);
+    g_store.slots = (shm_slot_t *)(void *)((char *)map + layout.slots);
+    g_store.ngroups = max_records / SHM_GROUP;
+    g_store.map_size = layout.total;
+    g_store.fd = fd;
+
+    /* Still exclusive: other workers wait on the lock until it is loaded */
+    if (fresh)
+        snapshot_load();
+    else if (__atomic_load_n(&g_store.hdr->rs_left, __ATOMIC_ACQUIRE) > 0)
+        snapshot_map(g_store.hdr->rs_id); /* Help with the restore */
+    if (fd >= 0)
+        flock(fd, LOCK_UN);
+    return 0;
+}
+
+int shm_get_record(const ip_addr_t *ip, brute_force_record_t *out)
+{
+    shm_slot_t *s;
+    uint64_t w;
+
+    if (!g_store.hdr || !ip || !out)
+        return -1;
+    s = find_slot(ip, 0, 0);
+    if (!s)
+        return -1;
+    w = __atomic_load_n(&s->window, __ATOMIC_ACQUIRE);
+    if (w == WINDOW_DEAD)
+        return -1; /* Being freed */
+    unpack_slot(s, w, out);
+    return 0;
+}
 
+int shm_update_record(const ip_addr_t *ip,
+                      const brute_force_record_t *record)
+{
+    uint64_t next;
+
+    if (!g_store.hdr || !ip || !record)
+        return -1;
+    next = pack_window(record->first_attempt, record->attempt_count);
+
+    for (;;) {
+        shm_slot_t *s = find_slot(ip, 1, time(NULL));
+        if (!s)
+            return -1; /* Table full */
+
+        uint64_t old = __atomic_load_n(&s->window, __ATOMIC_ACQUIRE);
+        while (old != WINDOW_DEAD &&
+               !__atomic_compare_exchange_n(&s->window, &old, next, 0,
+                                            __ATOMIC_SEQ_CST,
+                                            __ATOMIC_ACQUIRE))
+            ;
+        if (old == WINDOW_DEAD)
+            continue; /* Freed under us: insert afresh */
+
+        __atomic_store_n(&s->blocked_until, (uint32_t)record->blocked_until,
+                         __ATOMIC_RELAXED);
+        mark_dirty(s);
+        return 0;
+    }
+}
+
+int shm_record_attempt(const ip_addr_t *ip, time_t now, int window_sec,
+                       int limit, brute_force_record_t *out)
+{
+    shm_slot_t *s;
+    uint64_t old, next;
+    int rc;
+
+    if (!g_store.hdr || !ip)
+        return -1;
+
+retry:
+    s = find_slot(ip, 1, now);
+    if (!s)
+        return -1;
+
+    old = __atomic_load_n(&s->window, __ATOMIC_ACQUIRE);
     do {
-        if (g_store->occupied[idx] &&
-            strncmp(g_store->records[idx].ip, ip, sizeof(g_store->records[idx].ip) - 1) == 0) {
-            /* Update existing record */
-            memcpy(&g_store->records[idx], record, sizeof(brute_force_record_t));
-            strncpy(g_store->records[idx].ip, ip, sizeof(g_store->records[idx].ip) - 1);
-            g_store->records[idx].ip[sizeof(g_store->records[idx].ip) - 1] = '\0';
-            return 0;
-        }
-        if (!g_store->occupied[idx]) {
-            /* Empty slot — insert new record */
-            memcpy(&g_store->records[idx], record, sizeof(brute_force_record_t));
-            strncpy(g_store->records[idx].ip, ip, sizeof(g_store->records[idx].ip) - 1);
-            g_store->records[idx].ip[sizeof(g_store->records[idx].ip) - 1] = '\0';
-            g_store->occupied[idx] = 1;
-            g_store->count++;
-            return 0;
+        time_t first = (time_t)(uint32_t)(old >> 32);
+        uint32_t count = (uint32_t)old;
+
+        if (old == WINDOW_DEAD)
+            goto retry; /* Freed under us: insert afresh */
+
+        if (count == 0 || (now - first) >= (time_t)window_sec) {
+            /* Publish the new deadline before the window it covers */
+            __atomic_store_n(&s->expires, (uint32_t)(now + window_sec),
+                             __ATOMIC_SEQ_CST);
+            next = pack_window(now, 1);
+            rc = 0;
+        } else if ((int)count >= limit) {
+            next = old;
+            rc = 1;
+            break;
+        } else {
+            next = old + 1;
+            rc = 0;
         }
-        idx = (idx + 1) % g_store->capacity;
-    } while (idx != start);
+    } while (!__atomic_compare_exchange_n(&s->window, &old, next, 0,
+                                          __ATOMIC_SEQ_CST,
+                                          __ATOMIC_ACQUIRE));
+    if (rc == 0)
+        mark_dirty(s);
 
-    return -1; /* Table full */
+    if (out)
+        unpack_slot(s, next, out);
+    return rc;
 }
 
-int shm_cleanup_expired(time_t now)
+int shm_prefix_key(const ip_addr_t *ip, int v4_prefix, int v6_prefix,
+                   ip_addr_t *out)
 {
-    size_t i;
-    int cleaned = 0;
+    int v4, len;
+    uint64_t bits;
+
+    if (!ip || !out)
+        return -1;
+    v4 = ip_addr_is_v4(ip);
+    len = v4 ? v4_prefix : v6_prefix;
+    if (len <= 0 || len > (v4 ? 32 : 64))
+        return -1;
+
+    if (v4) {
+        bits = ip->lo & 0xffffffffULL;
+        bits &= (0xffffffffULL << (32 - len)) & 0xffffffffULL;
+    } else {
+        bits = ip->hi;
+        if (len < 64)
+            bits &= ~0ULL << (64 - len);
+    }
+    out->hi = SHM_PREFIX_KEY_HI | ((uint64_t)(v4 ? 4 : 6) << 8) |
+              (uint64_t)len;
+    out->lo = bits;
+    return 0;
+}
 
-    if (!g_store)
+int shm_expire(time_t now, int budget)
+{
+    shm_header_t *hdr = g_store.hdr;
+    uint32_t t;
+    int work = 0;
+    int freed = 0;
+
+    if (!hdr || budget <= 0 || !token_acquire(&hdr->cleaner))
         return 0;
 
-    for (i = 0; i < g_store->capacity; i++) {
-        if (!g_store->occupied[i])
+    t = __atomic_load_n(&hdr->wheel_time, __ATOMIC_ACQUIRE);
+    if (t == 0)
+        goto done; /* Nothing scheduled yet */
+
+    while (work < budget) {
+        /* Finish the lists drained by earlier ticks first */
+        int level;
+        for (level = 0; level < WHEEL_LEVELS; level++) {
+            if (hdr->pending[level] != LINK_NONE)
+                break;
+        }
+        if (level < WHEEL_LEVELS) {
+            uint32_t idx = hdr->pending[level] - 1;
+            hdr->pending[level] = g_store.next[idx];
+            freed += wheel_expire_slot(idx, t);
+            work++;
             continue;
+        }
 
-        brute_force_record_t *rec = &g_store->records[i];
+        if ((time_t)t >= now)
+            break;
 
         /*
-         * A record is expired if:
-         * - It has a blocked_until time that has passed, OR
-         * - It has no block and the first_attempt is old enough
-         *   (we use a generous 2x window as cleanup threshold)
-         *
-         * For simplicity, remove records where blocked_until > 0
-         * and blocked_until <= now (block expired).
-         * Also remove records where first_attempt < now (window passed)
-         * and they are not currently blocked.
+         * Jump over spans with nothing scheduled. After a full wheel span
+         * of lag everything scheduled is due, so one more span of ticks
+         * drains every bucket.
          */
-        int expired = 0;
+        uint32_t to = t;
+        if (now - (time_t)t > (time_t)WHEEL_SPAN) {
+            to = (uint32_t)now - WHEEL_SPAN;
+        } else if (now - (time_t)t > WHEEL_SIZE && wheel_level_empty(0)) {
+            to = t | WHEEL_MASK;
+            if (now - (time_t)t > WHEEL_SIZE * WHEEL_SIZE &&
+                wheel_level_empty(1)) {
+                to = t | (WHEEL_SIZE * WHEEL_SIZE - 1);
+                if (wheel_level_empty(2))
+                    to = (uint32_t)now;
+            }
+            if ((time_t)to > now)
+                to = (uint32_t)now;
+        }
+        if (to > t) {
+            t = to;
+            __atomic_store_n(&hdr->wheel_time, t, __ATOMIC_RELEASE);
+            work++;
+            continue;
+        }
 
-        if (rec->blocked_until > 0 && rec->blocked_until <= now) {
-            expired = 1;
-        } else if (rec->blocked_until == 0 && rec->first_attempt > 0 &&
-                   rec->first_attempt < now) {
-            /* Record with no active block and old first_attempt */
-            expired = 1;
+        /* Advance one tick, cascading the higher levels at boundaries */
+        t++;
+        for (level = 0; level < WHEEL_LEVELS; level++) {
+            unsigned shift = WHEEL_BITS * (unsigned)level;
+            if (level > 0 && (t & ((1u << shift) - 1)) != 0)
+                break;
+            hdr->pending[level] = __atomic_exchange_n(
+                &hdr->wheel[level][(t >> shift) & WHEEL_MASK], LINK_NONE,
+                __ATOMIC_ACQUIRE);
         }
+        __atomic_store_n(&hdr->wheel_time, t, __ATOMIC_RELEASE);
+        work++;
+    }
+
+done:
+    token_release(&hdr->cleaner);
+    return freed;
+}
 
-        if (expired) {
-            memset(rec, 0, sizeof(brute_force_record_t));
-            g_store->occupied[i] = 0;
-            g_store->count--;
-            cleaned++;
+int shm_cleanup_expired(time_t now)
+{
+    return shm_expire(now, INT_MAX);
+}
+
+int shm_get_stats(shm_stats_t *out)
+{
+    shm_header_t *hdr = g_store.hdr;
+
+    if (!out)
+        return -1;
+    memset(out, 0, sizeof(*out));
+    if (!hdr)
+        return -1;
+    out->capacity = (size_t)hdr->capacity;
+    out->occupied = (size_t)__atomic_load_n(&hdr->count, __ATOMIC_RELAXED);
+    out->evictions = __atomic_load_n(&hdr->evictions, __ATOMIC_RELAXED);
+    out->expired = __atomic_load_n(&hdr->expired, __ATOMIC_RELAXED);
+    out->insert_failures = __atomic_load_n(&hdr->failures, __ATOMIC_RELAXED);
+    out->restored = __atomic_load_n(&hdr->restored, __ATOMIC_RELAXED);
+    out->restore_left = __atomic_load_n(&hdr->rs_left, __ATOMIC_RELAXED);
+    return 0;
+}
+
+int shm_set_snapshot_dir(const char *dir)
+{
+    size_t len;
+
+    if (!dir) {
+        g_snapshot_dir[0] = '\0';
+        return 0;
+    }
+    len = strlen(dir);
+    while (len > 1 && dir[len - 1] == '/')
+        len--;
+    if (len == 0 || len >= sizeof(g_snapshot_dir))
+        return -1;
+    memcpy(g_snapshot_dir, dir, len);
+    g_snapshot_dir[len] = '\0';
+    return 0;
+}
+
+int shm_restore(time_t now, int budget)
+{
+    shm_header_t *hdr = g_store.hdr;
+    uint64_t left;
+
+    if (!hdr || !g_snap.map)
+        return 0;
+    while (budget > 0 && restoring()) {
+        uint64_t i = __atomic_fetch_add(&hdr->rs_next, SNAP_RESTORE_CHUNK,
+                                        __ATOMIC_RELAXED);
+        uint64_t end = i + SNAP_RESTORE_CHUNK;
+        uint64_t pending = 0;
+
+        if (i >= g_snap.total)
+            break;
+        if (end > g_snap.total)
+            end = g_snap.total;
+        for (uint64_t j = i; j < end; j++) {
+            if (!snapshot_record(j))
+                continue; /* Superseded by a newer log record */
+            if (snapshot_take(j))
+                snapshot_import(j, now);
+            else
+                pending |= 1ULL << (j - i);
         }
+        /* Lookups must not miss records still being restored elsewhere */
+        while (pending) {
+            snapshot_wait(i + (uint64_t)__builtin_ctzll(pending));
+            pending &= pending - 1;
+        }
+        __atomic_sub_fetch(&hdr->rs_left, end - i, __ATOMIC_ACQ_REL);
+        budget -= (int)(end - i);
     }
+    left = __atomic_load_n(&hdr->rs_left, __ATOMIC_ACQUIRE);
+    if (left == 0)
+        snapshot_unmap();
+    return left > INT_MAX ? INT_MAX : (int)left;
+}
 
-    return cleaned;
+int shm_snapshot_save(time_t now)
+{
+    shm_header_t *hdr = g_store.hdr;
+    char file[PATH_MAX + 16];
+    shm_slot_t *recs = NULL;
+    size_t n = 0;
+    int rc = -1;
+
+    if (!hdr || !g_snapshot_dir[0] || shm_make_dirs(g_snapshot_dir) != 0 ||
+        snapshot_path(file, sizeof(file), "") != 0 ||
+        !token_acquire(&hdr->saver))
+        return -1;
+
+    /* Append the groups changed since the last checkpoint */
+    if (__atomic_load_n(&hdr->snap_id, __ATOMIC_RELAXED) != 0 &&
+        (recs = snapshot_collect(0, now, &n)) != NULL &&
+        (n == 0 || snapshot_append(file, recs, n, now) == 0)) {
+        rc = 0;
+        goto done;
+    }
+
+    /*
+     * Compact instead: the log is full, the file is not the one the table
+     * extends, or there is none yet. The new base needs every record, so
+     * the restore is finished first; a table that cannot read its
+     * snapshot keeps it until a process that can has restored it.
+     */
+    shm_restore(now, INT_MAX);
+    if (__atomic_load_n(&hdr->rs_left, __ATOMIC_ACQUIRE) > 0)
+        goto done;
+    /* Records other workers restore from now on are flagged for it */
+    __atomic_store_n(&hdr->snap_id, 0, __ATOMIC_SEQ_CST);
+    snapshot_unmap();
+    free(recs);
+    if ((recs = snapshot_collect(1, now, &n)) != NULL &&
+        snapshot_compact(file, recs, n, now) == 0)
+        rc = 0;
+
+done:
+    if (rc < 0) {
+        /* Some changes may be lost from the log: compact next time */
+        __atomic_store_n(&hdr->snap_id, 0, __ATOMIC_RELAXED);
+    }
+    free(recs);
+    token_release(&hdr->saver);
+    if (rc < 0)
+        return -1;
+    return n > INT_MAX ? INT_MAX : (int)n;
+}
+
+int shm_maybe_snapshot(time_t now, int min_interval)
+{
+    shm_header_t *hdr = g_store.hdr;
+    uint32_t last;
+
+    if (!hdr || !g_snapshot_dir[0])
+        return 0;
+    last = __atomic_load_n(&hdr->snapshot_at, __ATOMIC_RELAXED);
+    if (last != 0 && now - (time_t)last < (time_t)min_interval)
+        return 0;
+    /* One worker per interval takes the snapshot */
+    if (!__atomic_compare_exchange_n(&hdr->snapshot_at, &last,
+                                     (uint32_t)now, 0, __ATOMIC_ACQ_REL,
+                                     __ATOMIC_RELAXED))
+        return 0;
+    return shm_snapshot_save(now) >= 0;
 }
 
 void shm_destroy(void)
 {
-    if (!g_store)
+    if (!g_store.hdr)
         return;
 
-    free(g_store->records);
-    free(g_store->occupied);
-    free(g_store);
-    g_store = NULL;
+    snapshot_unmap();
+    munmap(g_store.hdr, g_store.map_size);
+    if (g_store.fd >= 0)
+        close(g_store.fd);
+    g_store.hdr = NULL;
+    g_store.ctrl = NULL;
+    g_store.overflow = NULL;
+    g_store.next = NULL;
+    g_store.dirty = NULL;
+    g_store.taken = NULL;
+    g_store.done = NULL;
+    g_store.slots = NULL;
+    g_store.ngroups = 0;
+    g_store.map_size = 0;
+    g_store.fd = -1;
 }
@@ -13,8 +13,15 @@
 #include "ls.h"
 #include "htaccess_cache.h"
 #include "htaccess_shm.h"
+#include "htaccess_hitters.h"
+#include "htaccess_authpool.h"
+#include "htaccess_htgroup.h"
+#include "htaccess_htpasswd.h"
+#include "htaccess_redirect_map.h"
+#include "htaccess_regex_cache.h"
 #include "htaccess_dirwalker.h"
 #include "htaccess_directive.h"
+#include "htaccess_request.h"
 #include "htaccess_exec_acl.h"
 #include "htaccess_exec_redirect.h"
 #include "htaccess_exec_php.h"
@@ -33,8 +40,10 @@
 #include "htaccess_exec_forcetype.h"
 #include "htaccess_exec_encoding.h"
 
+#include <limits.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
 
 /* ------------------------------------------------------------------ */
 /*  Constants                                                          */
@@ -42,6 +51,9 @@
 
 #define MOD_HTACCESS_CACHE_BUCKETS  64
 #define MOD_HTACCESS_SHM_MAX_RECORDS 1024
+#define MOD_HTACCESS_SHM_RECORDS_ENV "OLS_HTACCESS_BF_RECORDS"
+#define MOD_HTACCESS_SNAPSHOT_DIR   "/var/lib/ols/"
+#define MOD_HTACCESS_SNAPSHOT_ENV   "OLS_HTACCESS_BF_SNAPSHOT_DIR"
 #define MOD_HTACCESS_HOOK_PRIORITY  100
 
 /* ------------------------------------------------------------------ */
@@ -51,6 +63,7 @@
 static int mod_htaccess_init(lsi_module_t *module);
 static int on_recv_req_header(lsi_session_t *session);
 static int on_send_resp_header(lsi_session_t *session);
+static int on_http_end(lsi_session_t *session);
 
 /* ------------------------------------------------------------------ */
 /*  Module descriptor (19.1)                                           */
@@ -111,19 +124,6 @@ static char *build_target_dir(const char *doc_root, int doc_root_len,
     return result;
 }
 
-/* ------------------------------------------------------------------ */
-/*  Helper: extract filename from URI                                  */
-/*  Returns pointer into the URI string (no allocation).               */
-/* ------------------------------------------------------------------ */
-
-static const char *extract_filename(const char *uri, int uri_len)
-{
-    int i = uri_len;
-    while (i > 0 && uri[i - 1] != '/')
-        i--;
-    return uri + i;
-}
-
 /* ------------------------------------------------------------------ */
 /*  Logging helpers (19.4)                                             */
 /* ------------------------------------------------------------------ */
@@ -179,6 +179,7 @@ static const char *directive_type_str(directive_type_t type)
     case DIR_DENY_FROM:                     return "Deny from";
     case DIR_REDIRECT:                      return "Redirect";
     case DIR_REDIRECT_MATCH:                return "RedirectMatch";
+    case DIR_REDIRECT_MAP:                  return "RedirectMap";
     case DIR_ERROR_DOCUMENT:                return "ErrorDocument";
     case DIR_FILES_MATCH:                   return "FilesMatch";
     case DIR_EXPIRES_ACTIVE:                return "ExpiresActive";
@@ -191,6 +192,10 @@ static const char *directive_type_str(directive_type_t type)
     case DIR_BRUTE_FORCE_WINDOW:            return "BruteForceWindow";
     case DIR_BRUTE_FORCE_ACTION:            return "BruteForceAction";
     case DIR_BRUTE_FORCE_THROTTLE_DURATION: return "BruteForceThrottleDuration";
+    case DIR_BRUTE_FORCE_IPV4_PREFIX:       return "BruteForceIPv4Prefix";
+    case DIR_BRUTE_FORCE_IPV6_PREFIX:       return "BruteForceIPv6Prefix";
+    case DIR_BRUTE_FORCE_PREFIX_ATTEMPTS:   return "BruteForcePrefixAttempts";
+    case DIR_BRUTE_FORCE_FAILURE_STATUS:    return "BruteForceFailureStatus";
     default:                                return "Unknown";
     }
 }
@@ -199,6 +204,73 @@ static const char *directive_type_str(directive_type_t type)
 /*  Module init / cleanup (19.1)                                       */
 /* ------------------------------------------------------------------ */
 
+/**
+ * Brute force table capacity: OLS_HTACCESS_BF_RECORDS from the server
+ * environment when it holds a positive number, otherwise the default.
+ */
+static size_t shm_capacity(void)
+{
+    const char *env = getenv(MOD_HTACCESS_SHM_RECORDS_ENV);
+    char *endp;
+    unsigned long n;
+
+    if (!env || !*env)
+        return MOD_HTACCESS_SHM_MAX_RECORDS;
+    n = strtoul(env, &endp, 10);
+    if (*endp != '\0' || n == 0 || n >= 0xFFFFFFFFul) {
+        lsi_log(NULL, LSI_LOG_WARN,
+                "mod_htaccess: ignoring invalid %s value '%s'",
+                MOD_HTACCESS_SHM_RECORDS_ENV, env);
+        return MOD_HTACCESS_SHM_MAX_RECORDS;
+    }
+    return (size_t)n;
+}
+
+/**
+ * Brute force snapshot directory: OLS_HTACCESS_BF_SNAPSHOT_DIR from the
+ * server environment, an empty value turning snapshots off, otherwise
+ * the default.
+ */
+static const char *shm_snapshot_dir(void)
+{
+    const char *env = getenv(MOD_HTACCESS_SNAPSHOT_ENV);
+
+    if (!env)
+        return MOD_HTACCESS_SNAPSHOT_DIR;
+    return *env ? env : NULL;
+}
+
+/* Repeating timer that checkpoints the brute force table */
+static int g_snapshot_timer = -1;
+
+static void on_snapshot_timer(const void *arg)
+{
+    (void)arg;
+    shm_maybe_snapshot(time(NULL), SHM_SNAPSHOT_INTERVAL);
+}
+
+/* Repeating timer that restores the snapshot in steps after a restart */
+static int g_restore_timer = -1;
+
+static void on_restore_timer(const void *arg)
+{
+    (void)arg;
+    if (shm_restore(time(NULL), SHM_RESTORE_BUDGET) == 0 &&
+        g_restore_timer >= 0) {
+        lsi_remove_timer(g_restore_timer);
+        g_restore_timer = -1;
+    }
+}
+
+/* Repeating timer that writes the top offenders for operators */
+static int g_hitters_timer = -1;
+
+static void on_hitters_timer(const void *arg)
+{
+    (void)arg;
+    hitters_maybe_export(time(NULL));
+}
+
 /**
  * Module initialization — called by LSIAPI when the module is loaded.
  * Initializes cache and shared memory, registers hook callbacks.
@@ -214,12 +286,65 @@ static int mod_htaccess_init(lsi_module_t *module)
         return LSI_ERROR;
     }
 
+    /*
+     * Password hashing threads (started in each worker on first use),
+     * which also recompile large RedirectMap files
+     */
+    if (authpool_init(AUTHPOOL_DEFAULT_THREADS, AUTHPOOL_DEFAULT_QUEUE) != 0)
+        lsi_log(NULL, LSI_LOG_WARN,
+                "mod_htaccess: failed to configure the password hashing "
+                "pool, passwords will be checked inline");
+    else
+        redirect_map_set_runner(authpool_run);
+
     /* Initialize shared memory for brute force protection */
-    if (shm_init("/dev/shm/ols/", MOD_HTACCESS_SHM_MAX_RECORDS) != 0) {
+    if (shm_set_snapshot_dir(shm_snapshot_dir()) != 0) {
+        lsi_log(NULL, LSI_LOG_WARN,
+                "mod_htaccess: invalid %s, brute force state will not "
+                "be saved", MOD_HTACCESS_SNAPSHOT_ENV);
+        shm_set_snapshot_dir(NULL);
+    }
+    if (shm_init("/dev/shm/ols/", shm_capacity()) != 0) {
         lsi_log(NULL, LSI_LOG_WARN,
                 "mod_htaccess: failed to initialize shared memory, "
                 "brute force protection will be disabled");
         /* Non-fatal: continue without brute force protection */
+    } else {
+        shm_stats_t stats;
+        if (shm_get_stats(&stats) == 0 &&
+            stats.restored + stats.restore_left > 0)
+            lsi_log(NULL, LSI_LOG_INFO,
+                    "mod_htaccess: restoring %llu brute force records "
+                    "from snapshot",
+                    (unsigned long long)(stats.restored +
+                                         stats.restore_left));
+        /* Lookups restore their own records; the timer does the rest */
+        if (stats.restore_left > 0 && g_restore_timer < 0) {
+            g_restore_timer = lsi_set_timer(SHM_RESTORE_INTERVAL_MS, 1,
+                                            on_restore_timer, NULL);
+            if (g_restore_timer < 0)
+                shm_restore(time(NULL), INT_MAX);
+        }
+        if (shm_snapshot_dir() && g_snapshot_timer < 0) {
+            g_snapshot_timer = lsi_set_timer(SHM_SNAPSHOT_INTERVAL * 1000,
+                                             1, on_snapshot_timer, NULL);
+            if (g_snapshot_timer < 0)
+                lsi_log(NULL, LSI_LOG_WARN,
+                        "mod_htaccess: cannot arm the brute force "
+                        "snapshot timer, state is only saved at shutdown");
+        }
+    }
+    if (hitters_init("/dev/shm/ols/") != 0) {
+        lsi_log(NULL, LSI_LOG_WARN,
+                "mod_htaccess: failed to initialize brute force "
+                "telemetry, top offenders will not be reported");
+    } else if (g_hitters_timer < 0) {
+        g_hitters_timer = lsi_set_timer(HITTERS_EXPORT_INTERVAL * 1000, 1,
+                                        on_hitters_timer, NULL);
+        if (g_hitters_timer < 0)
+            lsi_log(NULL, LSI_LOG_WARN,
+                    "mod_htaccess: cannot arm the brute force telemetry "
+                    "timer, top offenders will not be exported");
     }
 
     /* Register hook callbacks */
@@ -239,6 +364,13 @@ static int mod_htaccess_init(lsi_module_t *module)
         return LSI_ERROR;
     }
 
+    if (lsi_register_hook(LSI_HKPT_HTTP_END, on_http_end,
+                          MOD_HTACCESS_HOOK_PRIORITY) != 0) {
+        lsi_log(NULL, LSI_LOG_ERROR,
+                "mod_htaccess: failed to register http_end hook");
+        return LSI_ERROR;
+    }
+
     lsi_log(NULL, LSI_LOG_INFO,
             "mod_htaccess: module initialized successfully");
     return LSI_OK;
@@ -249,9 +381,41 @@ static int mod_htaccess_init(lsi_module_t *module)
  */
 int mod_htaccess_cleanup(lsi_module_t *module)
 {
+    shm_stats_t stats;
+
     (void)module;
     htaccess_cache_destroy();
+    redirect_map_set_runner(NULL);
+    authpool_destroy();
+    htpasswd_cache_destroy();
+    htgroup_cache_destroy();
+    redirect_map_cache_destroy();
+    regex_cache_destroy();
+    if (shm_get_stats(&stats) == 0) {
+        lsi_log(NULL, LSI_LOG_INFO,
+                "mod_htaccess: brute force table %zu/%zu records, "
+                "%llu evicted, %llu expired, %llu insert failures",
+                stats.occupied, stats.capacity,
+                (unsigned long long)stats.evictions,
+                (unsigned long long)stats.expired,
+                (unsigned long long)stats.insert_failures);
+    }
+    if (g_snapshot_timer >= 0) {
+        lsi_remove_timer(g_snapshot_timer);
+        g_snapshot_timer = -1;
+    }
+    if (g_restore_timer >= 0) {
+        lsi_remove_timer(g_restore_timer);
+        g_restore_timer = -1;
+    }
+    /* Final checkpoint; workers stopping together write it once */
+    shm_maybe_snapshot(time(NULL), 1);
     shm_destroy();
+    if (g_hitters_timer >= 0) {
+        lsi_remove_timer(g_hitters_timer);
+        g_hitters_timer = -1;
+    }
+    hitters_destroy();
     lsi_log(NULL, LSI_LOG_INFO, "mod_htaccess: module cleaned up");
     return LSI_OK;
 }
@@ -261,129 +425,90 @@ int mod_htaccess_cleanup(lsi_module_t *module)
 /* ------------------------------------------------------------------ */
 
 /**
- * on_recv_req_header — called at LSI_HKPT_RECV_REQ_HEADER.
- *
- * Flow:
- * 1. Get doc_root and request URI
- * 2. Build target directory (strip filename from URI)
- * 3. Call DirWalker to collect merged directives
- * 4. Execute request-phase directives in order:
- *    a. Access control — return immediately on deny
- *    b. Redirects — return immediately on match
- *    c. PHP configuration
- *    d. Environment variables
- *    e. Brute force protection
- * 5. Free directives and return
+ * Log the result @p rc of running a Redirect or RedirectMatch directive.
+ * Returns 1 if the response was redirected, 0 otherwise.
  */
-static int on_recv_req_header(lsi_session_t *session)
+static int log_redirect(lsi_session_t *session,
+                        const htaccess_directive_t *dir, int rc)
 {
-    int doc_root_len = 0;
-    const char *doc_root = lsi_session_get_doc_root(session, &doc_root_len);
-    if (!doc_root || doc_root_len <= 0) {
-        lsi_log(session, LSI_LOG_DEBUG,
-                "mod_htaccess: no document root, skipping");
-        return LSI_OK;
-    }
-
-    int uri_len = 0;
-    const char *uri = lsi_session_get_uri(session, &uri_len);
-    if (!uri || uri_len <= 0) {
-        lsi_log(session, LSI_LOG_DEBUG,
-                "mod_htaccess: no request URI, skipping");
-        return LSI_OK;
-    }
-
-    /* Build target directory path */
-    char *target_dir = build_target_dir(doc_root, doc_root_len, uri, uri_len);
-    if (!target_dir) {
-        lsi_log(session, LSI_LOG_WARN,
-                "mod_htaccess: failed to allocate target directory");
-        return LSI_OK;
-    }
+    const char *type_name = directive_type_str(dir->type);
 
-    /* Collect merged directives via DirWalker */
-    htaccess_directive_t *directives = htaccess_dirwalk(session, doc_root,
-                                                         target_dir);
-    free(target_dir);
-
-    if (!directives) {
-        lsi_log(session, LSI_LOG_DEBUG,
-                "mod_htaccess: no directives found for request");
-        return LSI_OK;
-    }
-
-    /* (a) Access control */
-    int rc = exec_access_control(session, directives);
-    if (rc == LSI_ERROR) {
-        lsi_log(session, LSI_LOG_DEBUG,
-                "mod_htaccess: access denied by ACL");
-        htaccess_directives_free(directives);
-        return LSI_OK;
-    }
-
-    /* (a2) Apache 2.4 Require access control */
-    int ip_len = 0;
-    const char *client_ip = lsi_session_get_client_ip(session, &ip_len);
-    rc = exec_require(session, directives, client_ip);
-    if (rc == LSI_ERROR) {
-        lsi_log(session, LSI_LOG_DEBUG,
-                "mod_htaccess: access denied by Require");
-        htaccess_directives_free(directives);
-        return LSI_OK;
+    if (rc > 0) {
+        log_directive_ok(session, dir, type_name);
+        return 1;
     }
+    if (rc < 0)
+        log_directive_fail(session, dir, type_name, "execution error");
+    return 0;
+}
 
-    /* (a3) Limit/LimitExcept method restriction */
-    int method_len = 0;
-    const char *http_method = lsi_session_get_method(session, &method_len);
+/**
+ * Steps of the request phase that follow authentication, (b) to (g) of
+ * on_recv_req_header(). Releases @p cfg. Returns LSI_SUSPEND for a
+ * throttled request, LSI_OK otherwise.
+ */
+static int run_request_steps(lsi_session_t *session,
+                             htaccess_request_t *req,
+                             htaccess_config_t *cfg)
+{
+    const htaccess_directive_t *directives = cfg->directives;
     const htaccess_directive_t *dir;
-    for (dir = directives; dir != NULL; dir = dir->next) {
-        if (dir->type == DIR_LIMIT || dir->type == DIR_LIMIT_EXCEPT) {
-            if (http_method && limit_should_exec(dir, http_method)) {
-                /* Execute children of the Limit/LimitExcept block */
-                const htaccess_directive_t *child;
-                for (child = dir->data.limit.children; child; child = child->next) {
-                    /* Children may contain access control directives */
-                    if (child->type == DIR_REQUIRE_ALL_DENIED) {
-                        lsi_session_set_status(session, 403);
-                        htaccess_directives_free(directives);
-                        return LSI_OK;
-                    }
+    const char *doc_root = req->doc_root;
+    int doc_root_len = req->doc_root_len;
+    const char *uri = req->uri;
+    int uri_len = req->uri_len;
+
+    /* (b) Redirects: first match in directive order wins */
+    if (cfg->redirects_ready) {
+        const redirect_set_t *rs = &cfg->redirects;
+        size_t len = uri_len > 0 ? (size_t)uri_len : 0;
+        size_t first = redirect_set_first_prefix(rs, uri, len);
+        size_t i = 0, m = 0;
+
+        /* Only RedirectMatch and RedirectMap rules declared before the
+         * first matching Redirect can still take precedence over it */
+        for (;;) {
+            i = redirect_set_first_match(rs, uri, len, i, first);
+            size_t next = i < rs->num_regex ? rs->regex_rules[i] : first;
+
+            for (; m < rs->num_maps && rs->map_rules[m] < next; m++) {
+                dir = rs->rules[rs->map_rules[m]];
+                if (log_redirect(session, dir,
+                                 exec_redirect_map_req(req, dir))) {
+                    htaccess_config_release(cfg);
+                    return LSI_OK;
                 }
             }
-        }
-    }
-
-    /* (a4) AuthType Basic authentication */
-    rc = exec_auth_basic(session, directives);
-    if (rc == LSI_ERROR) {
-        lsi_log(session, LSI_LOG_DEBUG,
-                "mod_htaccess: authentication failed");
-        htaccess_directives_free(directives);
-        return LSI_OK;
-    }
-
-    /* (b) Redirects */
-    for (dir = directives; dir != NULL; dir = dir->next) {
-        int redir_rc = 0;
-        if (dir->type == DIR_REDIRECT) {
-            redir_rc = exec_redirect(session, dir);
-            if (redir_rc > 0) {
-                log_directive_ok(session, dir, "Redirect");
-                htaccess_directives_free(directives);
+            if (i >= rs->num_regex)
+                break;
+            dir = rs->rules[rs->regex_rules[i]];
+            if (log_redirect(session, dir,
+                             exec_redirect_set_match(req, rs, i))) {
+                htaccess_config_release(cfg);
                 return LSI_OK;
-            } else if (redir_rc < 0) {
-                log_directive_fail(session, dir, "Redirect",
-                                   "execution error");
             }
-        } else if (dir->type == DIR_REDIRECT_MATCH) {
-            redir_rc = exec_redirect_match(session, dir);
-            if (redir_rc > 0) {
-                log_directive_ok(session, dir, "RedirectMatch");
-                htaccess_directives_free(directives);
+            i++;
+        }
+        if (first < rs->num_rules &&
+            log_redirect(session, rs->rules[first],
+                         exec_redirect_req(req, rs->rules[first]))) {
+            htaccess_config_release(cfg);
+            return LSI_OK;
+        }
+    } else {
+        for (dir = directives; dir != NULL; dir = dir->next) {
+            int rc;
+            if (dir->type == DIR_REDIRECT)
+                rc = exec_redirect_req(req, dir);
+            else if (dir->type == DIR_REDIRECT_MATCH)
+                rc = exec_redirect_match_req(req, dir);
+            else if (dir->type == DIR_REDIRECT_MAP)
+                rc = exec_redirect_map_req(req, dir);
+            else
+                continue;
+            if (log_redirect(session, dir, rc)) {
+                htaccess_config_release(cfg);
                 return LSI_OK;
-            } else if (redir_rc < 0) {
-                log_directive_fail(session, dir, "RedirectMatch",
-                                   "execution error");
             }
         }
     }
@@ -423,7 +548,7 @@ static int on_recv_req_header(lsi_session_t *session)
             env_rc = exec_setenv(session, dir);
             break;
         case DIR_SETENVIF:
-            env_rc = exec_setenvif(session, dir);
+            env_rc = exec_setenvif_req(req, dir);
             break;
         case DIR_BROWSER_MATCH:
             env_rc = exec_browser_match(session, dir);
@@ -438,11 +563,15 @@ static int on_recv_req_header(lsi_session_t *session)
     }
 
     /* (e) Brute force protection */
-    if (client_ip && ip_len > 0) {
-        rc = exec_brute_force(session, directives, client_ip);
-        if (rc == LSI_ERROR) {
+    int bf_rc = LSI_OK;
+    if (req->client_ip && req->client_ip_len > 0) {
+        bf_rc = htaccess_config_exec_brute_force(req, cfg);
+        if (bf_rc == LSI_ERROR) {
             lsi_log(session, LSI_LOG_DEBUG,
                     "mod_htaccess: request blocked by brute force protection");
+        } else if (bf_rc == LSI_SUSPEND) {
+            lsi_log(session, LSI_LOG_DEBUG,
+                    "mod_htaccess: request throttled by brute force");
         }
     }
 
@@ -464,8 +593,154 @@ static int on_recv_req_header(lsi_session_t *session)
         }
     }
 
-    htaccess_directives_free(directives);
-    return LSI_OK;
+    htaccess_config_release(cfg);
+    /* A throttled request waits on its timer without holding the worker */
+    return bf_rc == LSI_SUSPEND ? LSI_SUSPEND : LSI_OK;
+}
+
+/**
+ * Completion of a password check that suspended the request: finish the
+ * request phase, then let the server continue the request.
+ */
+static void on_auth_done(lsi_session_t *session, int rc, void *arg)
+{
+    htaccess_config_t *cfg = arg;
+
+    if (!session) {
+        /* The client went away while its password was hashed */
+        htaccess_config_release(cfg);
+        return;
+    }
+    if (rc == LSI_OK) {
+        htaccess_request_t req;
+        htaccess_request_init(&req, session);
+        /* A throttled request is resumed by its timer instead */
+        if (run_request_steps(session, &req, cfg) == LSI_SUSPEND)
+            return;
+    } else {
+        lsi_log(session, LSI_LOG_DEBUG,
+                "mod_htaccess: authentication failed");
+        htaccess_config_release(cfg);
+    }
+    lsi_session_resume(session);
+}
+
+/**
+ * on_recv_req_header — called at LSI_HKPT_RECV_REQ_HEADER.
+ *
+ * Flow:
+ * 1. Build the request context (doc_root, URI, method, parsed client IP)
+ * 2. Build target directory (strip filename from URI)
+ * 3. Get the cached effective config for the directory via DirWalker
+ * 4. Execute request-phase directives in order:
+ *    a. Access control — return immediately on deny
+ *    b. Redirects — return immediately on match
+ *    c. PHP configuration
+ *    d. Environment variables
+ *    e. Brute force protection (block check only; attempts are counted
+ *       in the response phase)
+ * 5. Release the config and return, or return LSI_SUSPEND for a
+ *    throttled request once the remaining steps have run
+ *
+ * When AuthType Basic has to hash a password, the request is suspended
+ * after step (a) and on_auth_done() runs steps (b) to (g) once the
+ * hashing pool has answered.
+ */
+static int on_recv_req_header(lsi_session_t *session)
+{
+    htaccess_request_t req;
+    htaccess_request_init(&req, session);
+
+    const char *doc_root = req.doc_root;
+    int doc_root_len = req.doc_root_len;
+    if (!doc_root || doc_root_len <= 0) {
+        lsi_log(session, LSI_LOG_DEBUG,
+                "mod_htaccess: no document root, skipping");
+        return LSI_OK;
+    }
+
+    const char *uri = req.uri;
+    int uri_len = req.uri_len;
+    if (!uri || uri_len <= 0) {
+        lsi_log(session, LSI_LOG_DEBUG,
+                "mod_htaccess: no request URI, skipping");
+        return LSI_OK;
+    }
+
+    /* Build target directory path */
+    char *target_dir = build_target_dir(doc_root, doc_root_len, uri, uri_len);
+    if (!target_dir) {
+        lsi_log(session, LSI_LOG_WARN,
+                "mod_htaccess: failed to allocate target directory");
+        return LSI_OK;
+    }
+
+    /* Get the effective config (merged + compiled) via DirWalker */
+    htaccess_config_t *cfg = htaccess_dirwalk_config(session, doc_root,
+                                                     target_dir);
+    free(target_dir);
+
+    if (!cfg) {
+        lsi_log(session, LSI_LOG_DEBUG,
+                "mod_htaccess: no directives found for request");
+        return LSI_OK;
+    }
+    const htaccess_directive_t *directives = cfg->directives;
+
+    /* (a) Access control */
+    int rc = htaccess_config_exec_acl(&req, cfg);
+    if (rc == LSI_ERROR) {
+        lsi_log(session, LSI_LOG_DEBUG,
+                "mod_htaccess: access denied by ACL");
+        htaccess_config_release(cfg);
+        return LSI_OK;
+    }
+
+    /* (a2) Apache 2.4 Require access control */
+    rc = htaccess_config_exec_require(&req, cfg);
+    if (rc == LSI_ERROR) {
+        lsi_log(session, LSI_LOG_DEBUG,
+                "mod_htaccess: access denied by Require");
+        htaccess_config_release(cfg);
+        return LSI_OK;
+    }
+
+    /* (a3) Limit/LimitExcept method restriction */
+    const char *http_method = req.method;
+    const htaccess_directive_t *dir;
+    for (dir = directives; dir != NULL; dir = dir->next) {
+        if (dir->type == DIR_LIMIT || dir->type == DIR_LIMIT_EXCEPT) {
+            if (http_method && limit_should_exec(dir, http_method)) {
+                /* Execute children of the Limit/LimitExcept block */
+                const htaccess_directive_t *child;
+                for (child = dir->data.limit.children; child; child = child->next) {
+                    /* Children may contain access control directives */
+                    if (child->type == DIR_REQUIRE_ALL_DENIED) {
+                        lsi_session_set_status(session, 403);
+                        htaccess_config_release(cfg);
+                        return LSI_OK;
+                    }
+                }
+            }
+        }
+    }
+
+    /* (a4) AuthType Basic authentication */
+    rc = exec_auth_basic_async(session, directives, on_auth_done, cfg);
+    if (rc == LSI_SUSPEND) {
+        /* on_auth_done() runs the remaining steps and owns cfg */
+        lsi_log(session, LSI_LOG_DEBUG,
+                "mod_htaccess: waiting for password check");
+        return LSI_SUSPEND;
+    }
+    if (rc == LSI_ERROR) {
+        lsi_log(session, LSI_LOG_DEBUG,
+                "mod_htaccess: authentication failed");
+        htaccess_config_release(cfg);
+        return LSI_OK;
+    }
+
+    return run_request_steps(session, &req, cfg);
 }
 
 /* ------------------------------------------------------------------ */
@@ -476,43 +751,43 @@ static int on_recv_req_header(lsi_session_t *session)
  * on_send_resp_header — called at LSI_HKPT_SEND_RESP_HEADER.
  *
  * Flow:
- * 1. Get doc_root and URI, build target directory
- * 2. Call DirWalker to get merged directives
+ * 1. Build the request context, build target directory
+ * 2. Get the cached effective config via DirWalker
  * 3. Extract filename from URI for FilesMatch
  * 4. Execute response-phase directives:
  *    a. Header / RequestHeader directives
  *    b. FilesMatch conditional blocks
  *    c. Expires directives
  *    d. ErrorDocument directives
- * 5. Free directives and return
+ *    e. Brute force accounting of failed attempts (by final status)
+ * 5. Release the config and return
  */
 static int on_send_resp_header(lsi_session_t *session)
 {
-    int doc_root_len = 0;
-    const char *doc_root = lsi_session_get_doc_root(session, &doc_root_len);
-    if (!doc_root || doc_root_len <= 0)
+    htaccess_request_t req;
+    htaccess_request_init(&req, session);
+    if (!req.doc_root || req.doc_root_len <= 0)
         return LSI_OK;
-
-    int uri_len = 0;
-    const char *uri = lsi_session_get_uri(session, &uri_len);
-    if (!uri || uri_len <= 0)
+    if (!req.uri || req.uri_len <= 0)
         return LSI_OK;
 
     /* Build target directory */
-    char *target_dir = build_target_dir(doc_root, doc_root_len, uri, uri_len);
+    char *target_dir = build_target_dir(req.doc_root, req.doc_root_len,
+                                        req.uri, req.uri_len);
     if (!target_dir)
         return LSI_OK;
 
-    /* Collect merged directives */
-    htaccess_directive_t *directives = htaccess_dirwalk(session, doc_root,
-                                                         target_dir);
+    /* Get the effective config */
+    htaccess_config_t *cfg = htaccess_dirwalk_config(session, req.doc_root,
+                                                     target_dir);
     free(target_dir);
 
-    if (!directives)
+    if (!cfg)
         return LSI_OK;
+    const htaccess_directive_t *directives = cfg->directives;
 
-    /* Extract filename for FilesMatch */
-    const char *filename = extract_filename(uri, uri_len);
+    /* Filename for Files/FilesMatch and the Add* directives */
+    const char *filename = req.filename;
 
     /* (a) Header / RequestHeader directives */
     const htaccess_directive_t *dir;
@@ -621,6 +896,29 @@ static int on_send_resp_header(lsi_session_t *session)
             exec_set_handler(session, dir);
     }
 
-    htaccess_directives_free(directives);
+    /* (g) Brute force accounting: count the attempt if it failed */
+    if (req.client_ip && req.client_ip_len > 0)
+        htaccess_config_exec_brute_force_resp(&req, cfg,
+                                              lsi_session_get_status(session));
+
+    htaccess_config_release(cfg);
+    return LSI_OK;
+}
+
+/* ------------------------------------------------------------------ */
+/*  Session end                                                        */
+/* ------------------------------------------------------------------ */
+
+/**
+ * on_http_end — called at LSI_HKPT_HTTP_END.
+ *
+ * A request suspended on a password check or a throttle timer can end
+ * (client disconnect, timeout) before it is resumed; detach it so the
+ * completion does not use the freed session.
+ */
+static int on_http_end(lsi_session_t *session)
+{
+    exec_auth_session_end(session);
+    exec_brute_force_session_end(session);
     return LSI_OK;
 }
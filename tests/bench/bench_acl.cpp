@@ -0,0 +1,203 @@
+/**
+ * bench_acl.cpp - Throughput benchmark for large Allow/Deny lists
+ *
+ * Parses a .htaccess with 100k "Deny from" CIDRs (the size of a typical
+ * country blocklist), compiles it into the ACL's normalized interval sets
+ * and measures lookups per second against the per-request linear scan.
+ * The same rules are also loaded into a prefix trie to compare footprint
+ * and lookup latency of both structures. The run is repeated with IPv6
+ * rules and clients to compare both families.
+ *
+ * Not part of CTest; run the binary directly.
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ip_trie.h"
+#include "mock_lsiapi.h"
+
+extern "C" {
+#include "htaccess_exec_acl.h"
+#include "htaccess_parser.h"
+}
+
+using bench_clock = std::chrono::steady_clock;
+
+static double seconds_since(bench_clock::time_point start)
+{
+    return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+static std::string v4_string(uint32_t ip)
+{
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", ip >> 24, (ip >> 16) & 0xFF,
+             (ip >> 8) & 0xFF, ip & 0xFF);
+    return buf;
+}
+
+static std::string v6_string(uint64_t hi, uint64_t lo)
+{
+    char buf[48];
+    snprintf(buf, sizeof(buf), "%x:%x:%x:%x:%x:%x:%x:%x",
+             (unsigned)(hi >> 48), (unsigned)(hi >> 32) & 0xFFFF,
+             (unsigned)(hi >> 16) & 0xFFFF, (unsigned)hi & 0xFFFF,
+             (unsigned)(lo >> 48), (unsigned)(lo >> 32) & 0xFFFF,
+             (unsigned)(lo >> 16) & 0xFFFF, (unsigned)lo & 0xFFFF);
+    return buf;
+}
+
+/* Random rule text: IPv4 /16../32 or IPv6 /32../64 under 2000::/4 */
+static std::string random_rule(std::mt19937_64 &rng, bool six)
+{
+    if (!six) {
+        int len = 16 + (int)(rng() % 17);
+        uint32_t mask = ~(uint32_t)0 << (32 - len);
+        return v4_string((uint32_t)rng() & mask) + "/" + std::to_string(len);
+    }
+    int len = 32 + (int)(rng() % 33);
+    uint64_t hi = (rng() >> 4) | (2ULL << 60);
+    hi &= len == 64 ? ~0ULL : ~0ULL << (64 - len);
+    return v6_string(hi, 0) + "/" + std::to_string(len);
+}
+
+/* Client text; inside a random rule half of the time */
+static std::string random_client(std::mt19937_64 &rng, bool six,
+                                 const std::vector<ip_cidr_t> &rules)
+{
+    ip_addr_t a;
+    if (rng() & 1) {
+        const ip_cidr_t &r = rules[rng() % rules.size()];
+        unsigned host_bits = 128 - r.prefix_len;
+        a = r.network;
+        a.lo |= host_bits >= 64 ? rng() : rng() & ((1ULL << host_bits) - 1);
+        if (host_bits > 64)
+            a.hi |= rng() & ((1ULL << (host_bits - 64)) - 1);
+    } else if (six) {
+        a.hi = (rng() >> 4) | (2ULL << 60);
+        a.lo = rng();
+    } else {
+        ip_addr_from_v4((uint32_t)rng(), &a);
+    }
+    return six ? v6_string(a.hi, a.lo) : v4_string((uint32_t)a.lo);
+}
+
+static void run(int num_rules, bool six)
+{
+    const int lookups = 2000000;
+    const int exec_calls = 200000;
+    const int linear_calls = 2000;
+
+    std::mt19937_64 rng(42);
+    std::string text = "Order Deny,Allow\n";
+    std::vector<ip_cidr_t> rules(num_rules);
+    for (int i = 0; i < num_rules; i++) {
+        std::string rule = random_rule(rng, six);
+        ip_cidr_parse(rule.c_str(), &rules[i]);
+        text += "Deny from " + rule + "\n";
+    }
+
+    auto t0 = bench_clock::now();
+    htaccess_directive_t *dirs = htaccess_parse(text.c_str(), text.size(),
+                                                "bench");
+    double parse_s = seconds_since(t0);
+
+    acl_compiled_t acl;
+    t0 = bench_clock::now();
+    if (acl_compile(dirs, &acl) != 0) {
+        fprintf(stderr, "acl_compile failed\n");
+        exit(1);
+    }
+    double compile_s = seconds_since(t0);
+
+    ip_trie_t trie;
+    ip_trie_init(&trie);
+    t0 = bench_clock::now();
+    for (const ip_cidr_t &r : rules) {
+        if (ip_trie_insert(&trie, &r) != 0) {
+            fprintf(stderr, "ip_trie_insert failed\n");
+            exit(1);
+        }
+    }
+    double trie_compile_s = seconds_since(t0);
+
+    std::vector<std::string> clients(4096);
+    std::vector<ip_addr_t> probes(clients.size());
+    for (size_t i = 0; i < clients.size(); i++) {
+        clients[i] = random_client(rng, six, rules);
+        ip_addr_parse(clients[i].c_str(), &probes[i]);
+    }
+
+    /* Raw interval set lookups (the structure the ACL uses) */
+    unsigned hits = 0;
+    t0 = bench_clock::now();
+    for (int i = 0; i < lookups; i++)
+        hits += (unsigned)cidr_set_match(&acl.deny, &probes[i & 4095]);
+    double set_s = seconds_since(t0);
+
+    /* Same probes against the prefix trie */
+    unsigned trie_hits = 0;
+    t0 = bench_clock::now();
+    for (int i = 0; i < lookups; i++)
+        trie_hits += (unsigned)ip_trie_match(&trie, &probes[i & 4095]);
+    double trie_s = seconds_since(t0);
+    if (trie_hits != hits) {
+        fprintf(stderr, "interval set disagrees with trie\n");
+        exit(1);
+    }
+
+    /* End-to-end executor calls through the mock session */
+    MockSession session;
+    t0 = bench_clock::now();
+    for (int i = 0; i < exec_calls; i++) {
+        session.set_client_ip(clients[i & 4095]);
+        exec_access_control_compiled(session.handle(), &acl);
+    }
+    double exec_s = seconds_since(t0);
+
+    t0 = bench_clock::now();
+    for (int i = 0; i < linear_calls; i++) {
+        session.set_client_ip(clients[i & 4095]);
+        exec_access_control(session.handle(), dirs);
+    }
+    double linear_s = seconds_since(t0);
+
+    printf("[%s] rules:                %d\n", six ? "ipv6" : "ipv4", num_rules);
+    printf("[%s] parse:                %.3f s\n", six ? "ipv6" : "ipv4",
+           parse_s);
+    printf("[%s] set compile:          %.3f s\n", six ? "ipv6" : "ipv4",
+           compile_s);
+    printf("[%s] set memory:           %.1f KiB (%d intervals)\n",
+           six ? "ipv6" : "ipv4", cidr_set_memory(&acl.deny) / 1024.0,
+           acl.deny.count);
+    printf("[%s] set lookups/s:        %.0f (%.1f ns, hits %u)\n",
+           six ? "ipv6" : "ipv4", lookups / set_s, set_s * 1e9 / lookups,
+           hits);
+    printf("[%s] trie compile:         %.3f s\n", six ? "ipv6" : "ipv4",
+           trie_compile_s);
+    printf("[%s] trie memory:          %.1f KiB (%u nodes)\n",
+           six ? "ipv6" : "ipv4", ip_trie_memory(&trie) / 1024.0, trie.count);
+    printf("[%s] trie lookups/s:       %.0f (%.1f ns)\n",
+           six ? "ipv6" : "ipv4", lookups / trie_s, trie_s * 1e9 / lookups);
+    printf("[%s] compiled exec req/s:  %.0f\n", six ? "ipv6" : "ipv4",
+           exec_calls / exec_s);
+    printf("[%s] linear exec req/s:    %.0f\n", six ? "ipv6" : "ipv4",
+           linear_calls / linear_s);
+
+    ip_trie_free(&trie);
+    acl_compiled_free(&acl);
+    htaccess_directives_free(dirs);
+}
+
+int main(int argc, char **argv)
+{
+    int num_rules = argc > 1 ? atoi(argv[1]) : 100000;
+    run(num_rules, false);
+    run(num_rules, true);
+    return 0;
+}
@@ -0,0 +1,99 @@
+/**
+ * bench_auth.cpp - Throughput of Basic-authenticated requests
+ *
+ * Replays requests for a protected page and its assets, all carrying the
+ * same valid credentials against a bcrypt AuthUserFile entry, first with
+ * the verified-credential table disabled (every request runs crypt())
+ * and then with it enabled. Reports requests per second for both runs.
+ *
+ * Not part of CTest; run the binary directly:
+ *   bench_auth [requests] [bcrypt cost]
+ */
+#include <chrono>
+#include <crypt.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+
+#include "mock_lsiapi.h"
+
+extern "C" {
+#include "htaccess_exec_auth.h"
+#include "htaccess_htpasswd.h"
+#include "htaccess_parser.h"
+}
+
+using bench_clock = std::chrono::steady_clock;
+
+static double seconds_since(bench_clock::time_point start)
+{
+    return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+static double run(const htaccess_directive_t *dirs, int requests)
+{
+    MockSession session;
+    int passed = 0;
+
+    auto t0 = bench_clock::now();
+    for (int i = 0; i < requests; i++) {
+        session.reset();
+        /* admin:correct horse */
+        session.set_auth_header("Basic YWRtaW46Y29ycmVjdCBob3JzZQ==");
+        if (exec_auth_basic(session.handle(), dirs) == LSI_OK)
+            passed++;
+    }
+    double s = seconds_since(t0);
+    if (passed != requests)
+        fprintf(stderr, "only %d of %d requests passed\n", passed, requests);
+    return requests / s;
+}
+
+int main(int argc, char **argv)
+{
+    int requests = argc > 1 ? atoi(argv[1]) : 50;
+    int cost = argc > 2 ? atoi(argv[2]) : 10;
+    char file[] = "/tmp/bench_auth_XXXXXX";
+    int fd = mkstemp(file);
+    const char *salt = crypt_gensalt("$2y$", (unsigned long)cost, nullptr, 0);
+    const char *hash = salt ? crypt("correct horse", salt) : nullptr;
+
+    if (fd < 0 || !hash) {
+        fprintf(stderr, "setup failed\n");
+        return 1;
+    }
+    std::string line = std::string("admin:") + hash + "\n";
+    if (write(fd, line.data(), line.size()) != (ssize_t)line.size()) {
+        fprintf(stderr, "setup failed\n");
+        return 1;
+    }
+    close(fd);
+
+    std::string conf = std::string("AuthType Basic\n"
+                                   "AuthName \"Admin\"\n"
+                                   "AuthUserFile ") + file + "\n"
+                       "Require valid-user\n";
+    htaccess_directive_t *dirs = htaccess_parse(conf.c_str(), conf.size(),
+                                                "bench");
+
+    htpasswd_verified_set_ttl(0);
+    double before = run(dirs, requests);
+    htpasswd_verified_set_ttl(HTPASSWD_VERIFIED_TTL);
+    double after = run(dirs, requests);
+
+    htpasswd_stats_t stats;
+    htpasswd_cache_get_stats(&stats);
+    printf("hash:                 bcrypt cost %d\n", cost);
+    printf("requests:             %d per run\n", requests);
+    printf("crypt every request:  %.1f requests/s\n", before);
+    printf("verified cache:       %.1f requests/s\n", after);
+    printf("verified hits:        %llu\n",
+           (unsigned long long)stats.verified_hits);
+
+    htaccess_directives_free(dirs);
+    htpasswd_cache_destroy();
+    unlink(file);
+    return 0;
+}
@@ -0,0 +1,154 @@
+/**
+ * bench_brute_force.cpp - Load test for brute force tracking under
+ * address rotation
+ *
+ * Simulates attackers that draw a fresh source address for every login
+ * attempt, mixed with a population of ordinary clients, against a small
+ * shared table:
+ *   - an IPv6 attacker rotating inside one /64, with and without the
+ *     default /64 aggregation,
+ *   - an IPv4 attacker rotating inside one /24 with /24 aggregation,
+ *   - a botnet scattered over the whole IPv4 space (nothing to aggregate).
+ * For each run it reports request throughput, how many attacker attempts
+ * got through, whether ordinary clients were blocked, and the table's
+ * occupancy, evictions and insert failures, which must stay bounded by
+ * the configured capacity.
+ *
+ * Not part of CTest; run the binary directly.
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "mock_lsiapi.h"
+
+extern "C" {
+#include "htaccess_exec_brute_force.h"
+#include "htaccess_parser.h"
+#include "htaccess_shm.h"
+}
+
+using bench_clock = std::chrono::steady_clock;
+
+static double seconds_since(bench_clock::time_point start)
+{
+    return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+enum attack_t { ROTATE_V6_64, ROTATE_V4_24, SCATTER_V4 };
+
+static void attacker_ip(std::mt19937_64 &rng, attack_t attack, char *buf,
+                        size_t len)
+{
+    uint64_t r = rng();
+    switch (attack) {
+    case ROTATE_V6_64:
+        snprintf(buf, len, "2001:db8:bad:1:%x:%x:%x:%x",
+                 (unsigned)(r >> 48), (unsigned)(r >> 32) & 0xFFFF,
+                 (unsigned)(r >> 16) & 0xFFFF, (unsigned)r & 0xFFFF);
+        break;
+    case ROTATE_V4_24:
+        snprintf(buf, len, "203.0.113.%u", (unsigned)(r % 254) + 1);
+        break;
+    case SCATTER_V4:
+        snprintf(buf, len, "%u.%u.%u.%u", (unsigned)(r >> 24) & 0xFF,
+                 (unsigned)(r >> 16) & 0xFF, (unsigned)(r >> 8) & 0xFF,
+                 (unsigned)r & 0xFF);
+        break;
+    }
+}
+
+/*
+ * Ordinary clients: one address each, in networks of their own, spread
+ * over both families.
+ */
+static void client_ip(int i, char *buf, size_t len)
+{
+    if (i & 1)
+        snprintf(buf, len, "2001:db8:%x:%x::1", 0x100 + (i >> 16),
+                 i & 0xFFFF);
+    else
+        snprintf(buf, len, "10.%d.%d.1", (i >> 8) & 0xFF, i & 0xFF);
+}
+
+static void run(const char *tag, attack_t attack, const char *config,
+                size_t capacity, int requests, int clients)
+{
+    htaccess_directive_t *dirs = htaccess_parse(config, strlen(config),
+                                                "bench");
+    MockSession session;
+    std::mt19937_64 rng(42);
+    char ip[64];
+    int attacker_sent = 0, attacker_passed = 0;
+    int client_sent = 0, client_blocked = 0;
+    shm_stats_t stats;
+
+    shm_destroy();
+    if (!dirs || shm_init(nullptr, capacity) != 0) {
+        fprintf(stderr, "%s: setup failed\n", tag);
+        htaccess_directives_free(dirs);
+        return;
+    }
+
+    /*
+     * Nine attacker attempts for every ordinary one. Ordinary clients
+     * take turns, so each fails a few times, under its allowance.
+     */
+    auto t0 = bench_clock::now();
+    for (int i = 0; i < requests; i++) {
+        session.reset();
+        if (i % 10 != 9) {
+            attacker_ip(rng, attack, ip, sizeof(ip));
+            attacker_sent++;
+            if (exec_brute_force(session.handle(), dirs, ip) == LSI_OK)
+                attacker_passed++;
+        } else {
+            client_ip(client_sent % clients, ip, sizeof(ip));
+            client_sent++;
+            if (exec_brute_force(session.handle(), dirs, ip) != LSI_OK)
+                client_blocked++;
+        }
+    }
+    double run_s = seconds_since(t0);
+
+    shm_get_stats(&stats);
+    printf("[%s] requests/s:           %.0f\n", tag, requests / run_s);
+    printf("[%s] attacker passed:      %d of %d\n", tag, attacker_passed,
+           attacker_sent);
+    printf("[%s] clients blocked:      %d of %d\n", tag, client_blocked,
+           client_sent);
+    printf("[%s] occupied:             %zu of %zu\n", tag, stats.occupied,
+           stats.capacity);
+    printf("[%s] evictions:            %llu\n", tag,
+           (unsigned long long)stats.evictions);
+    printf("[%s] insert failures:      %llu\n", tag,
+           (unsigned long long)stats.insert_failures);
+
+    shm_destroy();
+    htaccess_directives_free(dirs);
+}
+
+int main(int argc, char **argv)
+{
+    int requests = argc > 1 ? atoi(argv[1]) : 1000000;
+    size_t capacity = argc > 2 ? (size_t)atol(argv[2]) : 4096;
+    /* Three attempts per ordinary client; allowance is five */
+    int clients = requests / 30 > 0 ? requests / 30 : 1;
+    const char *base = "BruteForceProtection On\n"
+                       "BruteForceAllowedAttempts 5\n"
+                       "BruteForceWindow 300\n"
+                       "BruteForceAction block\n";
+
+    run("v6-rotate-agg", ROTATE_V6_64, base, capacity, requests, clients);
+    run("v6-rotate-noagg", ROTATE_V6_64,
+        (std::string(base) + "BruteForceIPv6Prefix 0\n").c_str(), capacity,
+        requests, clients);
+    run("v4-rotate-agg", ROTATE_V4_24,
+        (std::string(base) + "BruteForceIPv4Prefix 24\n").c_str(), capacity,
+        requests, clients);
+    run("v4-scatter", SCATTER_V4, base, capacity, requests, clients);
+    return 0;
+}
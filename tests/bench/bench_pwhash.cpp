@@ -0,0 +1,108 @@
+/**
+ * bench_pwhash.cpp - Password verifications per second by hash format
+ *
+ * For each htpasswd hash format, times repeated checks of a correct
+ * password through the native verifier (pwhash_check) and through libc
+ * crypt_r(), and reports verifications per second for both. bcrypt has
+ * no native verifier and is listed for comparison.
+ *
+ * Not part of CTest; run the binary directly:
+ *   bench_pwhash [min seconds per row]
+ */
+#include <chrono>
+#include <crypt.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+extern "C" {
+#include "htaccess_pwhash.h"
+}
+
+using bench_clock = std::chrono::steady_clock;
+
+static const char *kPassword = "correct horse";
+
+static double seconds_since(bench_clock::time_point start)
+{
+    return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+/* Run `check` until `min_s` seconds pass; returns checks per second. */
+template <typename F>
+static double rate(double min_s, F check)
+{
+    long n = 0;
+    auto t0 = bench_clock::now();
+    double s;
+    do {
+        for (int i = 0; i < 8; i++) {
+            if (!check()) {
+                fprintf(stderr, "verification failed\n");
+                exit(1);
+            }
+        }
+        n += 8;
+    } while ((s = seconds_since(t0)) < min_s);
+    return n / s;
+}
+
+int main(int argc, char **argv)
+{
+    double min_s = argc > 1 ? atof(argv[1]) : 0.5;
+    struct {
+        const char *label;
+        std::string hash;
+    } rows[] = {
+        {"apr1", ""},
+        {"md5-crypt", ""},
+        {"{SHA}", ""},
+        {"sha256-crypt", ""},
+        {"sha512-crypt", ""},
+        {"bcrypt cost 5", ""},
+    };
+    struct crypt_data *data =
+        static_cast<struct crypt_data *>(calloc(1, sizeof(*data)));
+    const char *bsalt = crypt_gensalt("$2y$", 5, nullptr, 0);
+
+    if (!data || !bsalt) {
+        fprintf(stderr, "setup failed\n");
+        return 1;
+    }
+    /* `openssl passwd -apr1` of "myPassword" */
+    rows[0].hash = "$apr1$qHDFfhPC$nITSVHgYbDAK1Y0acGRnY0";
+    rows[1].hash = crypt(kPassword, "$1$saltsalt$");
+    /* SHA-1 of "correct horse" */
+    rows[2].hash = "{SHA}L55TUjtiq8FBorTWAZ0jy6g129A=";
+    rows[3].hash = crypt(kPassword, "$5$saltstring$");
+    rows[4].hash = crypt(kPassword, "$6$saltstring$");
+    rows[5].hash = crypt(kPassword, bsalt);
+
+    printf("%-14s %-13s %14s %14s\n", "format", "verifier", "native/s",
+           "libc crypt/s");
+    for (auto &row : rows) {
+        const char *hash = row.hash.c_str();
+        const char *pw = row.label[0] == 'a' ? "myPassword" : kPassword;
+        pwhash_format_t fmt = pwhash_detect(hash);
+        double native = rate(min_s, [&] {
+            return pwhash_verify(fmt, hash, pw) == 1;
+        });
+        /* glibc/libxcrypt crypt() does not know apr1 or {SHA} */
+        const char *out = crypt_r(pw, hash, data);
+        bool libc_ok = out && strcmp(out, hash) == 0;
+        double libc = libc_ok ? rate(min_s, [&] {
+            const char *o = crypt_r(pw, hash, data);
+            return o && strcmp(o, hash) == 0;
+        }) : 0.0;
+        char libc_col[32];
+        if (libc_ok)
+            snprintf(libc_col, sizeof(libc_col), "%14.0f", libc);
+        else
+            snprintf(libc_col, sizeof(libc_col), "%14s", "unsupported");
+        printf("%-14s %-13s %14.0f %s\n", row.label,
+               pwhash_format_name(fmt), native, libc_col);
+    }
+    free(data);
+    return 0;
+}
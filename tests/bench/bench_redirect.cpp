@@ -0,0 +1,265 @@
+/**
+ * bench_redirect.cpp - Redirect lookup cost against the size of the set
+ *
+ * Builds configs with N plain Redirect directives and times finding the
+ * first matching rule for a URI that matches the last rule and for one
+ * that matches none, both with the linear scan the executor used to do
+ * and with the compiled prefix trie (redirect_set_first_prefix).
+ *
+ * A second table does the same for N RedirectMatch directives: compiling
+ * and running every regex per request (the executor's old behaviour),
+ * running every precompiled regex, and the regex set with its literal
+ * prefilter (redirect_set_first_match).
+ *
+ * A third table times RedirectMap files of N entries: compiling the text,
+ * and looking up a URI (redirect_map_lookup, including its stat() of the
+ * map file).
+ *
+ * Not part of CTest; run the binary directly:
+ *   bench_redirect [min seconds per row]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <regex.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+extern "C" {
+#include "htaccess_exec_redirect.h"
+#include "htaccess_parser.h"
+#include "htaccess_redirect_map.h"
+}
+
+using bench_clock = std::chrono::steady_clock;
+
+static volatile size_t g_sink;
+
+/* Run `lookup` until `min_s` seconds pass; returns ns per lookup. */
+template <typename F>
+static double ns_per_op(double min_s, F lookup)
+{
+    long n = 0;
+    auto t0 = bench_clock::now();
+    double s;
+    do {
+        for (int i = 0; i < 16; i++)
+            g_sink = lookup();
+        n += 16;
+        s = std::chrono::duration<double>(bench_clock::now() - t0).count();
+    } while (s < min_s);
+    return s * 1e9 / n;
+}
+
+/* First Redirect whose prefix matches, scanning the list in order */
+static size_t linear_first(const htaccess_directive_t *dirs,
+                           const char *uri, size_t len)
+{
+    size_t i = 0;
+    for (const htaccess_directive_t *d = dirs; d; d = d->next, i++) {
+        size_t plen = strlen(d->name);
+        if (plen <= len && memcmp(uri, d->name, plen) == 0)
+            return i;
+    }
+    return i;
+}
+
+/* First RedirectMatch that matches, compiling each pattern per lookup */
+static size_t regcomp_first(const htaccess_directive_t *dirs,
+                            const char *uri)
+{
+    size_t i = 0;
+    for (const htaccess_directive_t *d = dirs; d; d = d->next, i++) {
+        regex_t re;
+        regmatch_t m[10];
+        if (regcomp(&re, d->data.redirect.pattern, REG_EXTENDED) != 0)
+            continue;
+        int rc = regexec(&re, uri, 10, m, 0);
+        regfree(&re);
+        if (rc == 0)
+            return i;
+    }
+    return i;
+}
+
+/* First RedirectMatch that matches, running each precompiled regex */
+static size_t regexec_first(const std::vector<regex_t> &res, const char *uri)
+{
+    for (size_t i = 0; i < res.size(); i++)
+        if (regexec(&res[i], uri, 0, nullptr, 0) == 0)
+            return i;
+    return res.size();
+}
+
+static int bench_redirect_match(double min_s)
+{
+    printf("\n%8s %-8s %14s %14s %14s\n", "matches", "uri",
+           "regcomp ns", "regexec ns", "set ns");
+    for (int n : {10, 100, 1000}) {
+        std::string conf;
+        for (int i = 0; i < n; i++)
+            conf += "RedirectMatch 301 ^/legacy/section-" +
+                    std::to_string(i) + "/(.*)\\.html$ "
+                    "https://example.com/new/" + std::to_string(i) +
+                    "/$1\n";
+        htaccess_directive_t *dirs = htaccess_parse(conf.c_str(),
+                                                    conf.size(), "bench");
+        redirect_set_t set;
+        if (!dirs || redirect_set_compile(dirs, &set) != 0 ||
+            set.num_regex != (size_t)n) {
+            fprintf(stderr, "setup failed\n");
+            return 1;
+        }
+        std::vector<regex_t> res(n);
+        for (int i = 0; i < n; i++)
+            regcomp(&res[i], set.rules[i]->data.redirect.pattern,
+                    REG_EXTENDED);
+        std::string hit = "/legacy/section-" + std::to_string(n - 1) +
+                          "/page/index.html";
+        const char *miss = "/legacy/section-x/page/index.html";
+        struct {
+            const char *label;
+            const char *uri;
+            size_t want;
+        } rows[] = {
+            {"last", hit.c_str(), (size_t)n - 1},
+            {"none", miss, (size_t)n},
+        };
+        for (auto &row : rows) {
+            size_t len = strlen(row.uri);
+            if (regexec_first(res, row.uri) != row.want ||
+                redirect_set_first_match(&set, row.uri, len, 0,
+                                         set.num_rules) != row.want) {
+                fprintf(stderr, "lookup mismatch\n");
+                return 1;
+            }
+            double comp = n <= 100 ? ns_per_op(min_s, [&] {
+                return regcomp_first(dirs, row.uri);
+            }) : 0.0;
+            double exec = ns_per_op(min_s, [&] {
+                return regexec_first(res, row.uri);
+            });
+            double fast = ns_per_op(min_s, [&] {
+                return redirect_set_first_match(&set, row.uri, len, 0,
+                                                set.num_rules);
+            });
+            char comp_col[32];
+            if (comp > 0)
+                snprintf(comp_col, sizeof(comp_col), "%14.0f", comp);
+            else
+                snprintf(comp_col, sizeof(comp_col), "%14s", "-");
+            printf("%8d %-8s %s %14.0f %14.1f\n", n, row.label, comp_col,
+                   exec, fast);
+        }
+        for (auto &re : res)
+            regfree(&re);
+        redirect_set_free(&set);
+        htaccess_directives_free(dirs);
+    }
+    return 0;
+}
+
+static int bench_redirect_map(double min_s)
+{
+    char dir[] = "/tmp/bench_redirect_XXXXXX";
+    if (!mkdtemp(dir)) {
+        fprintf(stderr, "setup failed\n");
+        return 1;
+    }
+    std::string map = std::string(dir) + "/map.txt";
+    std::string rmap = map + REDIRECT_MAP_SUFFIX;
+
+    printf("\n%8s %14s %14s %14s\n", "entries", "compile ms", "hit ns",
+           "miss ns");
+    for (int n : {1000, 100000, 1000000}) {
+        FILE *f = fopen(map.c_str(), "w");
+        if (!f)
+            return 1;
+        for (int i = 0; i < n; i++)
+            fprintf(f, "/legacy/section-%d/page https://example.com/new/%d\n",
+                    i, i);
+        fclose(f);
+
+        auto t0 = bench_clock::now();
+        if (redirect_map_compile(map.c_str(), rmap.c_str()) != n) {
+            fprintf(stderr, "compile failed\n");
+            return 1;
+        }
+        double build_ms = std::chrono::duration<double, std::milli>(
+                              bench_clock::now() - t0).count();
+        std::string hit = "/legacy/section-" + std::to_string(n / 2) +
+                          "/page";
+        const char *miss = "/legacy/section-x/page";
+        const char *target;
+        size_t len;
+        double hit_ns = ns_per_op(min_s, [&] {
+            return (size_t)redirect_map_lookup(map.c_str(), hit.c_str(),
+                                               hit.size(), &target, &len);
+        });
+        double miss_ns = ns_per_op(min_s, [&] {
+            return (size_t)redirect_map_lookup(map.c_str(), miss,
+                                               strlen(miss), &target, &len);
+        });
+        printf("%8d %14.1f %14.1f %14.1f\n", n, build_ms, hit_ns, miss_ns);
+        redirect_map_cache_destroy();
+    }
+    unlink(map.c_str());
+    unlink(rmap.c_str());
+    rmdir(dir);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    double min_s = argc > 1 ? atof(argv[1]) : 0.3;
+
+    printf("%8s %-8s %14s %14s\n", "rules", "uri", "linear ns", "trie ns");
+    for (int n : {10, 100, 1000, 10000, 50000}) {
+        std::string conf;
+        for (int i = 0; i < n; i++)
+            conf += "Redirect 301 /legacy/section-" + std::to_string(i) +
+                    "/page https://example.com/new/" + std::to_string(i) +
+                    "\n";
+        htaccess_directive_t *dirs = htaccess_parse(conf.c_str(),
+                                                    conf.size(), "bench");
+        redirect_set_t set;
+        if (!dirs || redirect_set_compile(dirs, &set) != 0 ||
+            set.num_rules != (size_t)n) {
+            fprintf(stderr, "setup failed\n");
+            return 1;
+        }
+        std::string hit = "/legacy/section-" + std::to_string(n - 1) +
+                          "/page/index.html";
+        const char *miss = "/legacy/section-x/page/index.html";
+        struct {
+            const char *label;
+            const char *uri;
+            size_t want;
+        } rows[] = {
+            {"last", hit.c_str(), (size_t)n - 1},
+            {"none", miss, (size_t)n},
+        };
+        for (auto &row : rows) {
+            size_t len = strlen(row.uri);
+            if (linear_first(dirs, row.uri, len) != row.want ||
+                redirect_set_first_prefix(&set, row.uri, len) != row.want) {
+                fprintf(stderr, "lookup mismatch\n");
+                return 1;
+            }
+            double lin = ns_per_op(min_s, [&] {
+                return linear_first(dirs, row.uri, len);
+            });
+            double trie = ns_per_op(min_s, [&] {
+                return redirect_set_first_prefix(&set, row.uri, len);
+            });
+            printf("%8d %-8s %14.1f %14.1f\n", n, row.label, lin, trie);
+        }
+        redirect_set_free(&set);
+        htaccess_directives_free(dirs);
+    }
+    if (bench_redirect_match(min_s) != 0)
+        return 1;
+    return bench_redirect_map(min_s);
+}
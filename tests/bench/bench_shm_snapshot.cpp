@@ -0,0 +1,119 @@
+/**
+ * bench_shm_snapshot.cpp - Checkpoint and reload cost of the brute force
+ * table
+ *
+ * Fills a table with live records (a mix of counting windows, blocks and
+ * records that have already expired), writes a snapshot, changes 1% of
+ * the records and checkpoints again, then reloads the snapshot into a
+ * freshly formatted table the way shm_init() does after a restart.
+ * Reports the full and incremental save times, the shm_init() time, and
+ * the time shm_restore() steps take to bring the rest back.
+ *
+ * Not part of CTest; run the binary directly:
+ *   bench_shm_snapshot [records] [dir]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <unistd.h>
+
+extern "C" {
+#include "htaccess_shm.h"
+}
+
+using bench_clock = std::chrono::steady_clock;
+
+static double ms_since(bench_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(bench_clock::now() -
+                                                     start).count();
+}
+
+int main(int argc, char **argv)
+{
+    size_t records = argc > 1 ? (size_t)atol(argv[1]) : 1000000;
+    std::string dir = argc > 2 ? argv[2] : "/tmp/bench_shm_snapshot";
+    /* Keep the table about two thirds full */
+    size_t capacity = records + records / 2;
+    time_t now = time(nullptr);
+    size_t expired = 0;
+
+    if (shm_set_snapshot_dir(dir.c_str()) != 0 ||
+        shm_init(nullptr, capacity) != 0) {
+        fprintf(stderr, "setup failed\n");
+        return 1;
+    }
+    for (size_t i = 0; i < records; i++) {
+        ip_addr_t a;
+        a.hi = 0x20010db800000000ULL | (i >> 16);
+        a.lo = (uint64_t)i * 0x9E3779B97F4A7C15ULL;
+        if (i % 8 == 0) {
+            brute_force_record_t rec = {};
+            rec.attempt_count = 10;
+            rec.first_attempt = now;
+            rec.blocked_until = now + 3600;
+            shm_update_record(&a, &rec);
+        } else if (i % 8 == 1) {
+            /* Still in the table, but its window is over */
+            shm_record_attempt(&a, now - 1000, 300, 10, nullptr);
+            expired++;
+        } else {
+            shm_record_attempt(&a, now, 300, 10, nullptr);
+        }
+    }
+
+    auto t0 = bench_clock::now();
+    int saved = shm_snapshot_save(now);
+    double save_ms = ms_since(t0);
+
+    /* Touch 1% of the records, spread over the table */
+    for (size_t i = 0; i < records; i += 100) {
+        ip_addr_t a;
+        a.hi = 0x20010db800000000ULL | (i >> 16);
+        a.lo = (uint64_t)i * 0x9E3779B97F4A7C15ULL;
+        shm_record_attempt(&a, now, 300, 10, nullptr);
+    }
+    t0 = bench_clock::now();
+    int appended = shm_snapshot_save(now);
+    double append_ms = ms_since(t0);
+    shm_destroy();
+
+    t0 = bench_clock::now();
+    int rc = shm_init(nullptr, capacity);
+    double load_ms = ms_since(t0);
+
+    /* The module's timer steps, back to back */
+    int steps = 0;
+    double step_max_ms = 0;
+    t0 = bench_clock::now();
+    for (int left = 1; left > 0; steps++) {
+        auto s0 = bench_clock::now();
+        left = shm_restore(now, SHM_RESTORE_BUDGET);
+        double ms = ms_since(s0);
+        if (ms > step_max_ms)
+            step_max_ms = ms;
+    }
+    double restore_ms = ms_since(t0);
+
+    shm_stats_t stats;
+    if (saved < 0 || appended < 0 || rc != 0 ||
+        shm_get_stats(&stats) != 0) {
+        fprintf(stderr, "snapshot round trip failed\n");
+        return 1;
+    }
+    printf("records:              %zu (%zu expired)\n", records, expired);
+    printf("capacity:             %zu\n", stats.capacity);
+    printf("saved:                %d in %.1f ms\n", saved, save_ms);
+    printf("checkpoint (1%%):      %d in %.1f ms\n", appended, append_ms);
+    printf("shm_init:             %.2f ms\n", load_ms);
+    printf("restored:             %llu in %.1f ms (%d steps, max %.2f ms)\n",
+           (unsigned long long)stats.restored, restore_ms, steps,
+           step_max_ms);
+
+    shm_destroy();
+    unlink((dir + "/" SHM_SNAPSHOT_NAME).c_str());
+    rmdir(dir.c_str());
+    return 0;
+}
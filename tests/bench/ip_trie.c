@@ -0,0 +1,221 @@
+/**
+ * ip_trie.c - Path-compressed radix trie (bench_acl baseline)
+ *
+ * Each node carries a full (key, bitlen) prefix, so a chain of
+ * single-child nodes never exists: a branch node is only created where
+ * two stored prefixes diverge. Lookups compare the address against the
+ * node prefix under its mask and then follow the bit at position bitlen.
+ *
+ * Validates: Requirements 6.3, 6.4, 6.5
+ */
+#include "ip_trie.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/** Initial node pool size (grows by doubling). */
+#define IP_TRIE_INITIAL_NODES 16
+
+/* ------------------------------------------------------------------ */
+/* Bit helpers (bit 0 is the most significant bit of hi)               */
+/* ------------------------------------------------------------------ */
+
+static inline uint64_t mask64(unsigned bits)
+{
+    return bits ? ~0ULL << (64 - bits) : 0;
+}
+
+/* 1 if a and b agree on their first `bitlen` bits. */
+static inline int prefix_equal(const ip_addr_t *a, const ip_addr_t *b,
+                               unsigned bitlen)
+{
+    if (bitlen <= 64)
+        return ((a->hi ^ b->hi) & mask64(bitlen)) == 0;
+    return a->hi == b->hi && ((a->lo ^ b->lo) & mask64(bitlen - 64)) == 0;
+}
+
+/* Bit `pos` of `x` (pos < 128). */
+static inline unsigned bit_at(const ip_addr_t *x, unsigned pos)
+{
+    if (pos < 64)
+        return (unsigned)(x->hi >> (63 - pos)) & 1u;
+    return (unsigned)(x->lo >> (127 - pos)) & 1u;
+}
+
+/* Length of the common leading-bit prefix of two keys, capped at `limit`. */
+static unsigned common_prefix(const ip_addr_t *a, const ip_addr_t *b,
+                              unsigned limit)
+{
+    uint64_t diff = a->hi ^ b->hi;
+    unsigned n;
+
+    if (diff)
+        n = (unsigned)__builtin_clzll(diff);
+    else if ((diff = a->lo ^ b->lo) != 0)
+        n = 64 + (unsigned)__builtin_clzll(diff);
+    else
+        n = 128;
+    return n < limit ? n : limit;
+}
+
+/* Copy of `x` with every bit past `bitlen` cleared. */
+static ip_addr_t masked(const ip_addr_t *x, unsigned bitlen)
+{
+    ip_addr_t r;
+    if (bitlen <= 64) {
+        r.hi = x->hi & mask64(bitlen);
+        r.lo = 0;
+    } else {
+        r.hi = x->hi;
+        r.lo = x->lo & mask64(bitlen - 64);
+    }
+    return r;
+}
+
+/* ------------------------------------------------------------------ */
+/* Node pool                                                           */
+/* ------------------------------------------------------------------ */
+
+/* Append a node; returns its index or 0 on allocation failure. */
+static uint32_t node_new(ip_trie_t *trie, const ip_addr_t *key,
+                         unsigned bitlen, int terminal)
+{
+    if (trie->count == trie->capacity) {
+        uint32_t cap = trie->capacity ? trie->capacity * 2
+                                      : IP_TRIE_INITIAL_NODES;
+        ip_trie_node_t *n = realloc(trie->nodes, cap * sizeof(*n));
+        if (!n)
+            return 0;
+        trie->nodes = n;
+        trie->capacity = cap;
+        if (trie->count == 0)
+            trie->count = 1; /* reserve the sentinel */
+    }
+
+    uint32_t idx = trie->count++;
+    ip_trie_node_t *node = &trie->nodes[idx];
+    node->key = *key;
+    node->child[0] = 0;
+    node->child[1] = 0;
+    node->bitlen = (uint8_t)bitlen;
+    node->terminal = (uint8_t)terminal;
+    return idx;
+}
+
+/* Point the link that currently leads to a node at `idx` instead. */
+static void relink(ip_trie_t *trie, uint32_t parent, unsigned side,
+                   uint32_t idx)
+{
+    if (parent)
+        trie->nodes[parent].child[side] = idx;
+    else
+        trie->root = idx;
+}
+
+/* ------------------------------------------------------------------ */
+/* Public API                                                          */
+/* ------------------------------------------------------------------ */
+
+void ip_trie_init(ip_trie_t *trie)
+{
+    if (trie)
+        memset(trie, 0, sizeof(*trie));
+}
+
+int ip_trie_insert(ip_trie_t *trie, const ip_cidr_t *cidr)
+{
+    if (!trie || !cidr)
+        return -1;
+
+    unsigned len = cidr->prefix_len;
+    ip_addr_t key = masked(&cidr->network, len);
+    uint32_t parent = 0;
+    unsigned side = 0;
+    uint32_t cur = trie->root;
+
+    while (cur) {
+        ip_trie_node_t *n = &trie->nodes[cur];
+        unsigned nlen = n->bitlen;
+        unsigned common = common_prefix(&key, &n->key,
+                                        len < nlen ? len : nlen);
+
+        if (common == nlen) {
+            /* Node prefix contains the new prefix */
+            if (n->terminal)
+                return 0; /* already covered */
+            if (len == nlen) {
+                /* Becomes a rule; everything below is now redundant */
+                n->terminal = 1;
+                n->child[0] = 0;
+                n->child[1] = 0;
+                return 0;
+            }
+            parent = cur;
+            side = bit_at(&key, nlen);
+            cur = n->child[side];
+            continue;
+        }
+
+        if (common == len) {
+            /* New prefix covers this node: replace the whole subtree */
+            uint32_t leaf = node_new(trie, &key, len, 1);
+            if (!leaf)
+                return -1;
+            relink(trie, parent, side, leaf);
+            return 0;
+        }
+
+        /* Prefixes diverge at bit `common`: insert a branch node */
+        unsigned old_side = bit_at(&n->key, common);
+        ip_addr_t branch_key = masked(&key, common);
+        uint32_t branch = node_new(trie, &branch_key, common, 0);
+        if (!branch)
+            return -1;
+        uint32_t leaf = node_new(trie, &key, len, 1);
+        if (!leaf)
+            return -1;
+        trie->nodes[branch].child[old_side ^ 1u] = leaf;
+        trie->nodes[branch].child[old_side] = cur;
+        relink(trie, parent, side, branch);
+        return 0;
+    }
+
+    uint32_t leaf = node_new(trie, &key, len, 1);
+    if (!leaf)
+        return -1;
+    relink(trie, parent, side, leaf);
+    return 0;
+}
+
+int ip_trie_match(const ip_trie_t *trie, const ip_addr_t *addr)
+{
+    if (!trie || !addr)
+        return 0;
+
+    const ip_trie_node_t *nodes = trie->nodes;
+    uint32_t cur = trie->root;
+
+    while (cur) {
+        const ip_trie_node_t *n = &nodes[cur];
+        if (!prefix_equal(addr, &n->key, n->bitlen))
+            return 0;
+        if (n->terminal)
+            return 1;
+        /* Non-terminal nodes are branch points, so bitlen < 128 here */
+        cur = n->child[bit_at(addr, n->bitlen)];
+    }
+    return 0;
+}
+
+size_t ip_trie_memory(const ip_trie_t *trie)
+{
+    return trie ? (size_t)trie->capacity * sizeof(ip_trie_node_t) : 0;
+}
+
+void ip_trie_free(ip_trie_t *trie)
+{
+    if (!trie)
+        return;
+    free(trie->nodes);
+    memset(trie, 0, sizeof(*trie));
+}
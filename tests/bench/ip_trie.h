@@ -0,0 +1,91 @@
+/**
+ * ip_trie.h - Path-compressed radix (Patricia) trie for IP sets
+ *
+ * Stores a set of CIDR prefixes and answers "is this address covered by
+ * any stored prefix" in O(address bits), independent of the number of
+ * rules. The module's ACLs use normalized interval sets (cidr_set_t);
+ * this trie is only built into the benchmarks, as the baseline bench_acl
+ * compares them against.
+ *
+ * Keys are 128-bit ip_addr_t values, so IPv4 (mapped) and IPv6 rules
+ * share one trie. Path compression collapses the common ::ffff:0:0/96
+ * prefix of IPv4 rules into a single node, keeping IPv4 lookup depth
+ * the same as with a 32-bit trie.
+ *
+ * Nodes live in one contiguous array and refer to each other by index,
+ * so a compiled trie is a single allocation that is cheap to walk and
+ * to free. Since lookups only need a yes/no answer, a prefix that is
+ * covered by a shorter stored prefix is dropped at insert time.
+ *
+ * Validates: Requirements 6.3, 6.4, 6.5
+ */
+#ifndef BENCH_IP_TRIE_H
+#define BENCH_IP_TRIE_H
+
+#include "htaccess_cidr.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Trie node. Index 0 is reserved as the "no node" sentinel.
+ */
+typedef struct {
+    ip_addr_t key;      /* Prefix bits (masked to bitlen) */
+    uint32_t child[2];  /* Child node indices by next bit, 0 = none */
+    uint8_t  bitlen;    /* Prefix length in bits [0..128] */
+    uint8_t  terminal;  /* 1 if this prefix is a stored rule */
+} ip_trie_node_t;
+
+/**
+ * IP prefix trie.
+ */
+typedef struct {
+    ip_trie_node_t *nodes;    /* Node pool (owned); nodes[0] unused */
+    uint32_t        count;    /* Nodes in use, including the sentinel */
+    uint32_t        capacity; /* Allocated nodes */
+    uint32_t        root;     /* Root node index, 0 when empty */
+} ip_trie_t;
+
+/**
+ * Initialise an empty trie (no allocation).
+ */
+void ip_trie_init(ip_trie_t *trie);
+
+/**
+ * Insert a CIDR prefix.
+ *
+ * @param trie  Trie to insert into.
+ * @param cidr  Parsed range (see ip_cidr_parse()).
+ * @return 0 on success, -1 on allocation failure.
+ */
+int ip_trie_insert(ip_trie_t *trie, const ip_cidr_t *cidr);
+
+/**
+ * Check whether an address is covered by any stored prefix.
+ *
+ * @param trie  Trie to search (NULL or empty matches nothing).
+ * @param addr  Address to look up.
+ * @return 1 if covered, 0 otherwise.
+ */
+int ip_trie_match(const ip_trie_t *trie, const ip_addr_t *addr);
+
+/**
+ * Approximate heap footprint of the trie in bytes.
+ */
+size_t ip_trie_memory(const ip_trie_t *trie);
+
+/**
+ * Release the node pool and reset the trie to empty.
+ */
+void ip_trie_free(ip_trie_t *trie);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* BENCH_IP_TRIE_H */
@@ -0,0 +1,60 @@
+/**
+ * file_cache_fixture.h - Shared fixture for the file cache tests
+ *
+ * The AuthUserFile, AuthGroupFile and RedirectMap caches are tested the
+ * same way: files are written into a private temporary directory, the
+ * cache is reset around each test, and the tests read its counters.
+ * FileCacheTest provides that setup for a cache given its stats type,
+ * stats getter and reset function; the directory is removed with
+ * everything left in it.
+ *
+ * Validates: Requirements 7.1, 10.4
+ */
+#ifndef FILE_CACHE_FIXTURE_H
+#define FILE_CACHE_FIXTURE_H
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstdlib>
+#include <ftw.h>
+#include <string>
+
+template <typename Stats, int (*GetStats)(Stats *), void (*Reset)(void)>
+class FileCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        Reset();
+        char tmpl[] = "/tmp/file_cache_test_XXXXXX";
+        ASSERT_NE(mkdtemp(tmpl), nullptr);
+        dir_ = tmpl;
+    }
+    void TearDown() override {
+        Reset();
+        nftw(dir_.c_str(), remove_one, 8, FTW_DEPTH | FTW_PHYS);
+    }
+    /* Path of `name` inside the test directory */
+    std::string path(const char *name) const {
+        return dir_ + "/" + name;
+    }
+    static void write_file(const std::string &path,
+                           const std::string &content) {
+        FILE *f = fopen(path.c_str(), "w");
+        ASSERT_NE(f, nullptr);
+        fputs(content.c_str(), f);
+        fclose(f);
+    }
+    Stats stats() {
+        Stats s;
+        EXPECT_EQ(GetStats(&s), 0);
+        return s;
+    }
+    std::string dir_;
+
+private:
+    static int remove_one(const char *p, const struct stat *, int,
+                          struct FTW *) {
+        return remove(p);
+    }
+};
+
+#endif /* FILE_CACHE_FIXTURE_H */
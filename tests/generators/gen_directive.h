@@ -136,12 +136,20 @@ inline rc::Gen<directive_type_t> directiveTypeV2b()
         DIR_ADD_CHARSET,
         DIR_BRUTE_FORCE_X_FORWARDED_FOR,
         DIR_BRUTE_FORCE_WHITELIST,
-        DIR_BRUTE_FORCE_PROTECT_PATH
+        DIR_BRUTE_FORCE_PROTECT_PATH,
+        DIR_BRUTE_FORCE_IPV4_PREFIX,
+        DIR_BRUTE_FORCE_IPV6_PREFIX,
+        DIR_BRUTE_FORCE_PREFIX_ATTEMPTS,
+        DIR_BRUTE_FORCE_FAILURE_STATUS,
+        DIR_AUTH_GROUP_FILE,
+        DIR_REQUIRE_USER,
+        DIR_REQUIRE_GROUP,
+        DIR_REDIRECT_MAP
     );
 }
 
 /**
- * Generate any of the 59 directive types (v1 + v2).
+ * Generate any of the 67 directive types (v1 + v2).
  */
 inline rc::Gen<directive_type_t> anyDirectiveType()
 {
@@ -267,6 +275,16 @@ inline rc::Gen<htaccess_directive_t *> directiveOfType(directive_type_t type)
                 return d;
             });
 
+    case DIR_REDIRECT_MAP:
+        return rc::gen::map(
+            rc::gen::pair(rc::gen::element(301, 302, 308), simpleValue()),
+            [](const std::pair<int, std::string> &p) {
+                auto *d = allocDir(DIR_REDIRECT_MAP);
+                d->data.redirect.status_code = p.first;
+                d->value = strdup(("/etc/redirects/" + p.second).c_str());
+                return d;
+            });
+
     case DIR_ERROR_DOCUMENT:
         return rc::gen::map(
             rc::gen::pair(
@@ -550,6 +568,25 @@ inline rc::Gen<htaccess_directive_t *> directiveOfType(directive_type_t type)
     case DIR_REQUIRE_VALID_USER:
         return rc::gen::just(allocDir(DIR_REQUIRE_VALID_USER));
 
+    case DIR_AUTH_GROUP_FILE:
+        return rc::gen::map(simpleValue(),
+            [](const std::string &v) {
+                auto *d = allocDir(DIR_AUTH_GROUP_FILE);
+                d->value = strdup(("/etc/htgroup/" + v).c_str());
+                return d;
+            });
+
+    case DIR_REQUIRE_USER:
+    case DIR_REQUIRE_GROUP:
+        return rc::gen::map(
+            rc::gen::element<std::string>("admin", "alice bob",
+                                          "staff ops dev"),
+            [type](const std::string &v) {
+                auto *d = allocDir(type);
+                d->value = strdup(v.c_str());
+                return d;
+            });
+
     case DIR_ADD_HANDLER:
         return rc::gen::map(
             rc::gen::pair(simpleValue(), simpleValue()),
@@ -652,6 +689,40 @@ inline rc::Gen<htaccess_directive_t *> directiveOfType(directive_type_t type)
                 return d;
             });
 
+    case DIR_BRUTE_FORCE_IPV4_PREFIX:
+        return rc::gen::map(rc::gen::inRange(0, 33),
+            [](int n) {
+                auto *d = allocDir(DIR_BRUTE_FORCE_IPV4_PREFIX);
+                d->data.brute_force.prefix_len = n;
+                return d;
+            });
+
+    case DIR_BRUTE_FORCE_IPV6_PREFIX:
+        return rc::gen::map(rc::gen::inRange(0, 65),
+            [](int n) {
+                auto *d = allocDir(DIR_BRUTE_FORCE_IPV6_PREFIX);
+                d->data.brute_force.prefix_len = n;
+                return d;
+            });
+
+    case DIR_BRUTE_FORCE_PREFIX_ATTEMPTS:
+        return rc::gen::map(rc::gen::inRange(1, 1000),
+            [](int n) {
+                auto *d = allocDir(DIR_BRUTE_FORCE_PREFIX_ATTEMPTS);
+                d->data.brute_force.allowed_attempts = n;
+                return d;
+            });
+
+    case DIR_BRUTE_FORCE_FAILURE_STATUS:
+        return rc::gen::map(
+            rc::gen::element<std::string>("401", "401 403", "403 429",
+                                          "200 401"),
+            [](const std::string &v) {
+                auto *d = allocDir(DIR_BRUTE_FORCE_FAILURE_STATUS);
+                d->value = strdup(v.c_str());
+                return d;
+            });
+
     default:
         /* Fallback: generate a simple Header set directive */
         return rc::gen::map(
@@ -323,6 +323,12 @@ inline rc::Gen<TaggedLine> taggedDirectiveLineV2b()
             [](const std::string &v) -> TaggedLine {
                 return {"BruteForceProtectPath " + v,
                         DIR_BRUTE_FORCE_PROTECT_PATH};
+            }),
+        /* BruteForceIPv6Prefix <0-64> */
+        rc::gen::map(rc::gen::inRange(0, 65),
+            [](int n) -> TaggedLine {
+                return {"BruteForceIPv6Prefix " + std::to_string(n),
+                        DIR_BRUTE_FORCE_IPV6_PREFIX};
             })
     );
 }
@@ -11,6 +11,9 @@
 #include <cstdarg>
 #include <cstdio>
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
 
 /* ================================================================== */
 /*  Internal helpers                                                    */
@@ -32,6 +35,31 @@ static inline std::string make_str(const char *p, int len) {
 static std::vector<HookRecord> g_hook_records;
 static std::vector<LogRecord>  g_log_records;
 
+/* Armed timers, due on the mock clock (milliseconds) */
+struct MockTimer {
+    int           id;
+    uint64_t      due_ms;
+    unsigned int  interval_ms;
+    bool          repeat;
+    lsi_timer_cb  cb;
+    const void   *arg;
+};
+
+static std::vector<MockTimer> g_timers;
+static uint64_t g_clock_ms = 0;
+static int      g_next_timer_id = 1;
+static bool     g_timers_available = true;
+
+/* Scheduled events; lsi_schedule_event() may be called from any thread */
+struct MockEvent {
+    lsi_event_cb  cb;
+    const void   *arg;
+};
+
+static std::mutex               g_events_lock;
+static std::condition_variable  g_events_cond;
+static std::vector<MockEvent>   g_events;
+
 namespace mock_lsiapi {
 
 const std::vector<HookRecord> &get_hook_records() { return g_hook_records; }
@@ -40,6 +68,59 @@ const std::vector<LogRecord>  &get_log_records()  { return g_log_records; }
 void reset_global_state() {
     g_hook_records.clear();
     g_log_records.clear();
+    g_timers.clear();
+    g_clock_ms = 0;
+    g_next_timer_id = 1;
+    g_timers_available = true;
+    std::lock_guard<std::mutex> lock(g_events_lock);
+    g_events.clear();
+}
+
+int advance_timers(unsigned int ms) {
+    uint64_t until = g_clock_ms + ms;
+    int fired = 0;
+
+    for (;;) {
+        /* Earliest timer due by `until`; callbacks may arm new ones */
+        auto next = std::min_element(g_timers.begin(), g_timers.end(),
+            [](const MockTimer &a, const MockTimer &b) {
+                return a.due_ms < b.due_ms;
+            });
+        if (next == g_timers.end() || next->due_ms > until)
+            break;
+        MockTimer t = *next;
+        g_clock_ms = t.due_ms;
+        if (t.repeat && t.interval_ms > 0)
+            next->due_ms += t.interval_ms;
+        else
+            g_timers.erase(next);
+        t.cb(t.arg);
+        fired++;
+    }
+    g_clock_ms = until;
+    return fired;
+}
+
+int pending_timers() { return static_cast<int>(g_timers.size()); }
+
+void set_timers_available(bool available) { g_timers_available = available; }
+
+int wait_events(int count, unsigned int timeout_ms) {
+    std::unique_lock<std::mutex> lock(g_events_lock);
+    g_events_cond.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+        [count] { return static_cast<int>(g_events.size()) >= count; });
+    return static_cast<int>(g_events.size());
+}
+
+int run_events() {
+    std::vector<MockEvent> ready;
+    {
+        std::lock_guard<std::mutex> lock(g_events_lock);
+        ready.swap(g_events);
+    }
+    for (const MockEvent &e : ready)
+        e.cb(e.arg);
+    return static_cast<int>(ready.size());
 }
 
 } /* namespace mock_lsiapi */
@@ -48,7 +129,7 @@ void reset_global_state() {
 /*  MockSession implementation                                          */
 /* ================================================================== */
 
-MockSession::MockSession() : status_code_(200) {}
+MockSession::MockSession() : status_code_(200), resume_count_(0) {}
 MockSession::~MockSession() = default;
 
 void MockSession::set_request_uri(const std::string &uri)  { request_uri_ = uri; }
@@ -140,6 +221,8 @@ bool MockSession::file_exists(const std::string &path) const {
     return existing_files_.count(path) > 0;
 }
 
+int MockSession::get_resume_count() const { return resume_count_; }
+
 void MockSession::reset() {
     req_headers_.clear();
     resp_headers_.clear();
@@ -156,6 +239,7 @@ void MockSession::reset() {
     auth_header_.clear();
     www_authenticate_.clear();
     existing_files_.clear();
+    resume_count_ = 0;
 }
 
 lsi_session_t *MockSession::handle() {
@@ -459,4 +543,44 @@ int lsi_session_set_www_authenticate(lsi_session_t *session,
     return LSI_OK;
 }
 
+/* ---- Timers and request suspension ---- */
+
+int lsi_set_timer(unsigned int timeout_ms, int repeat,
+                  lsi_timer_cb cb, const void *arg) {
+    if (!cb || !g_timers_available) return -1;
+    MockTimer t;
+    t.id          = g_next_timer_id++;
+    t.due_ms      = g_clock_ms + timeout_ms;
+    t.interval_ms = timeout_ms;
+    t.repeat      = (repeat != 0);
+    t.cb          = cb;
+    t.arg         = arg;
+    g_timers.push_back(t);
+    return t.id;
+}
+
+int lsi_remove_timer(int timer_id) {
+    auto it = std::find_if(g_timers.begin(), g_timers.end(),
+        [timer_id](const MockTimer &t) { return t.id == timer_id; });
+    if (it == g_timers.end()) return LSI_ERROR;
+    g_timers.erase(it);
+    return LSI_OK;
+}
+
+int lsi_session_resume(lsi_session_t *session) {
+    if (!session) return LSI_ERROR;
+    to_mock(session)->resume_count_++;
+    return LSI_OK;
+}
+
+int lsi_schedule_event(lsi_event_cb cb, const void *arg) {
+    if (!cb) return -1;
+    {
+        std::lock_guard<std::mutex> lock(g_events_lock);
+        g_events.push_back(MockEvent{cb, arg});
+    }
+    g_events_cond.notify_all();
+    return 0;
+}
+
 } /* extern "C" */
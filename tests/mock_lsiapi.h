@@ -37,6 +37,9 @@ extern "C" {
 #ifndef LSI_HKPT_SEND_RESP_HEADER
 #define LSI_HKPT_SEND_RESP_HEADER 1
 #endif
+#ifndef LSI_HKPT_HTTP_END
+#define LSI_HKPT_HTTP_END         2
+#endif
 
 /* Module signature */
 #ifndef LSI_MODULE_SIGNATURE
@@ -46,6 +49,7 @@ extern "C" {
 /* Return codes */
 #define LSI_OK   0
 #define LSI_ERROR (-1)
+#define LSI_SUSPEND 1
 
 /* Opaque session handle (points to MockSession in C++ land) */
 typedef struct lsi_session_s lsi_session_t;
@@ -157,6 +161,15 @@ const char *lsi_session_get_auth_header(lsi_session_t *session, int *len);
 int         lsi_session_set_www_authenticate(lsi_session_t *session,
                                              const char *realm, int realm_len);
 
+/* Timers and request suspension */
+typedef void (*lsi_timer_cb)(const void *arg);
+int         lsi_set_timer(unsigned int timeout_ms, int repeat,
+                          lsi_timer_cb cb, const void *arg);
+int         lsi_remove_timer(int timer_id);
+int         lsi_session_resume(lsi_session_t *session);
+typedef void (*lsi_event_cb)(const void *arg);
+int         lsi_schedule_event(lsi_event_cb cb, const void *arg);
+
 /* Logging */
 void        lsi_log(lsi_session_t *session, int level, const char *fmt, ...);
 
@@ -258,6 +271,9 @@ public:
     std::string get_www_authenticate() const;
     bool        file_exists(const std::string &path) const;
 
+    /* Times lsi_session_resume() was called for this session */
+    int         get_resume_count() const;
+
     /* Reset all state */
     void reset();
 
@@ -290,6 +306,7 @@ private:
     friend const char *::lsi_session_get_method(lsi_session_t*, int*);
     friend const char *::lsi_session_get_auth_header(lsi_session_t*, int*);
     friend int         ::lsi_session_set_www_authenticate(lsi_session_t*, const char*, int);
+    friend int         ::lsi_session_resume(lsi_session_t*);
 
     /* Request headers: name → value */
     std::unordered_map<std::string, std::string> req_headers_;
@@ -329,6 +346,9 @@ private:
 
     /* v2: Set of files that "exist" for file_exists checks */
     std::unordered_map<std::string, bool> existing_files_;
+
+    /* Resumes after LSI_SUSPEND */
+    int resume_count_;
 };
 
 /* ---- Global hook registry (for testing hook registration) ---- */
@@ -341,9 +361,31 @@ const std::vector<HookRecord> &get_hook_records();
 /* Get all log records */
 const std::vector<LogRecord> &get_log_records();
 
-/* Clear global state (hooks + logs) — call in test SetUp */
+/* Clear global state (hooks + logs + timers + events) — call in test SetUp */
 void reset_global_state();
 
+/*
+ * Timer stand-in: timers armed with lsi_set_timer() only fire when the
+ * test moves the mock clock forward. advance_timers() fires every timer
+ * that falls due within the next `ms` milliseconds, in due order, and
+ * returns how many callbacks ran.
+ */
+int  advance_timers(unsigned int ms);
+int  pending_timers();
+
+/* Make lsi_set_timer() fail, as when the server cannot arm a timer */
+void set_timers_available(bool available);
+
+/*
+ * Event loop stand-in: callbacks queued with lsi_schedule_event() (from
+ * any thread) wait until the test runs them. wait_events() blocks until
+ * at least `count` are queued or `timeout_ms` passes and returns how many
+ * are queued; run_events() runs the queued callbacks on the calling
+ * thread and returns how many ran.
+ */
+int  wait_events(int count, unsigned int timeout_ms);
+int  run_events();
+
 } /* namespace mock_lsiapi */
 
 #endif /* __cplusplus */
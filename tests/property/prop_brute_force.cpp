@@ -179,9 +179,12 @@ RC_GTEST_FIXTURE_PROP(BruteForcePropertyFixture,
     }
 
     /* Manually expire the record by setting first_attempt to the past */
-    brute_force_record_t *rec = shm_get_record(ip.c_str());
-    RC_ASSERT(rec != nullptr);
-    rec->first_attempt = time(NULL) - window - 1;
+    ip_addr_t key;
+    RC_ASSERT(ip_addr_parse(ip.c_str(), &key) == 0);
+    brute_force_record_t rec;
+    RC_ASSERT(shm_get_record(&key, &rec) == 0);
+    rec.first_attempt = time(NULL) - window - 1;
+    RC_ASSERT(shm_update_record(&key, &rec) == 0);
 
     /* Next attempt should start a new window (count=1), not trigger block */
     session_.reset();
@@ -192,9 +195,8 @@ RC_GTEST_FIXTURE_PROP(BruteForcePropertyFixture,
     RC_ASSERT(session_.get_status_code() == 200);
 
     /* Verify the record was reset to count=1 */
-    rec = shm_get_record(ip.c_str());
-    RC_ASSERT(rec != nullptr);
-    RC_ASSERT(rec->attempt_count == 1);
+    RC_ASSERT(shm_get_record(&key, &rec) == 0);
+    RC_ASSERT(rec.attempt_count == 1);
 
     free_dir_list(dirs);
 }
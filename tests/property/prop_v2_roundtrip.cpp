@@ -110,6 +110,16 @@ static bool directives_equivalent(const htaccess_directive_t *a,
             if (a->data.brute_force.throttle_ms != b->data.brute_force.throttle_ms)
                 return false;
             break;
+        case DIR_BRUTE_FORCE_IPV4_PREFIX:
+        case DIR_BRUTE_FORCE_IPV6_PREFIX:
+            if (a->data.brute_force.prefix_len != b->data.brute_force.prefix_len)
+                return false;
+            break;
+        case DIR_BRUTE_FORCE_PREFIX_ATTEMPTS:
+            if (a->data.brute_force.allowed_attempts !=
+                b->data.brute_force.allowed_attempts)
+                return false;
+            break;
         /* v2 container types */
         case DIR_IFMODULE:
             if (!directives_equivalent(a->data.ifmodule.children,
@@ -0,0 +1,330 @@
+/**
+ * test_authpool.cpp - Unit tests for the password hashing pool and
+ * suspended Basic authentication
+ *
+ * Pool results come back through the mock event loop: the tests wait for
+ * the pool threads to queue their completions and then run them on the
+ * test thread, the way the server's loop would.
+ *
+ * Validates: Requirements 10.4
+ */
+#include <gtest/gtest.h>
+#include <crypt.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "mock_lsiapi.h"
+
+extern "C" {
+#include "htaccess_authpool.h"
+#include "htaccess_exec_auth.h"
+#include "htaccess_htpasswd.h"
+#include "htaccess_parser.h"
+}
+
+/* Slow enough that several submits land before the first check ends */
+static std::string bcrypt_hash(const char *password)
+{
+    const char *salt = crypt_gensalt("$2y$", 10, nullptr, 0);
+    return salt ? crypt(password, salt) : "";
+}
+
+struct Completion {
+    int calls = 0;
+    int result = -2;
+    std::thread::id thread;
+};
+
+static void record_result(void *arg, int result)
+{
+    auto *c = static_cast<Completion *>(arg);
+    c->calls++;
+    c->result = result;
+    c->thread = std::this_thread::get_id();
+}
+
+struct Resumed {
+    int calls = 0;
+    int rc = -2;
+};
+
+static void record_resume(lsi_session_t *, int rc, void *arg)
+{
+    auto *r = static_cast<Resumed *>(arg);
+    r->calls++;
+    r->rc = rc;
+}
+
+class AuthPoolTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        mock_lsiapi::reset_global_state();
+        htpasswd_cache_destroy();
+        authpool_destroy();
+        char tmpl[] = "/tmp/authpool_test_XXXXXX";
+        int fd = mkstemp(tmpl);
+        ASSERT_GE(fd, 0);
+        close(fd);
+        file_ = tmpl;
+    }
+    void TearDown() override {
+        authpool_destroy();
+        mock_lsiapi::run_events();
+        htpasswd_cache_destroy();
+        unlink(file_.c_str());
+    }
+    void write_users(const std::string &content) {
+        FILE *f = fopen(file_.c_str(), "w");
+        ASSERT_NE(f, nullptr);
+        fputs(content.c_str(), f);
+        fclose(f);
+    }
+    htaccess_directive_t *auth_config() {
+        std::string conf = "AuthType Basic\n"
+                           "AuthName \"Admin\"\n"
+                           "AuthUserFile " + file_ + "\n"
+                           "Require valid-user\n";
+        return htaccess_parse(conf.c_str(), conf.size(), "test");
+    }
+    std::string file_;
+};
+
+TEST_F(AuthPoolTest, UnconfiguredPoolRefusesWork)
+{
+    Completion c;
+    EXPECT_EQ(authpool_submit("ab", "pw", record_result, &c), -1);
+    EXPECT_EQ(authpool_init(0, 4), -1);
+    EXPECT_EQ(authpool_init(AUTHPOOL_MAX_THREADS + 1, 4), -1);
+    EXPECT_EQ(authpool_init(1, 0), -1);
+}
+
+TEST_F(AuthPoolTest, ResultsArriveOnTheEventLoop)
+{
+    ASSERT_EQ(authpool_init(2, 8), 0);
+    std::string hash = crypt("secret", "ab");
+    Completion good, bad;
+    ASSERT_EQ(authpool_submit(hash.c_str(), "secret", record_result, &good),
+              0);
+    ASSERT_EQ(authpool_submit(hash.c_str(), "wrong", record_result, &bad),
+              0);
+
+    ASSERT_EQ(mock_lsiapi::wait_events(2, 10000), 2);
+    /* Nothing is reported until the loop runs the completions */
+    EXPECT_EQ(good.calls, 0);
+    EXPECT_EQ(mock_lsiapi::run_events(), 2);
+    EXPECT_EQ(good.calls, 1);
+    EXPECT_EQ(good.result, 1);
+    EXPECT_EQ(good.thread, std::this_thread::get_id());
+    EXPECT_EQ(bad.calls, 1);
+    EXPECT_EQ(bad.result, 0);
+
+    authpool_stats_t stats;
+    ASSERT_EQ(authpool_get_stats(&stats), 0);
+    EXPECT_EQ(stats.submitted, 2u);
+    EXPECT_EQ(stats.completed, 2u);
+    EXPECT_EQ(stats.queued, 0);
+}
+
+struct Task {
+    std::thread::id ran;
+    Completion done;
+};
+
+static int run_task(void *arg)
+{
+    static_cast<Task *>(arg)->ran = std::this_thread::get_id();
+    return 7;
+}
+
+static void task_done(void *arg, int result)
+{
+    record_result(&static_cast<Task *>(arg)->done, result);
+}
+
+TEST_F(AuthPoolTest, TasksRunOnAPoolThread)
+{
+    Task task;
+    EXPECT_EQ(authpool_run(run_task, task_done, &task), -1);
+    ASSERT_EQ(authpool_init(1, 4), 0);
+    EXPECT_EQ(authpool_run(nullptr, task_done, &task), -1);
+
+    ASSERT_EQ(authpool_run(run_task, task_done, &task), 0);
+    ASSERT_EQ(mock_lsiapi::wait_events(1, 10000), 1);
+    EXPECT_EQ(mock_lsiapi::run_events(), 1);
+    EXPECT_NE(task.ran, std::this_thread::get_id());
+    EXPECT_EQ(task.done.calls, 1);
+    EXPECT_EQ(task.done.result, 7);
+    EXPECT_EQ(task.done.thread, std::this_thread::get_id());
+}
+
+TEST_F(AuthPoolTest, FullQueueRejectsAtOnce)
+{
+    ASSERT_EQ(authpool_init(1, 1), 0);
+    std::string hash = bcrypt_hash("secret");
+    ASSERT_FALSE(hash.empty());
+    std::vector<Completion> done(4);
+    int accepted = 0, rejected = 0;
+    for (auto &c : done) {
+        int rc = authpool_submit(hash.c_str(), "secret", record_result, &c);
+        if (rc == 0)
+            accepted++;
+        else if (rc == AUTHPOOL_FULL)
+            rejected++;
+    }
+    /* One thread, one waiting slot: at most two checks are accepted */
+    EXPECT_GE(accepted, 1);
+    EXPECT_LE(accepted, 2);
+    EXPECT_EQ(accepted + rejected, 4);
+
+    ASSERT_EQ(mock_lsiapi::wait_events(accepted, 30000), accepted);
+    EXPECT_EQ(mock_lsiapi::run_events(), accepted);
+    authpool_stats_t stats;
+    ASSERT_EQ(authpool_get_stats(&stats), 0);
+    EXPECT_EQ(stats.rejected, (uint64_t)rejected);
+    EXPECT_EQ(stats.completed, (uint64_t)accepted);
+}
+
+/* Checks dropped by destroy still report, as failures */
+TEST_F(AuthPoolTest, DestroyFailsQueuedChecks)
+{
+    ASSERT_EQ(authpool_init(1, 8), 0);
+    std::string hash = bcrypt_hash("secret");
+    ASSERT_FALSE(hash.empty());
+    std::vector<Completion> done(4);
+    for (auto &c : done)
+        ASSERT_EQ(authpool_submit(hash.c_str(), "secret", record_result, &c),
+                  0);
+
+    authpool_destroy();
+    /* One thread: at most one check was running and delivers normally */
+    int failed = 0;
+    for (auto &c : done)
+        if (c.calls == 1 && c.result == -1)
+            failed++;
+    EXPECT_GE(failed, 3);
+    mock_lsiapi::run_events();
+    for (auto &c : done)
+        EXPECT_EQ(c.calls, 1);
+}
+
+TEST_F(AuthPoolTest, DestroyResumesSuspendedRequests)
+{
+    ASSERT_EQ(authpool_init(1, 8), 0);
+    write_users("admin:" + bcrypt_hash("secret") + "\n");
+    htaccess_directive_t *dirs = auth_config();
+    ASSERT_NE(dirs, nullptr);
+
+    MockSession sessions[3];
+    Resumed r[3];
+    for (int i = 0; i < 3; i++) {
+        sessions[i].set_auth_header("Basic YWRtaW46c2VjcmV0");
+        ASSERT_EQ(exec_auth_basic_async(sessions[i].handle(), dirs,
+                                        record_resume, &r[i]), LSI_SUSPEND);
+    }
+    htaccess_directives_free(dirs);
+
+    authpool_destroy();
+    mock_lsiapi::run_events();
+    int denied = 0;
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(r[i].calls, 1);
+        if (r[i].rc == LSI_ERROR) {
+            EXPECT_EQ(sessions[i].get_status_code(), 401);
+            denied++;
+        }
+    }
+    EXPECT_GE(denied, 2);
+}
+
+TEST_F(AuthPoolTest, AuthSuspendsUntilPasswordChecked)
+{
+    ASSERT_EQ(authpool_init(1, 8), 0);
+    write_users("admin:" + bcrypt_hash("secret") + "\n");
+    htaccess_directive_t *dirs = auth_config();
+    ASSERT_NE(dirs, nullptr);
+    MockSession session;
+    session.set_auth_header("Basic YWRtaW46c2VjcmV0"); /* admin:secret */
+
+    Resumed r;
+    EXPECT_EQ(exec_auth_basic_async(session.handle(), dirs, record_resume,
+                                    &r), LSI_SUSPEND);
+    htaccess_directives_free(dirs);   /* Not needed while suspended */
+    ASSERT_EQ(mock_lsiapi::wait_events(1, 10000), 1);
+    EXPECT_EQ(r.calls, 0);
+    mock_lsiapi::run_events();
+    EXPECT_EQ(r.calls, 1);
+    EXPECT_EQ(r.rc, LSI_OK);
+
+    /* The verified password is remembered: no second trip to the pool */
+    dirs = auth_config();
+    EXPECT_EQ(exec_auth_basic_async(session.handle(), dirs, record_resume,
+                                    &r), LSI_OK);
+    htaccess_directives_free(dirs);
+}
+
+TEST_F(AuthPoolTest, WrongPasswordAnswers401OnResume)
+{
+    ASSERT_EQ(authpool_init(1, 8), 0);
+    write_users("admin:" + std::string(crypt("secret", "ab")) + "\n");
+    htaccess_directive_t *dirs = auth_config();
+    ASSERT_NE(dirs, nullptr);
+    MockSession session;
+    session.set_auth_header("Basic YWRtaW46d3Jvbmc="); /* admin:wrong */
+
+    Resumed r;
+    EXPECT_EQ(exec_auth_basic_async(session.handle(), dirs, record_resume,
+                                    &r), LSI_SUSPEND);
+    ASSERT_EQ(mock_lsiapi::wait_events(1, 10000), 1);
+    mock_lsiapi::run_events();
+    EXPECT_EQ(r.rc, LSI_ERROR);
+    EXPECT_EQ(session.get_status_code(), 401);
+    EXPECT_FALSE(session.get_www_authenticate().empty());
+    htaccess_directives_free(dirs);
+}
+
+TEST_F(AuthPoolTest, OverloadAnswers503)
+{
+    ASSERT_EQ(authpool_init(1, 1), 0);
+    write_users("admin:" + bcrypt_hash("secret") + "\n");
+    htaccess_directive_t *dirs = auth_config();
+    ASSERT_NE(dirs, nullptr);
+
+    MockSession sessions[4];
+    Resumed r[4];
+    int suspended = 0, overloaded = 0;
+    for (int i = 0; i < 4; i++) {
+        sessions[i].set_auth_header("Basic YWRtaW46c2VjcmV0");
+        int rc = exec_auth_basic_async(sessions[i].handle(), dirs,
+                                       record_resume, &r[i]);
+        if (rc == LSI_SUSPEND)
+            suspended++;
+        else if (rc == LSI_ERROR && sessions[i].get_status_code() == 503)
+            overloaded++;
+    }
+    EXPECT_GE(overloaded, 2);
+    EXPECT_EQ(suspended + overloaded, 4);
+    ASSERT_EQ(mock_lsiapi::wait_events(suspended, 30000), suspended);
+    mock_lsiapi::run_events();
+    for (int i = 0; i < 4; i++)
+        if (sessions[i].get_status_code() != 503)
+            EXPECT_EQ(r[i].rc, LSI_OK);
+    htaccess_directives_free(dirs);
+}
+
+TEST_F(AuthPoolTest, WithoutPoolChecksInline)
+{
+    write_users("admin:" + std::string(crypt("secret", "ab")) + "\n");
+    htaccess_directive_t *dirs = auth_config();
+    ASSERT_NE(dirs, nullptr);
+    MockSession session;
+    session.set_auth_header("Basic YWRtaW46c2VjcmV0");
+    Resumed r;
+    EXPECT_EQ(exec_auth_basic_async(session.handle(), dirs, record_resume,
+                                    &r), LSI_OK);
+    EXPECT_EQ(r.calls, 0);
+    htaccess_directives_free(dirs);
+}
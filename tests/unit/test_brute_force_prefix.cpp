@@ -0,0 +1,270 @@
+/**
+ * test_brute_force_prefix.cpp - Unit tests for prefix-aggregated
+ * brute force tracking
+ *
+ * Tests the BruteForceIPv4Prefix / BruteForceIPv6Prefix /
+ * BruteForcePrefixAttempts directives, the aggregate key encoding, and
+ * the second counter tier against address rotation.
+ */
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstring>
+#include "mock_lsiapi.h"
+
+extern "C" {
+#include "htaccess_exec_brute_force.h"
+#include "htaccess_parser.h"
+#include "htaccess_printer.h"
+#include "htaccess_directive.h"
+#include "htaccess_shm.h"
+}
+
+static htaccess_directive_t *make_bf_dir(directive_type_t type)
+{
+    auto *d = (htaccess_directive_t *)calloc(1, sizeof(htaccess_directive_t));
+    d->type = type;
+    return d;
+}
+
+static void append(htaccess_directive_t *head, htaccess_directive_t *d)
+{
+    while (head->next)
+        head = head->next;
+    head->next = d;
+}
+
+/* Enabled chain: 2 attempts per address, 6 per prefix, 300 s, block */
+static htaccess_directive_t *build_bf_base()
+{
+    auto *d1 = make_bf_dir(DIR_BRUTE_FORCE_PROTECTION);
+    d1->data.brute_force.enabled = 1;
+    auto *d2 = make_bf_dir(DIR_BRUTE_FORCE_ALLOWED_ATTEMPTS);
+    d2->data.brute_force.allowed_attempts = 2;
+    auto *d3 = make_bf_dir(DIR_BRUTE_FORCE_WINDOW);
+    d3->data.brute_force.window_sec = 300;
+    auto *d4 = make_bf_dir(DIR_BRUTE_FORCE_ACTION);
+    d4->data.brute_force.action = BF_ACTION_BLOCK;
+    auto *d5 = make_bf_dir(DIR_BRUTE_FORCE_PREFIX_ATTEMPTS);
+    d5->data.brute_force.allowed_attempts = 6;
+    d1->next = d2; d2->next = d3; d3->next = d4; d4->next = d5;
+    return d1;
+}
+
+static htaccess_directive_t *prefix_dir(directive_type_t type, int len)
+{
+    auto *d = make_bf_dir(type);
+    d->data.brute_force.prefix_len = len;
+    return d;
+}
+
+class BruteForcePrefixTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        mock_lsiapi::reset_global_state();
+        session_.reset();
+        shm_destroy();
+        shm_init(nullptr, 1024);
+    }
+    void TearDown() override { shm_destroy(); }
+
+    int attempt(const htaccess_directive_t *dirs, const char *ip) {
+        return exec_brute_force(session_.handle(), dirs, ip);
+    }
+
+    MockSession session_;
+};
+
+/* --- Parsing and printing --- */
+
+TEST_F(BruteForcePrefixTest, ParsePrefixDirectives) {
+    const char *input = "BruteForceIPv4Prefix 24\n"
+                        "BruteForceIPv6Prefix 48\n"
+                        "BruteForcePrefixAttempts 40\n";
+    auto *d = htaccess_parse(input, strlen(input), "test");
+    ASSERT_NE(d, nullptr);
+    EXPECT_EQ(d->type, DIR_BRUTE_FORCE_IPV4_PREFIX);
+    EXPECT_EQ(d->data.brute_force.prefix_len, 24);
+    ASSERT_NE(d->next, nullptr);
+    EXPECT_EQ(d->next->type, DIR_BRUTE_FORCE_IPV6_PREFIX);
+    EXPECT_EQ(d->next->data.brute_force.prefix_len, 48);
+    ASSERT_NE(d->next->next, nullptr);
+    EXPECT_EQ(d->next->next->type, DIR_BRUTE_FORCE_PREFIX_ATTEMPTS);
+    EXPECT_EQ(d->next->next->data.brute_force.allowed_attempts, 40);
+    htaccess_directives_free(d);
+}
+
+TEST_F(BruteForcePrefixTest, ParseRejectsOutOfRangePrefix) {
+    const char *inputs[] = {
+        "BruteForceIPv4Prefix 33\n",
+        "BruteForceIPv6Prefix 65\n",
+        "BruteForceIPv6Prefix -1\n",
+        "BruteForcePrefixAttempts 0\n",
+    };
+    for (const char *input : inputs) {
+        auto *d = htaccess_parse(input, strlen(input), "test");
+        EXPECT_EQ(d, nullptr) << input;
+        htaccess_directives_free(d);
+    }
+}
+
+TEST_F(BruteForcePrefixTest, PrintRoundTrip) {
+    const char *input = "BruteForceIPv4Prefix 0\n"
+                        "BruteForceIPv6Prefix 56\n"
+                        "BruteForcePrefixAttempts 25\n";
+    auto *d = htaccess_parse(input, strlen(input), "test");
+    ASSERT_NE(d, nullptr);
+    char *out = htaccess_print(d);
+    ASSERT_NE(out, nullptr);
+    EXPECT_STREQ(out, input);
+    free(out);
+    htaccess_directives_free(d);
+}
+
+/* --- Aggregate keys --- */
+
+TEST_F(BruteForcePrefixTest, PrefixKeyMasksHostBits) {
+    ip_addr_t a, b, ka, kb;
+    ASSERT_EQ(ip_addr_parse("2001:db8:1:2:aaaa::1", &a), 0);
+    ASSERT_EQ(ip_addr_parse("2001:db8:1:2:ffff::9", &b), 0);
+    ASSERT_EQ(shm_prefix_key(&a, 0, 64, &ka), 0);
+    ASSERT_EQ(shm_prefix_key(&b, 0, 64, &kb), 0);
+    EXPECT_EQ(ka.hi, kb.hi);
+    EXPECT_EQ(ka.lo, kb.lo);
+
+    ASSERT_EQ(ip_addr_parse("2001:db8:1:3::1", &b), 0);
+    ASSERT_EQ(shm_prefix_key(&b, 0, 64, &kb), 0);
+    EXPECT_NE(ka.lo, kb.lo);
+}
+
+TEST_F(BruteForcePrefixTest, PrefixKeyIsOutsideClientSpace) {
+    ip_addr_t a, k;
+    ASSERT_EQ(ip_addr_parse("192.0.2.77", &a), 0);
+    ASSERT_EQ(shm_prefix_key(&a, 24, 64, &k), 0);
+    EXPECT_EQ(k.hi >> 56, SHM_PREFIX_KEY_HI >> 56);
+    EXPECT_EQ(k.lo, 0xc0000200ULL);
+
+    /* Same network bits under another length or family: distinct keys */
+    ip_addr_t k16;
+    ASSERT_EQ(shm_prefix_key(&a, 16, 64, &k16), 0);
+    EXPECT_NE(k.hi, k16.hi);
+}
+
+TEST_F(BruteForcePrefixTest, PrefixKeyOffPerFamily) {
+    ip_addr_t v4, v6, k;
+    ASSERT_EQ(ip_addr_parse("192.0.2.1", &v4), 0);
+    ASSERT_EQ(ip_addr_parse("2001:db8::1", &v6), 0);
+    EXPECT_EQ(shm_prefix_key(&v4, 0, 64, &k), -1);
+    EXPECT_EQ(shm_prefix_key(&v6, 24, 0, &k), -1);
+}
+
+/* --- Second tier --- */
+
+TEST_F(BruteForcePrefixTest, IPv6RotationWithinSlash64IsBlocked) {
+    auto *base = build_bf_base();
+    char ip[64];
+    int blocked_at = -1;
+
+    /* Each address stays under its own limit of 2 */
+    for (int i = 0; i < 20 && blocked_at < 0; i++) {
+        snprintf(ip, sizeof(ip), "2001:db8:0:1::%x", i + 1);
+        if (attempt(base, ip) == LSI_ERROR)
+            blocked_at = i;
+    }
+    EXPECT_EQ(blocked_at, 6);
+    EXPECT_EQ(session_.get_status_code(), 403);
+
+    /* A neighbouring /64 keeps its own budget */
+    session_.reset();
+    EXPECT_EQ(attempt(base, "2001:db8:0:2::1"), LSI_OK);
+
+    htaccess_directives_free(base);
+}
+
+TEST_F(BruteForcePrefixTest, BlockedPrefixTakesNoNewSlots) {
+    auto *base = build_bf_base();
+    char ip[64];
+    shm_stats_t before, after;
+
+    for (int i = 0; i < 7; i++) {
+        snprintf(ip, sizeof(ip), "2001:db8:0:1::%x", i + 1);
+        attempt(base, ip);
+    }
+    ASSERT_EQ(shm_get_stats(&before), 0);
+    for (int i = 100; i < 200; i++) {
+        snprintf(ip, sizeof(ip), "2001:db8:0:1::%x", i);
+        EXPECT_EQ(attempt(base, ip), LSI_ERROR);
+    }
+    ASSERT_EQ(shm_get_stats(&after), 0);
+    EXPECT_EQ(after.occupied, before.occupied);
+
+    htaccess_directives_free(base);
+}
+
+TEST_F(BruteForcePrefixTest, IPv6PrefixZeroDisablesAggregation) {
+    auto *base = build_bf_base();
+    append(base, prefix_dir(DIR_BRUTE_FORCE_IPV6_PREFIX, 0));
+    char ip[64];
+
+    for (int i = 0; i < 20; i++) {
+        snprintf(ip, sizeof(ip), "2001:db8:0:1::%x", i + 1);
+        EXPECT_EQ(attempt(base, ip), LSI_OK);
+    }
+
+    htaccess_directives_free(base);
+}
+
+TEST_F(BruteForcePrefixTest, IPv4AggregationIsOptIn) {
+    auto *base = build_bf_base();
+    char ip[32];
+
+    for (int i = 1; i <= 20; i++) {
+        snprintf(ip, sizeof(ip), "198.51.100.%d", i);
+        EXPECT_EQ(attempt(base, ip), LSI_OK);
+    }
+
+    append(base, prefix_dir(DIR_BRUTE_FORCE_IPV4_PREFIX, 24));
+    int blocked_at = -1;
+    for (int i = 1; i <= 20 && blocked_at < 0; i++) {
+        snprintf(ip, sizeof(ip), "203.0.113.%d", i);
+        if (attempt(base, ip) == LSI_ERROR)
+            blocked_at = i;
+    }
+    EXPECT_EQ(blocked_at, 7);
+
+    htaccess_directives_free(base);
+}
+
+TEST_F(BruteForcePrefixTest, BlockedAddressDoesNotDrainPrefix) {
+    auto *base = build_bf_base();
+
+    /* One client keeps failing long past its own limit */
+    for (int i = 0; i < 50; i++)
+        attempt(base, "2001:db8:0:1::bad");
+    EXPECT_EQ(attempt(base, "2001:db8:0:1::bad"), LSI_ERROR);
+
+    /* Its neighbours in the /64 still have the rest of the budget */
+    session_.reset();
+    EXPECT_EQ(attempt(base, "2001:db8:0:1::1"), LSI_OK);
+    EXPECT_EQ(attempt(base, "2001:db8:0:1::2"), LSI_OK);
+
+    htaccess_directives_free(base);
+}
+
+TEST_F(BruteForcePrefixTest, DefaultPrefixBudgetScalesWithAllowedAttempts) {
+    auto *d1 = make_bf_dir(DIR_BRUTE_FORCE_PROTECTION);
+    d1->data.brute_force.enabled = 1;
+    auto *d2 = make_bf_dir(DIR_BRUTE_FORCE_ALLOWED_ATTEMPTS);
+    d2->data.brute_force.allowed_attempts = 1;
+    d1->next = d2;
+    char ip[64];
+    int blocked_at = -1;
+
+    for (int i = 0; i < 20 && blocked_at < 0; i++) {
+        snprintf(ip, sizeof(ip), "2001:db8:0:9::%x", i + 1);
+        if (attempt(d1, ip) == LSI_ERROR)
+            blocked_at = i;
+    }
+    EXPECT_EQ(blocked_at, BF_PREFIX_ATTEMPTS_FACTOR);
+
+    htaccess_directives_free(d1);
+}
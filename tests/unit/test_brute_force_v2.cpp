@@ -1,13 +1,16 @@
 /**
  * test_brute_force_v2.cpp - Unit tests for BruteForce v2 enhancements
  *
- * Tests XFF processing, whitelist, and protect path features.
+ * Tests XFF processing, whitelist, and protect path features, including
+ * the compiled protect path trie.
  */
 #include <gtest/gtest.h>
+#include <cstdio>
 #include <cstring>
 #include "mock_lsiapi.h"
 
 extern "C" {
+#include "htaccess_config.h"
 #include "htaccess_exec_brute_force.h"
 #include "htaccess_parser.h"
 #include "htaccess_directive.h"
@@ -77,6 +80,29 @@ TEST_F(BruteForceV2Test, ParseProtectPath) {
     htaccess_directives_free(d);
 }
 
+TEST_F(BruteForceV2Test, ParseFailureStatus) {
+    const char *input = "BruteForceFailureStatus 401   403 429\n";
+    auto *d = htaccess_parse(input, strlen(input), "test");
+    ASSERT_NE(d, nullptr);
+    EXPECT_EQ(d->type, DIR_BRUTE_FORCE_FAILURE_STATUS);
+    EXPECT_STREQ(d->value, "401 403 429");
+    htaccess_directives_free(d);
+}
+
+TEST_F(BruteForceV2Test, ParseFailureStatusRejectsNonStatus) {
+    const char *inputs[] = {
+        "BruteForceFailureStatus\n",
+        "BruteForceFailureStatus 401 abc\n",
+        "BruteForceFailureStatus 99\n",
+        "BruteForceFailureStatus 600\n",
+    };
+    for (const char *input : inputs) {
+        auto *d = htaccess_parse(input, strlen(input), "test");
+        EXPECT_EQ(d, nullptr) << input;
+        htaccess_directives_free(d);
+    }
+}
+
 /* --- XFF tests --- */
 
 TEST_F(BruteForceV2Test, XFFEnabledUsesForwardedIP) {
@@ -151,6 +177,22 @@ TEST_F(BruteForceV2Test, NonWhitelistedIPBlocked) {
     htaccess_directives_free(base);
 }
 
+TEST_F(BruteForceV2Test, Ipv6WhitelistedIPBypasses) {
+    auto *base = build_bf_base();
+    auto *wl = make_bf_dir(DIR_BRUTE_FORCE_WHITELIST);
+    wl->value = strdup("2001:db8::/32");
+    htaccess_directive_t *tail = base;
+    while (tail->next) tail = tail->next;
+    tail->next = wl;
+
+    for (int i = 0; i < 10; i++) {
+        int rc = exec_brute_force(session_.handle(), base, "2001:db8::7");
+        EXPECT_EQ(rc, LSI_OK);
+    }
+
+    htaccess_directives_free(base);
+}
+
 /* --- Protect path tests --- */
 
 TEST_F(BruteForceV2Test, ProtectedPathTracked) {
@@ -189,3 +231,122 @@ TEST_F(BruteForceV2Test, UnprotectedPathNotTracked) {
 
     htaccess_directives_free(base);
 }
+
+/* --- Compiled protect path trie --- */
+
+static htaccess_directive_t *protect_paths(const char *const *paths, int n)
+{
+    htaccess_directive_t *head = nullptr, **tail = &head;
+    for (int i = 0; i < n; i++) {
+        auto *pp = make_bf_dir(DIR_BRUTE_FORCE_PROTECT_PATH);
+        pp->value = strdup(paths[i]);
+        *tail = pp;
+        tail = &pp->next;
+    }
+    return head;
+}
+
+TEST_F(BruteForceV2Test, PathTrieMatchesPrefixes) {
+    const char *paths[] = {"/wp-login.php", "/admin", "/xmlrpc.php",
+                           "/administrator/index.php", "/user/login"};
+    auto *list = protect_paths(paths, 5);
+    bf_path_trie_t trie;
+    ASSERT_EQ(bf_path_trie_compile(list, &trie), 0);
+    EXPECT_EQ(trie.num_paths, 5);
+
+    EXPECT_TRUE(bf_path_trie_match(&trie, "/wp-login.php"));
+    EXPECT_TRUE(bf_path_trie_match(&trie, "/wp-login.php?action=lost"));
+    EXPECT_TRUE(bf_path_trie_match(&trie, "/administrator/index.php"));
+    EXPECT_TRUE(bf_path_trie_match(&trie, "/admin"));
+    EXPECT_TRUE(bf_path_trie_match(&trie, "/user/login/"));
+    EXPECT_FALSE(bf_path_trie_match(&trie, "/wp-login"));
+    EXPECT_FALSE(bf_path_trie_match(&trie, "/adm"));
+    EXPECT_FALSE(bf_path_trie_match(&trie, "/user/logout"));
+    EXPECT_FALSE(bf_path_trie_match(&trie, "/"));
+    EXPECT_FALSE(bf_path_trie_match(&trie, ""));
+
+    bf_path_trie_free(&trie);
+    htaccess_directives_free(list);
+}
+
+TEST_F(BruteForceV2Test, PathTrieDropsPathsCoveredByPrefix) {
+    const char *paths[] = {"/admin/login", "/admin", "/admin/x/y"};
+    auto *list = protect_paths(paths, 3);
+    bf_path_trie_t trie;
+    ASSERT_EQ(bf_path_trie_compile(list, &trie), 0);
+
+    /* Only "/admin" is kept: root plus one node per byte */
+    EXPECT_EQ(trie.paths.num_nodes, strlen("/admin") + 1);
+    EXPECT_TRUE(bf_path_trie_match(&trie, "/admin/other"));
+
+    bf_path_trie_free(&trie);
+    htaccess_directives_free(list);
+}
+
+TEST_F(BruteForceV2Test, PathTrieHandlesHighBytes) {
+    const char *paths[] = {"/\xc3\xa9t\xc3\xa9", "/\x7f", "/\xff"};
+    auto *list = protect_paths(paths, 3);
+    bf_path_trie_t trie;
+    ASSERT_EQ(bf_path_trie_compile(list, &trie), 0);
+
+    EXPECT_TRUE(bf_path_trie_match(&trie, "/\xc3\xa9t\xc3\xa9/login"));
+    EXPECT_TRUE(bf_path_trie_match(&trie, "/\xff\xfe"));
+    EXPECT_TRUE(bf_path_trie_match(&trie, "/\x7f"));
+    EXPECT_FALSE(bf_path_trie_match(&trie, "/\xc3\xa9"));
+
+    bf_path_trie_free(&trie);
+    htaccess_directives_free(list);
+}
+
+TEST_F(BruteForceV2Test, EmptyPathTrieMatchesNothing) {
+    bf_path_trie_t trie;
+    ASSERT_EQ(bf_path_trie_compile(nullptr, &trie), 0);
+    EXPECT_EQ(trie.num_paths, 0);
+    EXPECT_FALSE(bf_path_trie_match(&trie, "/wp-login.php"));
+    bf_path_trie_free(&trie);
+}
+
+/* Paths past the 32nd used to be dropped */
+TEST_F(BruteForceV2Test, ManyProtectPathsAreAllHonoured) {
+    auto *base = build_bf_base();
+    htaccess_directive_t *tail = base;
+    while (tail->next) tail = tail->next;
+    char path[32];
+    for (int i = 0; i < 200; i++) {
+        auto *pp = make_bf_dir(DIR_BRUTE_FORCE_PROTECT_PATH);
+        snprintf(path, sizeof(path), "/site%d/login", i);
+        pp->value = strdup(path);
+        tail->next = pp;
+        tail = pp;
+    }
+    htaccess_config_t *cfg = htaccess_config_create(base);
+    ASSERT_NE(cfg, nullptr);
+    ASSERT_TRUE(cfg->bf_paths_ready);
+    EXPECT_EQ(cfg->bf_paths.num_paths, 200);
+
+    const char *uris[] = {"/site199/login", "/site7/login", "/site7/"};
+    const int expected[] = {LSI_ERROR, LSI_ERROR, LSI_OK};
+    for (int u = 0; u < 3; u++) {
+        for (int compiled = 0; compiled < 2; compiled++) {
+            shm_destroy();
+            shm_init(nullptr, 64);
+            session_.reset();
+            session_.set_client_ip("1.2.3.4");
+            session_.set_request_uri(uris[u]);
+            htaccess_request_t req;
+            htaccess_request_init(&req, session_.handle());
+            for (int i = 0; i < 2; i++) {
+                if (compiled)
+                    htaccess_config_exec_brute_force_resp(&req, cfg, 401);
+                else
+                    exec_brute_force_resp_req(&req, base, 401);
+            }
+            int rc = compiled ? htaccess_config_exec_brute_force(&req, cfg)
+                              : exec_brute_force_req(&req, base);
+            EXPECT_EQ(rc, expected[u]) << uris[u] << " compiled="
+                                       << compiled;
+        }
+    }
+
+    htaccess_config_release(cfg);
+}
@@ -6,9 +6,11 @@
 #include <gtest/gtest.h>
 #include <cstring>
 #include <cstdlib>
+#include <string>
 
 extern "C" {
 #include "htaccess_cache.h"
+#include "htaccess_config.h"
 #include "htaccess_directive.h"
 }
 
@@ -233,3 +235,60 @@ TEST(CacheDoubleDestroy, DestroyWithoutInitIsSafe)
     /* Calling destroy when init was never called should not crash */
     htaccess_cache_destroy();
 }
+
+/* ==================================================================
+ *  Effective configs: bounded, least recently used evicted first
+ * ================================================================== */
+
+TEST_F(CacheTest, EffectiveConfigsAreBounded)
+{
+    const uint64_t gens[1] = {1};
+    htaccess_config_t *cfg = nullptr;
+
+    for (int i = 0; i < CACHE_MAX_CONFIGS + 10; i++) {
+        std::string dir = "/var/www/d" + std::to_string(i);
+        htaccess_config_t *c = htaccess_config_create(
+            make_directive(DIR_HEADER_SET, "X-Dir", dir.c_str(), 1));
+        ASSERT_NE(c, nullptr);
+        ASSERT_EQ(htaccess_cache_put_config(dir.c_str(), gens, 1, c), 0);
+        htaccess_config_release(c);
+        /* Keep the first directory in use so it is never the oldest */
+        if (i % 64 == 0) {
+            ASSERT_EQ(htaccess_cache_get_config("/var/www/d0", gens, 1,
+                                                &cfg), 0);
+            htaccess_config_release(cfg);
+        }
+    }
+
+    EXPECT_EQ(htaccess_cache_get_config("/var/www/d0", gens, 1, &cfg), 0);
+    htaccess_config_release(cfg);
+    /* The oldest unused directories were evicted, the newest kept */
+    EXPECT_EQ(htaccess_cache_get_config("/var/www/d1", gens, 1, &cfg), -1);
+    EXPECT_EQ(htaccess_cache_get_config("/var/www/d10", gens, 1, &cfg), -1);
+    std::string last = "/var/www/d" + std::to_string(CACHE_MAX_CONFIGS + 9);
+    ASSERT_EQ(htaccess_cache_get_config(last.c_str(), gens, 1, &cfg), 0);
+    htaccess_config_release(cfg);
+}
+
+/* A config borrowed by a request outlives its eviction */
+TEST_F(CacheTest, EvictedConfigSurvivesBorrow)
+{
+    const uint64_t gens[1] = {1};
+    htaccess_config_t *held = htaccess_config_create(
+        make_directive(DIR_HEADER_SET, "X-Held", "1", 1));
+    ASSERT_NE(held, nullptr);
+    ASSERT_EQ(htaccess_cache_put_config("/held", gens, 1, held), 0);
+
+    for (int i = 0; i < CACHE_MAX_CONFIGS; i++) {
+        std::string dir = "/other/d" + std::to_string(i);
+        htaccess_config_t *c = htaccess_config_create(nullptr);
+        ASSERT_NE(c, nullptr);
+        ASSERT_EQ(htaccess_cache_put_config(dir.c_str(), gens, 1, c), 0);
+        htaccess_config_release(c);
+    }
+    htaccess_config_t *cfg = nullptr;
+    EXPECT_EQ(htaccess_cache_get_config("/held", gens, 1, &cfg), -1);
+    ASSERT_NE(held->directives, nullptr);
+    EXPECT_STREQ(held->directives->value, "1");
+    htaccess_config_release(held);
+}
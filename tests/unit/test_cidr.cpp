@@ -5,6 +5,11 @@
  */
 #include <gtest/gtest.h>
 
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
 extern "C" {
 #include "htaccess_cidr.h"
 }
@@ -275,3 +280,268 @@ TEST(IpParse, TrailingSlash_ReturnsError)
     uint32_t ip;
     EXPECT_EQ(ip_parse("10.0.0.1/24", &ip), -1);
 }
+
+/* ==================================================================
+ *  ip_addr / ip_cidr — 128-bit address engine
+ * ================================================================== */
+
+static ip_addr_t v4(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+{
+    ip_addr_t addr;
+    ip_addr_from_v4(make_ip(a, b, c, d), &addr);
+    return addr;
+}
+
+static ip_addr_t v6(const char *s)
+{
+    ip_addr_t addr{};
+    EXPECT_EQ(ip_addr_parse(s, &addr), 0) << s;
+    return addr;
+}
+
+TEST(IpAddrParse, Ipv4IsMapped)
+{
+    ip_addr_t a;
+    ASSERT_EQ(ip_addr_parse(" 192.0.2.1 ", &a), 0);
+    EXPECT_EQ(a.hi, 0u);
+    EXPECT_EQ(a.lo, 0x0000FFFFC0000201ull);
+    EXPECT_TRUE(ip_addr_is_v4(&a));
+}
+
+TEST(IpAddrParse, Ipv6Forms)
+{
+    ip_addr_t a;
+    ASSERT_EQ(ip_addr_parse("2001:db8::1", &a), 0);
+    EXPECT_EQ(a.hi, 0x20010DB800000000ull);
+    EXPECT_EQ(a.lo, 1u);
+    EXPECT_FALSE(ip_addr_is_v4(&a));
+
+    ASSERT_EQ(ip_addr_parse("fe80::1%eth0", &a), 0);
+    EXPECT_EQ(a.hi, 0xFE80000000000000ull);
+}
+
+TEST(IpAddrParse, MappedTextEqualsIpv4)
+{
+    ip_addr_t a = v6("::ffff:10.1.2.3");
+    ip_addr_t b = v4(10, 1, 2, 3);
+    EXPECT_EQ(a.hi, b.hi);
+    EXPECT_EQ(a.lo, b.lo);
+}
+
+TEST(IpAddrParse, InvalidInputs)
+{
+    ip_addr_t a;
+    EXPECT_EQ(ip_addr_parse("", &a), -1);
+    EXPECT_EQ(ip_addr_parse("2001:db8::1::2", &a), -1);
+    EXPECT_EQ(ip_addr_parse("1.2.3", &a), -1);
+    EXPECT_EQ(ip_addr_parse("10.0.0.1/8", &a), -1);
+    EXPECT_EQ(ip_addr_parse(nullptr, &a), -1);
+}
+
+TEST(IpCidrParse, Ipv4PrefixIsOffsetIntoMappedSpace)
+{
+    ip_cidr_t c;
+    ASSERT_EQ(ip_cidr_parse("10.9.8.7/8", &c), 0);
+    EXPECT_EQ(c.prefix_len, 104);
+    EXPECT_EQ(c.network.lo, 0x0000FFFF0A000000ull);
+
+    ASSERT_EQ(ip_cidr_parse("10.9.8.7", &c), 0);
+    EXPECT_EQ(c.prefix_len, 128);
+}
+
+TEST(IpCidrParse, Ipv6Prefix)
+{
+    ip_cidr_t c;
+    ASSERT_EQ(ip_cidr_parse("2001:db8:abcd:12ff::/48", &c), 0);
+    EXPECT_EQ(c.prefix_len, 48);
+    EXPECT_EQ(c.network.hi, 0x20010DB8ABCD0000ull);
+    EXPECT_EQ(c.network.lo, 0u);
+
+    EXPECT_EQ(ip_cidr_parse("2001:db8::/129", &c), -1);
+    EXPECT_EQ(ip_cidr_parse("10.0.0.0/33", &c), -1);
+    EXPECT_EQ(ip_cidr_parse("2001:db8::/", &c), -1);
+    EXPECT_EQ(ip_cidr_parse("2001:db8::/4x", &c), -1);
+}
+
+TEST(IpCidrMatch, BothFamilies)
+{
+    ip_cidr_t net4, net6, all;
+    ASSERT_EQ(ip_cidr_parse("192.168.0.0/16", &net4), 0);
+    ASSERT_EQ(ip_cidr_parse("2001:db8::/32", &net6), 0);
+    ASSERT_EQ(ip_cidr_parse("ALL", &all), 0);
+
+    ip_addr_t in4 = v4(192, 168, 7, 7);
+    ip_addr_t mapped = v6("::ffff:192.168.7.7");
+    ip_addr_t in6 = v6("2001:db8:1::5");
+    ip_addr_t out6 = v6("2001:db9::5");
+
+    EXPECT_TRUE(ip_cidr_match(&net4, &in4));
+    EXPECT_TRUE(ip_cidr_match(&net4, &mapped));
+    EXPECT_FALSE(ip_cidr_match(&net4, &in6));
+    EXPECT_TRUE(ip_cidr_match(&net6, &in6));
+    EXPECT_FALSE(ip_cidr_match(&net6, &out6));
+    EXPECT_FALSE(ip_cidr_match(&net6, &in4));
+    EXPECT_TRUE(ip_cidr_match(&all, &in4));
+    EXPECT_TRUE(ip_cidr_match(&all, &out6));
+}
+
+/* ==================================================================
+ *  cidr_set — compiled CIDR lists
+ * ================================================================== */
+
+TEST(CidrSet, CompileMixedSeparators)
+{
+    cidr_set_t set;
+    ASSERT_EQ(cidr_set_compile("10.0.0.0/8, 192.168.1.1\t172.16.0.0/12", &set), 3);
+    /* Stored sorted by start address */
+    EXPECT_EQ(set.first[0].lo, v4(10, 0, 0, 0).lo);
+    EXPECT_EQ(set.last[0].lo, v4(10, 255, 255, 255).lo);
+    EXPECT_EQ(set.first[1].lo, v4(172, 16, 0, 0).lo);
+    EXPECT_EQ(set.first[2].lo, v4(192, 168, 1, 1).lo);
+    EXPECT_EQ(set.last[2].lo, v4(192, 168, 1, 1).lo);
+    cidr_set_free(&set);
+    EXPECT_EQ(set.first, nullptr);
+    EXPECT_EQ(set.count, 0);
+}
+
+TEST(CidrSet, MixedFamilies)
+{
+    cidr_set_t set;
+    ASSERT_EQ(cidr_set_compile("10.0.0.0/8 2001:db8::/32", &set), 2);
+    ip_addr_t a = v4(10, 3, 3, 3);
+    ip_addr_t b = v6("2001:db8::42");
+    ip_addr_t c = v6("2001:db9::42");
+    EXPECT_TRUE(cidr_set_match(&set, &a));
+    EXPECT_TRUE(cidr_set_match(&set, &b));
+    EXPECT_FALSE(cidr_set_match(&set, &c));
+    cidr_set_free(&set);
+}
+
+TEST(CidrSet, InvalidTokensSkipped)
+{
+    cidr_set_t set;
+    ASSERT_EQ(cidr_set_compile("bogus 10.0.0.1 300.1.1.1/8", &set), 1);
+    ip_addr_t hit = v4(10, 0, 0, 1), miss = v4(10, 0, 0, 2);
+    EXPECT_TRUE(cidr_set_match(&set, &hit));
+    EXPECT_FALSE(cidr_set_match(&set, &miss));
+    cidr_set_free(&set);
+}
+
+TEST(CidrSet, EmptyOrNullListCompilesToEmptySet)
+{
+    cidr_set_t set;
+    EXPECT_EQ(cidr_set_compile(nullptr, &set), 0);
+    EXPECT_EQ(set.first, nullptr);
+    EXPECT_EQ(cidr_set_compile("  , ", &set), 0);
+    EXPECT_EQ(set.first, nullptr);
+    ip_addr_t a = v4(1, 2, 3, 4);
+    EXPECT_FALSE(cidr_set_match(&set, &a));
+}
+
+TEST(CidrSet, AllKeywordMatchesEverything)
+{
+    cidr_set_t set;
+    ASSERT_EQ(cidr_set_compile("all", &set), 1);
+    ip_addr_t lo = v4(0, 0, 0, 0), hi = v4(255, 255, 255, 255);
+    ip_addr_t six = v6("2001:db8::1");
+    EXPECT_TRUE(cidr_set_match(&set, &lo));
+    EXPECT_TRUE(cidr_set_match(&set, &hi));
+    EXPECT_TRUE(cidr_set_match(&set, &six));
+    cidr_set_free(&set);
+}
+
+TEST(CidrSet, NestedRangesCollapse)
+{
+    cidr_set_t set;
+    ASSERT_EQ(cidr_set_compile("10.1.2.3 10.1.2.0/24 10.1.2.200 10.1.2.0/25",
+                               &set), 1);
+    EXPECT_EQ(set.first[0].lo, v4(10, 1, 2, 0).lo);
+    EXPECT_EQ(set.last[0].lo, v4(10, 1, 2, 255).lo);
+    cidr_set_free(&set);
+}
+
+TEST(CidrSet, AdjacentRangesMerge)
+{
+    cidr_set_t set;
+    /* .0/25 + .128/25 + 10.1.3.0 form one interval; 10.1.3.2 does not touch */
+    ASSERT_EQ(cidr_set_compile("10.1.2.128/25 10.1.3.0 10.1.2.0/25 10.1.3.2",
+                               &set), 2);
+    EXPECT_EQ(set.first[0].lo, v4(10, 1, 2, 0).lo);
+    EXPECT_EQ(set.last[0].lo, v4(10, 1, 3, 0).lo);
+    ip_addr_t gap = v4(10, 1, 3, 1), tail = v4(10, 1, 3, 2);
+    ip_addr_t before = v4(10, 1, 1, 255), edge = v4(10, 1, 3, 0);
+    EXPECT_FALSE(cidr_set_match(&set, &gap));
+    EXPECT_TRUE(cidr_set_match(&set, &tail));
+    EXPECT_FALSE(cidr_set_match(&set, &before));
+    EXPECT_TRUE(cidr_set_match(&set, &edge));
+    cidr_set_free(&set);
+}
+
+TEST(CidrSet, AllAbsorbsEverything)
+{
+    cidr_set_t set;
+    ASSERT_EQ(cidr_set_compile("10.0.0.0/8 all 2001:db8::/32", &set), 1);
+    EXPECT_EQ(set.first[0].hi, 0u);
+    EXPECT_EQ(set.first[0].lo, 0u);
+    EXPECT_EQ(set.last[0].hi, ~0ull);
+    EXPECT_EQ(set.last[0].lo, ~0ull);
+    cidr_set_free(&set);
+}
+
+TEST(CidrSet, AgreesWithLinearScan)
+{
+    std::mt19937 rng(7);
+    std::string list;
+    std::vector<ip_cidr_t> rules;
+    for (int i = 0; i < 300; i++) {
+        char buf[32];
+        uint32_t ip = 0x0A000000u | (rng() & 0x0000FFFFu);
+        snprintf(buf, sizeof(buf), "%u.%u.%u.%u/%u", ip >> 24,
+                 (ip >> 16) & 0xFF, (ip >> 8) & 0xFF, ip & 0xFF,
+                 22 + rng() % 11);
+        ip_cidr_t c;
+        ASSERT_EQ(ip_cidr_parse(buf, &c), 0);
+        rules.push_back(c);
+        list += buf;
+        list += ' ';
+    }
+    cidr_set_t set;
+    ASSERT_GT(cidr_set_compile(list.c_str(), &set), 0);
+    for (int i = 1; i < set.count; i++) {
+        /* Disjoint, sorted and not touching */
+        ip_addr_t after = set.last[i - 1];
+        after.lo++;
+        EXPECT_LT(after.lo, set.first[i].lo);
+    }
+    for (int i = 0; i < 20000; i++) {
+        ip_addr_t a = v4(10, 0, 0, 0);
+        a.lo |= rng() & 0x0003FFFFu;
+        bool expect = false;
+        for (const auto &r : rules)
+            expect = expect || ip_cidr_match(&r, &a);
+        ASSERT_EQ(cidr_set_match(&set, &a) != 0, expect);
+    }
+    cidr_set_free(&set);
+}
+
+TEST(CidrSet, CopyIsIndependent)
+{
+    cidr_set_t a, b;
+    ASSERT_EQ(cidr_set_compile("192.168.0.0/16", &a), 1);
+    ASSERT_EQ(cidr_set_copy(&b, &a), 0);
+    cidr_set_free(&a);
+    ASSERT_EQ(b.count, 1);
+    ip_addr_t addr = v4(192, 168, 3, 4);
+    EXPECT_TRUE(cidr_set_match(&b, &addr));
+    cidr_set_free(&b);
+}
+
+TEST(CidrListMatch, MatchesWithoutCompiling)
+{
+    ip_addr_t in = v4(192, 168, 1, 9), out = v4(172, 16, 0, 1);
+    ip_addr_t six = v6("2001:db8::9");
+    EXPECT_EQ(cidr_list_match("10.0.0.0/8 192.168.1.0/24", &in), 1);
+    EXPECT_EQ(cidr_list_match("10.0.0.0/8,192.168.1.0/24", &out), 0);
+    EXPECT_EQ(cidr_list_match("10.0.0.0/8 2001:db8::/64", &six), 1);
+    EXPECT_EQ(cidr_list_match(nullptr, &in), 0);
+}
@@ -208,6 +208,22 @@ TEST(DirectiveEnums, V2EnumValuesStartAt28) {
     EXPECT_EQ(static_cast<int>(DIR_BRUTE_FORCE_X_FORWARDED_FOR), 56);
     EXPECT_EQ(static_cast<int>(DIR_BRUTE_FORCE_WHITELIST), 57);
     EXPECT_EQ(static_cast<int>(DIR_BRUTE_FORCE_PROTECT_PATH), 58);
+
+    /* Brute force prefix aggregation */
+    EXPECT_EQ(static_cast<int>(DIR_BRUTE_FORCE_IPV4_PREFIX), 59);
+    EXPECT_EQ(static_cast<int>(DIR_BRUTE_FORCE_IPV6_PREFIX), 60);
+    EXPECT_EQ(static_cast<int>(DIR_BRUTE_FORCE_PREFIX_ATTEMPTS), 61);
+
+    /* Brute force response-phase accounting */
+    EXPECT_EQ(static_cast<int>(DIR_BRUTE_FORCE_FAILURE_STATUS), 62);
+
+    /* Group and per-user authorization */
+    EXPECT_EQ(static_cast<int>(DIR_AUTH_GROUP_FILE), 63);
+    EXPECT_EQ(static_cast<int>(DIR_REQUIRE_USER), 64);
+    EXPECT_EQ(static_cast<int>(DIR_REQUIRE_GROUP), 65);
+
+    /* Bulk redirects */
+    EXPECT_EQ(static_cast<int>(DIR_REDIRECT_MAP), 66);
 }
 
 /* ---- v2 Container type free tests ---- */
@@ -333,3 +333,62 @@ TEST_F(DirWalkerTest, SingletonDirective_ChildOverrides)
 
     htaccess_directives_free(merged);
 }
+
+/* ==================================================================
+ *  11. Effective config is cached and reused per target directory
+ * ================================================================== */
+
+TEST_F(DirWalkerTest, Config_ReusedWhileLevelsUnchanged)
+{
+    htaccess_cache_put("/var/www/html/.htaccess", 0,
+                       make_directive(DIR_DENY_FROM, nullptr,
+                                      "10.0.0.0/8", 1));
+
+    htaccess_config_t *a = htaccess_dirwalk_config(
+        nullptr, "/var/www/html", "/var/www/html/sub");
+    htaccess_config_t *b = htaccess_dirwalk_config(
+        nullptr, "/var/www/html", "/var/www/html/sub");
+
+    ASSERT_NE(a, nullptr);
+    EXPECT_EQ(a, b);
+    EXPECT_TRUE(a->acl_ready);
+    EXPECT_TRUE(a->require_ready);
+    EXPECT_EQ(a->require.active, 0);
+    EXPECT_EQ(count_directives(a->directives), 1);
+
+    htaccess_config_release(a);
+    htaccess_config_release(b);
+}
+
+TEST_F(DirWalkerTest, Config_RebuiltWhenLevelReplaced)
+{
+    htaccess_cache_put("/var/www/html/sub/.htaccess", 0,
+                       make_directive(DIR_DENY_FROM, nullptr,
+                                      "10.0.0.0/8", 1));
+    htaccess_config_t *a = htaccess_dirwalk_config(
+        nullptr, "/var/www/html", "/var/www/html/sub");
+    ASSERT_NE(a, nullptr);
+
+    /* Same mtime but a new parse: the generation changes */
+    htaccess_cache_put("/var/www/html/sub/.htaccess", 0,
+                       make_directive(DIR_DENY_FROM, nullptr,
+                                      "192.168.0.0/16", 1));
+    htaccess_config_t *b = htaccess_dirwalk_config(
+        nullptr, "/var/www/html", "/var/www/html/sub");
+    ASSERT_NE(b, nullptr);
+    EXPECT_NE(a, b);
+    EXPECT_STREQ(b->directives->value, "192.168.0.0/16");
+
+    /* The old config stays valid until its last reference is dropped */
+    EXPECT_STREQ(a->directives->value, "10.0.0.0/8");
+
+    htaccess_config_release(a);
+    htaccess_config_release(b);
+}
+
+TEST_F(DirWalkerTest, Config_NullWhenNoDirectives)
+{
+    EXPECT_EQ(htaccess_dirwalk_config(nullptr, "/nonexistent/root",
+                                      "/nonexistent/root/sub"),
+              nullptr);
+}
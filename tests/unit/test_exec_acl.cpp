@@ -423,3 +423,149 @@ TEST_F(ExecAclTest, MultipleDenyRules)
 
     free_dir_list(order);
 }
+
+/* ------------------------------------------------------------------ */
+/*  Compiled ACL (interval sets per effective config)                  */
+/* ------------------------------------------------------------------ */
+
+TEST_F(ExecAclTest, Compiled_MatchesListEvaluation)
+{
+    auto *order = make_order(ORDER_DENY_ALLOW);
+    auto *deny = make_deny("10.0.0.0/8 172.16.0.0/12");
+    auto *allow = make_allow("10.1.2.3");
+    order->next = deny;
+    deny->next = allow;
+
+    acl_compiled_t acl;
+    ASSERT_EQ(acl_compile(order, &acl), 0);
+    EXPECT_EQ(acl.active, 1);
+    EXPECT_EQ(acl.order, ORDER_DENY_ALLOW);
+
+    const char *ips[] = {"10.1.2.3", "10.9.9.9", "172.20.0.1",
+                         "192.168.1.1"};
+    for (const char *ip : ips) {
+        session_.reset();
+        session_.set_client_ip(ip);
+        int expected = exec_access_control(session_.handle(), order);
+        session_.reset();
+        session_.set_client_ip(ip);
+        EXPECT_EQ(exec_access_control_compiled(session_.handle(), &acl),
+                  expected) << ip;
+    }
+
+    acl_compiled_free(&acl);
+    free_dir_list(order);
+}
+
+TEST_F(ExecAclTest, Compiled_DeniedSets403)
+{
+    auto *order = make_order(ORDER_ALLOW_DENY);
+    auto *allow = make_allow("all");
+    auto *deny = make_deny("203.0.113.0/24");
+    order->next = allow;
+    allow->next = deny;
+
+    acl_compiled_t acl;
+    ASSERT_EQ(acl_compile(order, &acl), 0);
+
+    session_.set_client_ip("203.0.113.7");
+    EXPECT_EQ(exec_access_control_compiled(session_.handle(), &acl),
+              LSI_ERROR);
+    EXPECT_EQ(session_.get_status_code(), 403);
+
+    acl_compiled_free(&acl);
+    free_dir_list(order);
+}
+
+TEST_F(ExecAclTest, Compiled_DirectivesMergeIntoOneSet)
+{
+    auto *order = make_order(ORDER_DENY_ALLOW);
+    auto *d1 = make_deny("198.51.100.0/25");
+    auto *d2 = make_deny("198.51.100.7 198.51.100.128/25");
+    auto *d3 = make_deny("198.51.100.200");
+    order->next = d1;
+    d1->next = d2;
+    d2->next = d3;
+
+    acl_compiled_t acl;
+    ASSERT_EQ(acl_compile(order, &acl), 0);
+    /* Three directives, four ranges, one /24 worth of addresses */
+    EXPECT_EQ(acl.deny.count, 1);
+    EXPECT_EQ(acl.allow.count, 0);
+
+    session_.set_client_ip("198.51.100.255");
+    EXPECT_EQ(exec_access_control_compiled(session_.handle(), &acl),
+              LSI_ERROR);
+    session_.reset();
+    session_.set_client_ip("198.51.101.0");
+    EXPECT_EQ(exec_access_control_compiled(session_.handle(), &acl), LSI_OK);
+
+    acl_compiled_free(&acl);
+    free_dir_list(order);
+}
+
+TEST_F(ExecAclTest, Compiled_InactiveWithoutAclDirectives)
+{
+    auto *d = (htaccess_directive_t *)calloc(1, sizeof(htaccess_directive_t));
+    d->type = DIR_HEADER_SET;
+
+    acl_compiled_t acl;
+    ASSERT_EQ(acl_compile(d, &acl), 0);
+    EXPECT_EQ(acl.active, 0);
+
+    session_.set_client_ip("10.0.0.1");
+    EXPECT_EQ(exec_access_control_compiled(session_.handle(), &acl), LSI_OK);
+
+    acl_compiled_free(&acl);
+    free_dir_list(d);
+}
+
+/* ------------------------------------------------------------------ */
+/*  IPv6 clients                                                       */
+/* ------------------------------------------------------------------ */
+
+TEST_F(ExecAclTest, Ipv6ClientDeniedByIpv6Range)
+{
+    session_.set_client_ip("2001:db8:1::25");
+    auto *order = make_order(ORDER_DENY_ALLOW);
+    auto *deny = make_deny("2001:db8::/32");
+    order->next = deny;
+
+    EXPECT_EQ(exec_access_control(session_.handle(), order), LSI_ERROR);
+    EXPECT_EQ(session_.get_status_code(), 403);
+
+    acl_compiled_t acl;
+    ASSERT_EQ(acl_compile(order, &acl), 0);
+    session_.reset();
+    session_.set_client_ip("2001:db8:1::25");
+    EXPECT_EQ(exec_access_control_compiled(session_.handle(), &acl),
+              LSI_ERROR);
+    acl_compiled_free(&acl);
+
+    free_dir_list(order);
+}
+
+TEST_F(ExecAclTest, Ipv6ClientNoLongerAllowedByDefault)
+{
+    /* Order Allow,Deny with only an IPv4 allow: IPv6 clients are denied */
+    session_.set_client_ip("2001:db8::1");
+    auto *order = make_order(ORDER_ALLOW_DENY);
+    auto *allow = make_allow("10.0.0.0/8");
+    order->next = allow;
+
+    EXPECT_EQ(exec_access_control(session_.handle(), order), LSI_ERROR);
+
+    free_dir_list(order);
+}
+
+TEST_F(ExecAclTest, MappedIpv4ClientMatchesIpv4Rule)
+{
+    session_.set_client_ip("::ffff:10.0.0.1");
+    auto *order = make_order(ORDER_DENY_ALLOW);
+    auto *deny = make_deny("10.0.0.0/8");
+    order->next = deny;
+
+    EXPECT_EQ(exec_access_control(session_.handle(), order), LSI_ERROR);
+
+    free_dir_list(order);
+}
@@ -197,3 +197,25 @@ TEST_F(AuthBasicTest, ParseRoundTrip)
 
     htaccess_directives_free(dirs);
 }
+
+/* Parsing of group and per-user authorization directives */
+TEST_F(AuthBasicTest, ParseGroupDirectives)
+{
+    const char *input =
+        "AuthGroupFile /etc/htgroup\n"
+        "Require user alice bob\n"
+        "Require group admins ops\n";
+    auto *dirs = parse(input);
+    ASSERT_NE(dirs, nullptr);
+
+    EXPECT_EQ(dirs->type, DIR_AUTH_GROUP_FILE);
+    EXPECT_STREQ(dirs->value, "/etc/htgroup");
+    ASSERT_NE(dirs->next, nullptr);
+    EXPECT_EQ(dirs->next->type, DIR_REQUIRE_USER);
+    EXPECT_STREQ(dirs->next->value, "alice bob");
+    ASSERT_NE(dirs->next->next, nullptr);
+    EXPECT_EQ(dirs->next->next->type, DIR_REQUIRE_GROUP);
+    EXPECT_STREQ(dirs->next->next->value, "admins ops");
+
+    htaccess_directives_free(dirs);
+}
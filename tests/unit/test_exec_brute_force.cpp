@@ -156,7 +156,7 @@ TEST_F(ExecBruteForceTest, BlockActionReturns403)
 /*  Throttle action (Req 12.6)                                         */
 /* ------------------------------------------------------------------ */
 
-TEST_F(ExecBruteForceTest, ThrottleActionSetsEnvVar)
+TEST_F(ExecBruteForceTest, ThrottleActionSuspendsRequest)
 {
     auto *dirs = build_bf_directives(1, 2, 300, BF_ACTION_THROTTLE, 2000);
     session_.set_client_ip("192.168.1.1");
@@ -165,13 +165,69 @@ TEST_F(ExecBruteForceTest, ThrottleActionSetsEnvVar)
     exec_brute_force(session_.handle(), dirs, "192.168.1.1");
     exec_brute_force(session_.handle(), dirs, "192.168.1.1");
 
-    /* 3rd triggers throttle — returns OK but sets env var */
+    /* 3rd triggers throttle — suspended, not rejected */
     session_.set_status_code(200);
     int result = exec_brute_force(session_.handle(), dirs, "192.168.1.1");
-    EXPECT_EQ(result, LSI_OK);
+    EXPECT_EQ(result, LSI_SUSPEND);
     EXPECT_EQ(session_.get_status_code(), 200);
     EXPECT_TRUE(session_.has_env_var("BF_THROTTLE_MS"));
     EXPECT_EQ(session_.get_env_var("BF_THROTTLE_MS"), "2000");
+    EXPECT_EQ(mock_lsiapi::pending_timers(), 1);
+
+    free_dir_list(dirs);
+}
+
+TEST_F(ExecBruteForceTest, ThrottledRequestResumesAfterDuration)
+{
+    auto *dirs = build_bf_directives(1, 1, 300, BF_ACTION_THROTTLE, 1500);
+    htaccess_request_t req;
+    session_.set_client_ip("192.168.1.1");
+    htaccess_request_init(&req, session_.handle());
+    exec_brute_force_resp_req(&req, dirs, 401);
+
+    ASSERT_EQ(exec_brute_force_req(&req, dirs), LSI_SUSPEND);
+    EXPECT_EQ(mock_lsiapi::advance_timers(1499), 0);
+    EXPECT_EQ(session_.get_resume_count(), 0);
+    EXPECT_EQ(mock_lsiapi::advance_timers(1), 1);
+    EXPECT_EQ(session_.get_resume_count(), 1);
+    EXPECT_EQ(mock_lsiapi::pending_timers(), 0);
+
+    free_dir_list(dirs);
+}
+
+TEST_F(ExecBruteForceTest, ThrottledRequestsWaitConcurrently)
+{
+    auto *dirs = build_bf_directives(1, 1, 300, BF_ACTION_THROTTLE, 1000);
+    MockSession others[8];
+
+    /* Each suspended request only costs a timer, not a blocked worker */
+    for (int i = 0; i < 8; i++) {
+        htaccess_request_t req;
+        others[i].set_client_ip("192.168.1.1");
+        htaccess_request_init(&req, others[i].handle());
+        if (i == 0)
+            exec_brute_force_resp_req(&req, dirs, 401);
+        EXPECT_EQ(exec_brute_force_req(&req, dirs), LSI_SUSPEND);
+    }
+    EXPECT_EQ(mock_lsiapi::pending_timers(), 8);
+    EXPECT_EQ(mock_lsiapi::advance_timers(1000), 8);
+    for (int i = 0; i < 8; i++)
+        EXPECT_EQ(others[i].get_resume_count(), 1);
+
+    free_dir_list(dirs);
+}
+
+TEST_F(ExecBruteForceTest, ThrottleWithoutTimerProceeds)
+{
+    auto *dirs = build_bf_directives(1, 1, 300, BF_ACTION_THROTTLE, 1000);
+    htaccess_request_t req;
+    session_.set_client_ip("192.168.1.1");
+    htaccess_request_init(&req, session_.handle());
+    exec_brute_force_resp_req(&req, dirs, 401);
+
+    mock_lsiapi::set_timers_available(false);
+    EXPECT_EQ(exec_brute_force_req(&req, dirs), LSI_OK);
+    EXPECT_EQ(session_.get_env_var("BF_THROTTLE_MS"), "1000");
 
     free_dir_list(dirs);
 }
@@ -216,9 +272,12 @@ TEST_F(ExecBruteForceTest, WindowExpiryResetsCount)
     exec_brute_force(session_.handle(), dirs, "10.0.0.1");
 
     /* Expire the window by manipulating the record */
-    brute_force_record_t *rec = shm_get_record("10.0.0.1");
-    ASSERT_NE(rec, nullptr);
-    rec->first_attempt = time(nullptr) - 61; /* Past the 60s window */
+    ip_addr_t key;
+    ASSERT_EQ(ip_addr_parse("10.0.0.1", &key), 0);
+    brute_force_record_t rec;
+    ASSERT_EQ(shm_get_record(&key, &rec), 0);
+    rec.first_attempt = time(nullptr) - 61; /* Past the 60s window */
+    ASSERT_EQ(shm_update_record(&key, &rec), 0);
 
     /* Next attempt should reset count to 1, not trigger block */
     session_.set_status_code(200);
@@ -226,9 +285,8 @@ TEST_F(ExecBruteForceTest, WindowExpiryResetsCount)
     EXPECT_EQ(session_.get_status_code(), 200);
 
     /* Verify count was reset */
-    rec = shm_get_record("10.0.0.1");
-    ASSERT_NE(rec, nullptr);
-    EXPECT_EQ(rec->attempt_count, 1);
+    ASSERT_EQ(shm_get_record(&key, &rec), 0);
+    EXPECT_EQ(rec.attempt_count, 1);
 
     free_dir_list(dirs);
 }
@@ -319,3 +377,102 @@ TEST_F(ExecBruteForceTest, NoBruteForceDirectivesReturnsOk)
 
     free_dir_list(d);
 }
+
+/* ------------------------------------------------------------------ */
+/*  Split request/response accounting                                  */
+/* ------------------------------------------------------------------ */
+
+/* One request through both phases; returns the request-phase result */
+static int request_round(MockSession &session,
+                         const htaccess_directive_t *dirs, const char *ip,
+                         int status)
+{
+    htaccess_request_t req;
+    session.reset();
+    session.set_client_ip(ip);
+    session.set_request_uri("/wp-login.php");
+    htaccess_request_init(&req, session.handle());
+    int rc = exec_brute_force_req(&req, dirs);
+    if (rc == LSI_OK)
+        session.set_status_code(status);
+    exec_brute_force_resp_req(&req, dirs, session.get_status_code());
+    return rc;
+}
+
+static int stored_attempts(const char *ip)
+{
+    ip_addr_t a;
+    brute_force_record_t rec;
+    if (ip_addr_parse(ip, &a) != 0 || shm_get_record(&a, &rec) != 0)
+        return 0;
+    return rec.attempt_count;
+}
+
+TEST_F(ExecBruteForceTest, RequestPhaseOnlyReads)
+{
+    auto *dirs = build_bf_directives(1, 2, 300, BF_ACTION_BLOCK, 1000);
+    htaccess_request_t req;
+    session_.set_client_ip("10.0.0.9");
+    htaccess_request_init(&req, session_.handle());
+
+    for (int i = 0; i < 10; i++)
+        EXPECT_EQ(exec_brute_force_req(&req, dirs), LSI_OK);
+    EXPECT_EQ(stored_attempts("10.0.0.9"), 0);
+
+    free_dir_list(dirs);
+}
+
+TEST_F(ExecBruteForceTest, SuccessfulResponsesAreNotCounted)
+{
+    auto *dirs = build_bf_directives(1, 2, 300, BF_ACTION_BLOCK, 1000);
+
+    for (int i = 0; i < 20; i++)
+        EXPECT_EQ(request_round(session_, dirs, "10.0.0.9", 200), LSI_OK);
+    EXPECT_EQ(stored_attempts("10.0.0.9"), 0);
+
+    free_dir_list(dirs);
+}
+
+TEST_F(ExecBruteForceTest, FailedResponsesLeadToBlock)
+{
+    auto *dirs = build_bf_directives(1, 2, 300, BF_ACTION_BLOCK, 1000);
+
+    EXPECT_EQ(request_round(session_, dirs, "10.0.0.9", 401), LSI_OK);
+    EXPECT_EQ(request_round(session_, dirs, "10.0.0.9", 403), LSI_OK);
+    EXPECT_EQ(stored_attempts("10.0.0.9"), 2);
+
+    /* Blocked in the request phase; the 403 it sets is not recounted */
+    EXPECT_EQ(request_round(session_, dirs, "10.0.0.9", 200), LSI_ERROR);
+    EXPECT_EQ(session_.get_status_code(), 403);
+    EXPECT_EQ(stored_attempts("10.0.0.9"), 2);
+
+    free_dir_list(dirs);
+}
+
+TEST_F(ExecBruteForceTest, FailureStatusDirectiveOverridesDefault)
+{
+    auto *dirs = build_bf_directives(1, 2, 300, BF_ACTION_BLOCK, 1000);
+    auto *fs = make_bf_dir(DIR_BRUTE_FORCE_FAILURE_STATUS);
+    fs->value = strdup("200 429");
+    dirs->next->next->next->next->next = fs;
+
+    EXPECT_EQ(request_round(session_, dirs, "10.0.0.9", 401), LSI_OK);
+    EXPECT_EQ(stored_attempts("10.0.0.9"), 0);
+    EXPECT_EQ(request_round(session_, dirs, "10.0.0.9", 429), LSI_OK);
+    EXPECT_EQ(request_round(session_, dirs, "10.0.0.9", 200), LSI_OK);
+    EXPECT_EQ(stored_attempts("10.0.0.9"), 2);
+    EXPECT_EQ(request_round(session_, dirs, "10.0.0.9", 200), LSI_ERROR);
+
+    free_dir_list(dirs);
+}
+
+TEST_F(ExecBruteForceTest, ResponsePhaseDisabledCountsNothing)
+{
+    auto *dirs = build_bf_directives(0, 2, 300, BF_ACTION_BLOCK, 1000);
+
+    for (int i = 0; i < 5; i++)
+        EXPECT_EQ(request_round(session_, dirs, "10.0.0.9", 401), LSI_OK);
+    EXPECT_EQ(stored_attempts("10.0.0.9"), 0);
+
+    free_dir_list(dirs);
+}
@@ -9,6 +9,7 @@
 #include <gtest/gtest.h>
 #include <cstring>
 #include <cstdlib>
+#include <string>
 
 #include "mock_lsiapi.h"
 
@@ -309,3 +310,145 @@ TEST_F(ExecRedirectTest, WrongTypeReturnsError)
     EXPECT_EQ(exec_redirect(session_.handle(), dir), -1);
     free_dir(dir);
 }
+
+/* ------------------------------------------------------------------ */
+/*  Compiled redirect set                                              */
+/* ------------------------------------------------------------------ */
+
+extern "C" {
+#include "htaccess_parser.h"
+}
+
+class RedirectSetTest : public ::testing::Test {
+protected:
+    void TearDown() override
+    {
+        redirect_set_free(&set_);
+        htaccess_directives_free(dirs_);
+    }
+    void compile(const char *conf)
+    {
+        dirs_ = htaccess_parse(conf, strlen(conf), "test");
+        ASSERT_NE(dirs_, nullptr);
+        ASSERT_EQ(redirect_set_compile(dirs_, &set_), 0);
+    }
+    /* Target of the first matching plain Redirect, or "" */
+    std::string first(const char *uri)
+    {
+        size_t i = redirect_set_first_prefix(&set_, uri, strlen(uri));
+        if (i >= set_.num_rules)
+            return "";
+        EXPECT_EQ(set_.rules[i]->type, DIR_REDIRECT);
+        return set_.rules[i]->value;
+    }
+    htaccess_directive_t *dirs_ = nullptr;
+    redirect_set_t set_ = {};
+};
+
+TEST_F(RedirectSetTest, EarliestMatchingPrefixWins)
+{
+    compile("Redirect /docs/old /a\n"
+            "Redirect /docs /b\n"
+            "Redirect /docs/old/deep /c\n"
+            "Redirect /img /d\n");
+    EXPECT_EQ(first("/docs/old/deep/x"), "/a");
+    EXPECT_EQ(first("/docs/new"), "/b");
+    EXPECT_EQ(first("/docs"), "/b");
+    EXPECT_EQ(first("/img/logo.png"), "/d");
+    EXPECT_EQ(first("/im"), "");
+    EXPECT_EQ(first("/other"), "");
+    EXPECT_EQ(first(""), "");
+}
+
+/* A shorter prefix declared first shadows every longer one after it */
+TEST_F(RedirectSetTest, ShorterEarlierPrefixShadowsLonger)
+{
+    compile("Redirect / /root\n"
+            "Redirect /docs /docs\n");
+    EXPECT_EQ(first("/docs/x"), "/root");
+    EXPECT_EQ(first("/"), "/root");
+}
+
+TEST_F(RedirectSetTest, DuplicatePrefixKeepsFirst)
+{
+    compile("Redirect /a /first\n"
+            "Redirect /a /second\n");
+    EXPECT_EQ(first("/a"), "/first");
+}
+
+TEST_F(RedirectSetTest, KeepsDeclarationOrderWithRedirectMatch)
+{
+    compile("Header set X-A 1\n"
+            "RedirectMatch ^/x(.*)$ /m1$1\n"
+            "Redirect /x /p1\n"
+            "RedirectMatch ^/y /m2\n"
+            "Redirect /y /p2\n");
+    ASSERT_EQ(set_.num_rules, 4u);
+    ASSERT_EQ(set_.num_regex, 2u);
+    EXPECT_EQ(set_.regex_rules[0], 0u);
+    EXPECT_EQ(set_.regex_rules[1], 2u);
+    EXPECT_EQ(redirect_set_first_prefix(&set_, "/x1", 3), 1u);
+    EXPECT_EQ(redirect_set_first_prefix(&set_, "/y1", 3), 3u);
+    EXPECT_EQ(redirect_set_first_prefix(&set_, "/z", 2), 4u);
+}
+
+/* Only the first uri_len bytes are matched */
+TEST_F(RedirectSetTest, HonoursUriLength)
+{
+    compile("Redirect /abc /long\n"
+            "Redirect /ab /short\n");
+    EXPECT_EQ(redirect_set_first_prefix(&set_, "/abcdef", 3), 1u);
+    EXPECT_EQ(redirect_set_first_prefix(&set_, "/abcdef", 2), 2u);
+}
+
+TEST_F(RedirectSetTest, EmptySet)
+{
+    compile("Header set X-A 1\n");
+    EXPECT_EQ(set_.num_rules, 0u);
+    EXPECT_EQ(redirect_set_first_prefix(&set_, "/a", 2), 0u);
+}
+
+TEST_F(RedirectSetTest, ManyPrefixes)
+{
+    std::string conf;
+    for (int i = 0; i < 2000; i++)
+        conf += "Redirect /p" + std::to_string(i) + "/ /t" +
+                std::to_string(i) + "\n";
+    compile(conf.c_str());
+    EXPECT_EQ(first("/p0/x"), "/t0");
+    EXPECT_EQ(first("/p1999/"), "/t1999");
+    EXPECT_EQ(first("/p123/a/b"), "/t123");
+    EXPECT_EQ(first("/p123"), "");
+    EXPECT_EQ(first("/p2000/"), "");
+}
+
+TEST_F(RedirectSetTest, FirstMatchStopsAtLimit)
+{
+    compile("RedirectMatch ^/a/(.*)$ /m0/$1\n"
+            "Redirect /b /p1\n"
+            "RedirectMatch ^/b /m2\n"
+            "RedirectMatch [bad /m3\n");
+    EXPECT_EQ(redirect_set_first_match(&set_, "/a/x", 4, 0, 4), 0u);
+    EXPECT_EQ(redirect_set_first_match(&set_, "/b", 2, 0, 1), 3u);
+    EXPECT_EQ(redirect_set_first_match(&set_, "/b", 2, 0, 4), 1u);
+    /* The invalid pattern is reported so its error can be logged */
+    EXPECT_EQ(redirect_set_first_match(&set_, "/c", 2, 0, 4), 2u);
+    EXPECT_EQ(redirect_set_first_match(&set_, "/c", 2, 3, 4), 3u);
+}
+
+TEST_F(RedirectSetTest, SetMatchSubstitutesCaptures)
+{
+    MockSession session;
+    htaccess_request_t req;
+
+    compile("RedirectMatch 301 ^/old/(.*)/(.*)$ https://example.com/$2/$1\n"
+            "RedirectMatch [bad /x\n");
+    session.set_request_uri("/old/a/b");
+    htaccess_request_init(&req, session.handle());
+    EXPECT_EQ(exec_redirect_set_match(&req, &set_, 0), 1);
+    EXPECT_EQ(session.get_status_code(), 301);
+    EXPECT_EQ(session.get_response_header("Location"),
+              "https://example.com/b/a");
+    EXPECT_EQ(exec_redirect_set_match(&req, &set_, 1), -1);
+    EXPECT_EQ(exec_redirect_set_match(&req, &set_, 2), -1);
+}
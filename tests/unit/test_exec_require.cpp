@@ -76,6 +76,23 @@ TEST_F(RequireExecTest, IpMatchGrants)
     htaccess_directives_free(dirs);
 }
 
+/* Require ip — a value without valid ranges is compiled once, to nothing */
+TEST_F(RequireExecTest, IpWithoutValidRangesDenies)
+{
+    auto *dirs = parse("Require ip bogus\n");
+    ASSERT_NE(dirs, nullptr);
+    ASSERT_EQ(dirs->data.ip.compiled, 1);
+    /* The program uses the compiled set, not a re-parse of the value */
+    free(dirs->value);
+    dirs->value = strdup("192.168.1.50");
+
+    int rc = exec_require(session_.handle(), dirs, "192.168.1.50");
+    EXPECT_EQ(rc, LSI_ERROR);
+    EXPECT_EQ(session_.get_status_code(), 403);
+
+    htaccess_directives_free(dirs);
+}
+
 /* Require ip — non-matching CIDR denies */
 TEST_F(RequireExecTest, IpNoMatchDenies)
 {
@@ -242,3 +259,136 @@ TEST_F(RequireExecTest, RequireIpMultipleCidrs)
 
     htaccess_directives_free(dirs);
 }
+
+/* Require ip — IPv6 client against an IPv6 range */
+TEST_F(RequireExecTest, RequireIpv6Range)
+{
+    const char *input = "Require ip 2001:db8::/48 10.0.0.0/8\n";
+    auto *dirs = parse(input);
+    ASSERT_NE(dirs, nullptr);
+
+    EXPECT_EQ(exec_require(session_.handle(), dirs, "2001:db8:0:5::1"), LSI_OK);
+    EXPECT_EQ(exec_require(session_.handle(), dirs, "2001:db8:1::1"), LSI_ERROR);
+    EXPECT_EQ(exec_require(session_.handle(), dirs, "::ffff:10.2.3.4"), LSI_OK);
+
+    htaccess_directives_free(dirs);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Compiled Require program                                           */
+/* ------------------------------------------------------------------ */
+
+static int run_compiled(MockSession &session, const require_program_t *prog,
+                        const char *ip)
+{
+    session.reset();
+    session.set_client_ip(ip);
+    htaccess_request_t req;
+    htaccess_request_init(&req, session.handle());
+    return exec_require_compiled(&req, prog);
+}
+
+/* Leaves are laid out in order with short-circuit jump targets */
+TEST_F(RequireExecTest, Compiled_JumpLayout)
+{
+    const char *input =
+        "<RequireAll>\n"
+        "Require ip 10.0.0.0/8\n"
+        "Require not ip 10.1.0.0/16\n"
+        "</RequireAll>\n"
+        "Require ip 192.168.0.0/16\n";
+    auto *dirs = parse(input);
+    ASSERT_NE(dirs, nullptr);
+
+    require_program_t prog;
+    ASSERT_EQ(require_compile(dirs, nullptr, &prog), 0);
+    ASSERT_EQ(prog.count, 3u);
+    EXPECT_EQ(prog.code[0].op, (uint32_t)REQUIRE_OP_IP);
+    EXPECT_EQ(prog.code[0].on_true, 1u);
+    EXPECT_EQ(prog.code[0].on_false, 2u);
+    EXPECT_EQ(prog.code[1].op, (uint32_t)REQUIRE_OP_NOT_IP);
+    EXPECT_EQ(prog.code[1].on_true, REQUIRE_PC_GRANT);
+    EXPECT_EQ(prog.code[1].on_false, 2u);
+    EXPECT_EQ(prog.code[2].on_true, REQUIRE_PC_GRANT);
+    EXPECT_EQ(prog.code[2].on_false, REQUIRE_PC_DENY);
+
+    EXPECT_EQ(run_compiled(session_, &prog, "10.2.0.1"), LSI_OK);
+    EXPECT_EQ(run_compiled(session_, &prog, "10.1.0.1"), LSI_ERROR);
+    EXPECT_EQ(run_compiled(session_, &prog, "192.168.7.7"), LSI_OK);
+    EXPECT_EQ(run_compiled(session_, &prog, "172.16.0.1"), LSI_ERROR);
+
+    require_program_free(&prog);
+    htaccess_directives_free(dirs);
+}
+
+/* Empty RequireAny denies, empty RequireAll grants */
+TEST_F(RequireExecTest, Compiled_EmptyContainers)
+{
+    auto *any = parse("<RequireAny>\n</RequireAny>\n");
+    auto *all = parse("<RequireAll>\n</RequireAll>\n");
+    ASSERT_NE(any, nullptr);
+    ASSERT_NE(all, nullptr);
+
+    require_program_t p_any, p_all;
+    ASSERT_EQ(require_compile(any, nullptr, &p_any), 0);
+    ASSERT_EQ(require_compile(all, nullptr, &p_all), 0);
+    EXPECT_EQ(run_compiled(session_, &p_any, "10.0.0.1"), LSI_ERROR);
+    EXPECT_EQ(run_compiled(session_, &p_all, "10.0.0.1"), LSI_OK);
+
+    require_program_free(&p_any);
+    require_program_free(&p_all);
+    htaccess_directives_free(any);
+    htaccess_directives_free(all);
+}
+
+/* Without Require directives the program is inactive and allows */
+TEST_F(RequireExecTest, Compiled_InactiveWithoutRequire)
+{
+    auto *dirs = parse("Deny from all\n");
+    ASSERT_NE(dirs, nullptr);
+
+    require_program_t prog;
+    ASSERT_EQ(require_compile(dirs, nullptr, &prog), 0);
+    EXPECT_EQ(prog.active, 0);
+    EXPECT_EQ(run_compiled(session_, &prog, "10.0.0.1"), LSI_OK);
+
+    require_program_free(&prog);
+    htaccess_directives_free(dirs);
+}
+
+/* The coexistence warning is logged by the compiler, not per request */
+TEST_F(RequireExecTest, Compiled_CoexistenceWarnedOnce)
+{
+    auto *dirs = parse("Order Deny,Allow\nRequire all granted\n");
+    ASSERT_NE(dirs, nullptr);
+
+    require_program_t prog;
+    ASSERT_EQ(require_compile(dirs, nullptr, &prog), 0);
+    for (int i = 0; i < 3; i++)
+        EXPECT_EQ(run_compiled(session_, &prog, "10.0.0.1"), LSI_OK);
+
+    int warnings = 0;
+    for (const auto &rec : mock_lsiapi::get_log_records()) {
+        if (rec.message.find("Require takes precedence") != std::string::npos)
+            warnings++;
+    }
+    EXPECT_EQ(warnings, 1);
+
+    require_program_free(&prog);
+    htaccess_directives_free(dirs);
+}
+
+/* Unparsable client address is denied before the program runs */
+TEST_F(RequireExecTest, Compiled_BadClientIpDenied)
+{
+    auto *dirs = parse("Require all granted\n");
+    ASSERT_NE(dirs, nullptr);
+
+    require_program_t prog;
+    ASSERT_EQ(require_compile(dirs, nullptr, &prog), 0);
+    EXPECT_EQ(run_compiled(session_, &prog, "not-an-ip"), LSI_ERROR);
+    EXPECT_EQ(session_.get_status_code(), 403);
+
+    require_program_free(&prog);
+    htaccess_directives_free(dirs);
+}
@@ -0,0 +1,255 @@
+/**
+ * test_hitters.cpp - Unit tests for brute force heavy-hitter telemetry
+ *
+ * Validates: Requirements 12.1, 12.2
+ */
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "mock_lsiapi.h"
+
+extern "C" {
+#include "htaccess_exec_brute_force.h"
+#include "htaccess_hitters.h"
+#include "htaccess_shm.h"
+}
+
+static ip_addr_t addr(const char *text)
+{
+    ip_addr_t a{};
+    EXPECT_EQ(ip_addr_parse(text, &a), 0);
+    return a;
+}
+
+static std::string read_file(const std::string &path)
+{
+    std::ifstream in(path);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+class HittersTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        hitters_destroy();
+        char tmpl[] = "/tmp/hitters_test_XXXXXX";
+        ASSERT_NE(mkdtemp(tmpl), nullptr);
+        dir_ = tmpl;
+    }
+    void TearDown() override {
+        hitters_destroy();
+        unlink((dir_ + "/" HITTERS_FILE_NAME).c_str());
+        unlink((dir_ + "/" HITTERS_EXPORT_NAME).c_str());
+        unlink((dir_ + "/snapshot.txt").c_str());
+        rmdir(dir_.c_str());
+    }
+    std::string dir_;
+};
+
+TEST_F(HittersTest, UninitializedIsInert)
+{
+    ip_addr_t a = addr("192.0.2.1");
+    hitters_entry_t out[4];
+    hitters_record(&a, "/login");
+    EXPECT_EQ(hitters_estimate_addr(&a), 0u);
+    EXPECT_EQ(hitters_top(HITTERS_ADDR, out, 4), -1);
+    EXPECT_EQ(hitters_export((dir_ + "/snapshot.txt").c_str()), -1);
+    EXPECT_EQ(hitters_maybe_export(1000), 0);
+}
+
+TEST_F(HittersTest, EstimateNeverUndercounts)
+{
+    ASSERT_EQ(hitters_init(nullptr), 0);
+    ip_addr_t a = addr("192.0.2.1");
+    for (int i = 0; i < 25; i++)
+        hitters_record(&a, "/wp-login.php");
+
+    EXPECT_GE(hitters_estimate_addr(&a), 25u);
+    EXPECT_GE(hitters_estimate_path("/wp-login.php"), 25u);
+    ip_addr_t other = addr("192.0.2.2");
+    EXPECT_LT(hitters_estimate_addr(&other), 25u);
+}
+
+TEST_F(HittersTest, TopKFindsHeavyHittersAmongNoise)
+{
+    ASSERT_EQ(hitters_init(nullptr), 0);
+    std::mt19937 rng(7);
+    char ip[32];
+    ip_addr_t heavy[3] = {addr("203.0.113.1"), addr("2001:db8::bad"),
+                          addr("198.51.100.9")};
+    const int heavy_hits[3] = {3000, 2000, 1000};
+
+    /* 20000 one-off addresses interleaved with three heavy hitters */
+    for (int i = 0; i < 20000; i++) {
+        snprintf(ip, sizeof(ip), "10.%u.%u.%u", (unsigned)(i >> 16) & 0xFF,
+                 (unsigned)(i >> 8) & 0xFF, (unsigned)i & 0xFF);
+        ip_addr_t a = addr(ip);
+        hitters_record(&a, nullptr);
+        for (int h = 0; h < 3; h++)
+            if ((int)(rng() % 20000) < heavy_hits[h])
+                hitters_record(&heavy[h], nullptr);
+    }
+
+    hitters_entry_t top[3];
+    ASSERT_EQ(hitters_top(HITTERS_ADDR, top, 3), 3);
+    for (int h = 0; h < 3; h++) {
+        EXPECT_EQ(memcmp(&top[h].addr, &heavy[h], sizeof(ip_addr_t)), 0)
+            << "rank " << h;
+        EXPECT_GE(top[h].count - top[h].error, (uint64_t)heavy_hits[h] / 2);
+    }
+    EXPECT_GE(top[0].count, top[1].count);
+    EXPECT_GE(top[1].count, top[2].count);
+}
+
+TEST_F(HittersTest, PathsAreTrackedAndTruncated)
+{
+    ASSERT_EQ(hitters_init(nullptr), 0);
+    std::string longpath = "/" + std::string(100, 'a');
+    ip_addr_t a = addr("192.0.2.1");
+    for (int i = 0; i < 5; i++)
+        hitters_record(&a, "/xmlrpc.php");
+    hitters_record(nullptr, longpath.c_str());
+
+    hitters_entry_t top[HITTERS_TOP_K];
+    ASSERT_EQ(hitters_top(HITTERS_PATH, top, HITTERS_TOP_K), 2);
+    EXPECT_STREQ(top[0].path, "/xmlrpc.php");
+    EXPECT_EQ(top[0].count, 5u);
+    EXPECT_EQ(strlen(top[1].path), (size_t)HITTERS_PATH_MAX);
+    EXPECT_EQ(strncmp(top[1].path, longpath.c_str(), HITTERS_PATH_MAX), 0);
+}
+
+TEST_F(HittersTest, ExportWritesRankedSnapshot)
+{
+    ASSERT_EQ(hitters_init(nullptr), 0);
+    ip_addr_t a = addr("203.0.113.5");
+    ip_addr_t b = addr("2001:db8::1");
+    for (int i = 0; i < 3; i++)
+        hitters_record(&a, "/login");
+    hitters_record(&b, "/admin");
+
+    std::string file = dir_ + "/snapshot.txt";
+    ASSERT_EQ(hitters_export(file.c_str()), 0);
+    EXPECT_EQ(read_file(file),
+              "# total 4\n"
+              "addr 3 0 203.0.113.5\n"
+              "addr 1 0 2001:db8::1\n"
+              "path 3 0 /login\n"
+              "path 1 0 /admin\n");
+}
+
+TEST_F(HittersTest, MaybeExportIsRateLimited)
+{
+    ASSERT_EQ(hitters_init(dir_.c_str()), 0);
+    ip_addr_t a = addr("192.0.2.1");
+    hitters_record(&a, "/login");
+
+    std::string file = dir_ + "/" HITTERS_EXPORT_NAME;
+    EXPECT_EQ(hitters_maybe_export(100000), 1);
+    EXPECT_EQ(access(file.c_str(), F_OK), 0);
+    EXPECT_EQ(hitters_maybe_export(100000 + HITTERS_EXPORT_INTERVAL - 1), 0);
+    EXPECT_EQ(hitters_maybe_export(100000 + HITTERS_EXPORT_INTERVAL), 1);
+}
+
+/* A lock holder that never lets go delays the export, never the caller */
+TEST_F(HittersTest, StuckLockSkipsExport)
+{
+    ASSERT_EQ(hitters_init(dir_.c_str()), 0);
+    ip_addr_t a = addr("192.0.2.1");
+    hitters_record(&a, "/login");
+
+    /* The lock word follows five 32-bit header fields */
+    int fd = open((dir_ + "/" HITTERS_FILE_NAME).c_str(), O_RDWR);
+    ASSERT_GE(fd, 0);
+    uint32_t holder = (uint32_t)getpid();
+    ASSERT_EQ(pwrite(fd, &holder, sizeof(holder), 20), (ssize_t)4);
+
+    hitters_entry_t top[1];
+    EXPECT_EQ(hitters_top(HITTERS_ADDR, top, 1), -1);
+    std::string file = dir_ + "/" HITTERS_EXPORT_NAME;
+    EXPECT_EQ(hitters_maybe_export(100000), 0);
+    EXPECT_NE(access(file.c_str(), F_OK), 0);
+
+    holder = 0;
+    ASSERT_EQ(pwrite(fd, &holder, sizeof(holder), 20), (ssize_t)4);
+    close(fd);
+    /* The skipped interval is retried right away */
+    EXPECT_EQ(hitters_maybe_export(100000), 1);
+    EXPECT_EQ(access(file.c_str(), F_OK), 0);
+}
+
+TEST_F(HittersTest, FileSurvivesReattach)
+{
+    ip_addr_t a = addr("192.0.2.1");
+    ASSERT_EQ(hitters_init(dir_.c_str()), 0);
+    hitters_record(&a, nullptr);
+    hitters_record(&a, nullptr);
+    hitters_destroy();
+
+    ASSERT_EQ(hitters_init((dir_ + "/").c_str()), 0);
+    hitters_entry_t top[1];
+    ASSERT_EQ(hitters_top(HITTERS_ADDR, top, 1), 1);
+    EXPECT_EQ(top[0].count, 2u);
+}
+
+TEST_F(HittersTest, ForkedWorkersShareTables)
+{
+    ASSERT_EQ(hitters_init(nullptr), 0);
+    ip_addr_t a = addr("198.51.100.7");
+    const int workers = 4;
+    const int per_worker = 200;
+
+    for (int w = 0; w < workers; w++) {
+        pid_t pid = fork();
+        ASSERT_GE(pid, 0);
+        if (pid == 0) {
+            for (int i = 0; i < per_worker; i++)
+                hitters_record(&a, "/wp-login.php");
+            _exit(0);
+        }
+    }
+    for (int w = 0; w < workers; w++) {
+        int status = 0;
+        wait(&status);
+        EXPECT_TRUE(WIFEXITED(status));
+    }
+
+    EXPECT_GE(hitters_estimate_addr(&a), (uint64_t)workers * per_worker);
+    hitters_entry_t top[1];
+    ASSERT_EQ(hitters_top(HITTERS_ADDR, top, 1), 1);
+    /* Contended updates may skip the table, never count twice */
+    EXPECT_LE(top[0].count, (uint64_t)workers * per_worker);
+    EXPECT_GT(top[0].count, 0u);
+}
+
+TEST_F(HittersTest, BruteForceExecutorFeedsTelemetry)
+{
+    ASSERT_EQ(hitters_init(nullptr), 0);
+    shm_destroy();
+    ASSERT_EQ(shm_init(nullptr, 64), 0);
+    mock_lsiapi::reset_global_state();
+    MockSession session;
+    session.set_request_uri("/wp-login.php");
+
+    htaccess_directive_t dir{};
+    dir.type = DIR_BRUTE_FORCE_PROTECTION;
+    dir.data.brute_force.enabled = 1;
+    for (int i = 0; i < 3; i++)
+        exec_brute_force(session.handle(), &dir, "203.0.113.77");
+
+    hitters_entry_t top[1];
+    ASSERT_EQ(hitters_top(HITTERS_ADDR, top, 1), 1);
+    EXPECT_EQ(top[0].count, 3u);
+    ASSERT_EQ(hitters_top(HITTERS_PATH, top, 1), 1);
+    EXPECT_STREQ(top[0].path, "/wp-login.php");
+    shm_destroy();
+}
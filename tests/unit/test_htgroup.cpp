@@ -0,0 +1,182 @@
+/**
+ * test_htgroup.cpp - Unit tests for AuthGroupFile and Require user/group
+ *
+ * Validates: Requirements 10.4
+ */
+#include <gtest/gtest.h>
+#include <crypt.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+#include "file_cache_fixture.h"
+#include "mock_lsiapi.h"
+
+extern "C" {
+#include "htaccess_exec_auth.h"
+#include "htaccess_htgroup.h"
+#include "htaccess_htpasswd.h"
+#include "htaccess_parser.h"
+}
+
+/* Group checks also read the AuthUserFile cache */
+static void reset_auth_caches(void)
+{
+    htgroup_cache_destroy();
+    htpasswd_cache_destroy();
+}
+
+class HtgroupTest
+    : public FileCacheTest<htgroup_stats_t, htgroup_cache_get_stats,
+                           reset_auth_caches> {
+protected:
+    void SetUp() override {
+        FileCacheTest::SetUp();
+        groups_ = path("htgroup");
+        users_ = path("htpasswd");
+    }
+    int check(const char *user, const char *groups) {
+        return htgroup_cache_check(groups_.c_str(), user, groups);
+    }
+    /* Run exec_auth_basic for user:secret against `conf` */
+    int auth(const std::string &conf, const char *basic) {
+        htaccess_directive_t *dirs = htaccess_parse(conf.c_str(),
+                                                    conf.size(), "test");
+        EXPECT_NE(dirs, nullptr);
+        session_.reset();
+        session_.set_auth_header(basic);
+        int rc = exec_auth_basic(session_.handle(), dirs);
+        htaccess_directives_free(dirs);
+        return rc;
+    }
+    std::string groups_;
+    std::string users_;
+    MockSession session_;
+};
+
+TEST_F(HtgroupTest, MembershipByGroup)
+{
+    write_file(groups_, "# teams\n"
+                        "admins: alice\n"
+                        "ops:bob  carol\r\n"
+                        "\n"
+                        "dev : carol\tdave\n"
+                        "no colon here\n");
+    EXPECT_EQ(check("alice", "admins"), 1);
+    EXPECT_EQ(check("alice", "ops dev"), 0);
+    EXPECT_EQ(check("carol", "ops"), 1);
+    EXPECT_EQ(check("carol", "dev"), 1);
+    EXPECT_EQ(check("dave", "admins ops dev"), 1);
+    EXPECT_EQ(check("bob", "dev"), 0);
+    EXPECT_EQ(check("eve", "admins"), 0);
+    EXPECT_EQ(check("alice", "admin"), 0);
+    EXPECT_EQ(check("alice", ""), 0);
+
+    htgroup_stats_t s = stats();
+    EXPECT_EQ(s.groups, 3u);
+    EXPECT_EQ(s.users, 4u);
+    EXPECT_EQ(s.loads, 1u);
+}
+
+/* A group on several lines collects every line's members */
+TEST_F(HtgroupTest, RepeatedGroupLinesMerge)
+{
+    write_file(groups_, "staff: alice\nstaff: bob\n");
+    EXPECT_EQ(check("alice", "staff"), 1);
+    EXPECT_EQ(check("bob", "staff"), 1);
+    EXPECT_EQ(stats().groups, 1u);
+}
+
+/* More groups than fit one bitset word */
+TEST_F(HtgroupTest, ManyGroups)
+{
+    std::string content;
+    for (int g = 0; g < 200; g++)
+        content += "g" + std::to_string(g) + ": u" +
+                   std::to_string(g % 7) + " all\n";
+    write_file(groups_, content);
+    EXPECT_EQ(check("all", "g199"), 1);
+    EXPECT_EQ(check("u3", "g3"), 1);
+    EXPECT_EQ(check("u3", "g144"), 0);
+    EXPECT_EQ(check("u3", "g0 g1 g2 g198 g192"), 1); /* 192 % 7 == 3 */
+    EXPECT_EQ(check("u3", "g0 g1 g2 g198"), 0);
+    EXPECT_EQ(stats().groups, 200u);
+}
+
+TEST_F(HtgroupTest, ChangedFileIsRecompiled)
+{
+    write_file(groups_, "admins: alice\n");
+    EXPECT_EQ(check("bob", "admins"), 0);
+    write_file(groups_, "admins: alice bob\n");
+    EXPECT_EQ(check("bob", "admins"), 1);
+    EXPECT_EQ(stats().loads, 2u);
+    EXPECT_EQ(stats().files, 1u);
+}
+
+TEST_F(HtgroupTest, MissingFileFails)
+{
+    EXPECT_EQ(check("alice", "admins"), -1);
+}
+
+TEST_F(HtgroupTest, RequireUserAndGroup)
+{
+    std::string hash = crypt("secret", "ab");
+    write_file(users_, "alice:" + hash + "\nbob:" + hash + "\n"
+                       "carol:" + hash + "\n");
+    write_file(groups_, "admins: carol\n");
+    std::string conf = "AuthType Basic\n"
+                       "AuthName \"Team\"\n"
+                       "AuthUserFile " + users_ + "\n"
+                       "AuthGroupFile " + groups_ + "\n"
+                       "Require user alice\n"
+                       "Require group admins\n";
+
+    EXPECT_EQ(auth(conf, "Basic YWxpY2U6c2VjcmV0"), LSI_OK);   /* alice */
+    EXPECT_EQ(auth(conf, "Basic Y2Fyb2w6c2VjcmV0"), LSI_OK);   /* carol */
+    EXPECT_EQ(auth(conf, "Basic Ym9iOnNlY3JldA=="), LSI_ERROR); /* bob */
+    EXPECT_EQ(session_.get_status_code(), 401);
+    EXPECT_FALSE(session_.get_www_authenticate().empty());
+    /* carol with a wrong password is still refused */
+    EXPECT_EQ(auth(conf, "Basic Y2Fyb2w6d3Jvbmc="), LSI_ERROR);
+    EXPECT_EQ(session_.get_status_code(), 401);
+}
+
+/* A refused user is turned away without hashing the password */
+TEST_F(HtgroupTest, RefusedUserSkipsPasswordCheck)
+{
+    std::string hash = crypt("secret", "ab");
+    write_file(users_, "alice:" + hash + "\nbob:" + hash + "\n");
+    std::string conf = "AuthType Basic\n"
+                       "AuthUserFile " + users_ + "\n"
+                       "Require user alice\n";
+
+    EXPECT_EQ(auth(conf, "Basic Ym9iOnNlY3JldA=="), LSI_ERROR); /* bob */
+    htpasswd_stats_t s;
+    ASSERT_EQ(htpasswd_cache_get_stats(&s), 0);
+    EXPECT_EQ(s.verified_misses, 0u);
+    EXPECT_EQ(auth(conf, "Basic YWxpY2U6c2VjcmV0"), LSI_OK);   /* alice */
+}
+
+TEST_F(HtgroupTest, UnreadableGroupFileIs500)
+{
+    std::string hash = crypt("secret", "ab");
+    write_file(users_, "alice:" + hash + "\n");
+    std::string conf = "AuthType Basic\n"
+                       "AuthUserFile " + users_ + "\n"
+                       "AuthGroupFile " + groups_ + "\n"
+                       "Require group admins\n";
+    EXPECT_EQ(auth(conf, "Basic YWxpY2U6c2VjcmV0"), LSI_ERROR);
+    EXPECT_EQ(session_.get_status_code(), 500);
+}
+
+TEST_F(HtgroupTest, RequireGroupWithoutGroupFileRefuses)
+{
+    std::string hash = crypt("secret", "ab");
+    write_file(users_, "alice:" + hash + "\n");
+    std::string conf = "AuthType Basic\n"
+                       "AuthUserFile " + users_ + "\n"
+                       "Require group admins\n";
+    EXPECT_EQ(auth(conf, "Basic YWxpY2U6c2VjcmV0"), LSI_ERROR);
+    EXPECT_EQ(session_.get_status_code(), 401);
+}
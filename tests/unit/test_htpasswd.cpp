@@ -0,0 +1,296 @@
+/**
+ * test_htpasswd.cpp - Unit tests for the AuthUserFile cache
+ *
+ * Validates: Requirements 10.4
+ */
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+
+#include "file_cache_fixture.h"
+#include "mock_lsiapi.h"
+
+extern "C" {
+#include "htaccess_exec_auth.h"
+#include "htaccess_htpasswd.h"
+#include "htaccess_parser.h"
+}
+
+class HtpasswdCacheTest
+    : public FileCacheTest<htpasswd_stats_t, htpasswd_cache_get_stats,
+                           htpasswd_cache_destroy> {
+protected:
+    void SetUp() override {
+        FileCacheTest::SetUp();
+        file_ = path("htpasswd");
+    }
+    using FileCacheTest::write_file;
+    void write_file(const std::string &content) {
+        write_file(file_, content);
+    }
+    int lookup(const char *user, std::string *hash = nullptr) {
+        char buf[512];
+        int rc = htpasswd_cache_lookup(file_.c_str(), user, buf, sizeof(buf));
+        if (rc == 1 && hash)
+            *hash = buf;
+        return rc;
+    }
+    std::string file_;
+};
+
+TEST_F(HtpasswdCacheTest, FindsUsersAndSkipsNoise)
+{
+    write_file("# admins\n"
+               "alice:hashA\r\n"
+               "\n"
+               "not an entry\n"
+               "bob:hashB:extra\n"
+               "carol:hashC");
+    std::string hash;
+    EXPECT_EQ(lookup("alice", &hash), 1);
+    EXPECT_EQ(hash, "hashA");
+    EXPECT_EQ(lookup("bob", &hash), 1);
+    EXPECT_EQ(hash, "hashB:extra");
+    EXPECT_EQ(lookup("carol", &hash), 1);
+    EXPECT_EQ(hash, "hashC");
+    EXPECT_EQ(lookup("# admins"), 0);
+    EXPECT_EQ(lookup("dave"), 0);
+    EXPECT_EQ(stats().users, 3u);
+}
+
+TEST_F(HtpasswdCacheTest, FirstEntryWins)
+{
+    write_file("alice:first\nalice:second\n");
+    std::string hash;
+    EXPECT_EQ(lookup("alice", &hash), 1);
+    EXPECT_EQ(hash, "first");
+}
+
+TEST_F(HtpasswdCacheTest, LongLinesAreNotTruncated)
+{
+    std::string user(700, 'u');
+    write_file("short:x\n" + user + ":longhash\n");
+    std::string hash;
+    EXPECT_EQ(lookup(user.c_str(), &hash), 1);
+    EXPECT_EQ(hash, "longhash");
+    EXPECT_EQ(lookup(user.substr(0, 500).c_str()), 0);
+}
+
+TEST_F(HtpasswdCacheTest, ManyUsersIndexed)
+{
+    std::string content;
+    char line[64];
+    for (int i = 0; i < 5000; i++) {
+        snprintf(line, sizeof(line), "user%d:hash%d\n", i, i);
+        content += line;
+    }
+    write_file(content);
+    std::string hash;
+    for (int i = 0; i < 5000; i += 499) {
+        snprintf(line, sizeof(line), "user%d", i);
+        ASSERT_EQ(lookup(line, &hash), 1);
+        EXPECT_EQ(hash, "hash" + std::to_string(i));
+    }
+    EXPECT_EQ(lookup("user5000"), 0);
+    EXPECT_EQ(stats().loads, 1u);
+}
+
+TEST_F(HtpasswdCacheTest, WarmLookupsDoNotReload)
+{
+    write_file("alice:hashA\n");
+    for (int i = 0; i < 10; i++)
+        EXPECT_EQ(lookup("alice"), 1);
+    htpasswd_stats_t s = stats();
+    EXPECT_EQ(s.loads, 1u);
+    EXPECT_EQ(s.lookups, 10u);
+    EXPECT_EQ(s.files, 1u);
+}
+
+TEST_F(HtpasswdCacheTest, ChangedFileIsReloaded)
+{
+    write_file("alice:hashA\n");
+    EXPECT_EQ(lookup("bob"), 0);
+    write_file("alice:hashA\nbob:hashB\n");
+    std::string hash;
+    EXPECT_EQ(lookup("bob", &hash), 1);
+    EXPECT_EQ(hash, "hashB");
+    EXPECT_EQ(stats().loads, 2u);
+    EXPECT_EQ(stats().files, 1u);
+}
+
+TEST_F(HtpasswdCacheTest, RemovedFileFailsAndIsDropped)
+{
+    write_file("alice:hashA\n");
+    EXPECT_EQ(lookup("alice"), 1);
+    unlink(file_.c_str());
+    EXPECT_EQ(lookup("alice"), -1);
+    EXPECT_EQ(stats().files, 0u);
+}
+
+TEST_F(HtpasswdCacheTest, HashTooLongForBufferIsNotFound)
+{
+    write_file("alice:" + std::string(64, 'h') + "\n");
+    char small[16];
+    EXPECT_EQ(htpasswd_cache_lookup(file_.c_str(), "alice", small,
+                                    sizeof(small)), 0);
+}
+
+/* Two directories naming the same AuthUserFile share one parsed copy */
+TEST_F(HtpasswdCacheTest, DirectoriesShareOneFile)
+{
+    const char *raw = crypt("secret", "ab");
+    ASSERT_NE(raw, nullptr);
+    write_file(std::string("alice:") + raw + "\n");
+
+    std::string conf = "AuthType Basic\n"
+                       "AuthName \"Restricted\"\n"
+                       "AuthUserFile " + file_ + "\n"
+                       "Require valid-user\n";
+    htaccess_directive_t *a = htaccess_parse(conf.c_str(), conf.size(),
+                                             "/www/a/.htaccess");
+    htaccess_directive_t *b = htaccess_parse(conf.c_str(), conf.size(),
+                                             "/www/b/.htaccess");
+    ASSERT_NE(a, nullptr);
+    ASSERT_NE(b, nullptr);
+
+    mock_lsiapi::reset_global_state();
+    MockSession session;
+    session.set_auth_header("Basic YWxpY2U6c2VjcmV0"); /* alice:secret */
+    EXPECT_EQ(exec_auth_basic(session.handle(), a), LSI_OK);
+    EXPECT_EQ(exec_auth_basic(session.handle(), b), LSI_OK);
+    session.set_auth_header("Basic YWxpY2U6d3Jvbmc="); /* alice:wrong */
+    EXPECT_EQ(exec_auth_basic(session.handle(), b), LSI_ERROR);
+    EXPECT_EQ(session.get_status_code(), 401);
+
+    htpasswd_stats_t s = stats();
+    EXPECT_EQ(s.loads, 1u);
+    EXPECT_EQ(s.files, 1u);
+    htaccess_directives_free(a);
+    htaccess_directives_free(b);
+}
+
+TEST_F(HtpasswdCacheTest, VerifiedCredentialsExpire)
+{
+    const char *f = file_.c_str();
+    EXPECT_EQ(htpasswd_verified_check(f, "alice", "pw", "H1", 1000), 0);
+    htpasswd_verified_store(f, "alice", "pw", "H1", 1000);
+    EXPECT_EQ(htpasswd_verified_check(f, "alice", "pw", "H1", 1001), 1);
+    EXPECT_EQ(htpasswd_verified_check(f, "alice", "pw",
+                                      "H1", 1000 + HTPASSWD_VERIFIED_TTL), 0);
+    htpasswd_stats_t s = stats();
+    EXPECT_EQ(s.verified_hits, 1u);
+    EXPECT_EQ(s.verified_misses, 2u);
+}
+
+TEST_F(HtpasswdCacheTest, VerifiedCredentialsAreExact)
+{
+    const char *f = file_.c_str();
+    htpasswd_verified_store(f, "alice", "pw", "H1", 1000);
+    EXPECT_EQ(htpasswd_verified_check(f, "alice", "pw2", "H1", 1000), 0);
+    EXPECT_EQ(htpasswd_verified_check(f, "alicex", "pw", "H1", 1000), 0);
+    EXPECT_EQ(htpasswd_verified_check(f, "alice", "pw", "H2", 1000), 0);
+    EXPECT_EQ(htpasswd_verified_check("/other", "alice", "pw", "H1", 1000),
+              0);
+    /* Field boundaries are part of the tag */
+    EXPECT_EQ(htpasswd_verified_check(f, "alicep", "w", "H1", 1000), 0);
+}
+
+TEST_F(HtpasswdCacheTest, VerifiedTableIsBounded)
+{
+    const char *f = file_.c_str();
+    const int n = HTPASSWD_VERIFIED_SLOTS * 2;
+    for (int i = 0; i < n; i++)
+        htpasswd_verified_store(f, "alice", std::to_string(i).c_str(), "H",
+                                1000 + i);
+    int remembered = 0;
+    for (int i = 0; i < n; i++)
+        remembered += htpasswd_verified_check(f, "alice",
+                                              std::to_string(i).c_str(),
+                                              "H", 1000 + n);
+    EXPECT_LE(remembered, HTPASSWD_VERIFIED_SLOTS);
+    /* The newest entry always survives */
+    EXPECT_EQ(htpasswd_verified_check(f, "alice",
+                                      std::to_string(n - 1).c_str(), "H",
+                                      1000 + n), 1);
+}
+
+TEST_F(HtpasswdCacheTest, ZeroTtlDisablesVerifiedTable)
+{
+    const char *f = file_.c_str();
+    htpasswd_verified_store(f, "alice", "pw", "H1", 1000);
+    htpasswd_verified_set_ttl(0);
+    EXPECT_EQ(htpasswd_verified_check(f, "alice", "pw", "H1", 1000), 0);
+    htpasswd_verified_store(f, "alice", "pw", "H1", 1000);
+    EXPECT_EQ(htpasswd_verified_check(f, "alice", "pw", "H1", 1000), 0);
+}
+
+/* Repeat requests skip crypt(); a changed entry is checked again */
+TEST_F(HtpasswdCacheTest, AuthRemembersAndRevalidatesPasswords)
+{
+    std::string old_hash = crypt("secret", "ab");
+    write_file("alice:" + old_hash + "\n");
+    std::string conf = "AuthType Basic\n"
+                       "AuthUserFile " + file_ + "\n"
+                       "Require valid-user\n";
+    htaccess_directive_t *dirs = htaccess_parse(conf.c_str(), conf.size(),
+                                                "/www/.htaccess");
+    ASSERT_NE(dirs, nullptr);
+
+    mock_lsiapi::reset_global_state();
+    MockSession session;
+    session.set_auth_header("Basic YWxpY2U6c2VjcmV0"); /* alice:secret */
+    EXPECT_EQ(exec_auth_basic(session.handle(), dirs), LSI_OK);
+    EXPECT_EQ(exec_auth_basic(session.handle(), dirs), LSI_OK);
+    EXPECT_EQ(stats().verified_hits, 1u);
+
+    /* Password changed: the remembered success no longer applies */
+    std::string new_hash = crypt("other", "cd");
+    write_file("alice:" + new_hash + "\n");
+    EXPECT_EQ(exec_auth_basic(session.handle(), dirs), LSI_ERROR);
+    EXPECT_EQ(session.get_status_code(), 401);
+    EXPECT_EQ(stats().verified_hits, 1u);
+    htaccess_directives_free(dirs);
+}
+
+TEST_F(HtpasswdCacheTest, FormatIsDetectedAtLoad)
+{
+    write_file("alice:$apr1$qHDFfhPC$nITSVHgYbDAK1Y0acGRnY0\n"
+               "bob:{SHA}GpHWL3ymc5liWkNopqtdSjuqYHM=\n"
+               "carol:abJnggxhB/yJU\n");
+    char buf[512];
+    pwhash_format_t fmt = PWHASH_CRYPT;
+    EXPECT_EQ(htpasswd_cache_lookup_format(file_.c_str(), "alice", buf,
+                                           sizeof(buf), &fmt), 1);
+    EXPECT_EQ(fmt, PWHASH_APR1);
+    EXPECT_EQ(htpasswd_cache_lookup_format(file_.c_str(), "bob", buf,
+                                           sizeof(buf), &fmt), 1);
+    EXPECT_EQ(fmt, PWHASH_SHA1);
+    EXPECT_EQ(htpasswd_cache_lookup_format(file_.c_str(), "carol", buf,
+                                           sizeof(buf), &fmt), 1);
+    EXPECT_EQ(fmt, PWHASH_CRYPT);
+}
+
+/* apr1 entries written by `htpasswd -m` authenticate */
+TEST_F(HtpasswdCacheTest, AuthAcceptsApr1Entries)
+{
+    write_file("alice:$apr1$qHDFfhPC$nITSVHgYbDAK1Y0acGRnY0\n");
+    std::string conf = "AuthType Basic\n"
+                       "AuthUserFile " + file_ + "\n"
+                       "Require valid-user\n";
+    htaccess_directive_t *dirs = htaccess_parse(conf.c_str(), conf.size(),
+                                                "/www/.htaccess");
+    ASSERT_NE(dirs, nullptr);
+
+    mock_lsiapi::reset_global_state();
+    MockSession session;
+    /* alice:myPassword */
+    session.set_auth_header("Basic YWxpY2U6bXlQYXNzd29yZA==");
+    EXPECT_EQ(exec_auth_basic(session.handle(), dirs), LSI_OK);
+    session.set_auth_header("Basic YWxpY2U6c2VjcmV0"); /* alice:secret */
+    EXPECT_EQ(exec_auth_basic(session.handle(), dirs), LSI_ERROR);
+    EXPECT_EQ(session.get_status_code(), 401);
+    htaccess_directives_free(dirs);
+}
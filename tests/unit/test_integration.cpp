@@ -18,11 +18,18 @@
 #include "mock_lsiapi.h"
 #include "htaccess_cache.h"
 #include "htaccess_shm.h"
+#include "htaccess_authpool.h"
+#include "htaccess_parser.h"
 #include "htaccess_directive.h"
 
+#include <crypt.h>
+#include <cstdio>
 #include <cstring>
 #include <cstdlib>
 #include <string>
+#include <ctime>
+#include <unistd.h>
+#include <vector>
 
 /* Access the module descriptor and cleanup function (C linkage) */
 extern "C" {
@@ -67,11 +74,17 @@ protected:
         /* Destroy any leftover cache/shm from previous tests */
         htaccess_cache_destroy();
         shm_destroy();
+        /* No brute force snapshots outside the tests that ask for them */
+        setenv("OLS_HTACCESS_BF_SNAPSHOT_DIR", "", 1);
     }
 
     void TearDown() override {
+        authpool_destroy();
+        mock_lsiapi::run_events();
         htaccess_cache_destroy();
         shm_destroy();
+        shm_set_snapshot_dir(nullptr);
+        unsetenv("OLS_HTACCESS_BF_SNAPSHOT_DIR");
     }
 
     /**
@@ -132,6 +145,26 @@ TEST_F(IntegrationTest, ModuleCleanupSucceeds) {
     EXPECT_EQ(rc, LSI_OK);
 }
 
+TEST_F(IntegrationTest, ShmCapacityFromEnvironment) {
+    setenv("OLS_HTACCESS_BF_RECORDS", "48", 1);
+    MNAME.init_cb(&MNAME);
+    unsetenv("OLS_HTACCESS_BF_RECORDS");
+
+    shm_stats_t stats;
+    ASSERT_EQ(shm_get_stats(&stats), 0);
+    EXPECT_EQ(stats.capacity, 48u);
+}
+
+TEST_F(IntegrationTest, ShmCapacityInvalidEnvironmentIgnored) {
+    setenv("OLS_HTACCESS_BF_RECORDS", "lots", 1);
+    MNAME.init_cb(&MNAME);
+    unsetenv("OLS_HTACCESS_BF_RECORDS");
+
+    shm_stats_t stats;
+    ASSERT_EQ(shm_get_stats(&stats), 0);
+    EXPECT_EQ(stats.capacity, 1024u);
+}
+
 TEST_F(IntegrationTest, ModuleInitLogsSuccess) {
     MNAME.init_cb(&MNAME);
     auto &logs = mock_lsiapi::get_log_records();
@@ -204,6 +237,58 @@ TEST_F(IntegrationTest, RequestPhase_RedirectShortCircuits) {
     EXPECT_FALSE(session_.has_env_var("SHOULD_NOT_SET"));
 }
 
+/* Redirect, RedirectMatch and RedirectMap keep first-match order */
+TEST_F(IntegrationTest, RequestPhase_RedirectKindsKeepDeclarationOrder) {
+    lsi_hook_cb req_hook, resp_hook;
+    ASSERT_TRUE(init_module(&req_hook, &resp_hook));
+
+    char tmpl[] = "/tmp/redirect_map_int_XXXXXX";
+    ASSERT_NE(mkdtemp(tmpl), nullptr);
+    std::string map = std::string(tmpl) + "/map.txt";
+    FILE *f = fopen(map.c_str(), "w");
+    ASSERT_NE(f, nullptr);
+    fputs("/docs/a https://example.com/map-a\n"
+          "/img/x.png https://example.com/map-img\n", f);
+    fclose(f);
+
+    std::string conf = "RedirectMatch 307 ^/docs/a$ https://example.com/re\n"
+                       "RedirectMap 301 " + map + "\n"
+                       "Redirect /docs https://example.com/prefix\n"
+                       "RedirectMatch ^/img/(.*)$ https://example.com/$1\n";
+    htaccess_directive_t *dirs = htaccess_parse(conf.c_str(), conf.size(),
+                                                "/var/www/.htaccess");
+    ASSERT_NE(dirs, nullptr);
+    htaccess_cache_put("/var/www/.htaccess", 0, dirs);
+    session_.set_doc_root("/var/www");
+    session_.set_client_ip("10.0.0.1");
+
+    const struct {
+        const char *uri;
+        int status;
+        const char *location;
+    } cases[] = {
+        {"/docs/a", 307, "https://example.com/re"},
+        {"/img/x.png", 301, "https://example.com/map-img"},
+        {"/docs/b", 302, "https://example.com/prefix"},
+        {"/img/y.png", 302, "https://example.com/y.png"},
+    };
+    for (const auto &c : cases) {
+        session_.reset();
+        session_.set_doc_root("/var/www");
+        session_.set_client_ip("10.0.0.1");
+        session_.set_request_uri(c.uri);
+        EXPECT_EQ(req_hook(session_.handle()), LSI_OK);
+        EXPECT_EQ(session_.get_status_code(), c.status) << c.uri;
+        EXPECT_EQ(session_.get_response_header("Location"), c.location)
+            << c.uri;
+    }
+
+    mod_htaccess_cleanup(&MNAME);
+    unlink(map.c_str());
+    unlink((map + ".rmap").c_str());
+    rmdir(tmpl);
+}
+
 TEST_F(IntegrationTest, RequestPhase_PHPConfigApplied) {
     lsi_hook_cb req_hook, resp_hook;
     ASSERT_TRUE(init_module(&req_hook, &resp_hook));
@@ -567,3 +652,319 @@ TEST_F(IntegrationTest, GracefulDegradation_MixedDirectives_ErrorInOneDoesNotAff
     EXPECT_EQ(records[0].name, "max_execution_time");
     EXPECT_EQ(records[0].value, "30");
 }
+
+/* ================================================================== */
+/*  Brute force: block in the request phase, count in the response    */
+/* ================================================================== */
+
+TEST_F(IntegrationTest, BruteForce_CountsOnlyFailedResponses) {
+    lsi_hook_cb req_hook, resp_hook;
+    ASSERT_TRUE(init_module(&req_hook, &resp_hook));
+    /* Private store, independent of /dev/shm state from earlier runs */
+    ASSERT_EQ(shm_init(nullptr, 1024), 0);
+
+    auto *d_on = make_directive(DIR_BRUTE_FORCE_PROTECTION, nullptr,
+                                nullptr, 1);
+    d_on->data.brute_force.enabled = 1;
+    auto *d_max = make_directive(DIR_BRUTE_FORCE_ALLOWED_ATTEMPTS, nullptr,
+                                 nullptr, 2);
+    d_max->data.brute_force.allowed_attempts = 2;
+    chain(d_on, d_max);
+    htaccess_cache_put("/var/www/.htaccess", 0, d_on);
+
+    auto round = [&](int status) {
+        session_.reset();
+        session_.set_doc_root("/var/www");
+        session_.set_request_uri("/login.php");
+        session_.set_client_ip("10.0.0.1");
+        req_hook(session_.handle());
+        int req_status = session_.get_status_code();
+        if (req_status != 403)
+            session_.set_status_code(status);
+        resp_hook(session_.handle());
+        return req_status;
+    };
+
+    /* Successful logins never lock the user out */
+    for (int i = 0; i < 5; i++)
+        EXPECT_NE(round(200), 403);
+
+    /* Two failures use up the allowance; the next request is blocked */
+    EXPECT_NE(round(401), 403);
+    EXPECT_NE(round(401), 403);
+    EXPECT_EQ(round(200), 403);
+}
+
+TEST_F(IntegrationTest, BruteForce_ThrottleSuspendsRequestHook) {
+    lsi_hook_cb req_hook, resp_hook;
+    ASSERT_TRUE(init_module(&req_hook, &resp_hook));
+    ASSERT_EQ(shm_init(nullptr, 1024), 0);
+
+    auto *d_on = make_directive(DIR_BRUTE_FORCE_PROTECTION, nullptr,
+                                nullptr, 1);
+    d_on->data.brute_force.enabled = 1;
+    auto *d_max = make_directive(DIR_BRUTE_FORCE_ALLOWED_ATTEMPTS, nullptr,
+                                 nullptr, 2);
+    d_max->data.brute_force.allowed_attempts = 1;
+    auto *d_act = make_directive(DIR_BRUTE_FORCE_ACTION, nullptr, nullptr, 3);
+    d_act->data.brute_force.action = BF_ACTION_THROTTLE;
+    chain(d_on, d_max);
+    chain(d_max, d_act);
+    htaccess_cache_put("/var/www/.htaccess", 0, d_on);
+
+    session_.set_doc_root("/var/www");
+    session_.set_request_uri("/login.php");
+    session_.set_client_ip("10.0.0.1");
+    EXPECT_EQ(req_hook(session_.handle()), LSI_OK);
+    session_.set_status_code(401);
+    resp_hook(session_.handle());
+
+    /* Over the allowance: the hook suspends instead of sleeping */
+    session_.set_status_code(200);
+    EXPECT_EQ(req_hook(session_.handle()), LSI_SUSPEND);
+    EXPECT_EQ(session_.get_status_code(), 200);
+    /* Default throttle duration: 1000 ms */
+    EXPECT_EQ(mock_lsiapi::advance_timers(999), 0);
+    EXPECT_EQ(mock_lsiapi::advance_timers(1), 1);
+    EXPECT_EQ(session_.get_resume_count(), 1);
+}
+
+/* A throttled client that disconnects is not resumed by its timer */
+TEST_F(IntegrationTest, BruteForce_SessionEndCancelsThrottle) {
+    lsi_hook_cb req_hook, resp_hook, end_hook = nullptr;
+    ASSERT_TRUE(init_module(&req_hook, &resp_hook));
+    for (auto &h : mock_lsiapi::get_hook_records())
+        if (h.hook_point == LSI_HKPT_HTTP_END)
+            end_hook = h.callback;
+    ASSERT_NE(end_hook, nullptr);
+    ASSERT_EQ(shm_init(nullptr, 1024), 0);
+
+    auto *d_on = make_directive(DIR_BRUTE_FORCE_PROTECTION, nullptr,
+                                nullptr, 1);
+    d_on->data.brute_force.enabled = 1;
+    auto *d_max = make_directive(DIR_BRUTE_FORCE_ALLOWED_ATTEMPTS, nullptr,
+                                 nullptr, 2);
+    d_max->data.brute_force.allowed_attempts = 1;
+    auto *d_act = make_directive(DIR_BRUTE_FORCE_ACTION, nullptr, nullptr, 3);
+    d_act->data.brute_force.action = BF_ACTION_THROTTLE;
+    chain(d_on, d_max);
+    chain(d_max, d_act);
+    htaccess_cache_put("/var/www/.htaccess", 0, d_on);
+
+    session_.set_doc_root("/var/www");
+    session_.set_request_uri("/login.php");
+    session_.set_client_ip("10.0.0.2");
+    EXPECT_EQ(req_hook(session_.handle()), LSI_OK);
+    session_.set_status_code(401);
+    resp_hook(session_.handle());
+
+    /* Module timers (telemetry export) stay armed throughout */
+    int armed = mock_lsiapi::pending_timers();
+    session_.set_status_code(200);
+    EXPECT_EQ(req_hook(session_.handle()), LSI_SUSPEND);
+    EXPECT_EQ(mock_lsiapi::pending_timers(), armed + 1);
+    EXPECT_EQ(end_hook(session_.handle()), LSI_OK);
+    EXPECT_EQ(mock_lsiapi::pending_timers(), armed);
+    EXPECT_EQ(mock_lsiapi::advance_timers(1000), 0);
+    EXPECT_EQ(session_.get_resume_count(), 0);
+    /* Ending a session with nothing pending is harmless */
+    EXPECT_EQ(end_hook(session_.handle()), LSI_OK);
+}
+
+/* Ending one of many throttled sessions cancels only its own timer */
+TEST_F(IntegrationTest, BruteForce_SessionEndCancelsOnlyItsThrottle) {
+    lsi_hook_cb req_hook, resp_hook, end_hook = nullptr;
+    ASSERT_TRUE(init_module(&req_hook, &resp_hook));
+    for (auto &h : mock_lsiapi::get_hook_records())
+        if (h.hook_point == LSI_HKPT_HTTP_END)
+            end_hook = h.callback;
+    ASSERT_NE(end_hook, nullptr);
+    ASSERT_EQ(shm_init(nullptr, 1024), 0);
+
+    auto *d_on = make_directive(DIR_BRUTE_FORCE_PROTECTION, nullptr,
+                                nullptr, 1);
+    d_on->data.brute_force.enabled = 1;
+    auto *d_max = make_directive(DIR_BRUTE_FORCE_ALLOWED_ATTEMPTS, nullptr,
+                                 nullptr, 2);
+    d_max->data.brute_force.allowed_attempts = 1;
+    auto *d_act = make_directive(DIR_BRUTE_FORCE_ACTION, nullptr, nullptr, 3);
+    d_act->data.brute_force.action = BF_ACTION_THROTTLE;
+    chain(d_on, d_max);
+    chain(d_max, d_act);
+    htaccess_cache_put("/var/www/.htaccess", 0, d_on);
+
+    session_.set_doc_root("/var/www");
+    session_.set_request_uri("/login.php");
+    session_.set_client_ip("10.0.0.2");
+    EXPECT_EQ(req_hook(session_.handle()), LSI_OK);
+    session_.set_status_code(401);
+    resp_hook(session_.handle());
+
+    const int n = 100;
+    int base = mock_lsiapi::pending_timers();
+    std::vector<MockSession> sessions(n);
+    for (auto &s : sessions) {
+        s.set_doc_root("/var/www");
+        s.set_request_uri("/login.php");
+        s.set_client_ip("10.0.0.2");
+        ASSERT_EQ(req_hook(s.handle()), LSI_SUSPEND);
+    }
+    EXPECT_EQ(mock_lsiapi::pending_timers(), base + n);
+    for (int i = 0; i < n; i += 2)
+        EXPECT_EQ(end_hook(sessions[i].handle()), LSI_OK);
+    EXPECT_EQ(mock_lsiapi::pending_timers(), base + n / 2);
+    mock_lsiapi::advance_timers(1000);
+    for (int i = 0; i < n; i++)
+        EXPECT_EQ(sessions[i].get_resume_count(), i % 2) << i;
+}
+
+TEST_F(IntegrationTest, AuthBasic_SuspendsWhilePasswordIsHashed) {
+    lsi_hook_cb req_hook, resp_hook;
+    ASSERT_TRUE(init_module(&req_hook, &resp_hook));
+
+    char users[] = "/tmp/integration_htpasswd_XXXXXX";
+    int fd = mkstemp(users);
+    ASSERT_GE(fd, 0);
+    std::string line = std::string("admin:") + crypt("secret", "ab") + "\n";
+    ASSERT_EQ(write(fd, line.data(), line.size()), (ssize_t)line.size());
+    close(fd);
+
+    std::string conf = std::string("AuthType Basic\n"
+                                   "AuthName \"Admin\"\n"
+                                   "AuthUserFile ") + users + "\n"
+                       "Require valid-user\n"
+                       "SetEnv AUTHED yes\n";
+    htaccess_cache_put("/var/www/.htaccess", 0,
+                       htaccess_parse(conf.c_str(), conf.size(),
+                                      "/var/www/.htaccess"));
+
+    session_.set_doc_root("/var/www");
+    session_.set_request_uri("/admin/index.php");
+    session_.set_auth_header("Basic YWRtaW46c2VjcmV0"); /* admin:secret */
+    EXPECT_EQ(req_hook(session_.handle()), LSI_SUSPEND);
+    /* Steps after authentication wait for the password check */
+    EXPECT_FALSE(session_.has_env_var("AUTHED"));
+    EXPECT_EQ(session_.get_resume_count(), 0);
+
+    ASSERT_EQ(mock_lsiapi::wait_events(1, 10000), 1);
+    mock_lsiapi::run_events();
+    EXPECT_EQ(session_.get_env_var("AUTHED"), "yes");
+    EXPECT_EQ(session_.get_resume_count(), 1);
+    EXPECT_EQ(session_.get_status_code(), 200);
+
+    /* A repeat request is answered from the verified-credential table */
+    EXPECT_EQ(req_hook(session_.handle()), LSI_OK);
+    EXPECT_EQ(mod_htaccess_cleanup(&MNAME), LSI_OK);
+    unlink(users);
+}
+
+/* A session that ends while its password is hashed is never touched */
+TEST_F(IntegrationTest, AuthBasic_SessionEndCancelsResume) {
+    lsi_hook_cb req_hook, resp_hook, end_hook = nullptr;
+    ASSERT_TRUE(init_module(&req_hook, &resp_hook));
+    for (auto &h : mock_lsiapi::get_hook_records())
+        if (h.hook_point == LSI_HKPT_HTTP_END)
+            end_hook = h.callback;
+    ASSERT_NE(end_hook, nullptr);
+
+    char users[] = "/tmp/integration_htpasswd_XXXXXX";
+    int fd = mkstemp(users);
+    ASSERT_GE(fd, 0);
+    std::string line = std::string("admin:") + crypt("secret", "ab") + "\n";
+    ASSERT_EQ(write(fd, line.data(), line.size()), (ssize_t)line.size());
+    close(fd);
+
+    std::string conf = std::string("AuthType Basic\n"
+                                   "AuthName \"Admin\"\n"
+                                   "AuthUserFile ") + users + "\n"
+                       "Require valid-user\n";
+    htaccess_cache_put("/var/www/.htaccess", 0,
+                       htaccess_parse(conf.c_str(), conf.size(),
+                                      "/var/www/.htaccess"));
+
+    session_.set_doc_root("/var/www");
+    session_.set_request_uri("/admin/index.php");
+    session_.set_auth_header("Basic YWRtaW46d3Jvbmc="); /* admin:wrong */
+    EXPECT_EQ(req_hook(session_.handle()), LSI_SUSPEND);
+    EXPECT_EQ(end_hook(session_.handle()), LSI_OK);
+
+    ASSERT_EQ(mock_lsiapi::wait_events(1, 10000), 1);
+    mock_lsiapi::run_events();
+    EXPECT_EQ(session_.get_resume_count(), 0);
+    EXPECT_EQ(session_.get_status_code(), 200);
+    EXPECT_TRUE(session_.get_www_authenticate().empty());
+    EXPECT_EQ(mod_htaccess_cleanup(&MNAME), LSI_OK);
+    unlink(users);
+}
+
+TEST_F(IntegrationTest, BruteForce_BlocksSurviveTableReformat) {
+    char tmpl[] = "/tmp/bf_snapshot_XXXXXX";
+    ASSERT_NE(mkdtemp(tmpl), nullptr);
+    std::string dir = tmpl;
+    setenv("OLS_HTACCESS_BF_SNAPSHOT_DIR", dir.c_str(), 1);
+
+    ip_addr_t a;
+    ASSERT_EQ(ip_addr_parse("203.0.113.9", &a), 0);
+    brute_force_record_t rec = {};
+    rec.attempt_count = 10;
+    rec.first_attempt = time(nullptr);
+    rec.blocked_until = time(nullptr) + 3600;
+
+    setenv("OLS_HTACCESS_BF_RECORDS", "64", 1);
+    ASSERT_EQ(MNAME.init_cb(&MNAME), LSI_OK);
+    ASSERT_EQ(shm_update_record(&a, &rec), 0);
+    /* Shutdown checkpoints the table */
+    mod_htaccess_cleanup(&MNAME);
+
+    /* A new capacity reformats the shared table on the next start */
+    setenv("OLS_HTACCESS_BF_RECORDS", "80", 1);
+    ASSERT_EQ(MNAME.init_cb(&MNAME), LSI_OK);
+    unsetenv("OLS_HTACCESS_BF_RECORDS");
+    brute_force_record_t out;
+    ASSERT_EQ(shm_get_record(&a, &out), 0);
+    EXPECT_EQ(out.blocked_until, rec.blocked_until);
+
+    shm_destroy();
+    unlink((dir + "/" SHM_SNAPSHOT_NAME).c_str());
+    rmdir(dir.c_str());
+}
+
+TEST_F(IntegrationTest, BruteForce_SnapshotIsRestoredOnATimer) {
+    char tmpl[] = "/tmp/bf_snapshot_XXXXXX";
+    ASSERT_NE(mkdtemp(tmpl), nullptr);
+    std::string dir = tmpl;
+    setenv("OLS_HTACCESS_BF_SNAPSHOT_DIR", dir.c_str(), 1);
+
+    time_t now = time(nullptr);
+    setenv("OLS_HTACCESS_BF_RECORDS", "4096", 1);
+    ASSERT_EQ(MNAME.init_cb(&MNAME), LSI_OK);
+    for (uint64_t i = 0; i < 1000; i++) {
+        ip_addr_t a = {};
+        a.hi = 0x20010db800000000ULL;
+        a.lo = i + 1;
+        ASSERT_EQ(shm_record_attempt(&a, now, 600, 5, nullptr), 0);
+    }
+    mod_htaccess_cleanup(&MNAME);
+
+    /* After a reformat the records come back in timer steps */
+    setenv("OLS_HTACCESS_BF_RECORDS", "8192", 1);
+    int armed = mock_lsiapi::pending_timers();
+    ASSERT_EQ(MNAME.init_cb(&MNAME), LSI_OK);
+    unsetenv("OLS_HTACCESS_BF_RECORDS");
+    shm_stats_t stats;
+    ASSERT_EQ(shm_get_stats(&stats), 0);
+    EXPECT_EQ(stats.occupied, 0u);
+    EXPECT_EQ(stats.restore_left, 1000u);
+    int with_restore = mock_lsiapi::pending_timers();
+    EXPECT_GT(with_restore, armed);
+
+    mock_lsiapi::advance_timers(SHM_RESTORE_INTERVAL_MS);
+    ASSERT_EQ(shm_get_stats(&stats), 0);
+    EXPECT_EQ(stats.occupied, 1000u);
+    EXPECT_EQ(stats.restore_left, 0u);
+    EXPECT_EQ(mock_lsiapi::pending_timers(), with_restore - 1);
+
+    EXPECT_EQ(mod_htaccess_cleanup(&MNAME), LSI_OK);
+    unlink((dir + "/" SHM_SNAPSHOT_NAME).c_str());
+    rmdir(dir.c_str());
+}
@@ -7,6 +7,7 @@
  * Validates: Requirements 2.1, 2.2, 2.3, 2.4, 9.1
  */
 #include <gtest/gtest.h>
+#include <cstdlib>
 #include <cstring>
 #include <string>
 
@@ -201,6 +202,47 @@ TEST_F(ParserTest, DenyFromAll) {
     htaccess_directives_free(d);
 }
 
+TEST_F(ParserTest, AllowFromCompilesCidrSet) {
+    auto *d = parse("Allow from 192.168.1.0/24\n");
+    ASSERT_NE(d, nullptr);
+    ASSERT_EQ(d->data.ip.cidrs.count, 1);
+    EXPECT_EQ(d->data.ip.cidrs.first[0].lo, 0x0000FFFFC0A80100ull);
+    EXPECT_EQ(d->data.ip.cidrs.last[0].lo, 0x0000FFFFC0A801FFull);
+    htaccess_directives_free(d);
+}
+
+TEST_F(ParserTest, RequireIpCompilesEveryRange) {
+    auto *d = parse("Require ip 10.0.0.0/8 2001:db8::/32 not-an-ip\n");
+    ASSERT_NE(d, nullptr);
+    EXPECT_EQ(d->type, DIR_REQUIRE_IP);
+    EXPECT_EQ(d->data.ip.cidrs.count, 2);
+    ip_addr_t in4, out4, in6;
+    ip_addr_from_v4(0x0A010203u, &in4);
+    ip_addr_from_v4(0xC0A80101u, &out4);
+    ASSERT_EQ(ip_addr_parse("2001:db8:5::1", &in6), 0);
+    EXPECT_TRUE(htaccess_directive_ip_match(d, &in4));
+    EXPECT_FALSE(htaccess_directive_ip_match(d, &out4));
+    EXPECT_TRUE(htaccess_directive_ip_match(d, &in6));
+    htaccess_directives_free(d);
+}
+
+/* A value without a valid range compiles to an empty set, not "unset" */
+TEST_F(ParserTest, RequireIpWithoutValidRangesIsCompiled) {
+    auto *d = parse("Require ip not-an-ip 300.1.2.3\n");
+    ASSERT_NE(d, nullptr);
+    EXPECT_EQ(d->data.ip.compiled, 1);
+    EXPECT_EQ(d->data.ip.cidrs.count, 0);
+    /* Matching uses the empty set and never goes back to the string */
+    free(d->value);
+    d->value = strdup("10.1.2.3");
+    ip_addr_t a;
+    ip_addr_from_v4(0x0A010203u, &a);
+    EXPECT_FALSE(htaccess_directive_ip_match(d, &a));
+    d->data.ip.compiled = 0;
+    EXPECT_TRUE(htaccess_directive_ip_match(d, &a));
+    htaccess_directives_free(d);
+}
+
 /* ---- Redirect directives ---- */
 
 TEST_F(ParserTest, RedirectDefault302) {
@@ -241,6 +283,22 @@ TEST_F(ParserTest, RedirectMatchDefault302) {
     htaccess_directives_free(d);
 }
 
+TEST_F(ParserTest, RedirectMap) {
+    auto *d = parse("RedirectMap /etc/redirects.txt\n"
+                    "RedirectMap 301 \"/etc/moved.txt\"\n"
+                    "RedirectMap\n");
+    ASSERT_NE(d, nullptr);
+    EXPECT_EQ(d->type, DIR_REDIRECT_MAP);
+    EXPECT_STREQ(d->value, "/etc/redirects.txt");
+    EXPECT_EQ(d->data.redirect.status_code, 302);
+    ASSERT_NE(d->next, nullptr);
+    EXPECT_EQ(d->next->type, DIR_REDIRECT_MAP);
+    EXPECT_STREQ(d->next->value, "/etc/moved.txt");
+    EXPECT_EQ(d->next->data.redirect.status_code, 301);
+    EXPECT_EQ(d->next->next, nullptr);
+    htaccess_directives_free(d);
+}
+
 /* ---- ErrorDocument ---- */
 
 TEST_F(ParserTest, ErrorDocumentPath) {
@@ -231,6 +231,19 @@ TEST(PrinterTest, RedirectMatch301) {
     htaccess_directives_free(d);
 }
 
+TEST(PrinterTest, RedirectMap) {
+    auto *d = make_dir(DIR_REDIRECT_MAP, nullptr, "/etc/redirects.txt");
+    d->data.redirect.status_code = 302;
+    d->next = make_dir(DIR_REDIRECT_MAP, nullptr, "/etc/moved.txt");
+    d->next->data.redirect.status_code = 301;
+    char *out = htaccess_print(d);
+    ASSERT_NE(out, nullptr);
+    EXPECT_STREQ(out, "RedirectMap /etc/redirects.txt\n"
+                      "RedirectMap 301 /etc/moved.txt\n");
+    free(out);
+    htaccess_directives_free(d);
+}
+
 /* ---- ErrorDocument ---- */
 
 TEST(PrinterTest, ErrorDocument) {
@@ -381,6 +394,28 @@ TEST(PrinterTest, BruteForceThrottleDuration) {
     htaccess_directives_free(d);
 }
 
+TEST(PrinterTest, BruteForceFailureStatus) {
+    auto *d = make_dir(DIR_BRUTE_FORCE_FAILURE_STATUS, nullptr, "401 429");
+    char *out = htaccess_print(d);
+    ASSERT_NE(out, nullptr);
+    EXPECT_STREQ(out, "BruteForceFailureStatus 401 429\n");
+    free(out);
+    htaccess_directives_free(d);
+}
+
+TEST(PrinterTest, GroupAuthorization) {
+    auto *d = make_dir(DIR_AUTH_GROUP_FILE, nullptr, "/etc/htgroup");
+    d->next = make_dir(DIR_REQUIRE_USER, nullptr, "alice bob");
+    d->next->next = make_dir(DIR_REQUIRE_GROUP, nullptr, "admins");
+    char *out = htaccess_print(d);
+    ASSERT_NE(out, nullptr);
+    EXPECT_STREQ(out, "AuthGroupFile /etc/htgroup\n"
+                      "Require user alice bob\n"
+                      "Require group admins\n");
+    free(out);
+    htaccess_directives_free(d);
+}
+
 /* ---- FilesMatch block ---- */
 
 TEST(PrinterTest, FilesMatchWithChildren) {
@@ -0,0 +1,121 @@
+/**
+ * test_pwhash.cpp - Unit tests for the native htpasswd hash verifiers
+ *
+ * Validates: Requirements 10.4
+ */
+#include <gtest/gtest.h>
+#include <crypt.h>
+#include <string>
+
+extern "C" {
+#include "htaccess_pwhash.h"
+}
+
+/* Hash with libc, for cross-checking the native code */
+static std::string libc_crypt(const char *pw, const char *setting)
+{
+    const char *out = crypt(pw, setting);
+    return out ? out : "";
+}
+
+TEST(PwhashTest, DetectsFormats)
+{
+    EXPECT_EQ(pwhash_detect("$apr1$salt$x"), PWHASH_APR1);
+    EXPECT_EQ(pwhash_detect("$1$salt$x"), PWHASH_MD5_CRYPT);
+    EXPECT_EQ(pwhash_detect("{SHA}abc="), PWHASH_SHA1);
+    EXPECT_EQ(pwhash_detect("$5$salt$x"), PWHASH_SHA256_CRYPT);
+    EXPECT_EQ(pwhash_detect("$6$rounds=1000$salt$x"), PWHASH_SHA512_CRYPT);
+    EXPECT_EQ(pwhash_detect("$2y$10$abcdefghijklmnopqrstuv"), PWHASH_CRYPT);
+    EXPECT_EQ(pwhash_detect("abJnggxhB/yJU"), PWHASH_CRYPT);
+    EXPECT_STREQ(pwhash_format_name(PWHASH_APR1), "apr1");
+    EXPECT_STREQ(pwhash_format_name(PWHASH_CRYPT), "crypt");
+    EXPECT_TRUE(pwhash_is_fast(PWHASH_SHA1));
+    EXPECT_FALSE(pwhash_is_fast(PWHASH_SHA512_CRYPT));
+}
+
+/* Reference value from `openssl passwd -apr1` */
+TEST(PwhashTest, Apr1MatchesReference)
+{
+    const char *hash = "$apr1$qHDFfhPC$nITSVHgYbDAK1Y0acGRnY0";
+    EXPECT_EQ(pwhash_check(hash, "myPassword"), 1);
+    EXPECT_EQ(pwhash_check(hash, "myPassword2"), 0);
+    EXPECT_EQ(pwhash_check(hash, ""), 0);
+}
+
+/* Reference value from `htpasswd -s` */
+TEST(PwhashTest, Sha1MatchesReference)
+{
+    EXPECT_EQ(pwhash_check("{SHA}GpHWL3ymc5liWkNopqtdSjuqYHM=", "pw"), 1);
+    EXPECT_EQ(pwhash_check("{SHA}GpHWL3ymc5liWkNopqtdSjuqYHM=", "pW"), 0);
+    EXPECT_EQ(pwhash_check("{SHA}GpHWL3ymc5liWkNopqtdSjuqYHM", "pw"), 0);
+}
+
+TEST(PwhashTest, Md5CryptMatchesLibc)
+{
+    std::string long_pw(100, 'x');
+    for (const char *pw : {"", "a", "secret", long_pw.c_str()}) {
+        std::string hash = libc_crypt(pw, "$1$saltsalt$");
+        ASSERT_EQ(pwhash_detect(hash.c_str()), PWHASH_MD5_CRYPT);
+        EXPECT_EQ(pwhash_check(hash.c_str(), pw), 1) << hash;
+        EXPECT_EQ(pwhash_check(hash.c_str(), "other"), 0);
+    }
+}
+
+TEST(PwhashTest, Sha256CryptMatchesLibc)
+{
+    std::string long_pw(80, 'p');
+    for (const char *setting : {"$5$saltstring$",
+                                "$5$rounds=1000$short$",
+                                "$5$averyveryverylongsaltvalue$"}) {
+        for (const char *pw : {"", "secret", long_pw.c_str()}) {
+            std::string hash = libc_crypt(pw, setting);
+            ASSERT_FALSE(hash.empty());
+            EXPECT_EQ(pwhash_check(hash.c_str(), pw), 1) << hash;
+            EXPECT_EQ(pwhash_check(hash.c_str(), "Secret"), 0);
+        }
+    }
+}
+
+TEST(PwhashTest, Sha512CryptMatchesLibc)
+{
+    std::string long_pw(200, 'q');
+    for (const char *setting : {"$6$saltstring$", "$6$rounds=1200$abc$"}) {
+        for (const char *pw : {"", "secret", long_pw.c_str()}) {
+            std::string hash = libc_crypt(pw, setting);
+            ASSERT_FALSE(hash.empty());
+            EXPECT_EQ(pwhash_check(hash.c_str(), pw), 1) << hash;
+            EXPECT_EQ(pwhash_check(hash.c_str(), "Secret"), 0);
+        }
+    }
+}
+
+/* Out-of-range round counts are rejected, as libxcrypt does */
+TEST(PwhashTest, ShaCryptRejectsBadRounds)
+{
+    EXPECT_EQ(libc_crypt("secret", "$5$rounds=10$salt$").compare(0, 1, "*"),
+              0);
+    EXPECT_EQ(pwhash_check("$5$rounds=10$salt$CCvcOM6b7TEJDPb37Aec/9UpOg4Q"
+                           "hPNAxPpL9ZzjTB7", "secret"), -1);
+    EXPECT_EQ(pwhash_check("$5$rounds=1000$salt$CCvcOM6b7TEJDPb37Aec/9UpOg"
+                           "4QhPNAxPpL9ZzjTB7", "secret"), 1);
+    EXPECT_EQ(pwhash_check("$6$rounds=-5$salt$x", "secret"), -1);
+}
+
+TEST(PwhashTest, FallsBackToLibcForOtherFormats)
+{
+    std::string des = libc_crypt("secret", "ab");
+    EXPECT_EQ(pwhash_detect(des.c_str()), PWHASH_CRYPT);
+    EXPECT_EQ(pwhash_check(des.c_str(), "secret"), 1);
+    EXPECT_EQ(pwhash_check(des.c_str(), "wrong"), 0);
+}
+
+TEST(PwhashTest, MalformedHashesDoNotMatch)
+{
+    EXPECT_EQ(pwhash_check(nullptr, "pw"), -1);
+    EXPECT_EQ(pwhash_check("$apr1$", nullptr), -1);
+    EXPECT_NE(pwhash_check("$apr1$", "pw"), 1);
+    EXPECT_NE(pwhash_check("$5$rounds=$salt$x", "pw"), 1);
+    EXPECT_NE(pwhash_check("$6$rounds=abc$salt$x", "pw"), 1);
+    EXPECT_NE(pwhash_check("{SHA}", "pw"), 1);
+    EXPECT_NE(pwhash_check("", "pw"), 1);
+}
@@ -0,0 +1,295 @@
+/**
+ * test_redirect_map.cpp - Unit tests for compiled RedirectMap files
+ *
+ * Validates: Requirements 7.1, 7.3
+ */
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#include "file_cache_fixture.h"
+#include "mock_lsiapi.h"
+
+extern "C" {
+#include "htaccess_authpool.h"
+#include "htaccess_exec_redirect.h"
+#include "htaccess_parser.h"
+#include "htaccess_redirect_map.h"
+}
+
+class RedirectMapTest
+    : public FileCacheTest<redirect_map_stats_t, redirect_map_get_stats,
+                           redirect_map_cache_destroy> {
+protected:
+    void SetUp() override {
+        FileCacheTest::SetUp();
+        map_ = path("redirects.txt");
+        rmap_ = map_ + REDIRECT_MAP_SUFFIX;
+    }
+    void TearDown() override {
+        redirect_map_set_runner(nullptr);
+        authpool_destroy();
+        mock_lsiapi::run_events();
+        FileCacheTest::TearDown();
+    }
+    /* Mapped target of `uri`, "" on a miss, "<error>" on failure */
+    std::string lookup(const char *uri) {
+        const char *target;
+        size_t len;
+        int rc = redirect_map_lookup(map_.c_str(), uri, strlen(uri),
+                                     &target, &len);
+        if (rc < 0)
+            return "<error>";
+        return rc ? std::string(target, len) : "";
+    }
+    std::string map_;
+    std::string rmap_;
+};
+
+TEST_F(RedirectMapTest, ExactLookups)
+{
+    write_file(map_, "# moved pages\n"
+                     "/old/a https://example.com/a\n"
+                     "\n"
+                     "  /old/b\thttps://example.com/b   trailing\r\n"
+                     "/no-target\n"
+                     "/old/a https://example.com/second\n"
+                     "/last https://example.com/last");
+    EXPECT_EQ(lookup("/old/a"), "https://example.com/a");
+    EXPECT_EQ(lookup("/old/b"), "https://example.com/b");
+    EXPECT_EQ(lookup("/last"), "https://example.com/last");
+    EXPECT_EQ(lookup("/old"), "");
+    EXPECT_EQ(lookup("/old/a/"), "");
+    EXPECT_EQ(lookup("/no-target"), "");
+    EXPECT_EQ(lookup("#"), "");
+
+    redirect_map_stats_t s = stats();
+    EXPECT_EQ(s.entries, 3u);
+    EXPECT_EQ(s.builds, 1u);
+    EXPECT_EQ(s.lookups, 7u);
+}
+
+/* The compiled file is reused by the next process, not rebuilt */
+TEST_F(RedirectMapTest, CompiledFileIsReused)
+{
+    write_file(map_, "/a /x\n");
+    EXPECT_EQ(lookup("/a"), "/x");
+    struct stat st;
+    ASSERT_EQ(stat(rmap_.c_str(), &st), 0);
+    EXPECT_EQ(stats().builds, 1u);
+
+    redirect_map_cache_destroy();
+    EXPECT_EQ(lookup("/a"), "/x");
+    EXPECT_EQ(stats().builds, 0u);
+    EXPECT_EQ(stats().opens, 1u);
+}
+
+TEST_F(RedirectMapTest, ChangedTextIsRecompiled)
+{
+    write_file(map_, "/a /x\n");
+    EXPECT_EQ(lookup("/b"), "");
+    write_file(map_, "/a /x\n/b /y\n");
+    EXPECT_EQ(lookup("/b"), "/y");
+    EXPECT_EQ(stats().builds, 2u);
+    EXPECT_EQ(stats().maps, 1u);
+
+    /* A compiled file left over from older text is rebuilt too */
+    redirect_map_cache_destroy();
+    write_file(map_, "/a /x\n/b /y\n/c /z\n");
+    EXPECT_EQ(lookup("/c"), "/z");
+    EXPECT_EQ(stats().builds, 1u);
+}
+
+TEST_F(RedirectMapTest, OfflineCompile)
+{
+    write_file(map_, "/a /x\n/b /y\n/a /dup\n");
+    EXPECT_EQ(redirect_map_compile(map_.c_str(), rmap_.c_str()), 2);
+    EXPECT_EQ(lookup("/a"), "/x");
+    EXPECT_EQ(stats().builds, 0u);
+    EXPECT_EQ(stats().opens, 1u);
+    EXPECT_EQ(redirect_map_compile("/nonexistent/map", rmap_.c_str()), -1);
+}
+
+TEST_F(RedirectMapTest, DamagedCompiledFileIsRebuilt)
+{
+    write_file(map_, "/a /x\n");
+    ASSERT_EQ(redirect_map_compile(map_.c_str(), rmap_.c_str()), 1);
+    FILE *f = fopen(rmap_.c_str(), "r+");
+    ASSERT_NE(f, nullptr);
+    fseek(f, 0, SEEK_END);
+    fputs("garbage", f);
+    fclose(f);
+    EXPECT_EQ(lookup("/a"), "/x");
+    EXPECT_EQ(stats().builds, 1u);
+}
+
+/* Without a writable compiled file the image is kept in memory */
+TEST_F(RedirectMapTest, UnwritableOutputFallsBackToMemory)
+{
+    write_file(map_, "/a /x\n");
+    ASSERT_EQ(mkdir(rmap_.c_str(), 0755), 0);
+    EXPECT_EQ(lookup("/a"), "/x");
+    EXPECT_EQ(lookup("/b"), "");
+    EXPECT_EQ(stats().builds, 1u);
+}
+
+/* A compiled file others can write is read into memory, not mapped */
+TEST_F(RedirectMapTest, WritableCompiledFileIsCopied)
+{
+    write_file(map_, "/a /x\n");
+    ASSERT_EQ(redirect_map_compile(map_.c_str(), rmap_.c_str()), 1);
+    EXPECT_EQ(lookup("/a"), "/x");
+    EXPECT_EQ(stats().copies, 0u);
+
+    redirect_map_cache_destroy();
+    ASSERT_EQ(chmod(rmap_.c_str(), 0666), 0);
+    EXPECT_EQ(lookup("/a"), "/x");
+    EXPECT_EQ(stats().opens, 1u);
+    EXPECT_EQ(stats().copies, 1u);
+}
+
+static std::string large_text()
+{
+    std::string text;
+    while (text.size() <= REDIRECT_MAP_INLINE_MAX)
+        text += "/p/" + std::to_string(text.size()) + " /old\n";
+    return text;
+}
+
+/* With nothing to serve, or nothing to hand the work to, compile here */
+TEST_F(RedirectMapTest, LargeMapWithoutImageIsCompiledInline)
+{
+    std::string text = large_text();
+    write_file(map_, text + "/a /x\n");
+    EXPECT_EQ(lookup("/a"), "/x");
+    EXPECT_EQ(stats().builds, 1u);
+
+    write_file(map_, text + "/a /y\n");
+    EXPECT_EQ(lookup("/a"), "/y");
+    EXPECT_EQ(stats().builds, 2u);
+    EXPECT_EQ(stats().stale, 0u);
+    EXPECT_EQ(stats().rebuilds, 0u);
+}
+
+/* A changed large map is served stale while the pool recompiles it */
+TEST_F(RedirectMapTest, LargeMapIsRebuiltOffTheRequestPath)
+{
+    ASSERT_EQ(authpool_init(1, 4), 0);
+    redirect_map_set_runner(authpool_run);
+    std::string text = large_text();
+    write_file(map_, text + "/a /x\n");
+    EXPECT_EQ(lookup("/a"), "/x");
+    EXPECT_EQ(stats().builds, 1u);
+
+    write_file(map_, text + "/a /y\n");
+    EXPECT_EQ(lookup("/a"), "/x");
+    EXPECT_EQ(lookup("/a"), "/x");
+    EXPECT_EQ(stats().stale, 1u);
+    EXPECT_EQ(stats().rebuilds, 1u);
+    EXPECT_EQ(stats().builds, 1u);
+
+    ASSERT_EQ(mock_lsiapi::wait_events(1, 10000), 1);
+    EXPECT_EQ(mock_lsiapi::run_events(), 1);
+    EXPECT_EQ(lookup("/a"), "/y");
+    EXPECT_EQ(stats().builds, 2u);
+    EXPECT_EQ(stats().rebuilds, 1u);
+    EXPECT_EQ(stats().maps, 1u);
+
+    /* The rebuild replaced the compiled file */
+    redirect_map_cache_destroy();
+    EXPECT_EQ(lookup("/a"), "/y");
+    EXPECT_EQ(stats().opens, 1u);
+    EXPECT_EQ(stats().builds, 0u);
+}
+
+static int wait_for_release(void *arg)
+{
+    auto *released = static_cast<std::atomic<bool> *>(arg);
+    while (!released->load())
+        std::this_thread::yield();
+    return 0;
+}
+
+static void ignore_result(void *, int) {}
+
+/* A rebuild that cannot replace the compiled file is kept in memory */
+TEST_F(RedirectMapTest, UnwritableRebuildIsKeptInMemory)
+{
+    ASSERT_EQ(authpool_init(1, 4), 0);
+    redirect_map_set_runner(authpool_run);
+    std::string text = large_text();
+    write_file(map_, text + "/a /x\n");
+    EXPECT_EQ(lookup("/a"), "/x");
+
+    /* Hold the only thread until the output has become a directory */
+    std::atomic<bool> released{false};
+    ASSERT_EQ(authpool_run(wait_for_release, ignore_result, &released), 0);
+    write_file(map_, text + "/a /y\n");
+    EXPECT_EQ(lookup("/a"), "/x");
+    ASSERT_EQ(unlink(rmap_.c_str()), 0);
+    ASSERT_EQ(mkdir(rmap_.c_str(), 0755), 0);
+    released = true;
+
+    ASSERT_EQ(mock_lsiapi::wait_events(2, 10000), 2);
+    EXPECT_EQ(mock_lsiapi::run_events(), 2);
+    EXPECT_EQ(lookup("/a"), "/y");
+    EXPECT_EQ(stats().builds, 2u);
+    EXPECT_EQ(stats().rebuilds, 1u);
+    EXPECT_EQ(stats().maps, 1u);
+    rmdir(rmap_.c_str());
+}
+
+TEST_F(RedirectMapTest, MissingMapFails)
+{
+    EXPECT_EQ(lookup("/a"), "<error>");
+    write_file(map_, "/a /x\n");
+    EXPECT_EQ(lookup("/a"), "/x");
+    unlink(map_.c_str());
+    EXPECT_EQ(lookup("/a"), "<error>");
+    EXPECT_EQ(stats().maps, 0u);
+}
+
+TEST_F(RedirectMapTest, ManyEntries)
+{
+    std::string text;
+    for (int i = 0; i < 20000; i++)
+        text += "/p/" + std::to_string(i) + " /t/" + std::to_string(i) + "\n";
+    write_file(map_, text);
+    ASSERT_GT(text.size(), (size_t)REDIRECT_MAP_INLINE_MAX);
+    ASSERT_EQ(redirect_map_compile(map_.c_str(), rmap_.c_str()), 20000);
+    EXPECT_EQ(lookup("/p/0"), "/t/0");
+    EXPECT_EQ(lookup("/p/19999"), "/t/19999");
+    EXPECT_EQ(lookup("/p/20000"), "");
+    EXPECT_EQ(stats().entries, 20000u);
+}
+
+TEST_F(RedirectMapTest, ExecSetsLocationAndStatus)
+{
+    write_file(map_, "/old https://example.com/new\n");
+    std::string conf = "RedirectMap 301 " + map_ + "\n";
+    htaccess_directive_t *dirs = htaccess_parse(conf.c_str(), conf.size(),
+                                                "test");
+    ASSERT_NE(dirs, nullptr);
+    MockSession session;
+
+    session.set_request_uri("/old");
+    EXPECT_EQ(exec_redirect_map(session.handle(), dirs), 1);
+    EXPECT_EQ(session.get_status_code(), 301);
+    EXPECT_EQ(session.get_response_header("Location"),
+              "https://example.com/new");
+
+    session.reset();
+    session.set_request_uri("/other");
+    EXPECT_EQ(exec_redirect_map(session.handle(), dirs), 0);
+    EXPECT_FALSE(session.has_response_header("Location"));
+
+    unlink(map_.c_str());
+    EXPECT_EQ(exec_redirect_map(session.handle(), dirs), -1);
+    htaccess_directives_free(dirs);
+}
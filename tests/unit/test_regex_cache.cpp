@@ -0,0 +1,81 @@
+/**
+ * test_regex_cache.cpp - Unit tests for the compiled pattern cache
+ *
+ * Validates: Requirements 9.1, 11.1
+ */
+#include <gtest/gtest.h>
+#include <string>
+
+extern "C" {
+#include "htaccess_regex_cache.h"
+}
+
+class RegexCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override { regex_cache_destroy(); }
+    void TearDown() override { regex_cache_destroy(); }
+    regex_cache_stats_t stats() {
+        regex_cache_stats_t s;
+        EXPECT_EQ(regex_cache_get_stats(&s), 0);
+        return s;
+    }
+};
+
+TEST_F(RegexCacheTest, MatchesLikeRegexec)
+{
+    EXPECT_EQ(regex_cache_match("\\.(php|phtml)$", "index.phtml"), 1);
+    EXPECT_EQ(regex_cache_match("\\.(php|phtml)$", "index.html"), 0);
+    EXPECT_EQ(regex_cache_match("^/old-blog/", "/old-blog/2019"), 1);
+    EXPECT_EQ(regex_cache_match("^/old-blog/", "/blog/old-blog/"), 0);
+    EXPECT_EQ(regex_cache_match("Googlebot", "Mozilla (Googlebot/2.1)"), 1);
+    EXPECT_EQ(regex_cache_match("Googlebot", "Mozilla (bingbot)"), 0);
+    EXPECT_EQ(regex_cache_match("^$", ""), 1);
+}
+
+/* Word and buffer anchors do not make the prefilter demand characters */
+TEST_F(RegexCacheTest, WordAndBufferAnchors)
+{
+    EXPECT_EQ(regex_cache_match("\\<MSIE\\>", "Mozilla (MSIE 6.0)"), 1);
+    EXPECT_EQ(regex_cache_match("\\<wp-config\\>", "wp-config.php"), 1);
+    EXPECT_EQ(regex_cache_match("\\.php\\'", "index.php"), 1);
+    EXPECT_EQ(regex_cache_match("\\.php\\'", "index.php.bak"), 0);
+    EXPECT_EQ(regex_cache_match("\\`/foo", "/foo/bar"), 1);
+    EXPECT_EQ(regex_cache_match("\\<MSIE\\>", "Mozilla (MSIEx)"), 0);
+}
+
+TEST_F(RegexCacheTest, CompilesEachPatternOnce)
+{
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(regex_cache_match("\\.php$", "a.php"), 1);
+        EXPECT_EQ(regex_cache_match("\\.php$", "a.css"), 0);
+    }
+    regex_cache_stats_t s = stats();
+    EXPECT_EQ(s.compiles, 1u);
+    EXPECT_EQ(s.patterns, 1u);
+    /* Subjects without ".php" at the end never reach regexec() */
+    EXPECT_EQ(s.rejected, 10u);
+    EXPECT_EQ(s.execs, 10u);
+}
+
+TEST_F(RegexCacheTest, InvalidPatternIsReportedEveryTime)
+{
+    EXPECT_EQ(regex_cache_match("[bad", "bad"), -1);
+    EXPECT_EQ(regex_cache_match("[bad", "x"), -1);
+    EXPECT_EQ(stats().compiles, 1u);
+    EXPECT_EQ(regex_cache_match(nullptr, "x"), -1);
+    EXPECT_EQ(regex_cache_match("x", nullptr), -1);
+}
+
+/* More patterns than slots: colliding patterns replace each other */
+TEST_F(RegexCacheTest, StaysBounded)
+{
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < 4 * REGEX_CACHE_SLOTS; i++) {
+            std::string pat = "^/p" + std::to_string(i) + "/";
+            std::string hit = "/p" + std::to_string(i) + "/x";
+            EXPECT_EQ(regex_cache_match(pat.c_str(), hit.c_str()), 1);
+            EXPECT_EQ(regex_cache_match(pat.c_str(), "/q/x"), 0);
+        }
+    }
+    EXPECT_LE(stats().patterns, (size_t)REGEX_CACHE_SLOTS);
+}
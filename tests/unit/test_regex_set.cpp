@@ -0,0 +1,277 @@
+/**
+ * test_regex_set.cpp - Unit tests for the ordered regex set
+ *
+ * Validates: Requirements 7.2, 7.5
+ */
+#include <gtest/gtest.h>
+#include <cstring>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "htaccess_regex_set.h"
+}
+
+static std::string literal(const char *pattern)
+{
+    char buf[REGEX_LITERAL_MAX + 1];
+    size_t len = regex_required_literal(pattern, buf);
+    EXPECT_EQ(len, strlen(buf));
+    return buf;
+}
+
+TEST(RegexLiteralTest, ExtractsLongestRequiredRun)
+{
+    EXPECT_EQ(literal("^/old/(.*)$"), "/old/");
+    EXPECT_EQ(literal("\\.php$"), ".php");
+    EXPECT_EQ(literal("^/a/[0-9]+/download\\.zip"), "/download.zip");
+    EXPECT_EQ(literal("MSIE [5-6]"), "MSIE ");
+    EXPECT_EQ(literal("abc"), "abc");
+}
+
+TEST(RegexLiteralTest, DropsOptionalCharacters)
+{
+    EXPECT_EQ(literal("colou?r"), "colo");
+    EXPECT_EQ(literal("abcd*"), "abc");
+    EXPECT_EQ(literal("ab{0,2}cdef"), "cdef");
+    EXPECT_EQ(literal("xy+z"), "xy");
+}
+
+TEST(RegexLiteralTest, UnknownWhenNothingIsRequired)
+{
+    EXPECT_EQ(literal("^/(foo|bar)/"), "");
+    EXPECT_EQ(literal("foo|bar"), "");
+    EXPECT_EQ(literal("(abc)"), "");
+    EXPECT_EQ(literal(".*"), "");
+    EXPECT_EQ(literal("\\w+"), "");
+    EXPECT_EQ(literal("[abc"), "");
+    EXPECT_EQ(literal(""), "");
+}
+
+TEST(RegexLiteralTest, BracketsAndEscapes)
+{
+    EXPECT_EQ(literal("[]|]abc"), "abc");
+    EXPECT_EQ(literal("[[:alpha:]]xyz"), "xyz");
+    EXPECT_EQ(literal("a\\|b"), "a|b");
+    EXPECT_EQ(literal("\\(x\\)"), "(x)");
+}
+
+/* glibc reads \< \> \` \' as anchors that match no character */
+TEST(RegexLiteralTest, WordAndBufferAnchors)
+{
+    EXPECT_EQ(literal("\\<foo\\>"), "foo");
+    EXPECT_EQ(literal("foo\\'"), "foo");
+    EXPECT_EQ(literal("\\`/foo"), "/foo");
+    EXPECT_EQ(literal("\\<a\\>\\<b"), "a");
+}
+
+TEST(RegexLiteralTest, LongRunsAreCapped)
+{
+    std::string pat(REGEX_LITERAL_MAX + 10, 'a');
+    EXPECT_EQ(literal(pat.c_str()).size(), (size_t)REGEX_LITERAL_MAX);
+    pat.back() = '?';
+    EXPECT_EQ(literal(pat.c_str()).size(), (size_t)REGEX_LITERAL_MAX);
+}
+
+static regex_prefilter_t prefilter(const char *pattern, int cflags = 0)
+{
+    regex_prefilter_t pf;
+    regex_prefilter_compile(pattern, cflags, &pf);
+    EXPECT_EQ(pf.len, strlen(pf.lit));
+    return pf;
+}
+
+static int may_match(const regex_prefilter_t &pf, const char *s)
+{
+    return regex_prefilter_match(&pf, s, strlen(s));
+}
+
+TEST(RegexPrefilterTest, ExtractsAnchors)
+{
+    regex_prefilter_t pf = prefilter("^/old-blog/(.*)$");
+    EXPECT_EQ(pf.anchor, REGEX_ANCHOR_START);
+    EXPECT_STREQ(pf.lit, "/old-blog/");
+
+    pf = prefilter("[^/]+\\.php$");
+    EXPECT_EQ(pf.anchor, REGEX_ANCHOR_END);
+    EXPECT_STREQ(pf.lit, ".php");
+
+    pf = prefilter("^/robots\\.txt$");
+    EXPECT_EQ(pf.anchor, REGEX_ANCHOR_EXACT);
+    EXPECT_STREQ(pf.lit, "/robots.txt");
+
+    pf = prefilter("Googlebot");
+    EXPECT_EQ(pf.anchor, REGEX_ANCHOR_NONE);
+    EXPECT_STREQ(pf.lit, "Googlebot");
+}
+
+TEST(RegexPrefilterTest, AnchorsNeedAdjacentLiterals)
+{
+    /* The quantified character may be absent, so only "ab" is anchored */
+    regex_prefilter_t pf = prefilter("^abc?");
+    EXPECT_EQ(pf.anchor, REGEX_ANCHOR_START);
+    EXPECT_STREQ(pf.lit, "ab");
+
+    EXPECT_EQ(prefilter("^(x)abc").anchor, REGEX_ANCHOR_NONE);
+    EXPECT_EQ(prefilter("abc*$").anchor, REGEX_ANCHOR_NONE);
+    EXPECT_EQ(prefilter("ab\\$").anchor, REGEX_ANCHOR_NONE);
+    EXPECT_EQ(prefilter("(ab$)").len, 0u);
+    EXPECT_EQ(prefilter("^a|b$").len, 0u);
+    EXPECT_EQ(prefilter(".*").len, 0u);
+    /* \` and \' are anchors, but not the ones '^' and '$' are */
+    EXPECT_EQ(prefilter("\\`foo").anchor, REGEX_ANCHOR_NONE);
+    EXPECT_EQ(prefilter("foo\\'").anchor, REGEX_ANCHOR_NONE);
+    EXPECT_STREQ(prefilter("\\<MSIE\\>").lit, "MSIE");
+}
+
+/* A short anchor loses to a much longer unanchored literal */
+TEST(RegexPrefilterTest, PrefersLongerLiteral)
+{
+    regex_prefilter_t pf = prefilter("^/.*/download-archive/");
+    EXPECT_EQ(pf.anchor, REGEX_ANCHOR_NONE);
+    EXPECT_STREQ(pf.lit, "/download-archive/");
+
+    pf = prefilter("^/img/.*\\.png$");
+    EXPECT_EQ(pf.anchor, REGEX_ANCHOR_START);
+    EXPECT_STREQ(pf.lit, "/img/");
+}
+
+TEST(RegexPrefilterTest, Match)
+{
+    regex_prefilter_t start = prefilter("^/old/");
+    regex_prefilter_t end = prefilter("\\.php$");
+    regex_prefilter_t exact = prefilter("^/a$");
+    regex_prefilter_t any = prefilter("bot");
+    regex_prefilter_t one = prefilter("x");
+    regex_prefilter_t none = prefilter("[0-9]+");
+
+    EXPECT_TRUE(may_match(start, "/old/x"));
+    EXPECT_FALSE(may_match(start, "/x/old/"));
+    EXPECT_FALSE(may_match(start, "/old"));
+    EXPECT_TRUE(may_match(end, "index.php"));
+    EXPECT_FALSE(may_match(end, "index.php.bak"));
+    EXPECT_TRUE(may_match(exact, "/a"));
+    EXPECT_FALSE(may_match(exact, "/ab"));
+    EXPECT_TRUE(may_match(any, "Googlebot/2.1"));
+    EXPECT_TRUE(may_match(any, "bot"));
+    EXPECT_FALSE(may_match(any, "bo bo-t"));
+    EXPECT_TRUE(may_match(one, "abcx"));
+    EXPECT_FALSE(may_match(one, "abc"));
+    EXPECT_TRUE(may_match(none, ""));
+}
+
+TEST(RegexPrefilterTest, CaseInsensitive)
+{
+    regex_prefilter_t pf = prefilter("MSIE", REG_ICASE);
+    EXPECT_TRUE(may_match(pf, "Mozilla (compatible; msie 6.0)"));
+    EXPECT_FALSE(may_match(pf, "Mozilla (compatible; ms ie)"));
+    pf = prefilter("\\.PHP$", REG_ICASE);
+    EXPECT_TRUE(may_match(pf, "index.Php"));
+}
+
+class RegexSetTest : public ::testing::Test {
+protected:
+    void TearDown() override { regex_set_free(&set_); }
+    void compile(std::vector<const char *> pats, int cflags = 0)
+    {
+        n_ = pats.size();
+        ASSERT_EQ(regex_set_compile(pats.data(), pats.size(), cflags, &set_),
+                  0);
+    }
+    size_t first(const char *s, size_t from = 0)
+    {
+        return regex_set_first(&set_, s, strlen(s), from, n_);
+    }
+    regex_set_t set_ = {};
+    size_t n_ = 0;
+};
+
+TEST_F(RegexSetTest, FirstMatchInListOrder)
+{
+    compile({"^/blog/([0-9]+)$", "\\.php$", "^/(a|b)/", "/blog/"});
+    EXPECT_EQ(first("/blog/42"), 0u);
+    EXPECT_EQ(first("/blog/x"), 3u);
+    EXPECT_EQ(first("/index.php"), 1u);
+    EXPECT_EQ(first("/a/x.php"), 1u);
+    EXPECT_EQ(first("/a/x"), 2u);
+    EXPECT_EQ(first("/c/x"), 4u);
+    EXPECT_EQ(first("/blog/42", 1), 3u);
+    EXPECT_EQ(regex_set_first(&set_, "/blog/x", 7, 0, 3), 3u);
+}
+
+/* Literals that are suffixes of others share dictionary links */
+TEST_F(RegexSetTest, OverlappingLiterals)
+{
+    compile({"she$", "he", "hers", "his"});
+    EXPECT_EQ(first("ushers"), 1u);
+    EXPECT_EQ(first("ushe"), 0u);
+    EXPECT_EQ(first("ahis"), 3u);
+    EXPECT_EQ(first("hxrs"), 4u);
+}
+
+TEST_F(RegexSetTest, SharedLiteral)
+{
+    compile({"^/x/a$", "^/x/b$", "^/x/"});
+    EXPECT_EQ(first("/x/b"), 1u);
+    EXPECT_EQ(first("/x/c"), 2u);
+    EXPECT_EQ(first("/y/c"), 3u);
+}
+
+/* A candidate whose literal is not where the anchor needs it is skipped */
+TEST_F(RegexSetTest, AnchoredLiterals)
+{
+    compile({"^/old/", "\\.php$", "/old/"});
+    EXPECT_EQ(first("/old/a.php"), 0u);
+    EXPECT_EQ(first("/x/old/a.php"), 1u);
+    EXPECT_EQ(first("/x/old/a.php.txt"), 2u);
+    EXPECT_EQ(first("/x/.php/a"), 3u);
+}
+
+TEST_F(RegexSetTest, WordAndBufferAnchors)
+{
+    compile({"\\<foo\\>", "foo\\'", "\\`/foo"});
+    EXPECT_EQ(first("/foo/bar"), 0u);
+    EXPECT_EQ(first("/foo/bar", 1), 2u);
+    EXPECT_EQ(first("/xfoo", 1), 1u);
+    EXPECT_EQ(first("/xfoox", 1), 3u);
+}
+
+TEST_F(RegexSetTest, InvalidPatternsAreReported)
+{
+    compile({"^/a", "[bad", nullptr, "^/b"});
+    EXPECT_EQ(first("/a"), 0u);
+    EXPECT_EQ(first("/b"), 1u);
+    EXPECT_EQ(first("/b", 2), 2u);
+    EXPECT_EQ(first("/b", 3), 3u);
+    EXPECT_EQ(regex_set_regex(&set_, 1), nullptr);
+    EXPECT_NE(regex_set_regex(&set_, 3), nullptr);
+}
+
+TEST_F(RegexSetTest, CaseInsensitive)
+{
+    compile({"MSIE 6", "Firefox"}, REG_ICASE);
+    EXPECT_EQ(first("Mozilla/4.0 (compatible; msie 6.0)"), 0u);
+    EXPECT_EQ(first("FIREFOX/99"), 1u);
+    EXPECT_EQ(first("Chrome"), 2u);
+}
+
+/* More patterns than fit the on-stack candidate bitset */
+TEST_F(RegexSetTest, ManyPatterns)
+{
+    std::vector<std::string> pats;
+    for (int i = 0; i < 6000; i++)
+        pats.push_back("^/item/" + std::to_string(i) + "/(.*)$");
+    std::vector<const char *> ptrs;
+    for (auto &p : pats)
+        ptrs.push_back(p.c_str());
+    compile(ptrs);
+    EXPECT_EQ(first("/item/5999/x"), 5999u);
+    EXPECT_EQ(first("/item/17/x"), 17u);
+    EXPECT_EQ(first("/item/6000/x"), 6000u);
+}
+
+TEST_F(RegexSetTest, EmptySet)
+{
+    compile({});
+    EXPECT_EQ(first("/a"), 0u);
+}
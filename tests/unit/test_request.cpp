@@ -0,0 +1,123 @@
+/**
+ * test_request.cpp - Unit tests for the per-request context
+ *
+ * Validates: Requirements 6.6, 8.1, 11.1, 12.1
+ */
+#include <gtest/gtest.h>
+#include <cstring>
+#include <string>
+
+#include "mock_lsiapi.h"
+
+extern "C" {
+#include "htaccess_request.h"
+#include "htaccess_exec_acl.h"
+#include "htaccess_exec_env.h"
+#include "htaccess_exec_require.h"
+#include "htaccess_parser.h"
+}
+
+class RequestTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        mock_lsiapi::reset_global_state();
+        session_.reset();
+    }
+    MockSession session_;
+};
+
+TEST_F(RequestTest, InitReadsSessionOnce)
+{
+    session_.set_doc_root("/var/www");
+    session_.set_request_uri("/admin/login.php");
+    session_.set_method("POST");
+    session_.set_client_ip("192.0.2.10");
+
+    htaccess_request_t req;
+    htaccess_request_init(&req, session_.handle());
+
+    EXPECT_EQ(req.session, session_.handle());
+    EXPECT_EQ(std::string(req.doc_root, req.doc_root_len), "/var/www");
+    EXPECT_EQ(std::string(req.uri, req.uri_len), "/admin/login.php");
+    EXPECT_STREQ(req.filename, "login.php");
+    EXPECT_EQ(std::string(req.method, req.method_len), "POST");
+    EXPECT_EQ(std::string(req.client_ip, req.client_ip_len), "192.0.2.10");
+    ASSERT_EQ(req.client_addr_ok, 1);
+    EXPECT_EQ(req.client_addr.lo, 0x0000FFFFC000020Aull);
+}
+
+TEST_F(RequestTest, Ipv6ClientParsed)
+{
+    session_.set_client_ip("2001:db8::7");
+    htaccess_request_t req;
+    htaccess_request_init(&req, session_.handle());
+    ASSERT_EQ(req.client_addr_ok, 1);
+    EXPECT_EQ(req.client_addr.hi, 0x20010DB800000000ull);
+    EXPECT_EQ(req.client_addr.lo, 7u);
+}
+
+TEST_F(RequestTest, UnparsableClientIpKeepsText)
+{
+    session_.set_client_ip("unix:/tmp/sock");
+    htaccess_request_t req;
+    htaccess_request_init(&req, session_.handle());
+    EXPECT_NE(req.client_ip, nullptr);
+    EXPECT_EQ(req.client_addr_ok, 0);
+}
+
+TEST_F(RequestTest, DirectoryUriHasEmptyFilename)
+{
+    session_.set_request_uri("/docs/");
+    htaccess_request_t req;
+    htaccess_request_init(&req, session_.handle());
+    EXPECT_STREQ(req.filename, "");
+}
+
+TEST_F(RequestTest, NullSessionGivesEmptyContext)
+{
+    htaccess_request_t req;
+    htaccess_request_init(&req, nullptr);
+    EXPECT_EQ(req.uri, nullptr);
+    EXPECT_EQ(req.client_ip, nullptr);
+    EXPECT_EQ(req.client_addr_ok, 0);
+}
+
+TEST_F(RequestTest, SetClientIpOverridesAddress)
+{
+    session_.set_client_ip("10.0.0.1");
+    htaccess_request_t req;
+    htaccess_request_init(&req, session_.handle());
+
+    htaccess_request_set_client_ip(&req, "203.0.113.5");
+    EXPECT_EQ(req.client_ip_len, 11);
+    EXPECT_EQ(req.client_addr.lo, 0x0000FFFFCB007105ull);
+
+    htaccess_request_set_client_ip(&req, nullptr);
+    EXPECT_EQ(req.client_ip, nullptr);
+    EXPECT_EQ(req.client_addr_ok, 0);
+}
+
+/* The _req executors evaluate the context, not the session */
+TEST_F(RequestTest, ExecutorsUseContextAddress)
+{
+    const char *text = "Require ip 10.0.0.0/8\n"
+                       "Deny from 10.0.0.0/8\n"
+                       "SetEnvIf Remote_Addr ^10\\. internal=1\n";
+    htaccess_directive_t *dirs = htaccess_parse(text, strlen(text), "test");
+    ASSERT_NE(dirs, nullptr);
+
+    session_.set_client_ip("192.0.2.1");
+    htaccess_request_t req;
+    htaccess_request_init(&req, session_.handle());
+    htaccess_request_set_client_ip(&req, "10.1.1.1");
+
+    EXPECT_EQ(exec_require_req(&req, dirs), LSI_OK);
+    EXPECT_EQ(exec_access_control_req(&req, dirs), LSI_ERROR);
+    for (const htaccess_directive_t *d = dirs; d; d = d->next) {
+        if (d->type == DIR_SETENVIF)
+            EXPECT_EQ(exec_setenvif_req(&req, d), LSI_OK);
+    }
+    EXPECT_EQ(session_.get_env_var("internal"), "1");
+
+    htaccess_directives_free(dirs);
+}
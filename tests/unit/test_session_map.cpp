@@ -0,0 +1,65 @@
+/**
+ * test_session_map.cpp - Unit tests for the suspended-request map
+ *
+ * Validates: Requirements 10.4, 12.5
+ */
+#include <gtest/gtest.h>
+#include <vector>
+
+extern "C" {
+#include "htaccess_session_map.h"
+}
+
+/* Distinct fake session handles; the map never dereferences them */
+static lsi_session_t *fake_session(size_t i)
+{
+    return reinterpret_cast<lsi_session_t *>(0x10000 + i * 64);
+}
+
+TEST(SessionMapTest, EmptyMapHasNothingToTake)
+{
+    session_map_t map = SESSION_MAP_INIT;
+    EXPECT_EQ(session_map_take(&map, fake_session(1)), nullptr);
+    session_link_t l{fake_session(1), nullptr};
+    session_map_remove(&map, &l);
+    session_map_free(&map);
+}
+
+TEST(SessionMapTest, TakesEachSessionsOwnLinkAcrossGrowth)
+{
+    session_map_t map = SESSION_MAP_INIT;
+    const size_t n = 5000;
+    std::vector<session_link_t> links(n);
+
+    for (size_t i = 0; i < n; i++) {
+        links[i].session = fake_session(i);
+        ASSERT_EQ(session_map_add(&map, &links[i]), 0);
+    }
+    EXPECT_EQ(map.count, n);
+    EXPECT_GE(map.nbuckets, n / 2);
+
+    /* Odd links leave by themselves, even ones by session */
+    for (size_t i = 1; i < n; i += 2)
+        session_map_remove(&map, &links[i]);
+    for (size_t i = 0; i < n; i += 2) {
+        EXPECT_EQ(session_map_take(&map, fake_session(i)), &links[i]);
+        EXPECT_EQ(session_map_take(&map, fake_session(i + 1)), nullptr);
+    }
+    EXPECT_EQ(map.count, 0u);
+    session_map_free(&map);
+}
+
+TEST(SessionMapTest, OneSessionCanHoldSeveralLinks)
+{
+    session_map_t map = SESSION_MAP_INIT;
+    session_link_t a{fake_session(7), nullptr}, b{fake_session(7), nullptr};
+
+    ASSERT_EQ(session_map_add(&map, &a), 0);
+    ASSERT_EQ(session_map_add(&map, &b), 0);
+    session_link_t *first = session_map_take(&map, fake_session(7));
+    session_link_t *second = session_map_take(&map, fake_session(7));
+    EXPECT_TRUE((first == &a && second == &b) ||
+                (first == &b && second == &a));
+    EXPECT_EQ(session_map_take(&map, fake_session(7)), nullptr);
+    session_map_free(&map);
+}
@@ -0,0 +1,1008 @@
+/**
+ * test_shm.cpp - Unit tests for the shared brute force store
+ *
+ * Validates: Requirements 12.2, 12.3, 12.4
+ */
+#include <gtest/gtest.h>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern "C" {
+#include "htaccess_shm.h"
+}
+
+static ip_addr_t addr(const char *text)
+{
+    ip_addr_t a{};
+    EXPECT_EQ(ip_addr_parse(text, &a), 0);
+    return a;
+}
+
+class ShmTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        shm_destroy();
+        shm_set_snapshot_dir(nullptr);
+        char tmpl[] = "/tmp/shm_test_XXXXXX";
+        ASSERT_NE(mkdtemp(tmpl), nullptr);
+        dir_ = tmpl;
+    }
+    void TearDown() override {
+        shm_destroy();
+        shm_set_snapshot_dir(nullptr);
+        unlink((dir_ + "/" SHM_FILE_NAME).c_str());
+        unlink((dir_ + "/" SHM_SNAPSHOT_NAME).c_str());
+        rmdir(dir_.c_str());
+    }
+    std::string dir_;
+};
+
+TEST_F(ShmTest, UpdateThenGet)
+{
+    ASSERT_EQ(shm_init(nullptr, 64), 0);
+    ip_addr_t a = addr("192.0.2.1");
+    ip_addr_t b = addr("192.0.2.2");
+    brute_force_record_t rec = {};
+    rec.attempt_count = 3;
+    rec.first_attempt = 1000;
+    rec.blocked_until = 2000;
+    ASSERT_EQ(shm_update_record(&a, &rec), 0);
+
+    brute_force_record_t out;
+    ASSERT_EQ(shm_get_record(&a, &out), 0);
+    EXPECT_EQ(out.addr.hi, a.hi);
+    EXPECT_EQ(out.addr.lo, a.lo);
+    EXPECT_EQ(out.attempt_count, 3);
+    EXPECT_EQ(out.first_attempt, 1000);
+    EXPECT_EQ(out.blocked_until, 2000);
+    EXPECT_EQ(shm_get_record(&b, &out), -1);
+}
+
+TEST_F(ShmTest, RecordAttemptCountsUntilLimit)
+{
+    ASSERT_EQ(shm_init(nullptr, 64), 0);
+    ip_addr_t a = addr("10.0.0.1");
+    brute_force_record_t out;
+    time_t now = 100000;
+
+    EXPECT_EQ(shm_record_attempt(&a, now, 60, 3, &out), 0);
+    EXPECT_EQ(out.attempt_count, 1);
+    EXPECT_EQ(out.first_attempt, now);
+    EXPECT_EQ(shm_record_attempt(&a, now + 1, 60, 3, &out), 0);
+    EXPECT_EQ(shm_record_attempt(&a, now + 2, 60, 3, &out), 0);
+    EXPECT_EQ(out.attempt_count, 3);
+    EXPECT_EQ(shm_record_attempt(&a, now + 3, 60, 3, &out), 1);
+    EXPECT_EQ(out.attempt_count, 3);
+
+    /* Window over: a new one starts */
+    EXPECT_EQ(shm_record_attempt(&a, now + 60, 60, 3, &out), 0);
+    EXPECT_EQ(out.attempt_count, 1);
+    EXPECT_EQ(out.first_attempt, now + 60);
+}
+
+TEST_F(ShmTest, Ipv4AndMappedFormShareRecord)
+{
+    ASSERT_EQ(shm_init(nullptr, 64), 0);
+    ip_addr_t v4 = addr("203.0.113.9");
+    ip_addr_t mapped = addr("::ffff:203.0.113.9");
+    EXPECT_EQ(shm_record_attempt(&v4, 1, 60, 5, nullptr), 0);
+    brute_force_record_t out;
+    EXPECT_EQ(shm_record_attempt(&mapped, 2, 60, 5, &out), 0);
+    EXPECT_EQ(out.attempt_count, 2);
+}
+
+TEST_F(ShmTest, CapacityRoundsUpToGroup)
+{
+    /* 2 requested slots become one group of 16 */
+    ASSERT_EQ(shm_init(nullptr, 2), 0);
+    char ip[32];
+    for (int i = 0; i < 16; i++) {
+        snprintf(ip, sizeof(ip), "10.0.0.%d", i);
+        ip_addr_t a = addr(ip);
+        EXPECT_EQ(shm_record_attempt(&a, 1, 60, 5, nullptr), 0) << ip;
+    }
+    shm_stats_t stats;
+    ASSERT_EQ(shm_get_stats(&stats), 0);
+    EXPECT_EQ(stats.capacity, 16u);
+    EXPECT_EQ(stats.occupied, 16u);
+    EXPECT_EQ(stats.evictions, 0u);
+}
+
+TEST_F(ShmTest, ProbesAcrossGroups)
+{
+    /* More keys than one group: every key must stay reachable */
+    ASSERT_EQ(shm_init(nullptr, 64), 0);
+    char ip[48];
+    for (int i = 0; i < 64; i++) {
+        snprintf(ip, sizeof(ip), "2001:db8::%x", i);
+        ip_addr_t a = addr(ip);
+        ASSERT_EQ(shm_record_attempt(&a, 1, 60, 100, nullptr), 0) << ip;
+    }
+    for (int i = 0; i < 64; i++) {
+        snprintf(ip, sizeof(ip), "2001:db8::%x", i);
+        ip_addr_t a = addr(ip);
+        brute_force_record_t out;
+        ASSERT_EQ(shm_get_record(&a, &out), 0) << ip;
+        EXPECT_EQ(out.attempt_count, 1);
+    }
+}
+
+TEST_F(ShmTest, UninitializedStoreFails)
+{
+    ip_addr_t a = addr("10.0.0.1");
+    brute_force_record_t out;
+    EXPECT_EQ(shm_get_record(&a, &out), -1);
+    EXPECT_EQ(shm_record_attempt(&a, 1, 60, 5, &out), -1);
+}
+
+TEST_F(ShmTest, ForkedWorkersShareCounters)
+{
+    ASSERT_EQ(shm_init(nullptr, 1024), 0);
+    ip_addr_t a = addr("198.51.100.7");
+    const int workers = 4;
+    const int per_worker = 200;
+
+    for (int w = 0; w < workers; w++) {
+        pid_t pid = fork();
+        ASSERT_GE(pid, 0);
+        if (pid == 0) {
+            for (int i = 0; i < per_worker; i++)
+                shm_record_attempt(&a, 5000, 3600, 1 << 30, nullptr);
+            _exit(0);
+        }
+    }
+    for (int w = 0; w < workers; w++) {
+        int status = 0;
+        wait(&status);
+        EXPECT_TRUE(WIFEXITED(status));
+    }
+
+    brute_force_record_t out;
+    ASSERT_EQ(shm_get_record(&a, &out), 0);
+    EXPECT_EQ(out.attempt_count, workers * per_worker);
+}
+
+/* Workers inserting the same new addresses at once share one record each */
+TEST_F(ShmTest, ConcurrentInsertsOfOneKeyShareASlot)
+{
+    ASSERT_EQ(shm_init(nullptr, 65536), 0);
+    const int workers = 8;
+    const int keys = 30000;
+    int go[2];
+    ASSERT_EQ(pipe(go), 0);
+
+    for (int w = 0; w < workers; w++) {
+        pid_t pid = fork();
+        ASSERT_GE(pid, 0);
+        if (pid == 0) {
+            char c;
+            close(go[1]);
+            if (read(go[0], &c, 1) != 0)
+                _exit(1);
+            for (int k = 0; k < keys; k++) {
+                ip_addr_t a{};
+                a.hi = 0x20010db800000000ULL;
+                a.lo = (uint64_t)k + 1;
+                shm_record_attempt(&a, 5000, 3600, 1 << 30, nullptr);
+            }
+            _exit(0);
+        }
+    }
+    /* Closing the write end releases every worker at once */
+    close(go[0]);
+    close(go[1]);
+    for (int w = 0; w < workers; w++) {
+        int status = 0;
+        wait(&status);
+        EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+    shm_stats_t st;
+    ASSERT_EQ(shm_get_stats(&st), 0);
+    EXPECT_EQ(st.occupied, (size_t)keys);
+    for (int k = 0; k < keys; k++) {
+        ip_addr_t a{};
+        a.hi = 0x20010db800000000ULL;
+        a.lo = (uint64_t)k + 1;
+        brute_force_record_t out;
+        ASSERT_EQ(shm_get_record(&a, &out), 0);
+        EXPECT_EQ(out.attempt_count, workers) << "key " << k;
+    }
+}
+
+TEST_F(ShmTest, FileSurvivesReattach)
+{
+    ip_addr_t a = addr("2001:db8::1");
+    ASSERT_EQ(shm_init(dir_.c_str(), 128), 0);
+    EXPECT_EQ(shm_record_attempt(&a, 7000, 60, 5, nullptr), 0);
+    EXPECT_EQ(shm_record_attempt(&a, 7001, 60, 5, nullptr), 0);
+    shm_destroy();
+
+    /* Same layout: a restarted worker sees the existing counters */
+    ASSERT_EQ(shm_init((dir_ + "/").c_str(), 128), 0);
+    brute_force_record_t out;
+    ASSERT_EQ(shm_get_record(&a, &out), 0);
+    EXPECT_EQ(out.attempt_count, 2);
+}
+
+TEST_F(ShmTest, LayoutMismatchReformats)
+{
+    ip_addr_t a = addr("10.1.1.1");
+    ASSERT_EQ(shm_init(dir_.c_str(), 128), 0);
+    EXPECT_EQ(shm_record_attempt(&a, 7000, 60, 5, nullptr), 0);
+    shm_destroy();
+
+    ASSERT_EQ(shm_init(dir_.c_str(), 256), 0);
+    brute_force_record_t out;
+    EXPECT_EQ(shm_get_record(&a, &out), -1);
+}
+
+/* Another process still mapping the old table must not see it change */
+TEST_F(ShmTest, LayoutMismatchLeavesOldFileIntact)
+{
+    std::string file = dir_ + "/" SHM_FILE_NAME;
+    ASSERT_EQ(shm_init(dir_.c_str(), 128), 0);
+    int fd = open(file.c_str(), O_RDONLY);
+    ASSERT_GE(fd, 0);
+    struct stat before;
+    ASSERT_EQ(fstat(fd, &before), 0);
+    void *old = mmap(nullptr, (size_t)before.st_size, PROT_READ,
+                     MAP_SHARED, fd, 0);
+    ASSERT_NE(old, MAP_FAILED);
+    unsigned char head[64];
+    memcpy(head, old, sizeof(head));
+    shm_destroy();
+
+    ASSERT_EQ(shm_init(dir_.c_str(), 256), 0);
+    struct stat after, now;
+    ASSERT_EQ(fstat(fd, &after), 0);
+    ASSERT_EQ(stat(file.c_str(), &now), 0);
+    EXPECT_EQ(after.st_size, before.st_size);
+    EXPECT_NE(now.st_ino, before.st_ino);
+    /* Reading every page of the old mapping must not fault */
+    EXPECT_EQ(memcmp(head, old, sizeof(head)), 0);
+    volatile unsigned char sum = 0;
+    for (off_t off = 0; off < before.st_size; off += 4096)
+        sum += ((const unsigned char *)old)[off];
+    munmap(old, (size_t)before.st_size);
+    close(fd);
+
+    /* The replacement is what the next worker attaches to */
+    shm_destroy();
+    ASSERT_EQ(shm_init(dir_.c_str(), 256), 0);
+    struct stat again;
+    ASSERT_EQ(stat(file.c_str(), &again), 0);
+    EXPECT_EQ(again.st_ino, now.st_ino);
+}
+
+TEST_F(ShmTest, CreatesMissingDirectory)
+{
+    std::string nested = dir_ + "/ols";
+    ASSERT_EQ(shm_init(nested.c_str(), 16), 0);
+    EXPECT_EQ(access((nested + "/" SHM_FILE_NAME).c_str(), F_OK), 0);
+    shm_destroy();
+    unlink((nested + "/" SHM_FILE_NAME).c_str());
+    rmdir(nested.c_str());
+}
+
+/* ------------------------------------------------------------------ */
+/*  Expiry                                                             */
+/* ------------------------------------------------------------------ */
+
+TEST_F(ShmTest, ExpiryFreesOnlyDueRecords)
+{
+    ASSERT_EQ(shm_init(nullptr, 64), 0);
+    ip_addr_t short_lived = addr("10.0.0.1");
+    ip_addr_t long_lived = addr("10.0.0.2");
+    time_t t0 = 50000;
+
+    EXPECT_EQ(shm_record_attempt(&short_lived, t0, 10, 5, nullptr), 0);
+    EXPECT_EQ(shm_record_attempt(&long_lived, t0, 600, 5, nullptr), 0);
+
+    EXPECT_EQ(shm_cleanup_expired(t0 + 5), 0);
+    EXPECT_EQ(shm_cleanup_expired(t0 + 10), 1);
+
+    brute_force_record_t out;
+    EXPECT_EQ(shm_get_record(&short_lived, &out), -1);
+    ASSERT_EQ(shm_get_record(&long_lived, &out), 0);
+    EXPECT_EQ(out.attempt_count, 1);
+
+    /* Long deadlines cascade down from the higher wheel levels */
+    EXPECT_EQ(shm_cleanup_expired(t0 + 599), 0);
+    EXPECT_EQ(shm_cleanup_expired(t0 + 600), 1);
+    EXPECT_EQ(shm_get_record(&long_lived, &out), -1);
+}
+
+TEST_F(ShmTest, RenewedWindowIsRescheduled)
+{
+    ASSERT_EQ(shm_init(nullptr, 64), 0);
+    ip_addr_t a = addr("10.0.0.1");
+    time_t t0 = 50000;
+
+    EXPECT_EQ(shm_record_attempt(&a, t0, 10, 5, nullptr), 0);
+    EXPECT_EQ(shm_record_attempt(&a, t0 + 10, 10, 5, nullptr), 0);
+    EXPECT_EQ(shm_cleanup_expired(t0 + 15), 0);
+    EXPECT_EQ(shm_cleanup_expired(t0 + 20), 1);
+}
+
+TEST_F(ShmTest, BlockKeepsRecordPastWindow)
+{
+    ASSERT_EQ(shm_init(nullptr, 64), 0);
+    ip_addr_t a = addr("10.0.0.1");
+    time_t t0 = 50000;
+
+    EXPECT_EQ(shm_record_attempt(&a, t0, 10, 5, nullptr), 0);
+    brute_force_record_t rec;
+    ASSERT_EQ(shm_get_record(&a, &rec), 0);
+    rec.blocked_until = t0 + 100;
+    ASSERT_EQ(shm_update_record(&a, &rec), 0);
+
+    EXPECT_EQ(shm_cleanup_expired(t0 + 50), 0);
+    EXPECT_EQ(shm_cleanup_expired(t0 + 100), 1);
+}
+
+TEST_F(ShmTest, DeletionKeepsProbeChainsIntact)
+{
+    /* Fill two groups completely so keys overflow into the other group */
+    ASSERT_EQ(shm_init(nullptr, 32), 0);
+    time_t t0 = 50000;
+    char ip[32];
+    for (int i = 0; i < 32; i++) {
+        snprintf(ip, sizeof(ip), "192.0.2.%d", i);
+        ip_addr_t a = addr(ip);
+        /* Odd keys expire early, even keys stay */
+        ASSERT_EQ(shm_record_attempt(&a, t0, i % 2 ? 5 : 500, 5, nullptr), 0);
+    }
+    EXPECT_EQ(shm_cleanup_expired(t0 + 5), 16);
+
+    brute_force_record_t out;
+    for (int i = 0; i < 32; i++) {
+        snprintf(ip, sizeof(ip), "192.0.2.%d", i);
+        ip_addr_t a = addr(ip);
+        EXPECT_EQ(shm_get_record(&a, &out), i % 2 ? -1 : 0) << ip;
+    }
+
+    /* Freed slots are reused */
+    ip_addr_t extra = addr("198.51.100.1");
+    EXPECT_EQ(shm_record_attempt(&extra, t0 + 6, 5, 5, nullptr), 0);
+    shm_stats_t stats;
+    ASSERT_EQ(shm_get_stats(&stats), 0);
+    EXPECT_EQ(stats.occupied, 17u);
+    EXPECT_EQ(stats.expired, 16u);
+    EXPECT_EQ(stats.evictions, 0u);
+}
+
+TEST_F(ShmTest, ExpiryWorkIsBounded)
+{
+    ASSERT_EQ(shm_init(nullptr, 256), 0);
+    time_t t0 = 50000;
+    char ip[32];
+    for (int i = 0; i < 200; i++) {
+        snprintf(ip, sizeof(ip), "10.1.%d.%d", i / 256, i % 256);
+        ip_addr_t a = addr(ip);
+        ASSERT_EQ(shm_record_attempt(&a, t0, 1, 5, nullptr), 0);
+    }
+
+    int total = 0;
+    int calls = 0;
+    while (total < 200 && calls < 1000) {
+        int freed = shm_expire(t0 + 30, 8);
+        EXPECT_LE(freed, 8);
+        total += freed;
+        calls++;
+    }
+    EXPECT_EQ(total, 200);
+    EXPECT_GT(calls, 200 / 8);
+}
+
+TEST_F(ShmTest, LongIdleGapCatchesUpQuickly)
+{
+    ASSERT_EQ(shm_init(nullptr, 64), 0);
+    ip_addr_t a = addr("10.0.0.1");
+    EXPECT_EQ(shm_record_attempt(&a, 1000, 10, 5, nullptr), 0);
+
+    /* Weeks later: a handful of bounded calls finish the backlog */
+    int freed = 0;
+    for (int i = 0; i < 2000 && freed == 0; i++)
+        freed += shm_expire(1000 + 30 * 86400, SHM_EXPIRE_BUDGET);
+    EXPECT_EQ(freed, 1);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Eviction                                                           */
+/* ------------------------------------------------------------------ */
+
+/* Fill a 16-slot table; key i makes counts[i] attempts at t0 */
+static void fill_table(time_t t0, const int *counts)
+{
+    char ip[32];
+    for (int i = 0; i < 16; i++) {
+        snprintf(ip, sizeof(ip), "10.0.0.%d", i);
+        ip_addr_t a = addr(ip);
+        for (int n = 0; n < counts[i]; n++)
+            ASSERT_EQ(shm_record_attempt(&a, t0, 600, 100, nullptr), 0);
+    }
+}
+
+static bool present(const char *ip)
+{
+    ip_addr_t a = addr(ip);
+    brute_force_record_t out;
+    return shm_get_record(&a, &out) == 0;
+}
+
+TEST_F(ShmTest, FullTableEvictsLowCountRecord)
+{
+    ASSERT_EQ(shm_init(nullptr, 16), 0);
+    int counts[16];
+    for (int i = 0; i < 16; i++)
+        counts[i] = 5;
+    counts[7] = 1;
+    fill_table(50000, counts);
+
+    ip_addr_t fresh = addr("198.51.100.1");
+    brute_force_record_t out;
+    EXPECT_EQ(shm_record_attempt(&fresh, 50010, 600, 100, &out), 0);
+    EXPECT_EQ(out.attempt_count, 1);
+
+    EXPECT_FALSE(present("10.0.0.7"));
+    EXPECT_TRUE(present("198.51.100.1"));
+    EXPECT_TRUE(present("10.0.0.0"));
+    EXPECT_TRUE(present("10.0.0.15"));
+
+    shm_stats_t stats;
+    ASSERT_EQ(shm_get_stats(&stats), 0);
+    EXPECT_EQ(stats.occupied, 16u);
+    EXPECT_EQ(stats.evictions, 1u);
+    EXPECT_EQ(stats.insert_failures, 0u);
+}
+
+TEST_F(ShmTest, EvictionPrefersExpiredRecord)
+{
+    ASSERT_EQ(shm_init(nullptr, 16), 0);
+    int counts[16];
+    for (int i = 0; i < 16; i++)
+        counts[i] = 1;
+    counts[3] = 0;
+    fill_table(50000, counts);
+
+    /* Many attempts, but in a 5 s window that has already ended */
+    ip_addr_t old = addr("10.0.0.3");
+    for (int n = 0; n < 50; n++)
+        ASSERT_EQ(shm_record_attempt(&old, 50000, 5, 100, nullptr), 0);
+
+    ip_addr_t fresh = addr("198.51.100.2");
+    EXPECT_EQ(shm_record_attempt(&fresh, 50010, 600, 100, nullptr), 0);
+    EXPECT_FALSE(present("10.0.0.3"));
+    EXPECT_TRUE(present("198.51.100.2"));
+}
+
+TEST_F(ShmTest, EvictionSparesBlockedRecords)
+{
+    ASSERT_EQ(shm_init(nullptr, 16), 0);
+    int counts[16];
+    for (int i = 0; i < 16; i++)
+        counts[i] = 1;
+    fill_table(50000, counts);
+
+    /* Block everyone except 10.0.0.12 */
+    char ip[32];
+    for (int i = 0; i < 16; i++) {
+        if (i == 12)
+            continue;
+        snprintf(ip, sizeof(ip), "10.0.0.%d", i);
+        ip_addr_t a = addr(ip);
+        brute_force_record_t rec;
+        ASSERT_EQ(shm_get_record(&a, &rec), 0);
+        rec.blocked_until = 60000;
+        ASSERT_EQ(shm_update_record(&a, &rec), 0);
+    }
+
+    ip_addr_t fresh = addr("198.51.100.3");
+    EXPECT_EQ(shm_record_attempt(&fresh, 50010, 600, 100, nullptr), 0);
+    EXPECT_FALSE(present("10.0.0.12"));
+    for (int i = 0; i < 16; i++) {
+        if (i == 12)
+            continue;
+        snprintf(ip, sizeof(ip), "10.0.0.%d", i);
+        EXPECT_TRUE(present(ip)) << ip;
+    }
+}
+
+TEST_F(ShmTest, EvictedSlotStillExpires)
+{
+    ASSERT_EQ(shm_init(nullptr, 16), 0);
+    int counts[16];
+    for (int i = 0; i < 16; i++)
+        counts[i] = 3;
+    fill_table(50000, counts);
+
+    ip_addr_t fresh = addr("198.51.100.4");
+    EXPECT_EQ(shm_record_attempt(&fresh, 50010, 30, 100, nullptr), 0);
+
+    /* The new record inherits the victim's wheel entry */
+    EXPECT_EQ(shm_cleanup_expired(50040), 1);
+    EXPECT_FALSE(present("198.51.100.4"));
+    EXPECT_EQ(shm_cleanup_expired(50600), 15);
+}
+
+/* Workers evicting for the same new addresses at once share one record */
+TEST_F(ShmTest, ConcurrentEvictionsOfOneKeyShareASlot)
+{
+    ASSERT_EQ(shm_init(nullptr, 16384), 0);
+    const int workers = 8;
+    const int keys = 4000;
+    int go[2];
+
+    /* Fill every slot with records whose 5 s window has already ended */
+    for (uint64_t k = 0; k < 3 * 16384; k++) {
+        ip_addr_t a{};
+        a.hi = 0x20010db8ffff0000ULL;
+        a.lo = k + 1;
+        shm_record_attempt(&a, 40000, 5, 1 << 30, nullptr);
+    }
+    shm_stats_t st;
+    ASSERT_EQ(shm_get_stats(&st), 0);
+    ASSERT_EQ(st.occupied, 16384u);
+    uint64_t filled = st.evictions;
+
+    ASSERT_EQ(pipe(go), 0);
+    for (int w = 0; w < workers; w++) {
+        pid_t pid = fork();
+        ASSERT_GE(pid, 0);
+        if (pid == 0) {
+            char c;
+            close(go[1]);
+            if (read(go[0], &c, 1) != 0)
+                _exit(1);
+            for (int k = 0; k < keys; k++) {
+                ip_addr_t a{};
+                a.hi = 0x20010db800000000ULL;
+                a.lo = (uint64_t)k + 1;
+                shm_record_attempt(&a, 50000, 3600, 1 << 30, nullptr);
+            }
+            _exit(0);
+        }
+    }
+    close(go[0]);
+    close(go[1]);
+    for (int w = 0; w < workers; w++) {
+        int status = 0;
+        wait(&status);
+        EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+    ASSERT_EQ(shm_get_stats(&st), 0);
+    EXPECT_EQ(st.evictions - filled, (uint64_t)keys);
+    EXPECT_EQ(st.insert_failures, 0u);
+    for (int k = 0; k < keys; k++) {
+        ip_addr_t a{};
+        a.hi = 0x20010db800000000ULL;
+        a.lo = (uint64_t)k + 1;
+        brute_force_record_t out;
+        ASSERT_EQ(shm_get_record(&a, &out), 0);
+        EXPECT_EQ(out.attempt_count, workers) << "key " << k;
+    }
+
+    /* Slots given back by losing workers are freed with the rest */
+    shm_cleanup_expired(60000);
+    ASSERT_EQ(shm_get_stats(&st), 0);
+    EXPECT_EQ(st.occupied, 0u);
+}
+
+TEST_F(ShmTest, StatsRequireInit)
+{
+    shm_stats_t stats;
+    EXPECT_EQ(shm_get_stats(&stats), -1);
+    EXPECT_EQ(stats.capacity, 0u);
+}
+
+/* ------------------------------------------------------------------ */
+/*  Snapshots                                                          */
+/* ------------------------------------------------------------------ */
+
+/* Block `a` until `until` the way an operator tool would */
+static void block_until(const ip_addr_t *a, time_t until)
+{
+    brute_force_record_t rec = {};
+    rec.attempt_count = 10;
+    rec.first_attempt = until - 1000;
+    rec.blocked_until = until;
+    ASSERT_EQ(shm_update_record(a, &rec), 0);
+}
+
+TEST_F(ShmTest, SnapshotRestoresLiveRecords)
+{
+    time_t now = time(nullptr);
+    ip_addr_t active = addr("203.0.113.1");
+    ip_addr_t expired = addr("203.0.113.2");
+    ip_addr_t blocked = addr("2001:db8::66");
+    brute_force_record_t out;
+
+    ASSERT_EQ(shm_set_snapshot_dir(dir_.c_str()), 0);
+    ASSERT_EQ(shm_init(dir_.c_str(), 128), 0);
+    EXPECT_EQ(shm_record_attempt(&active, now, 600, 5, nullptr), 0);
+    EXPECT_EQ(shm_record_attempt(&active, now, 600, 5, nullptr), 0);
+    EXPECT_EQ(shm_record_attempt(&expired, now - 100, 10, 5, nullptr), 0);
+    block_until(&blocked, now + 3600);
+    EXPECT_EQ(shm_snapshot_save(now), 2);
+    shm_destroy();
+
+    /* A different capacity reformats the table, which reloads it */
+    ASSERT_EQ(shm_init(dir_.c_str(), 256), 0);
+    ASSERT_EQ(shm_get_record(&active, &out), 0);
+    EXPECT_EQ(out.attempt_count, 2);
+    EXPECT_EQ(out.first_attempt, now);
+    ASSERT_EQ(shm_get_record(&blocked, &out), 0);
+    EXPECT_EQ(out.blocked_until, now + 3600);
+    EXPECT_EQ(shm_get_record(&expired, &out), -1);
+
+    shm_stats_t stats;
+    ASSERT_EQ(shm_get_stats(&stats), 0);
+    EXPECT_EQ(stats.occupied, 2u);
+    EXPECT_EQ(stats.restored, 2u);
+
+    /* Restored records still count and expire as usual */
+    EXPECT_EQ(shm_record_attempt(&active, now, 600, 5, &out), 0);
+    EXPECT_EQ(out.attempt_count, 3);
+    EXPECT_EQ(shm_cleanup_expired(now + 600), 1);
+    EXPECT_EQ(shm_cleanup_expired(now + 3600), 1);
+}
+
+TEST_F(ShmTest, SnapshotLoadDropsRecordsExpiredSinceSave)
+{
+    time_t now = time(nullptr);
+    ip_addr_t stale = addr("192.0.2.10");
+    ip_addr_t live = addr("192.0.2.11");
+
+    ASSERT_EQ(shm_set_snapshot_dir(dir_.c_str()), 0);
+    ASSERT_EQ(shm_init(nullptr, 64), 0);
+    /* Both live when the snapshot was taken, an hour ago */
+    EXPECT_EQ(shm_record_attempt(&stale, now - 3600, 600, 5, nullptr), 0);
+    block_until(&live, now + 600);
+    EXPECT_EQ(shm_snapshot_save(now - 3600), 2);
+
+    ASSERT_EQ(shm_init(nullptr, 64), 0);
+    brute_force_record_t out;
+    EXPECT_EQ(shm_get_record(&stale, &out), -1);
+    EXPECT_EQ(shm_get_record(&live, &out), 0);
+}
+
+TEST_F(ShmTest, ReattachKeepsTableOverSnapshot)
+{
+    time_t now = time(nullptr);
+    ip_addr_t a = addr("198.51.100.1");
+
+    ASSERT_EQ(shm_set_snapshot_dir(dir_.c_str()), 0);
+    ASSERT_EQ(shm_init(dir_.c_str(), 128), 0);
+    EXPECT_EQ(shm_record_attempt(&a, now, 600, 5, nullptr), 0);
+    EXPECT_EQ(shm_snapshot_save(now), 1);
+    EXPECT_EQ(shm_record_attempt(&a, now, 600, 5, nullptr), 0);
+    shm_destroy();
+
+    /* The shared table is newer than the snapshot and is kept */
+    ASSERT_EQ(shm_init(dir_.c_str(), 128), 0);
+    brute_force_record_t out;
+    ASSERT_EQ(shm_get_record(&a, &out), 0);
+    EXPECT_EQ(out.attempt_count, 2);
+    shm_stats_t stats;
+    ASSERT_EQ(shm_get_stats(&stats), 0);
+    EXPECT_EQ(stats.restored, 0u);
+}
+
+TEST_F(ShmTest, DamagedSnapshotIsIgnored)
+{
+    time_t now = time(nullptr);
+    ip_addr_t a = addr("198.51.100.1");
+    std::string file = dir_ + "/" SHM_SNAPSHOT_NAME;
+
+    ASSERT_EQ(shm_set_snapshot_dir(dir_.c_str()), 0);
+    ASSERT_EQ(shm_init(nullptr, 64), 0);
+    EXPECT_EQ(shm_record_attempt(&a, now, 600, 5, nullptr), 0);
+    ASSERT_EQ(shm_snapshot_save(now), 1);
+    ASSERT_EQ(truncate(file.c_str(), 40), 0);
+
+    ASSERT_EQ(shm_init(nullptr, 64), 0);
+    shm_stats_t stats;
+    ASSERT_EQ(shm_get_stats(&stats), 0);
+    EXPECT_EQ(stats.occupied, 0u);
+    EXPECT_EQ(stats.restored, 0u);
+}
+
+/* Distinct addresses for filling a table */
+static ip_addr_t nth_addr(size_t i)
+{
+    ip_addr_t a{};
+    a.hi = 0x20010db800000000ULL;
+    a.lo = (uint64_t)i + 1;
+    return a;
+}
+
+static off_t file_size(const std::string &file)
+{
+    struct stat st;
+    return stat(file.c_str(), &st) == 0 ? st.st_size : -1;
+}
+
+TEST_F(ShmTest, ReloadIsLazy)
+{
+    time_t now = time(nullptr);
+    const size_t n = 1000;
+    brute_force_record_t out;
+    shm_stats_t stats;
+
+    ASSERT_EQ(shm_set_snapshot_dir(dir_.c_str()), 0);
+    ASSERT_EQ(shm_init(nullptr, 2048), 0);
+    for (size_t i = 0; i < n; i++) {
+        ip_addr_t a = nth_addr(i);
+        ASSERT_EQ(shm_record_attempt(&a, now, 600, 5, nullptr), 0);
+    }
+    ASSERT_EQ(shm_snapshot_save(now), (int)n);
+
+    /* Nothing is placed at init; a lookup brings its record in */
+    ASSERT_EQ(shm_init(nullptr, 2048), 0);
+    ASSERT_EQ(shm_get_stats(&stats), 0);
+    EXPECT_EQ(stats.occupied, 0u);
+    EXPECT_EQ(stats.restore_left, n);
+    ip_addr_t a = nth_addr(500);
+    ASSERT_EQ(shm_get_record(&a, &out), 0);
+    EXPECT_EQ(out.attempt_count, 1);
+    ASSERT_EQ(shm_get_stats(&stats), 0);
+    EXPECT_EQ(stats.occupied, 1u);
+
+    /* Bounded steps restore the rest, each record once */
+    EXPECT_GT(shm_restore(now, 100), 0);
+    EXPECT_EQ(shm_restore(now, INT_MAX), 0);
+    ASSERT_EQ(shm_get_stats(&stats), 0);
+    EXPECT_EQ(stats.occupied, n);
+    EXPECT_EQ(stats.restored, n);
+    EXPECT_EQ(stats.restore_left, 0u);
+    ASSERT_EQ(shm_get_record(&a, &out), 0);
+    EXPECT_EQ(out.attempt_count, 1);
+}
+
+TEST_F(ShmTest, AttemptDuringRestoreCountsOnSavedRecord)
+{
+    time_t now = time(nullptr);
+    ip_addr_t a = addr("198.51.100.7");
+    brute_force_record_t out;
+
+    ASSERT_EQ(shm_set_snapshot_dir(dir_.c_str()), 0);
+    ASSERT_EQ(shm_init(nullptr, 64), 0);
+    EXPECT_EQ(shm_record_attempt(&a, now, 600, 5, nullptr), 0);
+    EXPECT_EQ(shm_record_attempt(&a, now, 600, 5, nullptr), 0);
+    ASSERT_EQ(shm_snapshot_save(now), 1);
+
+    ASSERT_EQ(shm_init(nullptr, 64), 0);
+    EXPECT_EQ(shm_record_attempt(&a, now, 600, 5, &out), 0);
+    EXPECT_EQ(out.attempt_count, 3);
+    EXPECT_EQ(shm_restore(now, INT_MAX), 0);
+    ASSERT_EQ(shm_get_record(&a, &out), 0);
+    EXPECT_EQ(out.attempt_count, 3);
+}
+
+/* Workers restoring and looking up at once bring each record back once */
+TEST_F(ShmTest, ForkedWorkersShareTheRestore)
+{
+    time_t now = time(nullptr);
+    const size_t n = 5000;
+    const int workers = 4;
+
+    ASSERT_EQ(shm_set_snapshot_dir(dir_.c_str()), 0);
+    ASSERT_EQ(shm_init(nullptr, 8192), 0);
+    for (size_t i = 0; i < n; i++) {
+        ip_addr_t a = nth_addr(i);
+        ASSERT_EQ(shm_record_attempt(&a, now, 600, 5, nullptr), 0);
+    }
+    ASSERT_EQ(shm_snapshot_save(now), (int)n);
+    ASSERT_EQ(shm_init(nullptr, 8192), 0);
+
+    for (int w = 0; w < workers; w++) {
+        pid_t pid = fork();
+        ASSERT_GE(pid, 0);
+        if (pid == 0) {
+            for (size_t i = (size_t)w; i < n; i += 7) {
+                ip_addr_t a = nth_addr(i);
+                shm_record_attempt(&a, now, 600, 5, nullptr);
+                if (i % 64 == 0)
+                    shm_restore(now, 256);
+            }
+            while (shm_restore(now, 256) > 0)
+                ;
+            _exit(0);
+        }
+    }
+    for (int w = 0; w < workers; w++) {
+        int status = 0;
+        wait(&status);
+        EXPECT_TRUE(WIFEXITED(status));
+    }
+
+    shm_stats_t stats;
+    ASSERT_EQ(shm_get_stats(&stats), 0);
+    EXPECT_EQ(stats.occupied, n);
+    EXPECT_EQ(stats.restored, n);
+    EXPECT_EQ(stats.restore_left, 0u);
+    for (size_t i = 0; i < n; i++) {
+        ip_addr_t a = nth_addr(i);
+        brute_force_record_t out;
+        ASSERT_EQ(shm_get_record(&a, &out), 0);
+        /* Worker w counts addresses w, w + 7, ... once on top */
+        EXPECT_EQ(out.attempt_count, i % 7 < (size_t)workers ? 2 : 1);
+    }
+}
+
+TEST_F(ShmTest, CheckpointAppendsOnlyChangedRecords)
+{
+    time_t now = time(nullptr);
+    std::string file = dir_ + "/" SHM_SNAPSHOT_NAME;
+    ip_addr_t a = nth_addr(7);
+    brute_force_record_t out;
+
+    ASSERT_EQ(shm_set_snapshot_dir(dir_.c_str()), 0);
+    ASSERT_EQ(shm_init(nullptr, 1024), 0);
+    for (size_t i = 0; i < 500; i++) {
+        ip_addr_t b = nth_addr(i);
+        ASSERT_EQ(shm_record_attempt(&b, now, 600, 5, nullptr), 0);
+    }
+    ASSERT_EQ(shm_snapshot_save(now), 500);
+    off_t base = file_size(file);
+
+    /* Unchanged: nothing to write */
+    EXPECT_EQ(shm_snapshot_save(now), 0);
+    EXPECT_EQ(file_size(file), base);
+
+    /* One change writes that record only */
+    EXPECT_EQ(shm_record_attempt(&a, now, 600, 5, nullptr), 0);
+    EXPECT_EQ(shm_snapshot_save(now), 1);
+    EXPECT_EQ(file_size(file), base + 32);
+
+    /* The appended copy supersedes the one in the base */
+    ASSERT_EQ(shm_init(nullptr, 1024), 0);
+    ASSERT_EQ(shm_get_record(&a, &out), 0);
+    EXPECT_EQ(out.attempt_count, 2);
+    EXPECT_EQ(shm_restore(now, INT_MAX), 0);
+    shm_stats_t stats;
+    ASSERT_EQ(shm_get_stats(&stats), 0);
+    EXPECT_EQ(stats.occupied, 500u);
+    ASSERT_EQ(shm_get_record(&a, &out), 0);
+    EXPECT_EQ(out.attempt_count, 2);
+
+    /* And appends continue on the reloaded table */
+    EXPECT_EQ(shm_snapshot_save(now), 0);
+    EXPECT_EQ(shm_update_record(&a, &out), 0);
+    EXPECT_EQ(shm_snapshot_save(now), 1);
+    EXPECT_EQ(file_size(file), base + 2 * 32);
+}
+
+TEST_F(ShmTest, ClearedBlockIsCheckpointed)
+{
+    time_t now = time(nullptr);
+    ip_addr_t a = addr("192.0.2.99");
+    brute_force_record_t out;
+
+    ASSERT_EQ(shm_set_snapshot_dir(dir_.c_str()), 0);
+    ASSERT_EQ(shm_init(nullptr, 64), 0);
+    block_until(&a, now + 3600);
+    ASSERT_EQ(shm_snapshot_save(now), 1);
+    brute_force_record_t rec = {};
+    rec.attempt_count = 1;
+    rec.first_attempt = now;
+    ASSERT_EQ(shm_update_record(&a, &rec), 0);
+    /* Written although expired, to replace the blocked copy */
+    ASSERT_EQ(shm_snapshot_save(now + 1), 1);
+
+    ASSERT_EQ(shm_init(nullptr, 64), 0);
+    EXPECT_EQ(shm_get_record(&a, &out), -1);
+}
+
+TEST_F(ShmTest, FullLogIsCompacted)
+{
+    time_t now = time(nullptr);
+    std::string file = dir_ + "/" SHM_SNAPSHOT_NAME;
+    const size_t n = SHM_SNAPSHOT_LOG_MAX + 1000;
+
+    ASSERT_EQ(shm_set_snapshot_dir(dir_.c_str()), 0);
+    ASSERT_EQ(shm_init(nullptr, 2 * n), 0);
+    for (size_t i = 0; i < n; i++) {
+        ip_addr_t a = nth_addr(i);
+        ASSERT_EQ(shm_record_attempt(&a, now, 600, 5, nullptr), 0);
+    }
+    ASSERT_EQ(shm_snapshot_save(now), (int)n);
+    off_t base = file_size(file);
+
+    /* Every record changed: too many for the log, so it is rewritten */
+    for (size_t i = 0; i < n; i++) {
+        ip_addr_t a = nth_addr(i);
+        ASSERT_EQ(shm_record_attempt(&a, now, 600, 5, nullptr), 0);
+    }
+    EXPECT_EQ(shm_snapshot_save(now), (int)n);
+    EXPECT_EQ(file_size(file), base);
+
+    ASSERT_EQ(shm_init(nullptr, 2 * n), 0);
+    EXPECT_EQ(shm_restore(now, INT_MAX), 0);
+    shm_stats_t stats;
+    ASSERT_EQ(shm_get_stats(&stats), 0);
+    EXPECT_EQ(stats.occupied, n);
+    brute_force_record_t out;
+    ip_addr_t a = nth_addr(n - 1);
+    ASSERT_EQ(shm_get_record(&a, &out), 0);
+    EXPECT_EQ(out.attempt_count, 2);
+}
+
+TEST_F(ShmTest, CompactionFinishesRestore)
+{
+    time_t now = time(nullptr);
+    ip_addr_t a = addr("203.0.113.50");
+    ip_addr_t b = addr("203.0.113.51");
+    brute_force_record_t out;
+
+    ASSERT_EQ(shm_set_snapshot_dir(dir_.c_str()), 0);
+    ASSERT_EQ(shm_init(nullptr, 64), 0);
+    EXPECT_EQ(shm_record_attempt(&a, now, 600, 5, nullptr), 0);
+    EXPECT_EQ(shm_record_attempt(&b, now, 600, 5, nullptr), 0);
+    ASSERT_EQ(shm_snapshot_save(now), 2);
+
+    /* Lost snapshot: rebuilt from the table once the restore is done */
+    ASSERT_EQ(shm_init(nullptr, 64), 0);
+    EXPECT_EQ(shm_record_attempt(&a, now, 600, 5, nullptr), 0);
+    unlink((dir_ + "/" SHM_SNAPSHOT_NAME).c_str());
+    EXPECT_EQ(shm_snapshot_save(now), 2);
+
+    ASSERT_EQ(shm_init(nullptr, 64), 0);
+    EXPECT_EQ(shm_get_record(&a, &out), 0);
+    EXPECT_EQ(shm_get_record(&b, &out), 0);
+}
+
+TEST_F(ShmTest, ReattachDuringRestoreFindsSavedRecords)
+{
+    time_t now = time(nullptr);
+    ip_addr_t a = addr("198.51.100.20");
+    brute_force_record_t out;
+
+    ASSERT_EQ(shm_set_snapshot_dir(dir_.c_str()), 0);
+    ASSERT_EQ(shm_init(dir_.c_str(), 128), 0);
+    EXPECT_EQ(shm_record_attempt(&a, now, 600, 5, nullptr), 0);
+    ASSERT_EQ(shm_snapshot_save(now), 1);
+    shm_destroy();
+
+    /* Reformatted, then left mid-restore by its first worker */
+    ASSERT_EQ(shm_init(dir_.c_str(), 256), 0);
+    shm_destroy();
+    ASSERT_EQ(shm_init(dir_.c_str(), 256), 0);
+    ASSERT_EQ(shm_get_record(&a, &out), 0);
+    EXPECT_EQ(out.attempt_count, 1);
+    EXPECT_EQ(shm_restore(now, INT_MAX), 0);
+    unlink((dir_ + "/" SHM_FILE_NAME).c_str());
+}
+
+TEST_F(ShmTest, SnapshotNeedsDirectory)
+{
+    ASSERT_EQ(shm_init(nullptr, 64), 0);
+    EXPECT_EQ(shm_snapshot_save(time(nullptr)), -1);
+    EXPECT_EQ(shm_maybe_snapshot(time(nullptr), 0), 0);
+}
+
+TEST_F(ShmTest, MaybeSnapshotIsRateLimited)
+{
+    time_t now = time(nullptr);
+    std::string file = dir_ + "/" SHM_SNAPSHOT_NAME;
+
+    ASSERT_EQ(shm_set_snapshot_dir(dir_.c_str()), 0);
+    ASSERT_EQ(shm_init(nullptr, 64), 0);
+    EXPECT_EQ(shm_maybe_snapshot(now, SHM_SNAPSHOT_INTERVAL), 1);
+    EXPECT_EQ(access(file.c_str(), F_OK), 0);
+    EXPECT_EQ(shm_maybe_snapshot(now + SHM_SNAPSHOT_INTERVAL - 1,
+                                 SHM_SNAPSHOT_INTERVAL), 0);
+    EXPECT_EQ(shm_maybe_snapshot(now + SHM_SNAPSHOT_INTERVAL,
+                                 SHM_SNAPSHOT_INTERVAL), 1);
+}
@@ -0,0 +1,59 @@
+/**
+ * ols_htaccess_mapc.c - Offline compiler for RedirectMap files
+ *
+ * Compiles a RedirectMap text file into the memory-mappable format the
+ * module reads. The module compiles maps on its own when the text
+ * changes, large ones on its worker threads; running this ahead of time
+ * (at deploy, or from the redirect_maps build target) spares the first
+ * request after a change the compile. The compiled file records the
+ * identity (inode, size, modification time) of the text, so compile the
+ * file where it is served from, as the user the server runs as so that
+ * the file can be mapped rather than copied.
+ *
+ * Usage: ols_htaccess_mapc <map-file> [<output>]
+ *        (output defaults to <map-file>.rmap)
+ *
+ * Validates: Requirements 7.1, 7.3
+ */
+#include "htaccess_redirect_map.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char **argv)
+{
+    char *dst;
+    long entries;
+
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "usage: %s <map-file> [<output>]\n", argv[0]);
+        return 2;
+    }
+    if (argc == 3) {
+        dst = strdup(argv[2]);
+    } else {
+        size_t len = strlen(argv[1]);
+        dst = malloc(len + sizeof(REDIRECT_MAP_SUFFIX));
+        if (dst) {
+            memcpy(dst, argv[1], len);
+            memcpy(dst + len, REDIRECT_MAP_SUFFIX,
+                   sizeof(REDIRECT_MAP_SUFFIX));
+        }
+    }
+    if (!dst) {
+        fprintf(stderr, "%s: out of memory\n", argv[0]);
+        return 1;
+    }
+
+    entries = redirect_map_compile(argv[1], dst);
+    if (entries < 0) {
+        fprintf(stderr, "%s: cannot compile %s into %s\n", argv[0],
+                argv[1], dst);
+        free(dst);
+        return 1;
+    }
+    printf("%s: %ld entries\n", dst, entries);
+    free(dst);
+    return 0;
+}